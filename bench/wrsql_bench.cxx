@@ -0,0 +1,545 @@
+/**
+ * \file wrsql_bench.cxx
+ *
+ * \brief Throughput benchmarks for the wrSQL library's hot paths
+ *
+ * Each benchmark is run repeatedly until a minimum time has elapsed, then
+ * reported as a single line of JSON on standard output:
+ *
+ * \code
+ * {"benchmark":"exec.registered","iterations":181203,"ops":181203,
+ *  "ns_per_op":1103.6,"ops_per_sec":906123}
+ * \endcode
+ *
+ * A leading line describes the run itself. The output is intended to be
+ * collected and compared across releases.
+ *
+ * Usage: <code>wrsql_bench [--min-time-ms=N] [filter ...]</code>; when
+ * filters are given, only benchmarks whose names contain one of them run.
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <wrutil/filesystem.h>
+#include <wrutil/Format.h>
+
+#include <wrsql/BlobStream.h>
+#include <wrsql/IDSet.h>
+#include <wrsql/Session.h>
+#include <wrsql/Statement.h>
+#include <wrsql/Transaction.h>
+
+#include "SampleDB.h"
+
+
+namespace {
+
+
+using Clock = std::chrono::steady_clock;
+
+/*
+ * a benchmark performs one iteration per call and returns the number of
+ * operations that iteration performed (e.g. rows fetched), so that results
+ * are reported per operation
+ */
+struct Benchmark
+{
+        std::string                 name;
+        std::function<uint64_t ()> iterate;
+};
+
+//--------------------------------------
+
+/*
+ * temporary database file, deleted on destruction along with any journal
+ */
+struct ScratchFile
+{
+        ScratchFile() :
+                path_(wr::temp_directory_path() / wr::unique_path()) {}
+
+        ~ScratchFile()
+        {
+                wr::fs_error_code err;
+                for (auto suffix: { "", "-wal", "-shm", "-journal" }) {
+                        wr::remove(wr::path(path_.string() + suffix), err);
+                }
+        }
+
+        std::string uri() const
+                { return u8"sqlite3:" + wr::to_generic_u8string(path_); }
+
+        wr::path path_;
+};
+
+
+/*
+ * consumes a computed value so that the work producing it is not optimized
+ * away
+ */
+volatile size_t sink;
+
+
+} // anonymous namespace
+
+//--------------------------------------
+
+static void
+report(
+        const std::string &name,
+        uint64_t           iterations,
+        uint64_t           ops,
+        Clock::duration    elapsed
+)
+{
+        double ns = static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                        elapsed).count());
+        double ns_per_op = ops ? ns / ops : 0;
+
+        printf("{\"benchmark\":\"%s\",\"iterations\":%llu,\"ops\":%llu,"
+               "\"ns_per_op\":%.1f,\"ops_per_sec\":%.0f}\n",
+               name.c_str(), static_cast<unsigned long long>(iterations),
+               static_cast<unsigned long long>(ops), ns_per_op,
+               ns_per_op > 0 ? 1e9 / ns_per_op : 0.0);
+        fflush(stdout);
+}
+
+//--------------------------------------
+
+static void
+measure(
+        const Benchmark           &bench,
+        std::chrono::milliseconds  min_time
+)
+{
+        bench.iterate();  // warm up caches and compile statements
+
+        uint64_t iterations = 0, ops = 0;
+        auto     start = Clock::now();
+        auto     elapsed = Clock::duration::zero();
+
+        do {
+                ops += bench.iterate();
+                ++iterations;
+                elapsed = Clock::now() - start;
+        } while (elapsed < min_time);
+
+        report(bench.name, iterations, ops, elapsed);
+}
+
+//--------------------------------------
+
+static void
+addStatementBenchmarks(
+        std::vector<Benchmark> &benches,
+        SampleDB               &db
+)
+{
+        static const char PRODUCT_NAME_SQL[]
+                = "SELECT name FROM products WHERE code = ?";
+        static const size_t PRODUCT_NAME = wr::sql::registerStatement(
+                                                        PRODUCT_NAME_SQL);
+
+        benches.push_back({ "stmt.prepare", [&db] {
+                wr::sql::Statement stmt(db, PRODUCT_NAME_SQL);
+                stmt.begin("S10_1678");
+                return uint64_t(1);
+        }});
+
+        benches.push_back({ "exec.registered", [&db] {
+                db.exec(PRODUCT_NAME, "S10_1678");
+                return uint64_t(1);
+        }});
+
+        // one table holding a column of each type, fetched per column
+        db.exec("DROP TABLE IF EXISTS bench_values");
+        db.exec("CREATE TABLE bench_values "
+                "(i INTEGER, d REAL, t TEXT, b BLOB)");
+        db.beginTransaction([&](wr::sql::Transaction &) {
+                wr::sql::Statement insert(db, "INSERT INTO bench_values "
+                                              "VALUES (?, ?, ?, ?)");
+                std::vector<uint8_t> blob(64, 0xa5);
+                for (int n = 0; n < 1000; ++n) {
+                        insert.begin(n, n * 0.5,
+                                     "text value " + std::to_string(n),
+                                     std::vector<uint8_t>(blob));
+                }
+        });
+
+        struct { const char *name; int col; } cols[] = {
+                { "int", 0 }, { "double", 1 }, { "text", 2 }, { "blob", 3 }
+        };
+
+        for (auto &c: cols) {
+                int col = c.col;
+                benches.push_back({ std::string("step_get.") + c.name,
+                                    [&db, col] {
+                        static const size_t SELECT_VALUES
+                                = wr::sql::registerStatement(
+                                        "SELECT i, d, t, b FROM bench_values");
+                        uint64_t rows = 0;
+                        size_t   sum = 0;
+                        for (wr::sql::Row row: db.exec(SELECT_VALUES)) {
+                                switch (col) {
+                                case 0:
+                                        sum += row.get<int>(0);
+                                        break;
+                                case 1:
+                                        sum += static_cast<size_t>(
+                                                        row.get<double>(1));
+                                        break;
+                                case 2:
+                                        sum += row.get<wr::u8string_view>(2)
+                                                        .bytes();
+                                        break;
+                                default:
+                                        sum += row.colSize(3)
+                                               + (row.get<const void *>(3)
+                                                        != nullptr);
+                                        break;
+                                }
+                                ++rows;
+                        }
+                        sink = sum;
+                        return rows;
+                }});
+        }
+
+        benches.push_back({ "bind.int_text", [&db] {
+                static const size_t COUNT_MATCHES = wr::sql::registerStatement(
+                        "SELECT count(*) FROM bench_values "
+                        "WHERE i = ? AND t = ?");
+                db.exec(COUNT_MATCHES, 500, "text value 500");
+                return uint64_t(1);
+        }});
+
+        static const size_t SELECT_PRODUCTS = wr::sql::registerStatement(
+                        "SELECT code, name, line, vendor FROM products");
+
+        benches.push_back({ "column.by_index", [&db] {
+                uint64_t rows = 0;
+                size_t   bytes = 0;
+                for (wr::sql::Row row: db.exec(SELECT_PRODUCTS)) {
+                        bytes += row.get<wr::u8string_view>(1).bytes()
+                                 + row.get<wr::u8string_view>(3).bytes();
+                        ++rows;
+                }
+                sink = bytes;
+                return rows;
+        }});
+
+        benches.push_back({ "column.by_name", [&db] {
+                uint64_t rows = 0;
+                size_t   bytes = 0;
+                for (wr::sql::Row row: db.exec(SELECT_PRODUCTS)) {
+                        bytes += row.get<wr::u8string_view>("name").bytes()
+                                 + row.get<wr::u8string_view>("vendor").bytes();
+                        ++rows;
+                }
+                sink = bytes;
+                return rows;
+        }});
+}
+
+//--------------------------------------
+
+static void
+addIDSetBenchmarks(
+        std::vector<Benchmark> &benches,
+        SampleDB               &db
+)
+{
+        static const size_t SIZES[] = { 1000, 100000 };
+
+        // rows to join against, dense in [1, 200000]
+        db.exec("DROP TABLE IF EXISTS bench_rows");
+        db.exec("CREATE TABLE bench_rows "
+                "(id INTEGER PRIMARY KEY, v INTEGER NOT NULL)");
+        db.exec("WITH RECURSIVE n(x) AS "
+                "(SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < 200000) "
+                "INSERT INTO bench_rows SELECT x, x % 97 FROM n");
+
+        for (auto size: SIZES) {
+                auto ids = std::make_shared<std::vector<wr::sql::ID>>();
+                std::minstd_rand rng(static_cast<unsigned>(size));
+
+                ids->reserve(size);
+                for (size_t i = 0; i < size; ++i) {
+                        ids->push_back(1 + rng() % (2 * size));
+                }
+
+                for (auto mode: { wr::sql::IDSet::VECTOR_STORAGE,
+                                  wr::sql::IDSet::COMPRESSED_STORAGE }) {
+                        std::string suffix = wr::printStr(".%s.%u",
+                                (mode == wr::sql::IDSet::VECTOR_STORAGE)
+                                        ? "vector" : "compressed",
+                                size);
+
+                        benches.push_back({ "idset.insert" + suffix,
+                                            [ids, mode] {
+                                wr::sql::IDSet set(mode);
+                                for (auto id: *ids) {
+                                        set.insert(id);
+                                }
+                                return uint64_t(ids->size());
+                        }});
+
+                        auto other = std::make_shared<wr::sql::IDSet>(mode);
+                        for (size_t i = 0; i < ids->size(); i += 2) {
+                                other->insert((*ids)[i] + 1);
+                        }
+
+                        benches.push_back({ "idset.intersect" + suffix,
+                                            [ids, mode, other] {
+                                wr::sql::IDSet set(mode);
+                                set.insert(ids->begin(), ids->end());
+                                set.intersect(*other);
+                                return uint64_t(ids->size());
+                        }});
+
+                        auto joined = std::make_shared<wr::sql::IDSet>(db, mode);
+                        joined->insert(ids->begin(), ids->end());
+                        auto join_sql = std::make_shared<std::string>(
+                                wr::printStr("SELECT sum(v) FROM bench_rows "
+                                             "JOIN %s USING (id)", *joined));
+
+                        benches.push_back({ "idset.vtab_join" + suffix,
+                                            [&db, joined, join_sql] {
+                                db.exec(*join_sql);
+                                return uint64_t(joined->size());
+                        }});
+                }
+        }
+}
+
+//--------------------------------------
+
+static void
+addTransactionBenchmarks(
+        std::vector<Benchmark>        &benches,
+        std::vector<wr::sql::Session> &sessions,
+        const ScratchFile (&scratch)[2]
+)
+{
+        using Options = wr::sql::SessionOptions;
+
+        static const struct
+        {
+                const char           *name;
+                Options::JournalMode  mode;
+                Options::Synchronous  sync;
+        } configs[2] = {
+                { "txn.commit.delete_full", Options::DELETE_JOURNAL,
+                                            Options::FULL_SYNC },
+                { "txn.commit.wal_normal",  Options::WAL_JOURNAL,
+                                            Options::NORMAL_SYNC }
+        };
+
+        // journal mode persists in the file, so each has its own database
+        for (size_t i = 0; i < 2; ++i) {
+                auto    &config = configs[i];
+                Options  options;
+                options.journal_mode = config.mode;
+                options.synchronous = config.sync;
+
+                sessions.emplace_back(scratch[i].uri(), options);
+                wr::sql::Session *db = &sessions.back();
+
+                db->exec("CREATE TABLE IF NOT EXISTS bench_log "
+                         "(id INTEGER PRIMARY KEY, entry TEXT)");
+
+                benches.push_back({ config.name, [db] {
+                        static const size_t INSERT_LOG
+                                = wr::sql::registerStatement(
+                                        "INSERT INTO bench_log (entry) "
+                                        "VALUES ('benchmark entry')");
+                        db->beginTransaction([db](wr::sql::Transaction &) {
+                                db->exec(INSERT_LOG);
+                        });
+                        return uint64_t(1);
+                }});
+        }
+
+        wr::sql::Session *db = &sessions.back();
+
+        benches.push_back({ "txn.batch_insert.1000", [db] {
+                static const size_t INSERT_ENTRY = wr::sql::registerStatement(
+                                "INSERT INTO bench_log (entry) VALUES (?)");
+                std::vector<std::string> entries(1000, "batched entry");
+                return uint64_t(db->execBatch(INSERT_ENTRY, entries));
+        }});
+}
+
+//--------------------------------------
+
+static void
+addBlobBenchmarks(
+        std::vector<Benchmark> &benches,
+        SampleDB               &db
+)
+{
+        static const size_t BLOB_SIZE = 1 << 20, CHUNK = 64 << 10;
+
+        db.exec("DROP TABLE IF EXISTS bench_blobs");
+        db.exec("CREATE TABLE bench_blobs (id INTEGER PRIMARY KEY, body BLOB)");
+        wr::sql::Statement(db, "INSERT INTO bench_blobs (body) VALUES (?)")
+                .bindZeroBlob(1, BLOB_SIZE).begin();
+
+        auto row = db.lastInsertRowID();
+        auto buf = std::make_shared<std::vector<uint8_t>>(CHUNK, 0x5a);
+
+        benches.push_back({ "blob.write.64KiB", [&db, row, buf] {
+                wr::sql::BlobStream blob(db, "bench_blobs", "body", row,
+                                         wr::sql::BlobStream::READ_WRITE);
+                uint64_t chunks = 0;
+                while (blob.tell() < blob.size()) {
+                        blob.write(buf->data(), buf->size());
+                        ++chunks;
+                }
+                return chunks;
+        }});
+
+        benches.push_back({ "blob.read.64KiB", [&db, row, buf] {
+                wr::sql::BlobStream blob(db, "bench_blobs", "body", row);
+                uint64_t chunks = 0;
+                while (blob.read(buf->data(), buf->size())) {
+                        ++chunks;
+                }
+                return chunks;
+        }});
+}
+
+//--------------------------------------
+
+static void
+addCollationBenchmarks(
+        std::vector<Benchmark> &benches,
+        SampleDB               &db
+)
+{
+        static const int NUM_NAMES = 10000;
+
+        db.exec("DROP TABLE IF EXISTS bench_names");
+        db.exec("CREATE TABLE bench_names (name TEXT, key BLOB GENERATED "
+                "ALWAYS AS (alphanum_key(name)) STORED)");
+
+        db.beginTransaction([&](wr::sql::Transaction &) {
+                wr::sql::Statement insert(db, "INSERT INTO bench_names (name) "
+                                              "VALUES (?)");
+                std::minstd_rand rng(NUM_NAMES);
+                for (int n = 0; n < NUM_NAMES; ++n) {
+                        auto x = rng();
+                        insert.begin(wr::printStr("Customer-%u Trading Co. #%u",
+                                                  x % 5000, (x >> 16) % 97));
+                }
+        });
+
+        benches.push_back({ "collate.alphanum.order_by", [&db] {
+                uint64_t rows = 0;
+                for (wr::sql::Row row: db.exec("SELECT name FROM bench_names "
+                                               "ORDER BY name COLLATE ALPHANUM")) {
+                        (void) row;
+                        ++rows;
+                }
+                return rows;
+        }});
+
+        benches.push_back({ "collate.alphanum_key.order_by", [&db] {
+                uint64_t rows = 0;
+                for (wr::sql::Row row: db.exec("SELECT name FROM bench_names "
+                                               "ORDER BY key")) {
+                        (void) row;
+                        ++rows;
+                }
+                return rows;
+        }});
+}
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        std::chrono::milliseconds min_time(500);
+        std::vector<std::string>  filters;
+
+        for (int i = 1; i < argc; ++i) {
+                static const char MIN_TIME[] = "--min-time-ms=";
+                if (strncmp(argv[i], MIN_TIME, sizeof(MIN_TIME) - 1) == 0) {
+                        min_time = std::chrono::milliseconds(
+                                atol(argv[i] + sizeof(MIN_TIME) - 1));
+                } else {
+                        filters.emplace_back(argv[i]);
+                }
+        }
+
+        try {
+                ScratchFile                   scratch[2];
+                SampleDB                      db;
+                std::vector<wr::sql::Session> sessions;
+                std::vector<Benchmark>        benches;
+
+                db.init(":memory:");
+                sessions.reserve(2);  // benchmarks keep pointers to elements
+
+                addStatementBenchmarks(benches, db);
+                addIDSetBenchmarks(benches, db);
+                addTransactionBenchmarks(benches, sessions, scratch);
+                addBlobBenchmarks(benches, db);
+                addCollationBenchmarks(benches, db);
+
+                printf("{\"wrsql_bench\":1,\"sqlite_version\":\"%s\","
+                       "\"min_time_ms\":%lld}\n",
+                       db.exec("SELECT sqlite_version()").currentRow()
+                                .get<std::string>(0).c_str(),
+                       static_cast<long long>(min_time.count()));
+
+                for (auto &bench: benches) {
+                        bool selected = filters.empty();
+                        for (auto &filter: filters) {
+                                if (bench.name.find(filter) != bench.name.npos) {
+                                        selected = true;
+                                        break;
+                                }
+                        }
+                        if (selected) {
+                                measure(bench, min_time);
+                        }
+                }
+        } catch (std::exception &err) {
+                fprintf(stderr, "wrsql_bench: %s\n", err.what());
+                return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,437 @@
+/**
+ * \file wrsql/AsyncSession.h
+ *
+ * \brief Declaration of class \c wr::sql::AsyncSession
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_ASYNC_SESSION_H
+#define WRSQL_ASYNC_SESSION_H
+
+#include <stddef.h>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+#include <wrsql/Session.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/**
+ * \class wr::sql::AsyncSession
+ * \brief database connection driven by a dedicated executor thread
+ *
+ * An \c AsyncSession owns a \c Session and a worker thread which is the only
+ * thread ever to use that \c Session. Work is submitted from any thread as a
+ * task and queued; the worker executes tasks one at a time in submission
+ * order, so any number of statements may be submitted back to back without
+ * waiting for each to complete (the results of each are delivered through
+ * its own \c std::future). Blocking inside the worker, whether executing a
+ * statement or waiting for another connection to release a lock, never
+ * blocks the submitting thread.
+ *
+ * \code{.cpp}
+ * wr::sql::AsyncSession db("sqlite3:app.db");
+ *
+ * auto done  = db.execAsync(INSERT_EVENT, event_id, payload);
+ * auto users = db.fetchAsync<std::tuple<int, std::string>>(GET_USERS,
+ *                                                         group_id);
+ *
+ * // ... service other I/O, then collect the results
+ * done.get();
+ * for (auto &user: users.get()) { ... }
+ * \endcode
+ *
+ * Arguments to be bound to statement parameters are copied (or moved) into
+ * the task when it is submitted. Non-owning arguments such as
+ * \c u8string_view or pointers must therefore remain valid until the
+ * corresponding future becomes ready. Exceptions thrown while executing a
+ * task are stored in its future and rethrown by \c std::future::get().
+ *
+ * All \c AsyncSession methods are thread safe, except that \c open() and
+ * \c close() must not be called concurrently with each other or from within
+ * a task.
+ */
+class WRSQL_API AsyncSession
+{
+public:
+        using this_t = AsyncSession;
+
+        /// \brief unit of work executed by the worker thread
+        using Task = std::function<void (Session &)>;
+
+        ///@{
+        /**
+         * \brief object constructor
+         *
+         * The default constructor creates a closed \c AsyncSession with no
+         * worker thread. The other constructors open the connection through
+         * an implicit call to \c open().
+         *
+         * \param [in] uri
+         *      URI describing type and location of database to open
+         * \param [in] options
+         *      settings to apply to the connection
+         *
+         * \throw wr::sql::Error
+         *      invalid \c uri, permission denied, memory exhausted or
+         *      \c options could not be applied
+         */
+        AsyncSession();
+        explicit AsyncSession(const u8string_view &uri);
+        AsyncSession(const u8string_view &uri, const SessionOptions &options);
+        AsyncSession(const this_t &) = delete;
+        ///@}
+
+        /**
+         * \brief object destructor
+         *
+         * Implicitly calls \c close(), discarding any error it reports.
+         */
+        ~AsyncSession();
+
+        this_t &operator=(const this_t &) = delete;
+
+        /**
+         * \brief open connection and start worker thread
+         *
+         * If already open, \c *this is closed first by an implicit call to
+         * \c close(). The connection is opened by the new worker thread;
+         * \c open() blocks until it has done so.
+         *
+         * \param [in] uri
+         *      URI describing type and location of database to open
+         * \param [in] options
+         *      settings to apply to the connection; if not specified,
+         *      default settings are used
+         *
+         * \throw wr::sql::Error
+         *      invalid \c uri, permission denied, memory exhausted or
+         *      \c options could not be applied; the worker thread is stopped
+         */
+        void open(const u8string_view &uri);
+        void open(const u8string_view &uri, const SessionOptions &options);
+
+        /**
+         * \brief close connection and stop worker thread
+         *
+         * Blocks until every task already submitted has been executed, then
+         * closes the connection and joins the worker thread. Has no effect if
+         * \c *this is not open.
+         *
+         * \throw wr::sql::Error
+         *      statements were left active by a task submitted through
+         *      \c post(); the worker thread is nevertheless stopped
+         */
+        void close();
+
+        ///@{
+        /**
+         * \brief get status information
+         * \return
+         *      \c isOpen() returns \c true between a successful \c open()
+         *      and the following \c close()
+         * \return
+         *      \c pending() returns the number of submitted tasks not yet
+         *      started by the worker thread
+         */
+        bool isOpen() const;
+        size_t pending() const;
+        ///@}
+
+        /**
+         * \brief interrupt the statement currently being executed
+         *
+         * Has the same effect as calling \c Session::interrupt() on the
+         * worker's connection: the running task receives a
+         * \c wr::sql::Interrupt exception, which is stored in its future.
+         * Tasks still queued are not affected.
+         */
+        void interrupt();
+
+        /**
+         * \brief queue a task for execution by the worker thread
+         *
+         * Any exception escaping \c task is discarded; use \c submit() to
+         * have exceptions (and a result) delivered to the caller.
+         *
+         * \param [in] task  the task to execute
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         */
+        void post(Task task);
+
+        /**
+         * \brief queue a function for execution by the worker thread
+         *
+         * \param [in] fn
+         *      function object invoked by the worker thread with a reference
+         *      to the worker's \c Session
+         *
+         * \return future receiving the value returned by \c fn, or any
+         *      exception it throws
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         */
+        template <typename Fn>
+        std::future<typename std::result_of<
+                        typename std::decay<Fn>::type &(Session &)>::type>
+        submit(Fn &&fn);
+
+        ///@{
+        /**
+         * \brief execute a statement asynchronously, discarding any rows
+         *
+         * Equivalent to a call to \c Session::exec() made by the worker
+         * thread. The statement runs until its first result row is available
+         * and is then reset, which completes \c INSERT, \c UPDATE, \c DELETE
+         * and DDL statements.
+         *
+         * \param [in] stmt_id
+         *      ID of the precompiled statement as returned by
+         *      \c registerStatement()
+         * \param [in] sql
+         *      UTF-8-encoded SQL statement text; copied into the task
+         * \param [in] args...
+         *      optional value(s) to bind to statement parameters
+         *
+         * \return future which becomes ready once the statement has executed
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         */
+        template <typename ...Args>
+        std::future<void> execAsync(size_t stmt_id, Args &&...args);
+
+        template <typename ...Args>
+        std::future<void> execAsync(const u8string_view &sql,
+                                    Args &&...args);
+        ///@}
+
+        /**
+         * \brief execute a registered statement asynchronously and decode
+         *      all result rows
+         *
+         * Equivalent to a call to \c Statement::fetchAll() made by the worker
+         * thread.
+         *
+         * \param [in] stmt_id
+         *      ID of the precompiled statement as returned by
+         *      \c registerStatement()
+         * \param [in] args...
+         *      optional value(s) to bind to statement parameters
+         *
+         * \return future receiving all decoded rows
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         */
+        template <typename T, typename ...Args>
+        std::future<std::vector<T>> fetchAsync(size_t stmt_id,
+                                               Args &&...args);
+
+        /**
+         * \brief execute a registered statement asynchronously, delivering
+         *      result rows in batches
+         *
+         * Rows are decoded as per \c Row::as() and passed to \c on_batch
+         * in batches of \c batch_size rows (the final batch may be smaller),
+         * so that a consumer can start processing the first rows while the
+         * worker is still fetching the rest. \c on_batch is called by the
+         * worker thread; typically it hands each batch over to the
+         * consumer's own event loop. If \c on_batch throws, no further
+         * batches are delivered and the exception is stored in the returned
+         * future.
+         *
+         * \param [in] stmt_id
+         *      ID of the precompiled statement as returned by
+         *      \c registerStatement()
+         * \param [in] batch_size
+         *      maximum number of rows per batch; must be nonzero
+         * \param [in] on_batch
+         *      function receiving each batch of rows
+         * \param [in] args...
+         *      optional value(s) to bind to statement parameters
+         *
+         * \return future receiving the total number of rows delivered
+         *
+         * \throw std::invalid_argument
+         *      \c batch_size was zero
+         * \throw std::logic_error
+         *      \c *this is not open
+         */
+        template <typename T, typename ...Args>
+        std::future<size_t> fetchBatchesAsync(
+                size_t                                    stmt_id,
+                size_t                                    batch_size,
+                std::function<void (std::vector<T> &&)>   on_batch,
+                Args                                  &&...args);
+
+private:
+        struct Body;
+
+        template <typename Fn, typename Tuple, size_t ...I>
+        static auto apply_(Fn &&fn, Tuple &args, std::index_sequence<I...>)
+                -> decltype(fn(std::get<I>(args)...))
+                { return fn(std::get<I>(args)...); }
+
+        Body *body_;
+};
+
+//--------------------------------------
+
+template <typename Fn> inline auto
+AsyncSession::submit(
+        Fn &&fn
+) -> std::future<typename std::result_of<
+                        typename std::decay<Fn>::type &(Session &)>::type>
+{
+        using Result = typename std::result_of<
+                        typename std::decay<Fn>::type &(Session &)>::type;
+
+        auto task = std::make_shared<std::packaged_task<Result (Session &)>>(
+                                                        std::forward<Fn>(fn));
+        auto result = task->get_future();
+        post([task](Session &session) { (*task)(session); });
+        return result;
+}
+
+//--------------------------------------
+
+template <typename ...Args> inline std::future<void>
+AsyncSession::execAsync(
+        size_t      stmt_id,
+        Args   &&...args
+)
+{
+        return submit([stmt_id,
+                       params = std::make_tuple(std::forward<Args>(args)...)]
+                      (Session &session) mutable {
+                apply_([&](auto &...p) { session.exec(stmt_id, p...); },
+                       params, std::index_sequence_for<Args...>());
+        });
+}
+
+//--------------------------------------
+
+template <typename ...Args> inline std::future<void>
+AsyncSession::execAsync(
+        const u8string_view     &sql,
+        Args                &&...args
+)
+{
+        return submit([sql = sql.to_string(),
+                       params = std::make_tuple(std::forward<Args>(args)...)]
+                      (Session &session) mutable {
+                apply_([&](auto &...p) { session.exec(sql, p...); },
+                       params, std::index_sequence_for<Args...>());
+        });
+}
+
+//--------------------------------------
+
+template <typename T, typename ...Args> inline auto
+AsyncSession::fetchAsync(
+        size_t      stmt_id,
+        Args   &&...args
+) -> std::future<std::vector<T>>
+{
+        return submit([stmt_id,
+                       params = std::make_tuple(std::forward<Args>(args)...)]
+                      (Session &session) mutable {
+                Statement::Ptr stmt = session.statement(stmt_id);
+
+                try {
+                        return apply_([&](auto &...p) {
+                                        return stmt->fetchAll<T>(p...);
+                                }, params, std::index_sequence_for<Args...>());
+                } catch (...) {
+                        stmt->reset();
+                        throw;
+                }
+        });
+}
+
+//--------------------------------------
+
+template <typename T, typename ...Args> inline auto
+AsyncSession::fetchBatchesAsync(
+        size_t                                    stmt_id,
+        size_t                                    batch_size,
+        std::function<void (std::vector<T> &&)>   on_batch,
+        Args                                  &&...args
+) -> std::future<size_t>
+{
+        if (!batch_size) {
+                throw std::invalid_argument("AsyncSession::fetchBatchesAsync(): batch_size must be nonzero");
+        }
+
+        return submit([stmt_id, batch_size, on_batch = std::move(on_batch),
+                       params = std::make_tuple(std::forward<Args>(args)...)]
+                      (Session &session) mutable {
+                Session::ExecResult result = apply_([&](auto &...p) {
+                                return session.exec(stmt_id, p...);
+                        }, params, std::index_sequence_for<Args...>());
+
+                std::vector<T> batch;
+                size_t         total = 0;
+
+                batch.reserve(batch_size);
+
+                for (Row row: result) {
+                        batch.emplace_back();
+                        RowDecoder<T>::decode(row, batch.back());
+                        if (batch.size() == batch_size) {
+                                total += batch.size();
+                                on_batch(std::move(batch));
+                                batch.clear();
+                                batch.reserve(batch_size);
+                        }
+                }
+
+                if (!batch.empty()) {
+                        total += batch.size();
+                        on_batch(std::move(batch));
+                }
+
+                return total;
+        });
+}
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_ASYNC_SESSION_H
@@ -0,0 +1,255 @@
+/**
+ * \file wrsql/Backup.h
+ *
+ * \brief Declaration of class \c wr::sql::Backup
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_BACKUP_H
+#define WRSQL_BACKUP_H
+
+#include <chrono>
+#include <functional>
+
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+
+
+namespace wr {
+namespace sql {
+
+
+class Session;
+
+/**
+ * \class wr::sql::Backup
+ * \brief incremental copy of the contents of one database into another
+ *
+ * A \c Backup copies every page of a source database into a destination
+ * database, replacing the destination's previous contents. The copy is
+ * performed a number of pages at a time by successive calls to \c step(),
+ * leaving the source unlocked between calls so that other connections can
+ * continue to write to it while a large database is being backed up:
+ *
+ * \code{.cpp}
+ * wr::sql::Session  dest("backup.db");
+ * wr::sql::Backup   backup(dest, db);
+ *
+ * while (!backup.step(256)) {
+ *         reportProgress(backup.pageCount() - backup.remaining(),
+ *                        backup.pageCount());
+ *         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+ * }
+ * \endcode
+ *
+ * \c run() performs the same loop with an optional progress callback. If the
+ * source is modified between steps through any connection other than the
+ * source \c Session itself, the copy restarts from the beginning on the next
+ * step; changes made through the source \c Session are applied to the
+ * destination as they are made.
+ *
+ * The destination \c Session must not be used by any other thread while the
+ * backup is in progress, and both sessions must remain open until the
+ * \c Backup is closed or destroyed.
+ */
+class WRSQL_API Backup
+{
+public:
+        using this_t = Backup;
+
+        /// \brief default number of pages copied by each call to \c step()
+        enum: int { DEFAULT_STEP_PAGES = 256 };
+
+        /**
+         * \brief progress callback for \c run()
+         *
+         * Called after each step with the number of pages still to be copied
+         * and the total number of pages in the source database. Returning
+         * \c false abandons the backup.
+         */
+        using ProgressFn = std::function<bool (int remaining, int page_count)>;
+
+        ///@{
+        /**
+         * \brief object constructor
+         *
+         * The default constructor initialises a closed \c Backup. The other
+         * constructors start a backup by an implicit call to \c open().
+         *
+         * \param [in,out] other
+         *      \c Backup object to be transferred; left closed
+         * \param [in] dest
+         *      an open database connection to receive the copy
+         * \param [in] src
+         *      an open database connection to be copied; must differ from
+         *      \c dest
+         * \param [in] dest_db
+         *      name of the attached database within \c dest to be replaced
+         * \param [in] src_db
+         *      name of the attached database within \c src to be copied
+         *
+         * \throw std::logic_error
+         *      \c dest or \c src is not open
+         * \throw wr::sql::Error
+         *      the destination is in use by a read transaction, or the
+         *      named databases do not exist
+         */
+        Backup();
+        Backup(const this_t &) = delete;
+        Backup(this_t &&other);
+        Backup(Session &dest, const Session &src,
+               const u8string_view &dest_db = u8"main",
+               const u8string_view &src_db = u8"main");
+        ///@}
+
+        /**
+         * \brief object destructor
+         *
+         * Implicitly calls \c close(), abandoning the backup if incomplete.
+         */
+        ~Backup();
+
+        this_t &operator=(const this_t &) = delete;
+
+        /**
+         * \brief move assignment operator
+         *
+         * Closes \c *this if open, then transfers the state of \c other to
+         * \c *this, leaving \c other closed.
+         *
+         * \param [in,out] other  \c Backup object to be transferred
+         * \return reference to \c *this
+         */
+        this_t &operator=(this_t &&other);
+
+        /**
+         * \brief start backup of one database into another
+         *
+         * Any backup previously started by \c *this is closed first. No
+         * pages are copied until \c step() is called.
+         *
+         * \param [in] dest
+         *      an open database connection to receive the copy
+         * \param [in] src
+         *      an open database connection to be copied; must differ from
+         *      \c dest
+         * \param [in] dest_db
+         *      name of the attached database within \c dest to be replaced
+         * \param [in] src_db
+         *      name of the attached database within \c src to be copied
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      \c dest or \c src is not open
+         * \throw wr::sql::Error
+         *      the destination is in use by a read transaction, or the
+         *      named databases do not exist
+         */
+        this_t &open(Session &dest, const Session &src,
+                     const u8string_view &dest_db = u8"main",
+                     const u8string_view &src_db = u8"main");
+
+        /**
+         * \brief copy up to the given number of pages
+         *
+         * If either database is locked by another connection, no pages are
+         * copied and \c false is returned so that the step can be retried
+         * later; this function never waits for a lock.
+         *
+         * \param [in] pages
+         *      maximum number of pages to copy; negative to copy all
+         *      remaining pages
+         *
+         * \return \c true if the backup is complete, otherwise \c false
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         * \throw wr::sql::Error
+         *      a run-time database error occurred; the backup is closed
+         */
+        bool step(int pages = DEFAULT_STEP_PAGES);
+
+        /**
+         * \brief perform the remaining steps of the backup
+         *
+         * Calls \c step() until the backup completes, waiting for \c pause
+         * after each incomplete step so that other connections may lock the
+         * source database in the meantime. The backup is closed on return.
+         *
+         * \param [in] pages_per_step
+         *      number of pages to copy in each step; negative to copy all
+         *      pages in one step
+         * \param [in] pause
+         *      interval between successive steps
+         * \param [in] progress
+         *      called after each step; may be empty
+         *
+         * \return \c true if the backup completed, \c false if abandoned by
+         *      \c progress
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         * \throw wr::sql::Error
+         *      a run-time database error occurred; the backup is closed
+         */
+        bool run(int pages_per_step = DEFAULT_STEP_PAGES,
+                 std::chrono::steady_clock::duration pause
+                        = std::chrono::milliseconds(10),
+                 const ProgressFn &progress = {});
+
+        /**
+         * \brief close backup
+         *
+         * Has no effect if \c *this is not open. If the backup is incomplete
+         * then it is abandoned, leaving the destination's previous contents
+         * in place.
+         */
+        void close();
+
+        /// \brief determine whether \c *this has been opened and not closed
+        bool isOpen() const { return backup_ != nullptr; }
+
+        /**
+         * \brief number of pages still to be copied as of the last
+         *      \c step(), or zero if not open
+         */
+        int remaining() const;
+
+        /**
+         * \brief number of pages in the source database as of the last
+         *      \c step(), or zero if not open
+         */
+        int pageCount() const;
+
+private:
+        void checkOpen() const;
+
+        void    *backup_;
+        Session *dest_;
+        bool     done_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_BACKUP_H
@@ -0,0 +1,345 @@
+/**
+ * \file wrsql/BlobStream.h
+ *
+ * \brief Declaration of class \c wr::sql::BlobStream
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_BLOB_STREAM_H
+#define WRSQL_BLOB_STREAM_H
+
+#include <stddef.h>
+#include <string>
+
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+class Session;
+
+
+/**
+ * \class wr::sql::BlobStream
+ * \brief incremental access to a single BLOB or text value stored in a
+ *      database table
+ *
+ * A \c BlobStream reads or writes part of a stored value directly between
+ * the database and caller-supplied buffers, so a large value never has to
+ * be held in memory in its entirety. Once open, \c reopen() moves the
+ * stream to the same column of another row far more cheaply than opening
+ * a new stream.
+ *
+ * The size of a value cannot be changed through a \c BlobStream. To store
+ * a large value incrementally, first insert a zero-filled value of the
+ * required size with \c Statement::bindZeroBlob(), then open a writable
+ * stream on the new row and write the contents in chunks:
+ *
+ * \code{.cpp}
+ * wr::sql::Statement insert(db, "INSERT INTO documents (body) VALUES (?)");
+ * insert.bindZeroBlob(1, doc_size).begin();
+ *
+ * wr::sql::BlobStream blob(db, "documents", "body", db.lastInsertRowID(),
+ *                          wr::sql::BlobStream::READ_WRITE);
+ * while (size_t n = source.read(buf, sizeof(buf))) {
+ *         blob.write(buf, n);
+ * }
+ * \endcode
+ *
+ * A \c BlobStream must be closed (or destroyed) before its \c Session is
+ * closed. If the row it refers to is modified or deleted by any means other
+ * than the stream itself, the stream expires and subsequent reads and writes
+ * throw \c wr::sql::Error until it is closed or opened again by \c open().
+ */
+class WRSQL_API BlobStream
+{
+public:
+        using this_t = BlobStream;
+
+        /// \brief stream access mode
+        enum Mode
+        {
+                READ_ONLY = 0,
+                READ_WRITE
+        };
+
+        ///@{
+        /**
+         * \brief object constructor
+         *
+         * The default constructor initialises a closed stream. The other
+         * constructors open a stream by an implicit call to \c open().
+         *
+         * \param [in,out] other
+         *      \c BlobStream object to be transferred; left closed
+         * \param [in] session
+         *      an open database connection
+         * \param [in] table
+         *      name of table containing the value
+         * \param [in] column
+         *      name of column containing the value
+         * \param [in] row
+         *      row ID of row containing the value
+         * \param [in] mode
+         *      whether the value is to be written as well as read
+         * \param [in] db_name
+         *      name of the attached database containing \c table
+         *
+         * \throw wr::sql::Error
+         *      the table, column or row does not exist, the value is neither
+         *      BLOB nor text, or the column is indexed or part of a foreign
+         *      key and \c mode is \c READ_WRITE
+         */
+        BlobStream();
+        BlobStream(const this_t &) = delete;
+        BlobStream(this_t &&other);
+        BlobStream(const Session &session, const u8string_view &table,
+                   const u8string_view &column, ID row,
+                   Mode mode = READ_ONLY,
+                   const u8string_view &db_name = u8"main");
+        ///@}
+
+        /**
+         * \brief object destructor
+         *
+         * Implicitly calls \c close().
+         */
+        ~BlobStream();
+
+        this_t &operator=(const this_t &) = delete;
+
+        /**
+         * \brief move assignment operator
+         *
+         * Closes \c *this if open, then transfers the state of \c other to
+         * \c *this, leaving \c other closed.
+         *
+         * \param [in,out] other  \c BlobStream object to be transferred
+         * \return reference to \c *this
+         */
+        this_t &operator=(this_t &&other);
+
+        /**
+         * \brief open stream on a stored value
+         *
+         * Any value previously opened by \c *this is closed first. The
+         * stream position is set to the start of the value.
+         *
+         * \param [in] session
+         *      an open database connection
+         * \param [in] table
+         *      name of table containing the value
+         * \param [in] column
+         *      name of column containing the value
+         * \param [in] row
+         *      row ID of row containing the value
+         * \param [in] mode
+         *      whether the value is to be written as well as read
+         * \param [in] db_name
+         *      name of the attached database containing \c table
+         *
+         * \return reference to \c *this
+         *
+         * \throw wr::sql::Error
+         *      the table, column or row does not exist, the value is neither
+         *      BLOB nor text, or the column is indexed or part of a foreign
+         *      key and \c mode is \c READ_WRITE
+         */
+        this_t &open(const Session &session, const u8string_view &table,
+                     const u8string_view &column, ID row,
+                     Mode mode = READ_ONLY,
+                     const u8string_view &db_name = u8"main");
+
+        /**
+         * \brief move stream to the value in the same column of another row
+         *
+         * The stream position is set to the start of the new value. An
+         * expired stream cannot be reopened and must be opened afresh with
+         * \c open().
+         *
+         * \param [in] row  row ID of the new row
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      the stream is not open
+         * \throw wr::sql::Error
+         *      the row does not exist, its value in the stream's column is
+         *      neither BLOB nor text, or the stream has expired; the stream is
+         *      closed
+         */
+        this_t &reopen(ID row);
+
+        /**
+         * \brief close stream
+         *
+         * Has no effect if the stream is not open. Changes made by \c write()
+         * become visible to other statements on the same connection
+         * immediately and do not depend upon calling \c close().
+         */
+        void close();
+
+        /**
+         * \brief determine if the stream is open
+         * \return \c true if open, \c false otherwise
+         */
+        bool isOpen() const { return blob_ != nullptr; }
+
+        /**
+         * \brief determine if the stream was opened for writing
+         * \return \c true if opened with mode \c READ_WRITE, \c false if
+         *      opened with mode \c READ_ONLY or not open
+         */
+        bool isWritable() const { return blob_ && writable_; }
+
+        /**
+         * \brief get ID of the row containing the value
+         * \return row ID, or \c 0 if the stream is not open
+         */
+        ID row() const { return row_; }
+
+        /**
+         * \brief get size of the value in bytes
+         * \return size, or \c 0 if the stream is not open
+         */
+        size_t size() const { return size_; }
+
+        ///@{
+        /**
+         * \brief get or set stream position
+         *
+         * The position is the offset from the start of the value at which
+         * the next \c read() or \c write() takes place.
+         *
+         * \param [in] pos  new position; must not exceed \c size()
+         *
+         * \return \c tell() returns the current position; \c seek() returns
+         *      a reference to \c *this
+         *
+         * \throw std::out_of_range
+         *      <code>(pos > size())</code>
+         */
+        size_t tell() const { return pos_; }
+        this_t &seek(size_t pos);
+        ///@}
+
+        /**
+         * \brief read from current stream position
+         *
+         * Reads up to \c bytes bytes into \c buf, stopping at the end of the
+         * value, and advances the stream position past the data read.
+         *
+         * \param [out] buf    destination buffer
+         * \param [in]  bytes  maximum number of bytes to read
+         *
+         * \return number of bytes read; \c 0 at the end of the value
+         *
+         * \throw std::logic_error
+         *      the stream is not open
+         * \throw wr::sql::Error
+         *      the stream has expired or a run-time database error occurred
+         */
+        size_t read(void *buf, size_t bytes);
+
+        /**
+         * \brief write at current stream position
+         *
+         * Writes \c bytes bytes from \c data over the stored value and
+         * advances the stream position past the data written.
+         *
+         * \param [in] data   data to write
+         * \param [in] bytes  number of bytes to write
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      the stream is not open or was not opened for writing
+         * \throw std::length_error
+         *      writing \c bytes bytes would pass the end of the value
+         * \throw wr::sql::Error
+         *      the stream has expired or a run-time database error occurred
+         */
+        this_t &write(const void *data, size_t bytes);
+
+        /**
+         * \brief read from an arbitrary offset
+         *
+         * As for \c read() except that data is read from \c offset and the
+         * stream position is unchanged.
+         *
+         * \param [in]  offset  offset from start of value
+         * \param [out] buf     destination buffer
+         * \param [in]  bytes   maximum number of bytes to read
+         *
+         * \return number of bytes read; \c 0 if <code>(offset >= size())</code>
+         *
+         * \throw std::logic_error
+         *      the stream is not open
+         * \throw wr::sql::Error
+         *      the stream has expired or a run-time database error occurred
+         */
+        size_t readAt(size_t offset, void *buf, size_t bytes) const;
+
+        /**
+         * \brief write at an arbitrary offset
+         *
+         * As for \c write() except that data is written at \c offset and the
+         * stream position is unchanged.
+         *
+         * \param [in] offset  offset from start of value
+         * \param [in] data    data to write
+         * \param [in] bytes   number of bytes to write
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      the stream is not open or was not opened for writing
+         * \throw std::length_error
+         *      writing \c bytes bytes at \c offset would pass the end of the
+         *      value
+         * \throw wr::sql::Error
+         *      the stream has expired or a run-time database error occurred
+         */
+        this_t &writeAt(size_t offset, const void *data, size_t bytes);
+
+private:
+        void checkOpen() const;
+        void throwError(int status) const;
+        void markDirty() const;
+
+        void          *blob_;
+        const Session *session_;
+        ID             row_;
+        size_t         size_,
+                       pos_;
+        bool           writable_;
+        std::string    table_;     ///< if writable, for result cache
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_BLOB_STREAM_H
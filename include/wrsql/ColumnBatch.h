@@ -0,0 +1,181 @@
+/**
+ * \file wrsql/ColumnBatch.h
+ *
+ * \brief Declaration of class \c wr::sql::ColumnBatch
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_COLUMN_BATCH_H
+#define WRSQL_COLUMN_BATCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/**
+ * \class wr::sql::ColumnBatch
+ * \brief block of result rows stored column by column
+ *
+ * A \c ColumnBatch is filled by \c Statement::fetchBatch() with up to a
+ * given number of result rows, each column's values being stored
+ * contiguously so that they may be processed in bulk or handed to other
+ * systems without further copying. The buffers of each \c Column follow
+ * the Apache Arrow columnar layout:
+ *
+ * - \c validity is a bitmap holding one bit per row, least significant
+ *   bit first, which is set if the row's value is not \c NULL
+ * - \c ints and \c floats hold one value per row of an \c INT_TYPE or
+ *   \c FLOAT_TYPE column respectively, \c NULL values being stored as zero
+ * - text and BLOB values are stored end to end in \c data, the value for
+ *   row \c i occupying bytes <code>[offsets[i], offsets[i + 1])</code>;
+ *   \c NULL values are empty
+ *
+ * Since SQLite does not restrict the type of value a column may hold, the
+ * type of each \c Column is that of its first non-\c NULL value within the
+ * batch. Integer columns are widened to \c FLOAT_TYPE if a floating-point
+ * value follows; otherwise, any value not matching the column's type is
+ * converted according to SQLite's usual rules. A column having only
+ * \c NULL values has type \c NULL_TYPE and uses \c validity alone.
+ *
+ * \code
+ * wr::sql::ColumnBatch batch;
+ *
+ * stmt.begin(year);
+ * while (stmt.fetchBatch(batch, 4096)) {
+ *         auto &amounts = batch.column(2).floats;
+ *         total += std::accumulate(amounts.begin(), amounts.end(), 0.0);
+ * }
+ * \endcode
+ */
+class WRSQL_API ColumnBatch
+{
+public:
+        using this_t = ColumnBatch;
+
+        /// \brief values of one result column
+        struct Column
+        {
+                std::string           name;              ///< column name
+                ValueType             type = NULL_TYPE;  ///< type of stored values
+                size_t                null_count = 0;    ///< number of \c NULL values
+                std::vector<uint8_t>  validity;          ///< non-\c NULL bitmap
+                std::vector<int64_t>  ints;              ///< if \c INT_TYPE
+                std::vector<double>   floats;            ///< if \c FLOAT_TYPE
+                std::vector<int32_t>  offsets;           ///< if text or BLOB
+                std::vector<uint8_t>  data;              ///< if text or BLOB
+
+                /**
+                 * \brief determine whether a row's value is \c NULL
+                 * \param [in] row  row number within the batch
+                 * \return \c true if the value is \c NULL, \c false otherwise
+                 */
+                bool isNull(size_t row) const
+                        { return !(validity[row >> 3] & (1u << (row & 7))); }
+
+                ///@{
+                /**
+                 * \brief access a text or BLOB value
+                 * \param [in] row  row number within the batch
+                 * \return
+                 *      \c text() returns a view of the value as text;
+                 *      \c valueData() returns a pointer to its first byte
+                 *      and \c valueSize() its length in bytes
+                 */
+                u8string_view text(size_t row) const
+                        { return { reinterpret_cast<const char *>(
+                                                valueData(row)),
+                                   valueSize(row) }; }
+
+                const uint8_t *valueData(size_t row) const
+                        { return data.data() + offsets[row]; }
+
+                size_t valueSize(size_t row) const
+                        { return static_cast<size_t>(offsets[row + 1]
+                                                     - offsets[row]); }
+                ///@}
+        };
+
+        /**
+         * \brief default constructor
+         *
+         * Constructs an empty batch having no columns.
+         */
+        ColumnBatch() : num_rows_(0) {}
+
+        /**
+         * \brief get the number of rows held
+         * \return number of rows
+         */
+        size_t numRows() const { return num_rows_; }
+
+        /**
+         * \brief get the number of columns held
+         * \return number of columns
+         */
+        size_t numColumns() const { return cols_.size(); }
+
+        /**
+         * \brief determine whether the batch holds no rows
+         * \return \c true if \c numRows() is zero, \c false otherwise
+         */
+        bool empty() const { return !num_rows_; }
+
+        /**
+         * \brief access a column's values
+         * \param [in] col_no  zero-based column number
+         * \return reference to the column; undefined if \c col_no is out
+         *      of range
+         */
+        const Column &column(size_t col_no) const { return cols_[col_no]; }
+
+        /**
+         * \brief discard all rows
+         *
+         * The columns themselves remain, with their types reset to
+         * \c NULL_TYPE; the memory allocated to each is retained for reuse
+         * by a subsequent \c Statement::fetchBatch() call.
+         */
+        void clear();
+
+private:
+        friend Statement;
+
+        void reset(void *stmt);      // takes columns from stmt
+        void appendRow(void *stmt);  // appends stmt's current row
+
+        size_t              num_rows_;
+        std::vector<Column> cols_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_COLUMN_BATCH_H
@@ -0,0 +1,612 @@
+/**
+ * \file wrsql/Function.h
+ *
+ * \brief Declaration of class \c wr::sql::Function and supporting types
+ *      for application-defined SQL functions
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_FUNCTION_H
+#define WRSQL_FUNCTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <wrutil/optional.h>
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+class Session;
+
+
+/// \brief properties of an application-defined SQL function
+enum FunctionFlags: unsigned
+{
+        /** always returns the same result given the same arguments, so may
+            be used in indices and its calls factored out of queries */
+        DETERMINISTIC_FUNCTION = 0x1,
+        /** has no side effects, so may be used within the schema (e.g. in
+            views and triggers) even when the schema is untrusted */
+        INNOCUOUS_FUNCTION     = 0x2,
+        /// may only be invoked from top-level SQL, not from the schema
+        DIRECT_ONLY_FUNCTION   = 0x4
+};
+
+//--------------------------------------
+/**
+ * \class wr::sql::FunctionArgs
+ * \brief arguments passed to an application-defined SQL function
+ *
+ * Values are converted between types according to the underlying database
+ * implementation's usual rules; a \c NULL argument reads as zero or an empty
+ * string or BLOB. Text and BLOB values remain valid until the function
+ * returns.
+ */
+class WRSQL_API FunctionArgs
+{
+public:
+        using this_t = FunctionArgs;
+
+        /// \brief constructor, used internally by wrSQL
+        FunctionArgs(int argc, void **argv) : argc_(argc), argv_(argv) {}
+
+        /**
+         * \brief get argument information or values
+         *
+         * \param [in] i  zero-based argument number
+         *
+         * \return
+         *      \c size() returns the number of arguments passed
+         * \return
+         *      \c isNull() returns \c true if argument \c i is \c NULL
+         * \return
+         *      \c type() returns the type of argument \c i
+         * \return
+         *      \c intValue(), \c floatValue(), \c text() and \c blob()
+         *      return argument \c i converted to the respective type; the
+         *      pointer returned by \c blob() is to the BLOB's first byte
+         *      and is null if it is empty
+         */
+        int size() const { return argc_; }
+        bool isNull(int i) const;
+        ValueType type(int i) const;
+        int64_t intValue(int i) const;
+        double floatValue(int i) const;
+        u8string_view text(int i) const;
+        std::pair<const uint8_t *, size_t> blob(int i) const;
+
+private:
+        int    argc_;
+        void **argv_;
+};
+
+//--------------------------------------
+/**
+ * \class wr::sql::FunctionResult
+ * \brief result of a call to an application-defined SQL function
+ *
+ * The result is \c NULL unless one of the \c set() methods is called.
+ * Text and BLOB values are copied.
+ */
+class WRSQL_API FunctionResult
+{
+public:
+        using this_t = FunctionResult;
+
+        /// \brief constructor, used internally by wrSQL
+        explicit FunctionResult(void *context) : context_(context) {}
+
+        ///@{
+        /**
+         * \brief set the function's result
+         * \param [in] value  result value
+         * \param [in] data   first byte of BLOB result
+         * \param [in] bytes  length of BLOB result
+         */
+        void setNull();
+        void set(int64_t value);
+        void set(double value);
+        void set(const u8string_view &value);
+        void set(const void *data, size_t bytes);
+        ///@}
+
+        /**
+         * \brief fail the SQL statement invoking the function
+         *
+         * Causes the statement to throw \c wr::sql::Error with the given
+         * message. The same happens if the function throws an exception,
+         * whose \c what() text is used as the message.
+         *
+         * \param [in] msg  error message
+         */
+        void setError(const u8string_view &msg);
+
+private:
+        void *context_;
+};
+
+//--------------------------------------
+/**
+ * \struct wr::sql::FunctionArg
+ * \brief compile-time conversion of \c FunctionArgs values to C++ types
+ *
+ * Specializations are provided for arithmetic types, \c std::string,
+ * \c wr::u8string_view, <code>std::vector\<uint8_t\></code> (BLOBs) and
+ * \c wr::optional of any of these (\c nullopt if the argument is \c NULL).
+ * Applications may specialize \c FunctionArg for further types.
+ */
+template <typename T, typename = void>
+struct FunctionArg;  // not defined
+
+/// \cond
+template <typename T>
+struct FunctionArg<T, typename std::enable_if<
+                        std::is_integral<T>::value>::type>
+{
+        static T get(const FunctionArgs &args, int i)
+                { return static_cast<T>(args.intValue(i)); }
+};
+
+template <typename T>
+struct FunctionArg<T, typename std::enable_if<
+                        std::is_floating_point<T>::value>::type>
+{
+        static T get(const FunctionArgs &args, int i)
+                { return static_cast<T>(args.floatValue(i)); }
+};
+
+template <>
+struct FunctionArg<u8string_view>
+{
+        static u8string_view get(const FunctionArgs &args, int i)
+                { return args.text(i); }
+};
+
+template <>
+struct FunctionArg<std::string>
+{
+        static std::string get(const FunctionArgs &args, int i)
+                { return args.text(i).to_string(); }
+};
+
+template <>
+struct FunctionArg<std::vector<uint8_t>>
+{
+        static std::vector<uint8_t> get(const FunctionArgs &args, int i)
+        {
+                auto blob = args.blob(i);
+                return { blob.first, blob.first + blob.second };
+        }
+};
+
+template <typename T>
+struct FunctionArg<optional<T>>
+{
+        static optional<T> get(const FunctionArgs &args, int i)
+        {
+                if (args.isNull(i)) {
+                        return nullopt;
+                }
+                return FunctionArg<T>::get(args, i);
+        }
+};
+/// \endcond
+
+//--------------------------------------
+/**
+ * \struct wr::sql::FunctionReturn
+ * \brief compile-time conversion of C++ values to \c FunctionResult values
+ *
+ * Specializations are provided for the same types as \c FunctionArg, as
+ * well as <code>const char *</code> and \c std::nullptr_t.
+ */
+template <typename T, typename = void>
+struct FunctionReturn;  // not defined
+
+/// \cond
+template <typename T>
+struct FunctionReturn<T, typename std::enable_if<
+                        std::is_integral<T>::value>::type>
+{
+        static void set(FunctionResult &result, T value)
+                { result.set(static_cast<int64_t>(value)); }
+};
+
+template <typename T>
+struct FunctionReturn<T, typename std::enable_if<
+                        std::is_floating_point<T>::value>::type>
+{
+        static void set(FunctionResult &result, T value)
+                { result.set(static_cast<double>(value)); }
+};
+
+template <typename T>
+struct FunctionReturn<T, typename std::enable_if<
+                        std::is_convertible<T, u8string_view>::value>::type>
+{
+        static void set(FunctionResult &result, const T &value)
+                { result.set(u8string_view(value)); }
+};
+
+template <>
+struct FunctionReturn<std::vector<uint8_t>>
+{
+        static void set(FunctionResult &result,
+                        const std::vector<uint8_t> &value)
+                { result.set(value.data(), value.size()); }
+};
+
+template <>
+struct FunctionReturn<std::nullptr_t>
+{
+        static void set(FunctionResult &result, std::nullptr_t)
+                { result.setNull(); }
+};
+
+template <typename T>
+struct FunctionReturn<optional<T>>
+{
+        static void set(FunctionResult &result, const optional<T> &value)
+        {
+                if (value) {
+                        FunctionReturn<T>::set(result, *value);
+                } else {
+                        result.setNull();
+                }
+        }
+};
+/// \endcond
+
+//--------------------------------------
+/**
+ * \struct wr::sql::FunctionTraits
+ * \brief compile-time deduction of the signature of a function, function
+ *      pointer or function object with a single <code>operator()</code>
+ */
+template <typename F>
+struct FunctionTraits : FunctionTraits<decltype(&F::operator())> {};
+
+/// \cond
+template <typename R, typename ...A>
+struct FunctionTraits<R (A...)>
+{
+        using result_type = R;
+        using arg_types = std::tuple<typename std::decay<A>::type...>;
+
+        enum: size_t { NUM_ARGS = sizeof...(A) };
+};
+
+template <typename R, typename ...A>
+struct FunctionTraits<R (*)(A...)> : FunctionTraits<R (A...)> {};
+
+template <typename C, typename R, typename ...A>
+struct FunctionTraits<R (C::*)(A...)> : FunctionTraits<R (A...)> {};
+
+template <typename C, typename R, typename ...A>
+struct FunctionTraits<R (C::*)(A...) const> : FunctionTraits<R (A...)> {};
+/// \endcond
+
+//--------------------------------------
+/**
+ * \class wr::sql::Function
+ * \brief definition of an application-defined SQL function
+ *
+ * A \c Function may be defined on an individual \c Session by
+ * \c Session::defineFunction(), or on every connection opened with a given
+ * \c SessionOptions object by adding it to \c SessionOptions::functions,
+ * which applies it to every \c Session of a \c SessionPool or
+ * \c SessionGroup. Copies of a \c Function share the same implementation.
+ *
+ * Scalar functions are most easily created from a C++ function or lambda by
+ * \c scalar(), the number and types of whose parameters determine those of
+ * the SQL function; each argument is converted by \c FunctionArg and the
+ * return value by \c FunctionReturn (a \c void function returns \c NULL):
+ *
+ * \code
+ * db.defineFunction(wr::sql::Function::scalar("fnv1a",
+ *         [](wr::u8string_view s) {
+ *                 uint64_t h = 14695981039346656037u;
+ *                 for (unsigned char c: s) { h = (h ^ c) * 1099511628211u; }
+ *                 return static_cast<int64_t>(h);
+ *         }, wr::sql::DETERMINISTIC_FUNCTION | wr::sql::INNOCUOUS_FUNCTION));
+ * \endcode
+ *
+ * Aggregate functions are created by \c aggregate() from a default
+ * constructible state type, a step function invoked for each row with a
+ * reference to the state followed by the row's arguments, and a finish
+ * function mapping the state to the result:
+ *
+ * \code
+ * struct Product { double value = 1; };
+ *
+ * db.defineFunction(wr::sql::Function::aggregate<Product>("product",
+ *         [](Product &p, double x) { p.value *= x; },
+ *         [](Product &p) { return p.value; }));
+ * \endcode
+ *
+ * Exceptions thrown by a function cause the invoking statement to throw
+ * \c wr::sql::Error.
+ */
+class WRSQL_API Function
+{
+public:
+        using this_t = Function;
+
+        /// \brief type-erased scalar function implementation
+        using ScalarFn = std::function<void (FunctionResult &result,
+                                             const FunctionArgs &args)>;
+
+        /// \brief state of one evaluation of an aggregate function
+        class WRSQL_API Aggregate
+        {
+        public:
+                virtual ~Aggregate();
+
+                /// \brief accumulate one row's arguments
+                virtual void step(const FunctionArgs &args) = 0;
+
+                /// \brief produce the function's result
+                virtual void finish(FunctionResult &result) = 0;
+        };
+
+        /// \brief creates the state for each evaluation of an aggregate
+        using AggregateFactory = std::function<std::unique_ptr<Aggregate> ()>;
+
+        ///@{
+        /**
+         * \brief constructor
+         *
+         * \param [in] name
+         *      SQL name of function
+         * \param [in] num_args
+         *      number of arguments taken, or -1 for any number
+         * \param [in] fn
+         *      scalar function implementation
+         * \param [in] factory
+         *      aggregate function implementation
+         * \param [in] flags
+         *      bitwise-OR of \c FunctionFlags values
+         */
+        Function(const u8string_view &name, int num_args, ScalarFn fn,
+                 unsigned flags = 0);
+        Function(const u8string_view &name, int num_args,
+                 AggregateFactory factory, unsigned flags = 0);
+        ///@}
+
+        /**
+         * \brief create a scalar function from a C++ callable
+         *
+         * \param [in] name   SQL name of function
+         * \param [in] fn     function, function pointer or function object
+         * \param [in] flags  bitwise-OR of \c FunctionFlags values
+         *
+         * \return new \c Function object
+         */
+        template <typename F>
+        static Function scalar(const u8string_view &name, F fn,
+                               unsigned flags = 0);
+
+        /**
+         * \brief create an aggregate function from C++ callables
+         *
+         * \param [in] name
+         *      SQL name of function
+         * \param [in] step
+         *      invoked as <code>step(State &, args...)</code> for each row
+         * \param [in] finish
+         *      invoked as <code>finish(State &)</code> to give the result
+         * \param [in] flags
+         *      bitwise-OR of \c FunctionFlags values
+         *
+         * \return new \c Function object
+         */
+        template <typename State, typename Step, typename Finish>
+        static Function aggregate(const u8string_view &name, Step step,
+                                  Finish finish, unsigned flags = 0);
+
+        ///@{
+        /**
+         * \brief get function properties
+         * \return
+         *      \c name() returns the function's SQL name, \c numArgs()
+         *      the number of arguments it takes (-1 if any number),
+         *      \c flags() its \c FunctionFlags and \c isAggregate() whether
+         *      it is an aggregate function
+         */
+        u8string_view name() const;
+        int numArgs() const;
+        unsigned flags() const;
+        bool isAggregate() const;
+        ///@}
+
+private:
+        friend Session;
+
+        struct Body;
+
+        template <typename Args, typename F, size_t ...I>
+        static decltype(auto) invoke_(F &fn, const FunctionArgs &args,
+                                      std::index_sequence<I...>);
+
+        template <typename R, typename Args, typename F>
+        static void call_(F &fn, FunctionResult &result,
+                          const FunctionArgs &args, std::false_type);
+
+        template <typename R, typename Args, typename F>
+        static void call_(F &fn, FunctionResult &result,
+                          const FunctionArgs &args, std::true_type);
+
+        int define(void *db) const;  // returns database status code
+
+        std::shared_ptr<const Body> body_;
+};
+
+//--------------------------------------
+
+/// \cond
+template <typename Tuple, typename Seq> struct FunctionArgsTail_;
+
+template <typename Tuple, size_t ...I>
+struct FunctionArgsTail_<Tuple, std::index_sequence<I...>>
+{
+        using type = std::tuple<typename std::tuple_element<I + 1,
+                                                            Tuple>::type...>;
+};
+/// \endcond
+
+//--------------------------------------
+
+template <typename Args, typename F, size_t ...I> inline decltype(auto)
+Function::invoke_(
+        F                  &fn,
+        const FunctionArgs &args,
+        std::index_sequence<I...>
+) // static
+{
+        return fn(FunctionArg<typename std::tuple_element<I, Args>::type>
+                        ::get(args, static_cast<int>(I))...);
+}
+
+//--------------------------------------
+
+template <typename R, typename Args, typename F> inline void
+Function::call_(
+        F                  &fn,
+        FunctionResult     &result,
+        const FunctionArgs &args,
+        std::false_type     // R is not void
+) // static
+{
+        FunctionReturn<typename std::decay<R>::type>::set(result,
+                invoke_<Args>(fn, args, std::make_index_sequence<
+                                        std::tuple_size<Args>::value>()));
+}
+
+//--------------------------------------
+
+template <typename R, typename Args, typename F> inline void
+Function::call_(
+        F                  &fn,
+        FunctionResult     &,
+        const FunctionArgs &args,
+        std::true_type      // R is void; result remains NULL
+) // static
+{
+        invoke_<Args>(fn, args, std::make_index_sequence<
+                                        std::tuple_size<Args>::value>());
+}
+
+//--------------------------------------
+
+template <typename F> inline Function
+Function::scalar(
+        const u8string_view &name,
+        F                    fn,
+        unsigned             flags
+) // static
+{
+        using Traits = FunctionTraits<F>;
+        using R = typename Traits::result_type;
+        using Args = typename Traits::arg_types;
+
+        return Function(name, static_cast<int>(Traits::NUM_ARGS),
+                        ScalarFn([fn](FunctionResult     &result,
+                                      const FunctionArgs &args) mutable {
+                call_<R, Args>(fn, result, args, std::is_void<R>());
+        }), flags);
+}
+
+//--------------------------------------
+
+template <typename State, typename Step, typename Finish> inline Function
+Function::aggregate(
+        const u8string_view &name,
+        Step                 step,
+        Finish               finish,
+        unsigned             flags
+) // static
+{
+        using StepTraits = FunctionTraits<Step>;
+        using R = typename FunctionTraits<Finish>::result_type;
+
+        static_assert(StepTraits::NUM_ARGS >= 1,
+                      "aggregate step function must take a State reference");
+
+        // the SQL arguments follow the state in the step function
+        using Args = typename FunctionArgsTail_<
+                        typename StepTraits::arg_types,
+                        std::make_index_sequence<StepTraits::NUM_ARGS - 1>
+                     >::type;
+
+        using Fns = std::pair<Step, Finish>;
+
+        struct Impl : Aggregate
+        {
+                explicit Impl(const std::shared_ptr<Fns> &fns) :
+                        fns_(fns), state_() {}
+
+                void step(const FunctionArgs &args) override
+                {
+                        auto step_state = [this](auto &&...values) {
+                                fns_->first(state_, std::forward<
+                                                decltype(values)>(values)...);
+                        };
+                        invoke_<Args>(step_state, args,
+                                      std::make_index_sequence<
+                                                StepTraits::NUM_ARGS - 1>());
+                }
+
+                void finish(FunctionResult &result) override
+                {
+                        FunctionReturn<typename std::decay<R>::type>::set(
+                                result, fns_->second(state_));
+                }
+
+                std::shared_ptr<Fns> fns_;
+                State                state_;
+        };
+
+        auto fns = std::make_shared<Fns>(std::move(step), std::move(finish));
+
+        return Function(name, static_cast<int>(StepTraits::NUM_ARGS - 1),
+                        AggregateFactory([fns] {
+                return std::unique_ptr<Aggregate>(new Impl(fns));
+        }), flags);
+}
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_FUNCTION_H
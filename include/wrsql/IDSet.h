@@ -25,10 +25,13 @@
 #ifndef WRSQL_ID_SET_H
 #define WRSQL_ID_SET_H
 
+#include <stddef.h>
+#include <iterator>
 #include <string>
 #include <vector>
 
 #include <wrsql/Config.h>
+#include <wrsql/IDSetView.h>
 #include <wrsql/Session.h>
 #include <wrsql/Statement.h>
 
@@ -62,6 +65,39 @@ namespace sql {
  * \c wr::printStr() functions using the \c \%s conversion specifier which
  * inserts the name of the temporary table. This provides a convenient way to
  * build SQL statements.
+ *
+ * Attaching and detaching change the temporary schema of the connection,
+ * which forces every prepared statement on it to be recompiled. Where sets
+ * are short-lived, or one prepared statement is to be used with many sets,
+ * an \c IDSet can instead be bound to a statement parameter of the
+ * table-valued function \c idset() which is available on every connection:
+ *
+ * \verbatim
+ * wr::sql::IDSet set = { 1002, 1056 };
+ * wr::sql::Statement stmt(db, "SELECT name FROM employees "
+ *                             "WHERE number IN idset(?)");
+ *
+ * for (wr::sql::Row row: stmt.bindAll(set)) {
+ *         ...
+ * }
+ * \endverbatim
+ *
+ * The set need not be attached to any database, but it must not be destroyed
+ * while bound to a statement that may still be executed.
+ *
+ * The argument of \c idset() may instead be a BLOB holding a set encoded by
+ * \c serialize(), for example one read from a cache table; its IDs are then
+ * decoded only as the query reads them.
+ *
+ * The elements are held in one of two ways, chosen when the \c IDSet is
+ * constructed (see \c StorageMode). By default they are kept in a sorted
+ * array, which is compact for small or sparse sets and gives the fastest
+ * iteration. Alternatively they can be kept in a compressed bitmap which
+ * splits the ID space into chunks of 65536 values, holding each chunk as a
+ * sorted array, a bitmap or a list of runs depending on its density. This
+ * makes insertion and removal of individual IDs cheap and uses far less
+ * memory for large sets of closely-spaced IDs, at the cost of slower
+ * positional access (\c operator[] and iterator arithmetic).
  */
 class WRSQL_API IDSet
 {
@@ -73,10 +109,139 @@ public:
         using difference_type = storage_type::difference_type;
         using pointer = storage_type::pointer;
         using reference = storage_type::reference;
-        using iterator = storage_type::const_iterator;
-        using const_iterator = storage_type::const_iterator;
-        using reverse_iterator = storage_type::const_reverse_iterator;
-        using const_reverse_iterator = storage_type::const_reverse_iterator;
+
+        /// \brief element storage method, chosen at construction
+        enum StorageMode
+        {
+                VECTOR_STORAGE,     ///< sorted array of IDs (the default)
+                COMPRESSED_STORAGE  ///< chunked array/bitmap/run containers
+        };
+
+private:
+        struct Body;   // defined in IDSetPrivate.h
+        class Bitmap;  // defined in IDSetBitmap.h
+
+public:
+        /**
+         * \class wr::sql::IDSet::const_iterator
+         * \brief random-access iterator referencing an element of an
+         *      \c IDSet
+         *
+         * Dereferencing a \c const_iterator yields the element's value
+         * rather than a reference to it, as the elements of an \c IDSet
+         * using \c COMPRESSED_STORAGE are not individually addressable.
+         */
+        class WRSQL_API const_iterator
+        {
+        public:
+                using this_t = const_iterator;
+                using iterator_category = std::random_access_iterator_tag;
+                using value_type = ID;
+                using difference_type = ptrdiff_t;
+                using pointer = const ID *;
+                using reference = ID;
+
+                const_iterator() :
+                        p_(nullptr), bits_(nullptr), chunk_(0), sub_(0), id_(0)
+                        {}
+
+                ID operator*() const { return bits_ ? id_ : *p_; }
+
+                ID operator[](difference_type n) const
+                        { return *(*this + n); }
+
+                this_t &operator++()
+                        { if (bits_) { increment(); } else { ++p_; }
+                          return *this; }
+
+                this_t &operator--()
+                        { if (bits_) { decrement(); } else { --p_; }
+                          return *this; }
+
+                this_t operator++(int)
+                        { this_t prev(*this); ++*this; return prev; }
+
+                this_t operator--(int)
+                        { this_t prev(*this); --*this; return prev; }
+
+                this_t &operator+=(difference_type n)
+                        { if (bits_) { advance(n); } else { p_ += n; }
+                          return *this; }
+
+                this_t &operator-=(difference_type n) { return *this += -n; }
+
+                this_t operator+(difference_type n) const
+                        { return this_t(*this) += n; }
+
+                this_t operator-(difference_type n) const
+                        { return this_t(*this) -= n; }
+
+                friend this_t operator+(difference_type n, const this_t &i)
+                        { return i + n; }
+
+                difference_type operator-(const this_t &other) const
+                        { return bits_ ? distance(other) : (p_ - other.p_); }
+
+                bool operator==(const this_t &other) const
+                {
+                        return bits_ ? ((chunk_ == other.chunk_)
+                                        && (id_ == other.id_))
+                                     : (p_ == other.p_);
+                }
+
+                bool operator<(const this_t &other) const
+                {
+                        if (!bits_) {
+                                return p_ < other.p_;
+                        } else if (chunk_ != other.chunk_) {
+                                return chunk_ < other.chunk_;
+                        } else {
+                                return id_ < other.id_;
+                        }
+                }
+
+                bool operator!=(const this_t &other) const
+                        { return !(*this == other); }
+
+                bool operator>(const this_t &other) const
+                        { return other < *this; }
+
+                bool operator<=(const this_t &other) const
+                        { return !(other < *this); }
+
+                bool operator>=(const this_t &other) const
+                        { return !(*this < other); }
+
+        private:
+                friend IDSet;
+                friend Body;
+                friend Bitmap;
+
+                explicit const_iterator(const ID *p) :
+                        p_(p), bits_(nullptr), chunk_(0), sub_(0), id_(0) {}
+
+                const_iterator(const Bitmap *bits, size_t chunk, size_t sub,
+                               ID id) :
+                        p_(nullptr), bits_(bits), chunk_(chunk), sub_(sub),
+                        id_(id) {}
+
+                // COMPRESSED_STORAGE operations; see IDSetBitmap.cxx
+                void increment();
+                void decrement();
+                void advance(difference_type n);
+                difference_type distance(const this_t &other) const;
+
+                const ID     *p_;      ///< element (VECTOR_STORAGE)
+                const Bitmap *bits_;   ///< container (COMPRESSED_STORAGE)
+                size_t        chunk_;  ///< chunk index (COMPRESSED_STORAGE)
+                size_t        sub_;    /**< array/run index within chunk
+                                            (COMPRESSED_STORAGE) */
+                ID            id_;     ///< element (COMPRESSED_STORAGE)
+        };
+
+        using iterator = const_iterator;
+        using reverse_iterator = std::reverse_iterator<const_iterator>;
+        using const_reverse_iterator = reverse_iterator;
 
 
         ///@{
@@ -102,18 +267,28 @@ public:
          *      matter
          * \param [in] db
          *      connection to the target database
+         * \param [in] view
+         *      serialized set whose IDs are to be decoded into \c this
+         * \param [in] mode
+         *      how the elements are to be stored; a copy of \c other uses
+         *      the same storage mode as \c other, while all other
+         *      constructors not taking \c mode use \c VECTOR_STORAGE
          *
          * \see \c operator=()
          * \see \c attach()
          */
         IDSet();
+        explicit IDSet(StorageMode mode);
         IDSet(const this_t &other);
         IDSet(this_t &&other);
         IDSet(std::initializer_list<ID> ids);
         IDSet(const Session &db);
+        IDSet(const Session &db, StorageMode mode);
         IDSet(const Session &db, const this_t &other);
         IDSet(const Session &db, std::initializer_list<ID> ids);
         IDSet(Statement &stmt, int col_no = 0);
+        explicit IDSet(const IDSetView &view,
+                       StorageMode mode = VECTOR_STORAGE);
 
         template <typename SrcIter> IDSet(SrcIter first, SrcIter last) : IDSet()
                 { insert(first, last); }
@@ -145,6 +320,9 @@ public:
          *
          * If <code>(&other == this)</code> these operator has no effect.
          *
+         * Copy assignment keeps the storage mode of \c this; move
+         * assignment takes on the storage mode of \c other.
+         *
          * \note
          *      Any iterators referencing elements of \c this prior to
          *      assignment must be considered invalid upon return.
@@ -175,7 +353,10 @@ public:
          * The exact nature of the temporary table depends on the underlying
          * database implementation. For SQLite3 databases an \c IDSet is
          * implemented as a 'virtual' table which allows the SQLite3 library
-         * to access the local element storage directly.
+         * to access the local element storage directly. Equality, range and
+         * \c IN constraints on its \c id column are answered by searching
+         * the storage, and the table reports its true size to the query
+         * planner so that joins against it are ordered sensibly.
          *
          * An \c IDSet object can be attached to only one database; calling
          * \c attach() will perform an implicit \c detach() on an \c IDSet
@@ -206,6 +387,12 @@ public:
          */
         const Session *db() const;
 
+        /**
+         * \brief retrieve the method by which the elements are stored
+         * \return the \c StorageMode given at construction
+         */
+        StorageMode storageMode() const;
+
         ///@{
         /**
          * \brief insert value(s)
@@ -328,9 +515,8 @@ public:
          * \param [in] other
          *      another \c IDSet object containing the secondary set
          * \param [in] stmt
-         *      prepared SQL statement that yields the secondary set; <em>the
-         *      statement results must be sequenced in ascending order of the
-         *      column taken</em>
+         *      prepared SQL statement that yields the secondary set; result
+         *      ordering does not matter
          * \param [in] col_no
          *      zero-based target column number to take from results of \c stmt
          * \param [in] ids
@@ -342,8 +528,7 @@ public:
          *      iterator referencing beyond last value in secondary set
          * \param [in] sql
          *      an SQL query returning the target values as the first column;
-         *      <em>the results must be sequenced in ascending order of the
-         *      first column</em>
+         *      result ordering does not matter
          * \param [in] args
          *      zero or more arguments to be bound to any parameters in \c sql
          *
@@ -421,8 +606,8 @@ public:
         /**
          * \brief exchange state with another IDSet object
          *
-         * \c swap() exchanges both the elements and database connection
-         * attachment states of \c this and \c other. Both \c IDSet objects'
+         * \c swap() exchanges the elements, storage modes and database
+         * connection attachment states of \c this and \c other. Both \c IDSet objects'
          * temporary table names remain the same and refer to the original
          * objects; they are not swapped. Thus, if both \c IDSet objects were
          * attached to the same database connection then it is safe to use
@@ -593,6 +778,10 @@ public:
          * \return
          *      the value at index \c i
          * \note
+         *      For an \c IDSet using \c COMPRESSED_STORAGE this takes time
+         *      proportional to the logarithm of the number of chunks plus
+         *      the size of the chunk containing the element.
+         * \note
          *      \c i is not checked for validity; the results of invoking
          *      <code>operator[]</code> with \c i equal to or greater than
          *      \c size() are undefined.
@@ -603,7 +792,8 @@ public:
          * \brief request allocation of memory ahead-of-time
          *
          * \c reserve() has no effect if \c n is the same as or less than
-         * \c size() or \c capacity().
+         * \c size() or \c capacity(), or if \c this uses
+         * \c COMPRESSED_STORAGE.
          *
          * \note
          *      Any iterators referencing elements of \c this prior to calling
@@ -619,6 +809,9 @@ public:
         /**
          * \brief request deallocation of unused memory
          *
+         * For an \c IDSet using \c COMPRESSED_STORAGE this also converts
+         * each chunk to a list of runs wherever that is smaller.
+         *
          * \note
          *      Any iterators referencing elements of \c this prior to calling
          *      \c shrink_to_fit() must be considered invalid upon return.
@@ -627,6 +820,44 @@ public:
          */
         this_t &shrink_to_fit();
 
+        /**
+         * \brief encode the elements in compact form
+         *
+         * The IDs are written as the gaps between successive values using
+         * variable-length integers, so that closely-spaced IDs take a byte
+         * or two each rather than eight. The result can be decoded with
+         * \c deserialize(), read in place through \c wr::sql::IDSetView,
+         * stored in a BLOB column or bound as a BLOB to the argument of
+         * the \c idset() table-valued function. The encoding does not
+         * depend on the storage mode or on byte order.
+         *
+         * \return the serialized set
+         *
+         * \throw std::bad_alloc
+         *      memory allocation failed
+         */
+        std::vector<uint8_t> serialize() const;
+
+        /**
+         * \brief decode a set previously encoded by \c serialize()
+         *
+         * \param [in] data
+         *      pointer to serialized set
+         * \param [in] bytes
+         *      size in bytes of the data at \c data
+         * \param [in] mode
+         *      how the elements of the new set are to be stored
+         *
+         * \return the decoded set, not attached to any database
+         *
+         * \throw std::invalid_argument
+         *      the data is not a serialized set
+         * \throw std::bad_alloc
+         *      memory allocation failed
+         */
+        static this_t deserialize(const void *data, size_t bytes,
+                                  StorageMode mode = VECTOR_STORAGE);
+
         ///@{
         /**
          * \brief compare the contents of two \c IDSet objects
@@ -676,10 +907,18 @@ public:
 
 private:
         friend class IDSetTests;
-        struct Body;
 
         void checkAttached(const char *context) const;
 
+        /*
+         * bulk operations on an unordered buffer of IDs; the buffer is
+         * sorted and stripped of duplicates in place before being merged
+         * with the set in a single linear pass
+         */
+        size_type insertBulk(storage_type &ids);
+        size_type eraseBulk(storage_type &ids);
+        size_type intersectBulk(storage_type &ids);
+
         Body *body_;
 };
 
@@ -691,15 +930,8 @@ IDSet::insert(
         SrcIter last
 ) -> size_type
 {
-        size_type n = 0;
-
-        for (; first != last; ++first) {
-                if (insert(*first).second) {
-                        ++n;
-                }
-        }
-
-        return n;
+        storage_type ids(first, last);
+        return insertBulk(ids);
 }
 
 //--------------------------------------
@@ -736,9 +968,8 @@ IDSet::intersect(
         SrcIter last
 ) -> size_type
 {
-        IDSet tmp;
-        tmp.insert(first, last);
-        return intersect(tmp);
+        storage_type ids(first, last);
+        return intersectBulk(ids);
 }
 
 //--------------------------------------
@@ -784,6 +1015,32 @@ IDSet::symmetric_difference_sql(
 }
 
 
+//--------------------------------------
+
+/**
+ * \brief bind an \c IDSet to a parameter of the \c idset() table-valued
+ *      function
+ *
+ * The set is bound by address and is not copied; it must remain in
+ * existence until the parameter is rebound or cleared, or the statement is
+ * destroyed.
+ *
+ * \param [in] param_no
+ *      1-based index of parameter to bind
+ * \param [in] set
+ *      the set to be bound
+ *
+ * \return reference to \c *this
+ *
+ * \throw std::invalid_argument
+ *      \c param_no referred to a nonexistent parameter number
+ * \throw wr::sql::Error
+ *      other run-time statement error occurred
+ */
+template <> WRSQL_API auto Statement::bind(int param_no,
+                                           const IDSet &set) -> this_t &;
+
+
 } // namespace sql
 
 
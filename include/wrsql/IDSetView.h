@@ -0,0 +1,193 @@
+/**
+ * \file wrsql/IDSetView.h
+ *
+ * \brief wr::sql::IDSetView class declaration
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_ID_SET_VIEW_H
+#define WRSQL_ID_SET_VIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <iterator>
+#include <vector>
+
+#include <wrsql/Config.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+/**
+ * \class wr::sql::IDSetView
+ * \brief read-only view of a serialized \c wr::sql::IDSet
+ *
+ * \c IDSetView reads the IDs held in a buffer produced by
+ * \c IDSet::serialize() without decoding them into a container first. The
+ * buffer may be held anywhere, for example in a memory-mapped file or a
+ * BLOB column value; the view refers to it by address and does not copy it,
+ * so the buffer must remain unchanged and in existence for as long as the
+ * view or any iterator obtained from it is used.
+ *
+ * The IDs are encoded in blocks of up to 128 values. Each block begins with
+ * its first ID and its size in bytes, followed by the gaps between its
+ * successive IDs as variable-length integers. Iteration decodes one value
+ * at a time; \c lower_bound(), \c find() and \c count() skip whole blocks
+ * by examining only their headers.
+ *
+ * A serialized set may also be bound as a BLOB to the argument of the
+ * \c idset() table-valued function (see \c wr::sql::IDSet), in which case it
+ * is likewise decoded only as far as each query needs.
+ */
+class WRSQL_API IDSetView
+{
+public:
+        using this_t = IDSetView;
+        using size_type = size_t;
+        using value_type = ID;
+
+        /**
+         * \class wr::sql::IDSetView::const_iterator
+         * \brief forward iterator over the IDs of an \c IDSetView
+         */
+        class WRSQL_API const_iterator
+        {
+        public:
+                using this_t = const_iterator;
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = ID;
+                using difference_type = ptrdiff_t;
+                using pointer = const ID *;
+                using reference = ID;
+
+                const_iterator() = default;
+
+                ID operator*() const { return id_; }
+
+                this_t &operator++();
+
+                this_t operator++(int)
+                        { this_t prev(*this); ++*this; return prev; }
+
+                bool operator==(const this_t &other) const
+                        { return (p_ == other.p_) && (left_ == other.left_); }
+
+                bool operator!=(const this_t &other) const
+                        { return !(*this == other); }
+
+        private:
+                friend IDSetView;
+
+                const uint8_t *p_ = nullptr;  ///< next byte to be decoded
+                size_t         left_ = 0;     ///< elements following this one
+                unsigned       in_block_ = 0; ///< index within current block
+                ID             id_ = 0;       ///< current element
+        };
+
+        using iterator = const_iterator;
+
+        ///@{
+        /**
+         * \brief constructor
+         *
+         * \param [in] data
+         *      pointer to serialized set
+         * \param [in] bytes
+         *      size in bytes of the data at \c data
+         * \param [in] blob
+         *      serialized set, as returned by \c IDSet::serialize()
+         *
+         * \throw std::invalid_argument
+         *      the data is not a serialized set
+         */
+        IDSetView() = default;
+        IDSetView(const void *data, size_t bytes);
+        explicit IDSetView(const std::vector<uint8_t> &blob);
+        ///@}
+
+        ///@{
+        /// \brief obtain iterator to first element
+        const_iterator begin() const;
+        const_iterator cbegin() const { return begin(); }
+        ///@}
+
+        ///@{
+        /// \brief obtain iterator to element following the last
+        const_iterator end() const    { return {}; }
+        const_iterator cend() const   { return {}; }
+        ///@}
+
+        /// \brief determine whether the view contains no IDs
+        bool empty() const            { return !size_; }
+
+        /// \brief number of IDs in the view
+        size_type size() const        { return size_; }
+
+        /// \brief serialized data referenced by the view
+        const uint8_t *data() const   { return data_; }
+
+        /// \brief size of the serialized data in bytes
+        size_t bytes() const          { return bytes_; }
+
+        /**
+         * \brief locate the first ID not less than a given value
+         *
+         * \param [in] id  the value to search for
+         *
+         * \return iterator to the first ID not less than \c id, or \c end()
+         *      if there is no such ID
+         */
+        const_iterator lower_bound(ID id) const;
+
+        /**
+         * \brief locate a given ID
+         *
+         * \param [in] id  the value to search for
+         *
+         * \return iterator to \c id, or \c end() if it is not present
+         */
+        const_iterator find(ID id) const;
+
+        /**
+         * \brief count the occurrences of an ID
+         *
+         * \param [in] id  the value to search for
+         *
+         * \return \c 1 if \c id is present, otherwise \c 0
+         */
+        size_type count(ID id) const  { return find(id) != end(); }
+
+private:
+        const_iterator blockStart(const uint8_t *header, size_t left) const;
+
+        const uint8_t *data_ = nullptr,   ///< start of serialized data
+                      *blocks_ = nullptr; ///< first block header
+        size_t         bytes_ = 0,        ///< size of serialized data
+                       size_ = 0;         ///< number of IDs
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_ID_SET_VIEW_H
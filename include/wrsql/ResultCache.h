@@ -0,0 +1,263 @@
+/**
+ * \file wrsql/ResultCache.h
+ *
+ * \brief Declaration of class \c wr::sql::ResultCache
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_RESULT_CACHE_H
+#define WRSQL_RESULT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <wrutil/optional.h>
+#include <wrsql/Config.h>
+#include <wrsql/ColumnBatch.h>
+
+
+namespace wr {
+namespace sql {
+
+
+class Session;
+
+/**
+ * \class wr::sql::ResultCache
+ * \brief cache of the results of read-only registered statements
+ *
+ * A \c ResultCache holds the complete result sets of registered \c SELECT
+ * statements executed by \c Session::execCached(), keyed by statement ID
+ * and the values bound to the statement's parameters, so that repeating a
+ * query with the same arguments can be answered without executing it. Each
+ * result set is held as a \c ColumnBatch, sharing ownership with callers,
+ * and the least recently used results are discarded once the cache exceeds
+ * its size limits.
+ *
+ * A cache may be attached to any number of \c Session objects, for example
+ * all connections of a \c SessionPool via \c SessionOptions::result_cache.
+ * Results are only shared between sessions connected to the same database
+ * file, the file's path forming part of each key, so one cache can serve
+ * several databases (such as a pool per tenant) without mixing their rows;
+ * results from an in-memory or temporary database are only returned to the
+ * connection which computed them.
+ * Each attached session records the tables its statements write to, both
+ * through \c sqlite3_update_hook() and from the tables each statement is
+ * compiled to modify, and discards the cached results depending on those
+ * tables when the changes are committed (via \c Session::onFinalCommit()
+ * within a \c Transaction, or on completion of the statement otherwise).
+ * Changes rolled back cause no invalidation. Tables are identified by name
+ * alone, so a change to a table invalidates the results depending on any
+ * table of that name, whichever database the results came from. While a
+ * session holds
+ * uncommitted changes to a table, its own cached queries reading that table
+ * bypass the cache, and results are only stored from sessions outside any
+ * transaction, so uncommitted data is never visible through the cache.
+ *
+ * Invalidation can only account for changes made through sessions attached
+ * to the cache. Changes made by other connections or processes must be
+ * reported by calling \c invalidate() or \c clear(). Results are cached
+ * regardless of the functions a statement calls, so statements whose
+ * results depend on anything other than the contents of ordinary tables
+ * (e.g. \c random(), \c date('now') or virtual tables) should not be
+ * executed through the cache. Statements reading \c TEMP tables are
+ * executed but never cached, such tables being private to one connection.
+ *
+ * This class is thread-safe.
+ */
+class WRSQL_API ResultCache
+{
+public:
+        using this_t = ResultCache;
+        using Ptr = std::shared_ptr<this_t>;
+
+        /// \brief a cached result set, shared with the cache
+        using Rows = std::shared_ptr<const ColumnBatch>;
+
+        /// \brief default value of \c maxBytes()
+        enum: size_t { DEFAULT_MAX_BYTES = 16 << 20 };
+
+        /// \brief counters reported by \c stats()
+        struct Stats
+        {
+                uint64_t hits = 0,           ///< lookups answered by the cache
+                         misses = 0,         ///< lookups executing the statement
+                         bypasses = 0,       /**< executions not eligible for
+                                                  caching */
+                         evictions = 0,      ///< results discarded for space
+                         invalidations = 0;  /**< results discarded following
+                                                  changes to their tables */
+                size_t   entries = 0,        ///< result sets currently held
+                         bytes = 0;          ///< approximate memory held
+        };
+
+        /**
+         * \class wr::sql::ResultCache::Key
+         * \brief encoded statement ID and parameter values identifying a
+         *      cached result set
+         *
+         * \c Session::execCached() appends each of its arguments to a
+         * \c Key in turn. The standard overloads of \c append() cover the
+         * same types as \c Statement::bind(); as with \c Statement::bind(),
+         * the template overload can be specialized for user-defined types,
+         * which must then append a representation that differs whenever
+         * the value bound differs:
+         *
+         * \verbatim
+         * template <> auto
+         * wr::sql::ResultCache::Key::append(const Fruit &val) -> this_t &
+         * {
+         *         return append(static_cast<int>(val));
+         * }
+         * \endverbatim
+         */
+        class WRSQL_API Key
+        {
+        public:
+                using this_t = Key;
+
+                /**
+                 * \brief begin key for registered statement \c stmt_id
+                 *      executed on the given database
+                 *
+                 * \param [in] database
+                 *      string identifying the database uniquely within
+                 *      the process
+                 * \param [in] stmt_id
+                 *      registered statement ID
+                 */
+                Key(const std::string &database, size_t stmt_id);
+
+                ///@{
+                /// \brief append an argument value to the key
+                this_t &append(std::nullptr_t)  { return appendNull(); }
+                this_t &append(nullopt_t)       { return appendNull(); }
+                this_t &append(bool val)        { return appendInt(val); }
+                this_t &append(char val)        { return appendInt(val); }
+                this_t &append(unsigned char val)  { return appendInt(val); }
+                this_t &append(short val)       { return appendInt(val); }
+                this_t &append(unsigned short val) { return appendInt(val); }
+                this_t &append(int val)         { return appendInt(val); }
+                this_t &append(unsigned int val)   { return appendInt(val); }
+                this_t &append(long val)        { return appendInt(val); }
+                this_t &append(unsigned long val)
+                        { return appendInt(static_cast<long long>(val)); }
+                this_t &append(long long val)   { return appendInt(val); }
+                this_t &append(unsigned long long val)
+                        { return appendInt(static_cast<long long>(val)); }
+                this_t &append(float val)       { return appendFloat(val); }
+                this_t &append(double val)      { return appendFloat(val); }
+                this_t &append(const char *val);
+
+                template <typename T> this_t &append(const optional<T> &val)
+                        { return val ? append(*val) : appendNull(); }
+
+                // for specialization on external classes
+                template <typename T> this_t &append(const T &val);
+                        /* specialized as standard for std::string,
+                           wr::u8string_view, wr::string_view and
+                           std::vector<uint8_t> */
+
+                template <size_t N> this_t &append(const char (&val)[N])
+                        { return appendText(val, N); }
+                ///@}
+
+                /// \brief encoded key
+                const std::string &bytes() const { return bytes_; }
+
+        private:
+                this_t &appendNull();
+                this_t &appendInt(long long val);
+                this_t &appendFloat(double val);
+                this_t &appendText(const char *text, size_t bytes);
+                this_t &appendBlob(const void *data, size_t bytes);
+
+                std::string bytes_;
+        };
+
+        /**
+         * \brief constructor
+         *
+         * \param [in] max_bytes
+         *      approximate memory the cached result sets may occupy; a
+         *      result set larger than this is never cached
+         * \param [in] max_entries
+         *      maximum number of result sets held, or zero for no limit
+         *      other than \c max_bytes
+         */
+        explicit ResultCache(size_t max_bytes = DEFAULT_MAX_BYTES,
+                             size_t max_entries = 0);
+
+        ResultCache(const this_t &) = delete;
+
+        /// \brief destructor
+        ~ResultCache();
+
+        this_t &operator=(const this_t &) = delete;
+
+        /// \brief approximate memory the cached result sets may occupy
+        size_t maxBytes() const;
+
+        /// \brief maximum number of result sets held, or zero for no limit
+        size_t maxEntries() const;
+
+        ///@{
+        /**
+         * \brief discard all results depending on the given table(s)
+         *
+         * Results currently being computed by other threads are not stored
+         * once they complete.
+         *
+         * \param [in] table
+         *      the name of a table, compared without regard to ASCII case
+         * \param [in] tables
+         *      the names of zero or more tables
+         */
+        void invalidate(const u8string_view &table);
+        void invalidate(const std::vector<std::string> &tables);
+        ///@}
+
+        /**
+         * \brief discard all cached results
+         */
+        void clear();
+
+        /**
+         * \brief obtain the cache's counters
+         */
+        Stats stats() const;
+
+private:
+        friend Session;
+
+        struct Body;
+
+        Body *body_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_RESULT_CACHE_H
@@ -25,25 +25,230 @@
 #ifndef WRSQL_SESSION_H
 #define WRSQL_SESSION_H
 
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
 #include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
 
 #include <boost/smart_ptr/intrusive_ptr.hpp>
 #include <boost/smart_ptr/intrusive_ref_counter.hpp>
 
 #include <wrutil/u8string_view.h>
+#include <wrsql/Backup.h>
 #include <wrsql/Config.h>
+#include <wrsql/Function.h>
+#include <wrsql/ResultCache.h>
 #include <wrsql/Statement.h>
+#include <wrsql/Transaction.h>
 
 
 namespace wr {
 namespace sql {
 
 
+class BlobStream;
 class IDSet;
+class SessionGroup;
+class SessionPool;
 class Transaction;
 class SessionTests;
 
 
+/**
+ * \struct wr::sql::SessionOptions
+ * \brief connection settings applied by \c Session::open()
+ *
+ * Settings left unset keep the underlying database implementation's
+ * defaults. All settings are applied before \c Session::open() returns; if
+ * any cannot be applied then the connection is not opened. They are applied
+ * again whenever a \c Session is copied.
+ *
+ * \code{.cpp}
+ * wr::sql::SessionOptions options;
+ * options.journal_mode = wr::sql::SessionOptions::WAL_JOURNAL;
+ * options.synchronous = wr::sql::SessionOptions::NORMAL_SYNC;
+ * options.mmap_size = 256 << 20;
+ * options.busy_timeout = std::chrono::milliseconds(5000);
+ *
+ * wr::sql::Session db("sqlite3:documents.db", options);
+ * \endcode
+ */
+struct SessionOptions
+{
+        /// \brief rollback journal mode (SQLite \c PRAGMA \c journal_mode)
+        enum JournalMode
+        {
+                DELETE_JOURNAL = 0,
+                TRUNCATE_JOURNAL,
+                PERSIST_JOURNAL,
+                MEMORY_JOURNAL,
+                WAL_JOURNAL,      ///< write-ahead log; readers do not block writers
+                NO_JOURNAL
+        };
+
+        /// \brief disk synchronisation level (SQLite \c PRAGMA \c synchronous)
+        enum Synchronous
+        {
+                OFF_SYNC = 0,
+                NORMAL_SYNC,      ///< sufficient for durability in WAL mode
+                FULL_SYNC,
+                EXTRA_SYNC
+        };
+
+        /// \brief storage of temporary tables and indices
+        enum TempStore
+        {
+                DEFAULT_TEMP_STORE = 0,
+                FILE_TEMP_STORE,
+                MEMORY_TEMP_STORE
+        };
+
+        /**
+         * \brief busy handler function type
+         *
+         * Invoked when a statement cannot proceed because the database is
+         * locked by another connection. \c attempts is the number of times
+         * the handler has already been invoked for the same lock. Returning
+         * \c true waits for the lock again; returning \c false causes the
+         * statement to throw \c wr::sql::Busy, as does any exception thrown
+         * by the handler. The handler is responsible for sleeping between
+         * attempts, and applies from the moment the connection is opened.
+         */
+        using BusyHandler = std::function<bool (int attempts)>;
+
+        /**
+         * \brief connection-private pool serving small memory allocations
+         *      (SQLite lookaside memory), allocated when the connection is
+         *      opened; zero \c slots disables it
+         */
+        struct Lookaside
+        {
+                int slot_size;  ///< bytes per allocation slot
+                int slots;      ///< number of slots
+        };
+
+        optional<JournalMode>     journal_mode;
+        optional<Synchronous>     synchronous;
+        optional<int64_t>         mmap_size;      ///< bytes of file to map
+        optional<int64_t>         cache_size;     /**< pages if positive,
+                                                       KiB if negative */
+        optional<TempStore>       temp_store;
+        optional<Lookaside>       lookaside;
+        std::chrono::milliseconds busy_timeout = {}; /**< how long to wait for
+                                                          a lock before
+                                                          throwing \c Busy;
+                                                          zero for not at all,
+                                                          ignored if
+                                                          \c busy_handler is
+                                                          set */
+        BusyHandler               busy_handler;
+        bool                      read_only = false;
+        bool                      no_mutex  = false; /**< omit connection mutex
+                                                          (\c Session objects
+                                                          are never
+                                                          thread safe anyway) */
+        bool                      statistics = false; /**< collect
+                                                           \c StatementStats
+                                                           from the outset */
+        std::vector<Function>     functions; /**< SQL functions defined on
+                                                  the connection when
+                                                  opened */
+        ResultCache::Ptr          result_cache; /**< cache attached to the
+                                                     connection when opened,
+                                                     shared by every
+                                                     connection opened with
+                                                     these options (as in a
+                                                     \c SessionPool) */
+};
+
+//--------------------------------------
+/**
+ * \struct wr::sql::StatementStats
+ * \brief run-time statistics accumulated for one SQL statement
+ *
+ * Statistics are collected by a \c Session for which
+ * \c Session::enableStatistics() has been called, for every distinct SQL
+ * statement text executed on that connection. Statements registered using
+ * \c registerStatement() are identified by their ID; all \c Statement
+ * objects with the same text share a single entry.
+ *
+ * An execution is counted each time a statement completes, that is when it
+ * returns its last row or is reset or finalized after being stepped at
+ * least once. Times are measured by the underlying database implementation
+ * from the first step until completion, and so exclude time spent by the
+ * application between steps only insofar as the implementation does.
+ */
+struct StatementStats
+{
+        using Duration = std::chrono::nanoseconds;
+
+        /// \brief value of \c stmt_id for statements never registered
+        enum: size_t { UNREGISTERED = ~size_t(0) };
+
+        std::string sql;            ///< statement text
+        size_t      stmt_id;        /**< ID returned by \c registerStatement()
+                                         or \c UNREGISTERED */
+        uint64_t    executions,     ///< number of completed executions
+                    rows;           ///< result rows returned in total
+        Duration    total_time,     ///< sum of execution times
+                    max_time,       ///< longest execution time
+                    p99_time;       /**< 99th percentile execution time,
+                                         accurate to within 1/8 */
+        uint64_t    fullscan_steps, /**< forward steps taken during full
+                                         table scans */
+                    sorts,          ///< sort operations performed
+                    autoindexes,    ///< rows inserted into automatic indices
+                    vm_steps,       /**< virtual machine operations
+                                         executed */
+                    reprepares;     /**< automatic recompilations following
+                                         schema changes */
+};
+
+//--------------------------------------
+/**
+ * \struct wr::sql::MemoryStats
+ * \brief snapshot of the memory held by one database connection
+ *
+ * Sizes are in bytes. Counters accumulate from the time the connection was
+ * opened.
+ */
+struct MemoryStats
+{
+        uint64_t cache_used,         /**< page cache memory, counting any
+                                          cache shared with other
+                                          connections in full */
+                 cache_used_shared,  /**< page cache memory, dividing any
+                                          shared cache evenly between the
+                                          connections sharing it */
+                 schema_used,        ///< memory holding the database schema
+                 stmt_used,          ///< memory held by compiled statements
+                 cached_stmts;       /**< compiled registered statements
+                                          cached by the \c Session */
+        uint64_t cache_hits,         ///< page cache hits
+                 cache_misses,       ///< page cache misses
+                 cache_writes,       ///< dirty pages written out
+                 cache_spills;       /**< dirty pages written out early
+                                          for want of cache space */
+        uint64_t lookaside_used,     ///< lookaside slots currently in use
+                 lookaside_highwater,/**< greatest number of lookaside
+                                          slots in use at once */
+                 lookaside_hits,     ///< allocations served from lookaside
+                 lookaside_misses;   /**< allocations too large for, or
+                                          refused for want of, a slot */
+
+        /**
+         * \brief get the total heap memory attributed to the connection
+         * \return sum of \c cache_used_shared, \c schema_used and
+         *      \c stmt_used
+         */
+        uint64_t memoryUsed() const
+                { return cache_used_shared + schema_used + stmt_used; }
+};
+
+//--------------------------------------
 /**
  * \class wr::sql::Session
  * \brief database connection
@@ -54,7 +259,22 @@ class SessionTests;
  * Accessing a given database via distinct Session objects is guaranteed to be
  * thread safe. For a given Session instance method calls are not thread safe.
  * To maintain thread safety it is recommended that each thread uses its own
- * dedicated Session object(s).
+ * dedicated Session object(s). Applications with many short-lived worker
+ * tasks may instead borrow Session objects from a \c wr::sql::SessionPool.
+ *
+ * Every connection provides the \c ALPHANUM collation sequence, which
+ * compares text by its letters and digits alone, ignoring case, and the
+ * SQL function \c alphanum_key(text), which returns a BLOB comparing
+ * bytewise as \c text does under \c ALPHANUM. Storing the key in an indexed
+ * (e.g. generated) column avoids evaluating the collation on every
+ * comparison:
+ *
+ * \code
+ * CREATE TABLE names (name TEXT,
+ *                     name_key BLOB AS (alphanum_key(name)) STORED);
+ * CREATE INDEX names_by_key ON names (name_key);
+ * SELECT name FROM names ORDER BY name_key;
+ * \endcode
  */
 class WRSQL_API Session : public boost::intrusive_ref_counter<Session>
 {
@@ -67,13 +287,19 @@ public:
         /**
          * \brief object constructor
          *
-         * \param other  \c Session object to be copied or moved
-         * \param uri    URI describing type and location of database to open
+         * The copy constructor opens a new connection to the same database
+         * as \c other with the same options, locking mode and retry policy.
+         *
+         * \param other    \c Session object to be copied or moved
+         * \param uri      URI describing type and location of database to
+         *                 open
+         * \param options  connection settings
          */
         Session();
         Session(const this_t &other);
         Session(this_t &&other);
         Session(const u8string_view &uri);
+        Session(const u8string_view &uri, const SessionOptions &options);
         ///@}
 
         /**
@@ -90,7 +316,8 @@ public:
          * Both the copy and move assignment operators close any connection
          * currently opened by the invoking \c Session object. The copy
          * assignment operator opens a new connection to the same database
-         * URI referred to by \c other. The move assignment operator causes
+         * URI referred to by \c other, with the same options, locking mode
+         * and retry policy. The move assignment operator causes
          * the invoking \c Session object to take over the state of the
          * \c other \c Session object leaving \c other in a valid but
          * indeterminate state (\c other is assumed to be no longer required).
@@ -114,11 +341,48 @@ public:
          *
          * \param [in] uri
          *      URI describing the type and location of the target database
+         * \param [in] options
+         *      connection settings; if not specified, default settings are
+         *      used
          *
          * \throw wr::sql::Error
-         *      invalid \c uri, permission denied or memory exhausted
+         *      invalid \c uri, permission denied, memory exhausted or
+         *      \c options could not be applied
          */
         void open(const u8string_view &uri);
+        void open(const u8string_view &uri, const SessionOptions &options);
+
+        /**
+         * \brief get settings applied to the connection when opened
+         * \return settings passed to \c open(), or default settings if the
+         *      connection is not open
+         */
+        const SessionOptions &options() const;
+
+        /**
+         * \brief define an application-defined SQL function on the
+         *      connection
+         *
+         * Replaces any function previously defined with the same name and
+         * number of arguments. The function is appended to the connection's
+         * \c options().functions, so that it is also defined on copies of
+         * this \c Session; it is not defined on other connections, for
+         * which \c SessionOptions::functions should be used instead.
+         *
+         * \param [in] fn  function to define
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      the \c Session is closed
+         * \throw wr::sql::Error
+         *      the function could not be defined, for example because its
+         *      name is too long or a statement is in progress on the
+         *      connection
+         *
+         * \see \c wr::sql::Function
+         */
+        this_t &defineFunction(const Function &fn);
 
         /**
          * \brief close connection if open
@@ -285,6 +549,195 @@ public:
         template <typename ...Args> ExecResult exec(size_t stmt_id,
                                                     Args &&...args) const;
 
+        ///@{
+        /**
+         * \brief execute precompiled statement for each element of a sequence
+         *
+         * \c execBatch() efficiently executes a registered \c INSERT,
+         * \c UPDATE or \c DELETE statement many times over, binding the
+         * values of each element of \c rows (or of the sequence delimited
+         * by \c first and \c last) in turn as per
+         * \c Statement::executeBatch().
+         *
+         * All elements are executed within a single transaction, so as to
+         * avoid the cost of committing each row individually. If
+         * \c commit_every is nonzero then a new transaction is instead begun
+         * for every \c commit_every elements, keeping the size of each
+         * transaction bounded for very large sequences. If a transaction is
+         * already active on this connection then the work is carried out
+         * within nested transactions and nothing is committed until the
+         * outermost transaction commits.
+         *
+         * As with \c Transaction::begin(), a transaction which encounters a
+         * \c wr::sql::Busy condition is rolled back and retried, so the
+         * sequence must support multiple passes (i.e. \c first and \c last
+         * must be at least forward iterators).
+         *
+         * \param [in] stmt_id
+         *      ID of statement returned by a prior call to
+         *      \c wr::sql::registerStatement()
+         * \param [in] rows
+         *      a container or other range of elements to execute
+         * \param [in] first, last
+         *      iterators delimiting the sequence of elements to execute
+         * \param [in] commit_every
+         *      maximum number of elements executed per transaction, or zero
+         *      to execute all elements in a single transaction
+         *
+         * \return number of elements executed
+         *
+         * \throw std::invalid_argument
+         *      \c stmt_id was not recognised, or an element contained more
+         *      values than the statement has parameters
+         * \throw wr::sql::Error
+         *      the statement could not be compiled or executed due to a
+         *      syntactic or semantic error in the SQL, a constraint
+         *      violation or some other run-time error; the transaction
+         *      executing the failed element is rolled back, while
+         *      transactions for preceding chunks (if \c commit_every is
+         *      nonzero) remain committed
+         * \throw wr::sql::Interrupt
+         *      a call to \c Session::interrupt() was issued by another thread
+         *      (or possibly a progress handler invoked by the calling
+         *      thread)
+         */
+        template <typename Range> size_t execBatch(size_t stmt_id,
+                                                   const Range &rows,
+                                                   size_t commit_every = 0);
+
+        template <typename Iter> size_t execBatch(size_t stmt_id,
+                                                  Iter first, Iter last,
+                                                  size_t commit_every = 0);
+        ///@}
+
+        /**
+         * \brief execute precompiled read-only statement, answering from
+         *      the attached \c ResultCache where possible
+         *
+         * If a \c ResultCache is attached to this connection (see
+         * \c setResultCache()) and holds the results of a previous
+         * execution of \c stmt_id with the same argument values, those
+         * results are returned without executing the statement. Otherwise
+         * the statement is executed as per \c exec(size_t), all of its
+         * result rows are fetched, and (unless this connection has begun a
+         * transaction, or holds uncommitted changes to a table read by the
+         * statement) the results are stored in the cache for future calls
+         * by this or any other connection sharing the cache.
+         *
+         * Each argument is appended to the cache key by
+         * \c ResultCache::Key::append() before being bound as per
+         * \c Statement::bindAll().
+         *
+         * If no cache is attached then the statement is simply executed and
+         * its results returned.
+         *
+         * \param [in] stmt_id
+         *      ID of statement returned by a prior call to
+         *      \c wr::sql::registerStatement()
+         * \param [in] ...args
+         *      argument value(s) to be bound to parameters given in the
+         *      registered statement, in order of appearance
+         *
+         * \return the statement's complete result set
+         *
+         * \throw std::invalid_argument
+         *      \c stmt_id was not recognised, or the statement is not
+         *      read-only
+         *
+         * Other exceptions are thrown as per \c exec(size_t).
+         *
+         * \see \c wr::sql::ResultCache
+         */
+        template <typename ...Args> ResultCache::Rows
+                execCached(size_t stmt_id, Args &&...args) const;
+
+        /**
+         * \brief attach a result cache to the connection
+         *
+         * \param [in] cache
+         *      the cache used by \c execCached(), which may be shared with
+         *      other connections, or \c nullptr to detach any cache
+         *
+         * \return reference to \c *this
+         *
+         * \see \c SessionOptions::result_cache
+         */
+        this_t &setResultCache(ResultCache::Ptr cache);
+
+        /**
+         * \brief obtain the cache attached by \c setResultCache() or
+         *      \c SessionOptions::result_cache, if any
+         */
+        const ResultCache::Ptr &resultCache() const;
+
+        ///@{
+        /**
+         * \brief execute a script of SQL statements
+         *
+         * \c execScript() executes each statement of a script containing any
+         * number of SQL statements separated by semicolons, in order of
+         * appearance, and returns the last statement having begun execution
+         * so that its results (if any) may be read. Result rows of the
+         * preceding statements are discarded.
+         *
+         * The script is split into statements as per
+         * \c wr::sql::registerScript(). The overload taking \c sql compiles
+         * every statement on each call, whereas the overload taking
+         * \c script_id compiles each statement only the first time it is
+         * used with this \c Session object, as per \c exec(size_t).
+         * Statements are compiled in turn immediately before executing them,
+         * so a statement may refer to objects created by those preceding it.
+         *
+         * Parameters are bound by name rather than position, since a
+         * parameter may appear in any number of the script's statements.
+         * \c named_args must therefore consist of pairs of arguments, each
+         * giving a parameter name including its prefix character (for
+         * example \c ":since") followed by the value to be bound to every
+         * occurrence of that parameter within the script. A statement
+         * having no parameter of a given name simply ignores that pair.
+         * Unbound parameters take the value \c NULL.
+         *
+         * No transaction is begun by \c execScript(); if the statements
+         * form a single unit of work then call \c execScript() within the
+         * context of a \c Transaction.
+         *
+         * \param [in] sql
+         *      UTF-8-encoded SQL script text
+         * \param [in] script_id
+         *      ID of script returned by a prior call to
+         *      \c wr::sql::registerScript()
+         * \param [in] ...named_args
+         *      zero or more pairs of parameter name and value
+         *
+         * \return the last statement of the script, having begun execution;
+         *      an unprepared statement if the script contains no statements
+         *
+         * \throw std::invalid_argument
+         *      \c script_id was not recognised
+         * \throw wr::sql::Error
+         *      a statement could not be compiled or executed due to a
+         *      syntax error in the original SQL or a semantic error in the
+         *      statement; statements preceding it remain executed
+         * \throw wr::sql::Busy
+         *      contention occurred with locks held by other database
+         *      connections, or a potential deadlock was detected; handled
+         *      automatically when called inside the context of a
+         *      \c Transaction
+         * \throw wr::sql::Interrupt
+         *      a call to \c Session::interrupt() was issued by another thread
+         *      (or possibly a progress handler invoked by the calling
+         *      thread)
+         *
+         * \see \c wr::sql::registerScript()
+         */
+        template <typename ...Args> Statement
+                execScript(const u8string_view &sql,
+                           Args &&...named_args) const;
+
+        template <typename ...Args> ExecResult
+                execScript(size_t script_id, Args &&...named_args) const;
+        ///@}
+
         /**
          * \brief search the database for a table, view or other named object
          *
@@ -376,9 +829,37 @@ public:
         /**
          * \brief free any spare memory previously allocated for the
          *      database connection
+         *
+         * Unused page cache memory is released and all cached registered
+         * statements are finalized, to be recompiled when next used.
          */
         void releaseMemory();
 
+        /**
+         * \brief get a snapshot of the connection's memory usage
+         * \return memory usage statistics; all zero if \c *this is closed
+         */
+        MemoryStats memoryStats() const;
+
+        ///@{
+        /**
+         * \brief get or set process-wide heap limits
+         *
+         * These limits apply to all memory allocated by the underlying
+         * database implementation, across every \c Session in the process.
+         * When the soft limit is exceeded, memory is reclaimed from page
+         * caches before further allocations are made; allocations exceeding
+         * the hard limit fail, causing the operation to throw
+         * \c wr::sql::Error. The soft limit cannot exceed the hard limit.
+         *
+         * \param [in] bytes  limit in bytes, zero for no limit, or negative
+         *      to query the limit without changing it
+         * \return the limit in effect before the call
+         */
+        static int64_t softHeapLimit(int64_t bytes = -1);
+        static int64_t hardHeapLimit(int64_t bytes = -1);
+        ///@}
+
         /**
          * \brief instruct the database to perform a garbage-collection cycle
          * \note If the specific database implementation does not support this
@@ -386,6 +867,132 @@ public:
          */
         void vacuum();
 
+        /// \brief default number of pages copied by each step of \c loadFrom()
+        enum: int { LOAD_STEP_PAGES = 4096 };
+
+        /**
+         * \brief replace the contents of a database with those of another
+         *      database
+         *
+         * Intended for populating an in-memory database (such as one opened
+         * as \c ":memory:" or \c "file::memory:?cache=shared") from a file
+         * at startup: the file is read from start to end in chunks of
+         * \c LOAD_STEP_PAGES pages, avoiding the random reads by which a
+         * file database's page cache would otherwise be warmed. The source
+         * is opened read-only for the duration of the call.
+         *
+         * \param [in] uri
+         *      identifies the database to be copied, as for \c open()
+         * \param [in] progress
+         *      called after each chunk with the number of pages remaining
+         *      and the total number of pages; may be empty
+         * \param [in] db_name
+         *      name of the attached database within \c *this to be replaced
+         *
+         * \return \c true if the copy completed, \c false if abandoned by
+         *      \c progress, in which case the previous contents remain
+         *
+         * \throw wr::sql::Error
+         *      the source could not be opened, \c *this is in use by a read
+         *      transaction, or the page sizes of an in-memory destination and
+         *      the source differ
+         */
+        bool loadFrom(const u8string_view &uri,
+                      const Backup::ProgressFn &progress = {},
+                      const u8string_view &db_name = u8"main");
+
+        /**
+         * \brief copy the contents of a database into another database
+         *
+         * The copy is made by a \c Backup, in steps of \c pages_per_step
+         * pages separated by \c pause, so that other connections may
+         * continue to write to \c *this while a large database is copied;
+         * see \c Backup::run(). The destination is created if necessary and
+         * its previous contents are replaced.
+         *
+         * \param [in] uri
+         *      identifies the destination database, as for \c open()
+         * \param [in] progress
+         *      called after each step with the number of pages remaining and
+         *      the total number of pages; may be empty
+         * \param [in] pages_per_step
+         *      number of pages copied by each step; negative to copy all
+         *      pages in one step
+         * \param [in] pause
+         *      interval between successive steps
+         * \param [in] db_name
+         *      name of the attached database within \c *this to be copied
+         *
+         * \return \c true if the copy completed, \c false if abandoned by
+         *      \c progress
+         *
+         * \throw wr::sql::Error
+         *      the destination could not be opened or written
+         */
+        bool backupTo(const u8string_view &uri,
+                      const Backup::ProgressFn &progress = {},
+                      int pages_per_step = Backup::DEFAULT_STEP_PAGES,
+                      std::chrono::steady_clock::duration pause
+                                = std::chrono::milliseconds(10),
+                      const u8string_view &db_name = u8"main") const;
+
+        /**
+         * \brief obtain a snapshot of a database as a contiguous image
+         *
+         * The image has the same format as a database file and may be
+         * written to one directly, or restored by \c deserialize() or
+         * \c deserializeView().
+         *
+         * \param [in] db_name  name of the attached database to be copied
+         * \return the database image; empty if the database has no pages
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         * \throw std::invalid_argument
+         *      no database named \c db_name is attached
+         */
+        std::vector<uint8_t> serialize(const u8string_view &db_name
+                                                = u8"main") const;
+
+        ///@{
+        /**
+         * \brief replace a database by an in-memory database whose contents
+         *      are given by an image
+         *
+         * \c deserialize() copies \c image into memory owned by the
+         * connection, which may be read and written like any other in-memory
+         * database. \c deserializeView() instead uses the caller's memory
+         * directly, read-only; this suits an image mapped from a file, which
+         * is then queried without being copied or read in its entirety. The
+         * memory must remain valid and unchanged until \c *this is closed or
+         * the database is replaced again.
+         *
+         * Any results cached for \c *this by a \c ResultCache are discarded.
+         *
+         * \param [in] image
+         *      database image, such as returned by \c serialize()
+         * \param [in] data
+         *      start of database image
+         * \param [in] bytes
+         *      size of database image in bytes
+         * \param [in] db_name
+         *      name of the attached database to be replaced; cannot be
+         *      \c "temp"
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      \c *this is not open
+         * \throw wr::sql::Error
+         *      \c *this is in use by a read transaction or a \c Backup, or
+         *      \c db_name does not name an attached database
+         */
+        this_t &deserialize(const std::vector<uint8_t> &image,
+                            const u8string_view &db_name = u8"main");
+        this_t &deserializeView(const void *data, size_t bytes,
+                                const u8string_view &db_name = u8"main");
+        ///@}
+
         /**
          * \brief return precompiled registered statement
          *
@@ -396,20 +1003,20 @@ public:
          * invoked with the desired SQL text, returning an ID number
          * corresponding to that statement. This is later passed to
          * `Session::statement()` to retrieve a `Statement` object corresponding
-         * to it. For every registered ID `Session` caches a `Statement` object
-         * for every thread that has invoked `Session::statement()` with that
-         * ID. To support reentrant usage of a given statement
-         * `Session::statement()` returns a copy of the cached `Statement`
-         * object if the cached object is already active.
+         * to it. For every registered ID `Session` caches a small number of
+         * compiled `Statement` objects. To support reentrant usage of a given
+         * statement (such as nested iteration over its results)
+         * `Session::statement()` returns the first cached object which is not
+         * already active, compiling and caching another if all are active;
+         * once the cache for that ID is full, an uncached `Statement` object
+         * is compiled instead.
          *
          * \param [in] stmt_id
          *      ID of statement as returned by a prior call to
          *      \c wr::sql::registerStatement()
          *
          * \return reference-counted pointer to corresponding precompiled
-         *      `Statement` object; if the default `Statement` object for the
-         *      current thread is already active, a private copy of that object
-         *      is returned instead.
+         *      `Statement` object which is not active
          *
          * \throw std::invalid_argument
          *      \c stmt_id was not recognised
@@ -424,6 +1031,23 @@ public:
          */
         void finalizeRegisteredStatements();
 
+        /**
+         * \brief compile all registered statements ahead of use
+         *
+         * Ensures a precompiled `Statement` object is cached for every ID
+         * registered so far, so that later calls to \c statement() do not
+         * incur the cost of compiling SQL. Statements which cannot be
+         * compiled against the current database schema (e.g. those referring
+         * to tables not yet created) are skipped; they are compiled on
+         * demand by \c statement() as usual.
+         *
+         * \return number of registered statements now compiled
+         *
+         * \throw wr::sql::Busy
+         *      the database schema was locked by another connection
+         */
+        size_t prepareRegisteredStatements();
+
         /**
          * \brief reset all precompiled registered statements
          */
@@ -483,6 +1107,158 @@ public:
                 Session &db_;
         };
 
+        /**
+         * \brief set the number of virtual machine steps between
+         *      invocations of the progress handler
+         *
+         * The progress handler set by \c setProgressHandler() and the check
+         * made against any deadline set by \c setDeadline() are carried out
+         * once every \c vm_steps virtual machine instructions executed. A
+         * smaller interval makes both more responsive at the cost of more
+         * frequent interruption of statement execution. The default interval
+         * is 10000 steps.
+         *
+         * \param [in] vm_steps
+         *      number of virtual machine instructions between invocations;
+         *      zero is treated as one
+         *
+         * \return reference to \c *this
+         */
+        this_t &setProgressInterval(unsigned vm_steps);
+
+        /**
+         * \brief query the number of virtual machine steps between
+         *      invocations of the progress handler
+         *
+         * \see \c setProgressInterval()
+         */
+        unsigned progressInterval() const;
+
+        /// \brief clock against which deadlines are measured
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * \brief set a time by which statements must finish executing
+         *
+         * Once \c when has passed, any statement executing on this
+         * connection is halted at its next progress check (see
+         * \c setProgressInterval()) and a \c wr::sql::Interrupt exception
+         * is thrown in the thread executing it, as if \c interrupt() had
+         * been called. Waiting for a table locked by another connection
+         * sharing the same cache likewise ends with \c wr::sql::Interrupt
+         * when the deadline passes. The deadline remains in force for all
+         * subsequent statements until changed or cleared.
+         *
+         * A deadline is checked only while statements are being executed;
+         * it does not interrupt the application between calls to
+         * \c Statement::next(). The deadline and any progress handler set
+         * by \c setProgressHandler() are independent of one another.
+         *
+         * \param [in] when
+         *      the deadline
+         *
+         * \return reference to \c *this
+         *
+         * \see \c ScopedDeadline, \c execWithDeadline()
+         */
+        this_t &setDeadline(Clock::time_point when);
+
+        /**
+         * \brief remove any deadline set by \c setDeadline()
+         *
+         * \return reference to \c *this
+         */
+        this_t &clearDeadline();
+
+        /**
+         * \brief query the deadline set by \c setDeadline()
+         *
+         * \return the current deadline, or <code>Clock::time_point::max()
+         *      </code> if none is set
+         */
+        Clock::time_point deadline() const;
+
+        /**
+         * \brief RAII class for setting a deadline and automatically
+         *      restoring the previous one upon exiting a given scope
+         *
+         * Deadlines nest: if a deadline earlier than the one given is
+         * already in force then it remains in force, so a statement can
+         * never be allowed more time than an enclosing scope permits.
+         */
+        class ScopedDeadline
+        {
+        public:
+                using this_t = ScopedDeadline;
+
+                ///@{
+                /**
+                 * \brief constructor
+                 *
+                 * \param [in] db
+                 *      the database connection to which the deadline applies
+                 * \param [in] when
+                 *      the deadline
+                 * \param [in] timeout
+                 *      time from now after which the deadline passes
+                 */
+                ScopedDeadline(Session &db, Clock::time_point when) :
+                        db_(db), prev_(db.deadline())
+                        { db_.setDeadline(std::min(when, prev_)); }
+
+                ScopedDeadline(Session &db, Clock::duration timeout) :
+                        this_t(db, Clock::now() + timeout) {}
+                ///@}
+
+                ScopedDeadline(const this_t &) = delete;
+                this_t &operator=(const this_t &) = delete;
+
+                ~ScopedDeadline() { db_.setDeadline(prev_); }
+
+        private:
+                Session           &db_;
+                Clock::time_point  prev_;
+        };
+
+        ///@{
+        /**
+         * \brief compile and begin executing an SQL statement within a
+         *      time limit
+         *
+         * Equivalent to \c exec() invoked within the scope of a
+         * \c ScopedDeadline expiring after \c timeout. The time limit applies
+         * to compilation and execution up to the first result row (or to
+         * completion for statements returning no rows); result rows fetched
+         * subsequently are not subject to it.
+         *
+         * \param [in] timeout
+         *      time allowed for the statement to execute
+         * \param [in] sql
+         *      the SQL statement
+         * \param [in] stmt_id
+         *      ID of statement returned by a prior call to
+         *      \c wr::sql::registerStatement()
+         * \param [in] ...args
+         *      argument value(s) to be bound to statement parameters, in
+         *      order of appearance
+         *
+         * \return the executed statement, as per \c exec()
+         *
+         * \throw wr::sql::Interrupt
+         *      \c timeout elapsed before the statement finished executing,
+         *      or a call to \c interrupt() was issued
+         *
+         * Other exceptions are thrown as per \c exec().
+         */
+        template <typename ...Args> Statement
+                execWithDeadline(Clock::duration timeout,
+                                 const u8string_view &sql, Args &&...args);
+
+        template <typename ...Args> ExecResult
+                execWithDeadline(Clock::duration timeout, size_t stmt_id,
+                                 Args &&...args);
+        ///@}
+
 
         /**
          * \brief execute a transaction
@@ -493,6 +1269,9 @@ public:
          *
          * For further information refer to \c Transaction::begin().
          *
+         * \param [in] mode
+         *      locking strategy for the transaction; if not specified, the
+         *      mode set by \c setLockingMode() is used
          * \param [in] code
          *      callable object invoked within the transaction's context
          *      with one argument: a reference to the created transaction
@@ -507,6 +1286,93 @@ public:
          * \see \c wr::sql::Transaction::begin()
          */
         Transaction beginTransaction(std::function<void (Transaction &)> code);
+        Transaction beginTransaction(LockingMode mode,
+                                     std::function<void (Transaction &)> code);
+
+        ///@{
+        /**
+         * \brief get or set the default locking mode for transactions
+         *
+         * The default locking mode applies to outermost transactions begun on
+         * this connection without an explicitly specified mode. Newly
+         * constructed \c Session objects use \c DEFERRED_LOCKING.
+         *
+         * \param [in] mode  the new default locking mode
+         *
+         * \return \c lockingMode() returns the current default mode;
+         *      \c setLockingMode() returns a reference to \c *this
+         */
+        LockingMode lockingMode() const;
+        this_t &setLockingMode(LockingMode mode);
+        ///@}
+
+        ///@{
+        /**
+         * \brief get or set the default policy for retrying transactions
+         *
+         * The default retry policy applies to transactions begun on this
+         * connection without an explicitly specified policy.
+         *
+         * \param [in] policy  the new default retry policy
+         *
+         * \return \c retryPolicy() returns the current default policy;
+         *      \c setRetryPolicy() returns a reference to \c *this
+         */
+        const RetryPolicy &retryPolicy() const;
+        this_t &setRetryPolicy(const RetryPolicy &policy);
+        ///@}
+
+        ///@{
+        /**
+         * \brief get or reset counters describing transaction retries on
+         *      this connection
+         *
+         * \return \c transactionStats() returns the counters accumulated
+         *      since the connection's \c Session object was constructed or
+         *      \c resetTransactionStats() was last called
+         */
+        TransactionStats transactionStats() const;
+        void resetTransactionStats();
+        ///@}
+
+        ///@{
+        /**
+         * \brief enable, disable or query per-statement statistics
+         *      collection
+         *
+         * Collection is disabled by default (unless
+         * \c SessionOptions::statistics was set when the connection was
+         * opened), in which case it imposes no overhead at all. Disabling
+         * collection keeps the statistics collected so far; reopening the
+         * connection discards them.
+         *
+         * \param [in] enable  \c true to collect statistics, \c false not to
+         *
+         * \return \c statisticsEnabled() returns \c true if statistics are
+         *      being collected; \c enableStatistics() returns a reference
+         *      to \c *this
+         *
+         * \throw std::logic_error
+         *      \c enableStatistics(true) was called on a closed \c Session
+         *
+         * \see \c StatementStats
+         */
+        this_t &enableStatistics(bool enable = true);
+        bool statisticsEnabled() const;
+        ///@}
+
+        ///@{
+        /**
+         * \brief get or reset per-statement statistics
+         *
+         * \return \c statistics() returns a snapshot of the statistics
+         *      accumulated for each statement executed on this connection
+         *      since collection was first enabled or \c resetStatistics()
+         *      was last called, ordered by descending total execution time
+         */
+        std::vector<StatementStats> statistics() const;
+        void resetStatistics();
+        ///@}
 
         /** \brief callback function invoked upon completion of the outermost
                 transaction */
@@ -527,7 +1393,9 @@ public:
          * invoked immediately.
          *
          * Actions registered using \c onFinalCommit() are forgotten after
-         * invocation, or if the active transaction is rolled back.
+         * invocation, or if the active transaction is rolled back. Rolling
+         * back a nested transaction only forgets the actions registered
+         * since it began.
          *
          * \param [in] action
          *      callable object to be invoked upon commit
@@ -555,6 +1423,8 @@ public:
          *
          * Actions registered using \c onRollback() are forgotten after
          * invocation, or once the outermost active transaction commits.
+         * Rolling back a nested transaction only invokes the actions
+         * registered since it began.
          *
          * \param [in] action
          *      callable object to be invoked upon rollback
@@ -564,13 +1434,47 @@ public:
         void onRollback(RollbackAction action);
 
 private:
+        friend Backup;
+        friend BlobStream;
         friend IDSet;
+        friend SessionGroup;
+        friend SessionPool;
         friend Statement;
         friend Transaction;
         friend SessionTests;
 
         struct Body;
 
+        using BatchChunkFn = std::function<size_t (Statement &stmt,
+                                                   size_t max_rows,
+                                                   bool retry)>;
+
+        size_t execBatch_(size_t stmt_id, size_t commit_every,
+                          const BatchChunkFn &exec_chunk);
+
+        void deserialize_(uint8_t *data, size_t bytes, unsigned flags,
+                          const u8string_view &db_name);
+
+        using BindFn = std::function<void (Statement &stmt)>;
+
+        // identifies the connection's database within ResultCache keys
+        const std::string &databaseID_() const;
+
+        ResultCache::Rows execCached_(size_t stmt_id,
+                                      const ResultCache::Key &key,
+                                      const BindFn &bind) const;
+
+        Statement execScript_(const u8string_view &sql,
+                              const BindFn &bind) const;
+        ExecResult execScript_(size_t script_id,
+                               const BindFn &bind) const;
+
+        static void bindNamed_(Statement &) {}
+
+        template <typename Name, typename T, typename ...Args> static void
+                bindNamed_(Statement &stmt, const Name &name, const T &val,
+                           const Args &...named_args);
+
         Body *body_;
 };
 
@@ -600,6 +1504,136 @@ Session::exec(
         return q;
 }
 
+//--------------------------------------
+
+template <typename Range> inline size_t
+Session::execBatch(
+        size_t       stmt_id,
+        const Range &rows,
+        size_t       commit_every
+)
+{
+        return execBatch(stmt_id, std::begin(rows), std::end(rows),
+                         commit_every);
+}
+
+//--------------------------------------
+
+template <typename Iter> inline size_t
+Session::execBatch(
+        size_t stmt_id,
+        Iter   first,
+        Iter   last,
+        size_t commit_every
+)
+{
+        Iter chunk_begin = first, chunk_end = first;
+
+        return execBatch_(stmt_id, commit_every,
+                [&](Statement &stmt, size_t max_rows, bool retry) -> size_t {
+                        if (!retry) {  // otherwise re-execute same chunk
+                                chunk_begin = chunk_end;
+                        }
+                        chunk_end = chunk_begin;
+                        for (size_t n = 0; (n < max_rows) && (chunk_end != last);
+                                           ++n) {
+                                ++chunk_end;
+                        }
+                        return stmt.executeBatch(chunk_begin, chunk_end);
+                });
+}
+
+//--------------------------------------
+
+template <typename ...Args> inline auto
+Session::execCached(
+        size_t      stmt_id,
+        Args   &&...args
+) const -> ResultCache::Rows
+{
+        ResultCache::Key key(databaseID_(), stmt_id);
+
+        (void) std::initializer_list<int>{ (key.append(args), 0)... };
+
+        return execCached_(stmt_id, key, [&](Statement &stmt) {
+                stmt.bindAll(std::forward<Args>(args)...);
+        });
+}
+
+//--------------------------------------
+
+template <typename ...Args> inline Statement
+Session::execScript(
+        const u8string_view     &sql,
+        Args                &&...named_args
+) const
+{
+        static_assert(sizeof...(Args) % 2 == 0,
+                      "execScript() requires pairs of name and value");
+        return execScript_(sql, [&](Statement &stmt) {
+                bindNamed_(stmt, named_args...);
+        });
+}
+
+//--------------------------------------
+
+template <typename ...Args> inline auto
+Session::execScript(
+        size_t      script_id,
+        Args   &&...named_args
+) const -> ExecResult
+{
+        static_assert(sizeof...(Args) % 2 == 0,
+                      "execScript() requires pairs of name and value");
+        return execScript_(script_id, [&](Statement &stmt) {
+                bindNamed_(stmt, named_args...);
+        });
+}
+
+//--------------------------------------
+
+template <typename Name, typename T, typename ...Args> inline void
+Session::bindNamed_(
+        Statement      &stmt,
+        const Name     &name,
+        const T        &val,
+        const Args &...named_args
+) // static
+{
+        int param_no = stmt.paramNo(name);
+
+        if (param_no) {
+                stmt.bind(param_no, val);
+        }
+        bindNamed_(stmt, named_args...);
+}
+
+//--------------------------------------
+
+template <typename ...Args> inline Statement
+Session::execWithDeadline(
+        Clock::duration          timeout,
+        const u8string_view     &sql,
+        Args                &&...args
+)
+{
+        ScopedDeadline deadline(*this, timeout);
+        return exec(sql, std::forward<Args>(args)...);
+}
+
+//--------------------------------------
+
+template <typename ...Args> inline auto
+Session::execWithDeadline(
+        Clock::duration      timeout,
+        size_t               stmt_id,
+        Args             &&...args
+) -> ExecResult
+{
+        ScopedDeadline deadline(*this, timeout);
+        return exec(stmt_id, std::forward<Args>(args)...);
+}
+
 
 } // namespace sql
 } // namespace wr
@@ -0,0 +1,272 @@
+/**
+ * \file wrsql/SessionGroup.h
+ *
+ * \brief Declaration of class \c wr::sql::SessionGroup
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_SESSION_GROUP_H
+#define WRSQL_SESSION_GROUP_H
+
+#include <stddef.h>
+#include <chrono>
+#include <functional>
+#include <future>
+
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+#include <wrsql/Session.h>
+#include <wrsql/SessionPool.h>
+#include <wrsql/Transaction.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/**
+ * \class wr::sql::SessionGroup
+ * \brief one writer connection and a pool of reader connections to a single
+ *      database
+ *
+ * SQLite permits only one connection to write to a database at a time. A
+ * \c SessionGroup enforces this by funnelling all writes through a single
+ * writer \c Session driven by its own thread, while any number of threads
+ * read concurrently through a pool of read-only sessions. The database is
+ * placed in WAL journal mode (unless \c SessionOptions::journal_mode
+ * specifies otherwise), so that each reader sees a consistent snapshot
+ * without blocking or being blocked by the writer.
+ *
+ * A write is submitted as a transaction body through \c write(), which
+ * returns immediately with a \c std::future that becomes ready once the
+ * body's changes have been committed. The writer thread drains up to
+ * \c maxBatchSize() queued bodies at a time and executes each in a nested
+ * transaction within a single outer \c IMMEDIATE transaction, committing
+ * the whole batch at once. One body failing rolls back only that body's
+ * own changes; the others still commit. \c Session::onFinalCommit() actions
+ * registered by a body run after the shared commit.
+ *
+ * \code{.cpp}
+ * wr::sql::SessionGroup group("sqlite3:app.db", 4);
+ *
+ * auto done = group.write([=](wr::sql::Session &writer) {
+ *         writer.exec(INSERT_EVENT, event_id, payload);
+ * });
+ *
+ * auto reader = group.read();
+ * for (auto row: reader->exec(GET_EVENTS)) { ... }
+ * \endcode
+ *
+ * All \c SessionGroup methods are thread safe. The group must refer to a
+ * database file; each connection to \c ":memory:" would open a separate
+ * database.
+ */
+class WRSQL_API SessionGroup
+{
+public:
+        using this_t = SessionGroup;
+        using Lease  = SessionPool::Lease;
+
+        /// \brief transaction body executed by the writer connection
+        using WriteFn = std::function<void (Session &writer)>;
+
+        ///@{
+        /**
+         * \brief object constructor
+         *
+         * The default constructor creates an empty, closed group. The other
+         * constructors open the group through an implicit call to \c open().
+         *
+         * \param [in] uri
+         *      URI describing type and location of database to open
+         * \param [in] options
+         *      settings applied to every connection
+         * \param [in] num_readers
+         *      number of read-only connections to open
+         * \param [in] prepare
+         *      if \c true, every registered statement is compiled on each
+         *      reader connection before it is first lent out
+         *
+         * \throw wr::sql::Error
+         *      invalid \c uri, permission denied, memory exhausted or
+         *      \c options could not be applied
+         */
+        SessionGroup();
+        SessionGroup(const u8string_view &uri, size_t num_readers,
+                     bool prepare = true);
+        SessionGroup(const u8string_view &uri, const SessionOptions &options,
+                     size_t num_readers, bool prepare = true);
+        SessionGroup(const this_t &) = delete;
+        ///@}
+
+        /**
+         * \brief object destructor
+         *
+         * Implicitly calls \c close().
+         */
+        ~SessionGroup();
+
+        this_t &operator=(const this_t &) = delete;
+
+        /**
+         * \brief open the group's connections
+         *
+         * If the group is already open it is closed first by an implicit
+         * call to \c close(). The writer connection is opened first, creating
+         * the database if required and \c options permit, and then the
+         * reader connections are opened with \c SessionOptions::read_only
+         * set.
+         *
+         * \param [in] uri
+         *      URI describing type and location of database to open
+         * \param [in] options
+         *      settings applied to every connection; if not specified,
+         *      default settings are used
+         * \param [in] num_readers
+         *      number of read-only connections to open; must be nonzero
+         * \param [in] prepare
+         *      if \c true, every registered statement is compiled on each
+         *      reader connection before it is first lent out
+         *
+         * \throw std::invalid_argument
+         *      \c num_readers was zero
+         * \throw wr::sql::Error
+         *      invalid \c uri, permission denied, memory exhausted or
+         *      \c options could not be applied; any connections already
+         *      opened by this call are closed again
+         */
+        void open(const u8string_view &uri, size_t num_readers,
+                  bool prepare = true);
+        void open(const u8string_view &uri, const SessionOptions &options,
+                  size_t num_readers, bool prepare = true);
+
+        /**
+         * \brief close all of the group's connections
+         *
+         * Blocks until every write already submitted has completed and every
+         * outstanding \c Lease has been returned.
+         *
+         * \throw wr::sql::Error
+         *      queries still in progress on one of the connections
+         */
+        void close();
+
+        ///@{
+        /**
+         * \brief borrow a read-only \c Session
+         *
+         * \c read() blocks until a reader becomes available, while
+         * \c tryRead() returns an empty \c Lease immediately if all readers
+         * are already lent out.
+         *
+         * \return \c Lease object holding the borrowed \c Session
+         *
+         * \throw std::logic_error
+         *      the group is not open
+         *
+         * \see \c SessionPool::acquire()
+         */
+        Lease read();
+        Lease tryRead();
+        ///@}
+
+        /**
+         * \brief queue a transaction body for execution by the writer
+         *
+         * \c code is invoked by the writer thread, with the writer
+         * \c Session, within a nested transaction as per
+         * \c Transaction::begin(). Like any transaction body it may be
+         * executed more than once if the enclosing batch has to be retried,
+         * so any side effects outside the database should be deferred by
+         * \c Session::onFinalCommit().
+         *
+         * If \c code causes the whole batch to be rolled back (for example
+         * by an \c INSERT \c OR \c ROLLBACK statement), every write in the
+         * batch executed so far fails with the same exception; the writes
+         * queued behind it are committed in a batch of their own.
+         *
+         * \param [in] code
+         *      transaction body
+         *
+         * \return future which becomes ready once the changes made by
+         *      \c code have been committed, or receives the exception thrown
+         *      by \c code or by the final commit
+         *
+         * \throw std::logic_error
+         *      the group is not open
+         */
+        std::future<void> write(WriteFn code);
+
+        ///@{
+        /**
+         * \brief get or set group commit parameters
+         *
+         * After taking the first of a batch of writes from its queue, the
+         * writer waits up to \c commitDelay() for further writes to arrive
+         * before executing the batch, unless \c maxBatchSize() writes are
+         * already queued. The default delay of zero commits whatever is
+         * queued at the time without waiting; a longer delay trades the
+         * latency of each write for fewer commits under light load.
+         *
+         * \param [in] size   maximum number of writes per commit; a size of
+         *                    \c 0 is treated as \c 1
+         * \param [in] delay  maximum time to wait for a batch to fill
+         */
+        size_t maxBatchSize() const;
+        void setMaxBatchSize(size_t size);
+
+        std::chrono::microseconds commitDelay() const;
+        void setCommitDelay(std::chrono::microseconds delay);
+        ///@}
+
+        ///@{
+        /**
+         * \brief get status information
+         * \return
+         *      \c isOpen() returns \c true if the group's connections are open
+         * \return
+         *      \c numReaders() returns the total number of reader connections
+         * \return
+         *      \c pendingWrites() returns the number of submitted writes
+         *      not yet taken up by the writer
+         * \return
+         *      \c numWrites() and \c numCommits() return the number of
+         *      writes executed and the number of commits performed by the
+         *      writer since the group was opened
+         */
+        bool isOpen() const;
+        size_t numReaders() const;
+        size_t pendingWrites() const;
+        size_t numWrites() const;
+        size_t numCommits() const;
+        ///@}
+
+private:
+        struct Body;
+
+        Body *body_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_SESSION_GROUP_H
@@ -0,0 +1,303 @@
+/**
+ * \file wrsql/SessionPool.h
+ *
+ * \brief Declaration of class \c wr::sql::SessionPool
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_SESSION_POOL_H
+#define WRSQL_SESSION_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+#include <wrsql/Session.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/**
+ * \class wr::sql::SessionPool
+ * \brief fixed-size pool of open connections to a single database
+ *
+ * A \c SessionPool opens a given number of \c Session objects to the same
+ * database URI up front and lends them out to callers on request, so that
+ * the cost of opening a connection (and optionally of compiling every
+ * registered statement) is paid once rather than on the request path.
+ *
+ * A \c Session is borrowed by calling \c acquire() or \c tryAcquire(), which
+ * return a \c Lease object; the \c Session is returned to the pool
+ * automatically when the \c Lease is destroyed. Each borrowing thread is
+ * given back the \c Session it used last whenever that \c Session is idle,
+ * keeping the connection's page cache and compiled statements warm on the
+ * same thread.
+ *
+ * All \c SessionPool methods are thread safe. Each lent-out \c Session must
+ * only be used by the thread holding its \c Lease, in accordance with the
+ * thread safety rules given for \c wr::sql::Session.
+ */
+class WRSQL_API SessionPool
+{
+public:
+        using this_t = SessionPool;
+
+        ///@{
+        /**
+         * \brief object constructor
+         *
+         * The default constructor creates an empty, closed pool. The other
+         * constructor opens the pool through an implicit call to \c open().
+         *
+         * \param [in] uri
+         *      URI describing type and location of database to open
+         * \param [in] options
+         *      settings applied to every connection
+         * \param [in] size
+         *      number of connections to open
+         * \param [in] prepare
+         *      if \c true, every registered statement is compiled on each
+         *      connection before it is first lent out
+         *
+         * \throw wr::sql::Error
+         *      invalid \c uri, permission denied, memory exhausted or
+         *      \c options could not be applied
+         */
+        SessionPool();
+        SessionPool(const u8string_view &uri, size_t size, bool prepare = true);
+        SessionPool(const u8string_view &uri, const SessionOptions &options,
+                    size_t size, bool prepare = true);
+        SessionPool(const this_t &) = delete;
+        ///@}
+
+        /**
+         * \brief object destructor
+         *
+         * Implicitly calls \c close().
+         */
+        ~SessionPool();
+
+        this_t &operator=(const this_t &) = delete;
+
+        /**
+         * \brief open the pool's connections
+         *
+         * If the pool is already open it is closed first by an implicit call
+         * to \c close().
+         *
+         * \param [in] uri
+         *      URI describing type and location of database to open
+         * \param [in] options
+         *      settings applied to every connection; if not specified,
+         *      default settings are used
+         * \param [in] size
+         *      number of connections to open; must be nonzero
+         * \param [in] prepare
+         *      if \c true, every registered statement is compiled on each
+         *      connection before it is first lent out; statements registered
+         *      later are compiled the next time a connection is borrowed
+         *
+         * \throw std::invalid_argument
+         *      \c size was zero
+         * \throw wr::sql::Error
+         *      invalid \c uri, permission denied, memory exhausted or
+         *      \c options could not be applied; any connections already
+         *      opened by this call are closed again
+         */
+        void open(const u8string_view &uri, size_t size, bool prepare = true);
+        void open(const u8string_view &uri, const SessionOptions &options,
+                  size_t size, bool prepare = true);
+
+        /**
+         * \brief close all of the pool's connections
+         *
+         * Blocks until every outstanding \c Lease has been returned.
+         *
+         * \throw wr::sql::Error
+         *      queries still in progress on one of the connections
+         */
+        void close();
+
+        /**
+         * \class wr::sql::SessionPool::Lease
+         * \brief RAII handle to a \c Session borrowed from a \c SessionPool
+         *
+         * The \c Session is given back to its pool when the \c Lease is
+         * destroyed or \c release() is called. At that point any registered
+         * statements left active by the borrower are reset, any transaction
+         * left open is rolled back (invoking any pending
+         * \c Session::onRollback() actions, and leaving any \c Transaction
+         * objects still held by the borrower inactive), and any deadline or
+         * progress handler set by the borrower is cleared, so that the next
+         * borrower receives the \c Session in the same state as when first
+         * opened. If the rollback fails, or the borrower closed the
+         * \c Session, the connection is reopened when next borrowed;
+         * returning a \c Session never throws.
+         */
+        class WRSQL_API Lease
+        {
+        public:
+                using this_t = Lease;
+
+                ///@{
+                /// \brief constructor
+                Lease() : pool_(nullptr), slot_(nullptr) {}
+                Lease(const this_t &) = delete;
+                Lease(this_t &&other);
+                ///@}
+
+                /// \brief destructor; returns the \c Session to its pool
+                ~Lease() { release(); }
+
+                ///@{
+                /// \brief assignment operator
+                this_t &operator=(const this_t &) = delete;
+                this_t &operator=(this_t &&other);
+                ///@}
+
+                ///@{
+                /// \brief provide access to the borrowed \c Session object
+                Session *get() const;
+                Session *operator->() const { return get(); }
+                Session &operator*() const  { return *get(); }
+                ///@}
+
+                /// \brief determine if \c this holds a \c Session
+                explicit operator bool() const { return slot_ != nullptr; }
+
+                /**
+                 * \brief return the \c Session to its pool ahead of
+                 *      destruction
+                 *
+                 * Has no effect if \c this holds no \c Session.
+                 */
+                void release();
+
+        private:
+                friend SessionPool;
+
+                Lease(SessionPool *pool, void *slot) :
+                        pool_(pool), slot_(slot) {}
+
+                SessionPool *pool_;
+                void        *slot_;
+        };
+
+        ///@{
+        /**
+         * \brief borrow a \c Session from the pool
+         *
+         * \c acquire() blocks until a \c Session becomes available, while
+         * \c tryAcquire() returns an empty \c Lease immediately if all
+         * of the pool's sessions are already lent out.
+         *
+         * \return \c Lease object holding the borrowed \c Session
+         *
+         * \throw std::logic_error
+         *      the pool is not open
+         * \throw wr::sql::Error
+         *      a connection which could not be restored when last returned
+         *      failed to reopen; it is reopened again on a later attempt
+         */
+        Lease acquire();
+        Lease tryAcquire();
+        ///@}
+
+        /**
+         * \brief compile registered statements on every idle connection
+         *
+         * Intended to be called once all of an application's statements have
+         * been registered. Sessions currently lent out are brought up to
+         * date the next time they are borrowed.
+         *
+         * \see \c Session::prepareRegisteredStatements()
+         */
+        void prepareRegisteredStatements();
+
+        ///@{
+        /**
+         * \brief get status information
+         * \return
+         *      \c isOpen() returns \c true if the pool's connections are open
+         * \return
+         *      \c uri() returns the URI the pool's connections were opened
+         *      with, or an empty string if the pool is closed
+         * \return
+         *      \c size() returns the total number of connections in the pool
+         * \return
+         *      \c available() returns the number of connections not
+         *      currently lent out
+         */
+        bool isOpen() const;
+        u8string_view uri() const;
+        size_t size() const;
+        size_t available() const;
+        ///@}
+
+        ///@{
+        /**
+         * \brief get or set the pool's memory budget
+         *
+         * Each time a \c Session is returned to the pool its memory usage,
+         * as given by <code>Session::memoryStats().memoryUsed()</code>, is
+         * sampled. If the total last sampled for all of the pool's sessions
+         * then exceeds the budget, \c Session::releaseMemory() is called on
+         * idle sessions, beginning with the largest, until the total falls
+         * within budget. Since their caches are cold, trimmed sessions lose
+         * their thread affinity and are lent out after all others; if the pool compiles registered
+         * statements ahead of use, they are compiled again when a trimmed
+         * session is next borrowed.
+         *
+         * \param [in] bytes  budget in bytes, or zero for no limit (the
+         *      default)
+         *
+         * \return
+         *      \c memoryBudget() returns the current budget
+         * \return
+         *      \c memoryUsed() returns the total memory usage last sampled
+         *      for the pool's sessions
+         * \return
+         *      \c numTrims() returns the number of times a session has been
+         *      trimmed since the pool was constructed
+         */
+        uint64_t memoryBudget() const;
+        void setMemoryBudget(uint64_t bytes);
+        uint64_t memoryUsed() const;
+        size_t numTrims() const;
+        ///@}
+
+private:
+        struct Body;
+
+        Lease acquire_(bool wait);
+        void giveBack(void *slot);
+
+        Body *body_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_SESSION_POOL_H
@@ -26,8 +26,14 @@
 #ifndef WRSQL_STATEMENT_H
 #define WRSQL_STATEMENT_H
 
+#include <stdint.h>
 #include <functional>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <boost/smart_ptr/intrusive_ptr.hpp>
 #include <boost/smart_ptr/intrusive_ref_counter.hpp>
@@ -60,8 +66,13 @@ enum ValueType
 };
 
 
+class ColumnBatch;
 class Session;
-class Row;  // defined below
+class Row;        // defined below
+class ColumnRef;  // defined below
+
+template <typename T> struct RowFields;   // specialized by applications
+template <typename T> struct RowDecoder;  // defined below
 
 
 /**
@@ -186,6 +197,11 @@ public:
          *      \c sql() returns the original SQL text associated with a
          *      prepared \c Statement object or an empty string for an
          *      unprepared \c Statement object
+         * \return
+         *      \c numParams() returns the highest parameter number in a
+         *      prepared \c Statement object, and \c numCols() the number of
+         *      columns in its result rows; both return zero for an
+         *      unprepared \c Statement object
          */
         bool isPrepared() const        { return stmt_ != nullptr; }
         bool isActive() const          { return stmt_ && (stmt_.tag() != 0); }
@@ -193,8 +209,33 @@ public:
         const Session *session() const { return session_; }
         explicit operator bool() const { return isPrepared(); }
         u8string_view sql() const;
+        int numParams() const;
+        int numCols() const;
         ///@}
 
+        /**
+         * \brief look up a named statement parameter
+         *
+         * \param [in] name
+         *      the parameter's name including its prefix character, for
+         *      example \c ":since" or \c "$limit"
+         *
+         * \return the 1-based number of the parameter named \c name, or
+         *      zero if the statement is not prepared or has no such
+         *      parameter
+         */
+        int paramNo(const u8string_view &name) const;
+
+        /**
+         * \brief determine whether the statement leaves the database
+         *      unchanged
+         *
+         * \return \c true if the statement makes no direct changes to the
+         *      content of the database or is not prepared, otherwise
+         *      \c false
+         */
+        bool isReadOnly() const;
+
         /**
          * \brief reset a prepared \c Statement object to an inactive state
          *
@@ -313,9 +354,10 @@ public:
          *      data size
          * \param [in] free_blob
          *      optional destructor function to release memory allocated for
-         *      \c data, invoked upon the next call to \c ~Statement(),
-         *      \c finalize() or \c clearBindings(); if \c free_blob is not
-         *      specified then no action is taken
+         *      \c data, invoked when parameter \c param_no is next bound or
+         *      upon the next call to \c ~Statement(), \c finalize() or
+         *      \c clearBindings(); also invoked immediately if binding fails.
+         *      If \c free_blob is not specified then no action is taken
          *
          * \return reference to \c *this
          *
@@ -327,13 +369,73 @@ public:
          * \throw std::bad_alloc
          *      memory allocation failed
          * \throw wr::sql::Error
-         *      \c data has already been bound with a non-default \c free_blob
-         *      function, or another run-time statement error occurred
-         *      (dependent on underlying database implementation)
+         *      other run-time statement error occurred (dependent on
+         *      underlying database implementation)
          */
         this_t &bind(int param_no, const void *data, size_t bytes,
                      FreeBlobFn free_blob = {});
 
+        ///@{
+        /**
+         * \brief bind text or binary data to statement parameter, taking
+         *      ownership of it
+         *
+         * The string or vector is moved into the \c Statement and handed to
+         * the database without its contents being copied (very short values
+         * are copied instead). It is released when parameter \c param_no is
+         * next bound or upon the next call to \c ~Statement(), \c finalize()
+         * or \c clearBindings().
+         *
+         * \param [in] param_no
+         *      1-based index of parameter to bind
+         * \param [in] text
+         *      UTF-8 text to bind
+         * \param [in] blob
+         *      binary data to bind; an empty vector binds a zero-length blob
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::invalid_argument
+         *      \c param_no referred to a nonexistent parameter number
+         * \throw std::length_error
+         *      data size exceeds limits imposed by underlying database
+         *      implementation
+         * \throw std::bad_alloc
+         *      memory allocation failed
+         * \throw wr::sql::Error
+         *      other run-time statement error occurred (dependent on
+         *      underlying database implementation)
+         */
+        this_t &bind(int param_no, std::string &&text);
+        this_t &bind(int param_no, std::vector<uint8_t> &&blob);
+        ///@}
+
+        /**
+         * \brief bind zero-filled binary data of a given size to statement
+         *      parameter
+         *
+         * No memory is allocated for the data when it is bound; inserting
+         * it reserves space in the database which can then be filled in
+         * place using a \c wr::sql::BlobStream.
+         *
+         * \param [in] param_no
+         *      1-based index of parameter to bind
+         * \param [in] bytes
+         *      data size
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::invalid_argument
+         *      \c param_no referred to a nonexistent parameter number
+         * \throw std::length_error
+         *      data size exceeds limits imposed by underlying database
+         *      implementation
+         * \throw wr::sql::Error
+         *      other run-time statement error occurred (dependent on
+         *      underlying database implementation)
+         */
+        this_t &bindZeroBlob(int param_no, size_t bytes);
+
         ///@{
         /**
          * \brief bind values to multiple statement parameters
@@ -432,6 +534,161 @@ public:
         template <typename ...Args> Row begin(Args &&...bind_args);
         ///@}
 
+        ///@{
+        /**
+         * \brief execute statement once for each element of a sequence
+         *
+         * \c executeBatch() is intended for bulk \c INSERT, \c UPDATE or
+         * \c DELETE operations. For each element of the given sequence the
+         * statement's parameters are bound and the statement is executed to
+         * completion, discarding any result rows. Each element may be a
+         * \c std::tuple or \c std::pair, whose members are bound to
+         * consecutive parameters beginning with parameter 1, or a single
+         * value, which is bound to parameter 1.
+         *
+         * Unlike \c bindAll(), bindings are \e not cleared before each
+         * element is bound, avoiding redundant work when every element binds
+         * every parameter. Parameters not bound by an element therefore
+         * retain the value bound by the previous element (or prior to the
+         * call to \c executeBatch()).
+         *
+         * \c executeBatch() does not begin a transaction of its own; see
+         * \c Session::execBatch() for a version that does.
+         *
+         * \param [in] first, last
+         *      iterators delimiting the sequence of elements to execute
+         * \param [in] rows
+         *      a container or other range of elements to execute, accepted
+         *      by \c std::begin() and \c std::end()
+         *
+         * \return number of elements executed
+         *
+         * \throw std::invalid_argument
+         *      an element contained more values than the statement has
+         *      parameters
+         * \throw std::length_error
+         *      size of a value exceeded limits imposed by underlying database
+         *      implementation
+         * \throw std::bad_alloc
+         *      memory allocation failed
+         * \throw wr::sql::Error
+         *      a miscellaneous error such as a constraint violation occurred;
+         *      elements preceding the failed element remain executed
+         * \throw wr::sql::Interrupt
+         *      \c Session::interrupt() was invoked by a progress handler or
+         *      another thread
+         * \throw wr::sql::Busy
+         *      a deadlock or excessive contention was detected between
+         *      this and other connections concurrently accessing the database
+         *      (handled automatically by \c Transaction::begin())
+         */
+        template <typename Iter> size_t executeBatch(Iter first, Iter last);
+
+        template <typename Range> size_t executeBatch(const Range &rows)
+                { return executeBatch(std::begin(rows), std::end(rows)); }
+        ///@}
+
+        ///@{
+        /**
+         * \brief execute statement and decode all result rows
+         *
+         * Executes the statement from the beginning, binding any arguments
+         * given by \c bind_args as per \c begin(), and decodes every result
+         * row into an object of type \c T using \c Row::as(). \c T may be
+         * a \c std::tuple, a \c std::pair or any type for which
+         * \c wr::sql::RowFields has been specialized.
+         *
+         * \c fetchAll() returns a new vector of decoded rows, while
+         * \c fetchInto() appends decoded rows to an existing vector, so that
+         * a vector reserved in advance (or reused across calls) avoids
+         * reallocation. Each row is decoded in place within the vector.
+         *
+         * \param [out] out
+         *      vector to which decoded rows are appended
+         * \param [in] bind_args...
+         *      optional value(s) to bind to statement parameters
+         *
+         * \return
+         *      \c fetchAll() returns a vector containing all decoded rows
+         * \return
+         *      \c fetchInto() returns the number of rows appended to \c out
+         *
+         * \throw std::invalid_argument
+         *      the statement returns fewer columns than the number of values
+         *      in \c T
+         * \throw wr::sql::Error
+         *      a run-time statement execution error occurred (exact nature
+         *      depends on underlying database implementation)
+         * \throw wr::sql::Interrupt
+         *      \c Session::interrupt() was invoked by a progress handler or
+         *      another thread
+         * \throw wr::sql::Busy
+         *      a deadlock or excessive contention was detected between
+         *      this and other connections concurrently accessing the database
+         *      (handled automatically by \c Transaction::begin())
+         */
+        template <typename T, typename ...Args>
+        std::vector<T> fetchAll(Args &&...bind_args);
+
+        template <typename T, typename ...Args>
+        size_t fetchInto(std::vector<T> &out, Args &&...bind_args);
+        ///@}
+
+        ///@{
+        /**
+         * \brief fetch a block of rows into column vectors
+         *
+         * Appends the current row and those following it, up to
+         * \c max_rows rows in total, to a \c wr::sql::ColumnBatch, leaving
+         * the statement positioned at the first row not fetched. The
+         * statement must already be executing, as after \c begin(); an
+         * inactive statement yields an empty batch, so that successive
+         * calls may be made until no rows remain:
+         *
+         * \code
+         * wr::sql::ColumnBatch batch;
+         *
+         * stmt.begin();
+         * while (stmt.fetchBatch(batch, 1024)) {
+         *         process(batch);
+         * }
+         * \endcode
+         *
+         * The overload taking a \c ColumnBatch argument discards its
+         * previous contents but reuses its memory.
+         *
+         * \param [out] out
+         *      batch to hold fetched rows
+         * \param [in] max_rows
+         *      maximum number of rows to fetch
+         *
+         * \return
+         *      <code>fetchBatch(size_t)</code> returns a new batch holding
+         *      the rows fetched
+         * \return
+         *      <code>fetchBatch(ColumnBatch &, size_t)</code> returns the
+         *      number of rows fetched
+         *
+         * \throw std::length_error
+         *      the text or BLOB values of a single column exceed 2GiB
+         *      within the batch
+         * \throw wr::sql::Error
+         *      a run-time statement execution error occurred (exact nature
+         *      depends on underlying database implementation)
+         * \throw wr::sql::Interrupt
+         *      \c Session::interrupt() was invoked by a progress handler or
+         *      another thread
+         * \throw wr::sql::Busy
+         *      a deadlock or excessive contention was detected between
+         *      this and other connections concurrently accessing the database
+         *      (handled automatically by \c Transaction::begin())
+         *
+         * \note If an exception is thrown, \c out holds no rows.
+         */
+        ColumnBatch fetchBatch(size_t max_rows);
+        size_t fetchBatch(ColumnBatch &out, size_t max_rows);
+        ///@}
+
         /**
          * \brief get the most recently-fetched row
          * \return
@@ -472,16 +729,88 @@ public:
 
 private:
         friend Row;
+        friend Session;
+
+        struct Body;
+        struct ParamData;
+
+        Body &body();
+
+        this_t &bindOwned(int param_no, ParamData &&data, bool is_text);
+        void checkBind(int param_no, int status);
 
         template <typename Arg1> this_t &bind_(int n, Arg1 &&arg);
 
         template <typename Arg1, typename ...ArgN>
         this_t &bind_(int n, Arg1 &&first, ArgN &&...rest);
 
+        template <typename ...T> void bindRow_(const std::tuple<T...> &row)
+                { bindTuple_(row, std::index_sequence_for<T...>()); }
+
+        template <typename T1, typename T2>
+        void bindRow_(const std::pair<T1, T2> &row)
+                { bind(1, row.first); bind(2, row.second); }
+
+        template <typename T> void bindRow_(const T &value)
+                { bind(1, value); }
+
+        template <typename Tuple, size_t ...I>
+        void bindTuple_(const Tuple &row, std::index_sequence<I...>);
+
         void throwBindError(int param_no, int status) const;
+        void checkNumCols(int expected) const;
 
         tagged_ptr<void, 1>  stmt_;
         const Session       *session_;
+        Body                *body_;  // allocated on demand
+};
+
+//--------------------------------------
+/**
+ * \class wr::sql::ColumnRef
+ * \brief result column name resolved to a column number on first use
+ *
+ * Passing a \c ColumnRef object rather than a column name to \c Row::get()
+ * and related methods avoids looking up the column name on every row of a
+ * result set. A \c ColumnRef object remembers the column number found for
+ * the statement it was last used with, so it is best constructed once
+ * outside of a loop fetching rows:
+ *
+ * \code{.cpp}
+ * wr::sql::ColumnRef surname("surname"), forename("forename");
+ *
+ * for (wr::sql::Row row: db.exec("SELECT * FROM employees")) {
+ *         auto name = row.get<std::string>(forename) + ' '
+ *                         + row.get<std::string>(surname);
+ *         // ...
+ * }
+ * \endcode
+ *
+ * The cached column number is discarded automatically if the \c ColumnRef
+ * is used with a different \c Statement, or with a \c Statement that has
+ * been recompiled since. A \c ColumnRef object must not be used by more
+ * than one thread at a time.
+ */
+class WRSQL_API ColumnRef
+{
+public:
+        using this_t = ColumnRef;
+
+        /**
+         * \brief object constructor
+         * \param [in] col_name  UTF-8-encoded column name
+         */
+        explicit ColumnRef(const u8string_view &col_name);
+
+        /// \brief get the column name
+        u8string_view name() const;
+
+private:
+        friend Row;
+
+        std::string      name_;
+        mutable uint64_t col_index_id_;  // identifies resolved column index
+        mutable int      col_no_;
 };
 
 //--------------------------------------
@@ -685,6 +1014,53 @@ public:
         template <size_t N> const this_t &get(const u8string_view &col_name,
                                               char (&val)[N]) const
                 { return getCharArray(colNo_throw(col_name), val, N); }
+
+        template <typename T> T get(const ColumnRef &col) const
+                { return get<T>(colNo_throw(col)); }
+
+        template <typename T> optional<T> getNullable(const ColumnRef &col) const
+                { return getNullable<T>(colNo_throw(col)); }
+
+        template <typename T> const this_t &get(const ColumnRef &col,
+                                                T &value_out) const
+                { value_out = get<T>(col); return *this; }
+
+        template <typename T> const this_t &get(const ColumnRef &col,
+                                                optional<T> &value_out) const
+                { value_out = getNullable<T>(col); return *this; }
+
+        template <size_t N> const this_t &get(const ColumnRef &col,
+                                              char (&val)[N]) const
+                { return getCharArray(colNo_throw(col), val, N); }
+        ///@}
+
+        ///@{
+        /**
+         * \brief decode all values of a row at once
+         *
+         * \c as() retrieves consecutive columns, beginning with column 0,
+         * into the members of a \c std::tuple, a \c std::pair or a
+         * structure for which \c wr::sql::RowFields has been specialized.
+         * Each member is retrieved as per the two-argument form of \c get(),
+         * so members of type \c wr::optional receive \c NULL values
+         * correctly. The sequence of \c get() calls is generated at compile
+         * time by \c wr::sql::RowDecoder, which may itself be specialized
+         * for any other type.
+         *
+         * \param [out] value_out
+         *      the decoded row
+         *
+         * \return
+         *      the single-argument \c as() returns the decoded row; the
+         *      two-argument \c as() returns a reference to \c *this
+         *
+         * \see \c Statement::fetchAll()
+         */
+        template <typename T> T as() const
+                { T value; RowDecoder<T>::decode(*this, value); return value; }
+
+        template <typename T> const this_t &as(T &value_out) const
+                { RowDecoder<T>::decode(*this, value_out); return *this; }
         ///@}
 
         ///@{
@@ -695,6 +1071,8 @@ public:
          *      zero-based column number
          * \param [in] col_name
          *      UTF-8-encoded column name
+         * \param [in] col
+         *      column name previously wrapped in a \c ColumnRef object
          *
          * \return
          *      \c numCols() returns the number of columns available
@@ -714,7 +1092,9 @@ public:
          * \return
          *      \c colNo() and \c colNo_throw() return the zero-based index of
          *      the specified column given its name; \c colNo() returns -1 if
-         *      \c col_name did not match any column's name
+         *      \c col_name did not match any column's name. Column names
+         *      are looked up in a hash table built once for each compiled
+         *      statement.
          *
          * \throw std::invalid_argument
          *      an unknown column name was passed to \c colNo_throw()
@@ -725,7 +1105,9 @@ public:
         u8string_view colName(int col_no) const;
         ValueType colType(int col_no) const;
         int colNo(const u8string_view &col_name) const;
+        int colNo(const ColumnRef &col) const;
         int colNo_throw(const u8string_view &col_name) const;
+        int colNo_throw(const ColumnRef &col) const;
         ///@}
 
         ///@{
@@ -760,6 +1142,105 @@ private:
         Statement *stmt_;
 };
 
+//--------------------------------------
+/**
+ * \struct wr::sql::RowFields
+ * \brief field list trait enabling a structure to be decoded from a row
+ *
+ * Specializing \c RowFields for a structure allows \c Row::as() and
+ * \c Statement::fetchAll() to decode result rows directly into objects of
+ * that structure. The specialization must provide a static member function
+ * \c fields() returning a \c std::tuple of pointers to the data members to
+ * be filled, in column order:
+ *
+ * \code{.cpp}
+ * struct Employee
+ * {
+ *         int                   number;
+ *         std::string           surname;
+ *         wr::optional<int>     reports_to;
+ * };
+ *
+ * template <> struct wr::sql::RowFields<Employee>
+ * {
+ *         static auto fields()
+ *         {
+ *                 return std::make_tuple(&Employee::number,
+ *                                        &Employee::surname,
+ *                                        &Employee::reports_to);
+ *         }
+ * };
+ *
+ * auto employees = wr::sql::Statement(db, "SELECT number, surname, "
+ *                                         "reports_to FROM employees")
+ *                          .fetchAll<Employee>();
+ * \endcode
+ */
+
+//--------------------------------------
+/**
+ * \struct wr::sql::RowDecoder
+ * \brief compile-time row decoder used by \c Row::as()
+ *
+ * The primary template decodes structures described by
+ * \c wr::sql::RowFields; partial specializations handle \c std::tuple and
+ * \c std::pair. \c NUM_COLS gives the number of columns consumed.
+ */
+template <typename T>
+struct RowDecoder
+{
+        using Fields = typename std::decay<decltype(
+                                        RowFields<T>::fields())>::type;
+
+        enum: size_t { NUM_COLS = std::tuple_size<Fields>::value };
+
+        static void decode(const Row &row, T &out)
+                { decode_(row, out, RowFields<T>::fields(),
+                          std::make_index_sequence<NUM_COLS>()); }
+
+private:
+        template <size_t ...I>
+        static void decode_(const Row &row, T &out, const Fields &fields,
+                            std::index_sequence<I...>)
+        {
+                int expand[] = { 0, (row.get(static_cast<int>(I),
+                                             out.*std::get<I>(fields)), 0)... };
+                (void) expand;
+        }
+};
+
+//--------------------------------------
+
+template <typename ...T>
+struct RowDecoder<std::tuple<T...>>
+{
+        enum: size_t { NUM_COLS = sizeof...(T) };
+
+        static void decode(const Row &row, std::tuple<T...> &out)
+                { decode_(row, out, std::index_sequence_for<T...>()); }
+
+private:
+        template <size_t ...I>
+        static void decode_(const Row &row, std::tuple<T...> &out,
+                            std::index_sequence<I...>)
+        {
+                int expand[] = { 0, (row.get(static_cast<int>(I),
+                                             std::get<I>(out)), 0)... };
+                (void) expand;
+        }
+};
+
+//--------------------------------------
+
+template <typename T1, typename T2>
+struct RowDecoder<std::pair<T1, T2>>
+{
+        enum: size_t { NUM_COLS = 2 };
+
+        static void decode(const Row &row, std::pair<T1, T2> &out)
+                { row.get(0, out.first).get(1, out.second); }
+};
+
 //--------------------------------------
 /**
  * \brief register an SQL statement for precompilation
@@ -801,7 +1282,8 @@ WRSQL_API size_t registerStatement(const u8string_view &sql);
 /**
  * \brief query the number of pre-registered SQL statements
  *
- * This function is thread-safe.
+ * This function is thread-safe and does not block concurrent calls to
+ * \c registerStatement().
  *
  * \return the number of pre-registered SQL statements
  */
@@ -813,7 +1295,8 @@ WRSQL_API size_t numRegisteredStatements();
  * \c registeredStatement() is used to retrieve the original text for an SQL
  * statement registered by a prior call to \c wr::sql::registerStatement().
  *
- * This function is thread-safe.
+ * This function is thread-safe and does not block concurrent calls to
+ * \c registerStatement().
  *
  * \param [in] id  identifier returned by prior call to \c registerStatement()
  *
@@ -824,6 +1307,59 @@ WRSQL_API size_t numRegisteredStatements();
  */
 WRSQL_API u8string_view registeredStatement(size_t id);
 
+/**
+ * \brief register a script of SQL statements for precompilation
+ *
+ * \c registerScript() splits the text of a script containing any number of
+ * SQL statements separated by semicolons into its constituent statements,
+ * registering each as per \c registerStatement(), and returns an integer
+ * uniquely identifying the script. This integer can then be passed to
+ * \c Session::execScript() to execute the statements in order, each being
+ * compiled only the first time it is used with each \c Session object.
+ *
+ * Statement boundaries are determined as by the \c sqlite3_complete()
+ * function, so semicolons within quoted strings, comments and
+ * \c CREATE \c TRIGGER bodies do not end a statement. Empty statements and
+ * statements consisting only of comments are discarded.
+ *
+ * If the script text was already registered then the same value is
+ * returned again.
+ *
+ * This function is thread-safe.
+ *
+ * \param [in] sql
+ *      UTF-8-encoded SQL script text
+ *
+ * \return an integer uniquely identifying the script
+ *
+ * \see \c Session::execScript(), \c registeredScript()
+ */
+WRSQL_API size_t registerScript(const u8string_view &sql);
+
+/**
+ * \brief query the number of pre-registered SQL scripts
+ *
+ * This function is thread-safe.
+ *
+ * \return the number of pre-registered SQL scripts
+ */
+WRSQL_API size_t numRegisteredScripts();
+
+/**
+ * \brief query the statements of a pre-registered script
+ *
+ * This function is thread-safe.
+ *
+ * \param [in] id  identifier returned by prior call to \c registerScript()
+ *
+ * \return the IDs of the script's statements as registered by
+ *      \c registerStatement(), in order of execution
+ *
+ * \throw std::invalid_argument
+ *      \c id was not recognised
+ */
+WRSQL_API const std::vector<size_t> &registeredScript(size_t id);
+
 //--------------------------------------
 
 template <typename T> inline auto
@@ -875,6 +1411,79 @@ Statement::begin(
         return std::move(bindAll(std::forward<Args>(bind_args)...).begin());
 }
 
+//--------------------------------------
+
+template <typename Iter> inline size_t
+Statement::executeBatch(
+        Iter first,
+        Iter last
+)
+{
+        size_t n = 0;
+
+        for (; first != last; ++first, ++n) {
+                bindRow_(*first);
+                if (begin()) {
+                        reset();  // discard result rows
+                }
+        }
+
+        return n;
+}
+
+//--------------------------------------
+
+template <typename T, typename ...Args> inline std::vector<T>
+Statement::fetchAll(
+        Args &&...bind_args
+)
+{
+        std::vector<T> rows;
+        fetchInto(rows, std::forward<Args>(bind_args)...);
+        return rows;
+}
+
+//--------------------------------------
+
+template <typename T, typename ...Args> inline size_t
+Statement::fetchInto(
+        std::vector<T>  &out,
+        Args        &&...bind_args
+)
+{
+        auto   start = out.size();
+        Row    row = begin(std::forward<Args>(bind_args)...);
+
+        if (row) {
+                checkNumCols(static_cast<int>(RowDecoder<T>::NUM_COLS));
+        }
+
+        try {
+                for (; row; row.next()) {
+                        out.emplace_back();
+                        RowDecoder<T>::decode(row, out.back());
+                }
+        } catch (...) {
+                out.resize(start);
+                throw;
+        }
+
+        return out.size() - start;
+}
+
+//--------------------------------------
+
+template <typename Tuple, size_t ...I> inline void
+Statement::bindTuple_(
+        const Tuple &row,
+        std::index_sequence<I...>
+)
+{
+        int expand[] = { 0, (bind(static_cast<int>(I) + 1,
+                                  std::get<I>(row)), 0)... };
+        (void) expand;
+}
+
 
 } // namespace sql
 } // namespace wr
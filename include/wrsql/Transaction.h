@@ -26,6 +26,8 @@
 #define WRSQL_TRANSACTION_H
 
 #include <wrsql/Config.h>
+#include <stdint.h>
+#include <chrono>
 #include <functional>
 #include <wrutil/tagged_ptr.h>
 
@@ -43,6 +45,123 @@ using TransactionFn = std::function<void (Transaction &)>;
 class Session;
 
 
+/**
+ * \brief database locking strategy for the outermost transaction
+ *
+ * \c DEFERRED_LOCKING acquires no locks until the transaction first reads or
+ * writes the database; a transaction which reads before it writes must then
+ * upgrade its read lock, which fails with \c wr::sql::Busy whenever another
+ * connection is also waiting to write. \c IMMEDIATE_LOCKING acquires the
+ * write lock when the transaction begins, so writers queue up at the
+ * beginning of their transactions instead. \c EXCLUSIVE_LOCKING also
+ * prevents other connections from reading while the transaction is active
+ * (except in WAL journal mode, where it is equivalent to
+ * \c IMMEDIATE_LOCKING).
+ *
+ * Nested transactions always take on the locks held by the outermost
+ * transaction.
+ */
+enum LockingMode
+{
+        DEFERRED_LOCKING = 0,
+        IMMEDIATE_LOCKING,
+        EXCLUSIVE_LOCKING
+};
+
+//--------------------------------------
+/**
+ * \struct wr::sql::RetryPolicy
+ * \brief policy for re-executing transactions which fail due to lock
+ *      contention
+ *
+ * When a transaction throws \c wr::sql::Busy, \c Transaction::begin() rolls
+ * it back and asks its \c RetryPolicy whether to re-execute it and how long
+ * to wait beforehand. The default policy retries indefinitely, waiting 100
+ * microseconds before the first retry and doubling the wait with each
+ * subsequent retry up to a maximum of 100 milliseconds, with each wait
+ * randomised to between half and all of its nominal duration so that
+ * competing connections do not keep colliding.
+ *
+ * If the policy declines to retry then the \c Busy exception is propagated to
+ * the caller of \c Transaction::begin().
+ */
+struct WRSQL_API RetryPolicy
+{
+        using Duration = std::chrono::microseconds;
+
+        /**
+         * \brief custom retry decision function type
+         *
+         * \param [in] failures
+         *      number of attempts that have failed so far (at least 1)
+         * \param [in] elapsed
+         *      time since the first attempt began
+         * \param [out] delay
+         *      time to wait before the next attempt
+         *
+         * \return \c true to retry the transaction, \c false to give up
+         */
+        using DecideFn = std::function<bool (unsigned failures,
+                                             Duration elapsed,
+                                             Duration &delay)>;
+
+        unsigned  max_attempts;   ///< maximum attempts, or \c 0 for no limit
+        Duration  initial_delay,  ///< wait before the first retry
+                  max_delay,      ///< upper bound for any wait
+                  time_limit;     /**< maximum time since the first attempt
+                                       by which a retry must begin, or \c 0
+                                       for no limit */
+        double    growth;         ///< factor applied to each successive wait
+        bool      jitter;         /**< randomise each wait to between half and
+                                       all of its nominal duration */
+        DecideFn  decide;         /**< if set, replaces the above parameters
+                                       entirely */
+
+        /**
+         * \brief object constructor
+         *
+         * Initialises the default policy described above.
+         */
+        RetryPolicy();
+
+        /**
+         * \brief decide whether to retry a failed transaction
+         *
+         * \param [in] failures
+         *      number of attempts that have failed so far (at least 1)
+         * \param [in] elapsed
+         *      time since the first attempt began
+         * \param [out] delay
+         *      time to wait before the next attempt; unchanged if the
+         *      function returns \c false
+         *
+         * \return \c true to retry the transaction, \c false to give up
+         */
+        bool retry(unsigned failures, Duration elapsed, Duration &delay) const;
+};
+
+//--------------------------------------
+/**
+ * \struct wr::sql::TransactionStats
+ * \brief counters describing the cost of lock contention to a connection
+ * \see \c Session::transactionStats()
+ */
+struct TransactionStats
+{
+        /// \brief attempts re-executed after a \c Busy condition
+        uint64_t                 busy_retries  = 0;
+
+        /// \brief transactions abandoned as the retry policy gave up
+        uint64_t                 busy_failures = 0;
+
+        /// \brief time spent executing attempts which were then rolled back
+        std::chrono::nanoseconds wasted_time   = {};
+
+        /// \brief time spent waiting between attempts
+        std::chrono::nanoseconds backoff_time  = {};
+};
+
+
 /**
  * \class wr::sql::Transaction
  * \brief transaction context
@@ -93,6 +212,7 @@ public:
          */
         this_t &operator=(this_t &&other);
 
+        ///@{
         /**
          * \brief create new transaction context and execute code inside it
          *
@@ -111,11 +231,12 @@ public:
          * is thrown inside \c code.
          *
          * When invoked within the context of an existing transaction on
-         * \c session, a \e nested transaction is begun. Invoking \c commit()
-         * on a nested transaction only affects the nested transaction itself,
-         * but invoking \c rollback() on a nested transaction causes all
-         * outlying transaction contexts to be rolled back as well. The
-         * outermost transaction context must commit before nested
+         * \c session, a \e nested transaction is begun by establishing a
+         * savepoint. Invoking \c commit() or \c rollback() on a nested
+         * transaction only affects the nested transaction itself: a nested
+         * rollback undoes the changes made since the nested transaction
+         * began, leaving the changes made by outlying transactions intact.
+         * The outermost transaction context must commit before nested
          * transactions' changes can take effect globally.
          *
          * If \c code throws an exception \e other than \c wr::sql::Busy then
@@ -128,8 +249,15 @@ public:
          * database (typically due to a potential deadlock) then by default
          * the transaction is rolled back and all transaction code is
          * re-executed from the beginning of the outermost transaction in
-         * effect when the \c Busy exception was thrown. Therefore the author
-         * of a transaction's code should be prepared for \c code to be
+         * effect when the \c Busy exception was thrown. If the connection
+         * had already acquired a write lock (i.e. an outlying transaction has
+         * already made changes) then only the innermost transaction is rolled
+         * back and re-executed, since the contention cannot be due to another
+         * connection waiting for this one to release its locks. Before each
+         * retry the transaction waits for a time determined by its
+         * \c RetryPolicy, which may instead decide to give up, propagating
+         * the \c Busy exception to the caller. Therefore the
+         * author of a transaction's code should be prepared for \c code to be
          * executed multiple times. \c Session::onFinalCommit() arranges for a
          * callable object to be invoked automatically when the outermost
          * transaction context commits. Likewise, \c Session::onRollback()
@@ -142,10 +270,26 @@ public:
          * not nested then the \c Busy exception is propagated back to the
          * caller.
          *
+         * Unless specified, the locking mode and retry policy are those set
+         * for \c session by \c Session::setLockingMode() and
+         * \c Session::setRetryPolicy(). The locking mode only applies to an
+         * outermost transaction.
+         *
+         * If \c timeout is given then the whole transaction, including any
+         * retries and the waits between them, must complete within that
+         * time; a deadline is set as per \c Session::ScopedDeadline for the
+         * duration of the call. Whether or not \c timeout is given, no retry
+         * is attempted once the deadline in force for \c session would pass
+         * before the wait preceding it ends. When the deadline passes the
+         * transaction is rolled back and \c wr::sql::Interrupt is thrown.
+         *
          * \c Session::beginTransaction() provides a convenient wrapper for
          * this function.
          *
          * \param [in,out] session  the database connection
+         * \param [in]     mode     locking strategy for the transaction
+         * \param [in]     policy   policy for retrying upon \c Busy
+         * \param [in]     timeout  time allowed for the transaction
          * \param [in]     code     the transactional code to execute
          *
          * \return the executed transaction - will have been committed or
@@ -155,6 +299,18 @@ public:
          *      \c Session::onFinalCommit(), \c Session::onRollback()
          */
         static this_t begin(Session &session, TransactionFn code);
+        static this_t begin(Session &session, LockingMode mode,
+                            TransactionFn code);
+        static this_t begin(Session &session, LockingMode mode,
+                            const RetryPolicy &policy, TransactionFn code);
+        static this_t begin(Session &session,
+                            std::chrono::steady_clock::duration timeout,
+                            TransactionFn code);
+        static this_t begin(Session &session, LockingMode mode,
+                            const RetryPolicy &policy,
+                            std::chrono::steady_clock::duration timeout,
+                            TransactionFn code);
+        ///@}
 
         /**
          * \brief commit the active transaction
@@ -191,8 +347,9 @@ public:
          * \c rollback() cancels the active transaction, making it inactive
          * and undoing all changes made under its context including any
          * changes made by committed nested transactions. If \c rollback() is
-         * invoked within the context of a nested transaction context then all
-         * outlying transactions are also rolled back.
+         * invoked on a nested transaction then the database is returned to
+         * its state when the nested transaction began; outlying transactions
+         * remain active and their changes are kept.
          *
          * Transaction code should not execute any further INSERT, UPDATE or
          * DELETE statements after issuing a \c rollback() or \c commit() as
@@ -222,14 +379,14 @@ public:
          * \return
          *      \c active() returns \c true if the \c Transaction object is
          *      in effect but no call to \c commit() or \c rollback() has
-         *      been made, or any nested transaction has rolled back;
-         *      otherwise \c active() returns \c false
+         *      been made on it or any outlying transaction; otherwise
+         *      \c active() returns \c false
          * \return
          *      \c committed() returns \c true if \c commit() has been
          *      invoked, \c false otherwise
          * \return
          *      \c rolledBack() returns \c true if \c rollback() has been
-         *      invoked by this or any nested \c Transaction, \c false
+         *      invoked on this or any outlying \c Transaction, \c false
          *      otherwise
          */
         bool active() const;
@@ -240,13 +397,15 @@ public:
 private:
         friend class Session;
 
-        void begin_(Session *session, ...);
+        void begin_(Session *session, LockingMode mode);
         this_t *onRollback();
 
         enum: uint8_t { DEFAULT = 0, COMMITTED, ROLLED_BACK };
 
         tagged_ptr<Session, 2>  session_; // tag contains value from above enum
         this_t                 *outer_;  
+        size_t                  commit_mark_,   /* numbers of commit/rollback */
+                                rollback_mark_; /* actions pending at start  */
 };
 
 
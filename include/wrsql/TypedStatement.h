@@ -0,0 +1,330 @@
+/**
+ * \file wrsql/TypedStatement.h
+ *
+ * \brief Declaration of class template \c wr::sql::TypedStatement
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_TYPED_STATEMENT_H
+#define WRSQL_TYPED_STATEMENT_H
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <wrutil/optional.h>
+#include <wrsql/Config.h>
+#include <wrsql/Session.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/**
+ * \class wr::sql::TypedStatementBase
+ * \brief type-independent part of \c wr::sql::TypedStatement
+ */
+class WRSQL_API TypedStatementBase
+{
+public:
+        using this_t = TypedStatementBase;
+
+        TypedStatementBase(const this_t &) = delete;
+        this_t &operator=(const this_t &) = delete;
+
+        /**
+         * \brief get registered statement ID
+         * \return ID returned by \c wr::sql::registerStatement() for the
+         *      statement's SQL text, as accepted by \c Session::exec()
+         */
+        size_t id() const { return id_; }
+
+protected:
+        TypedStatementBase(const u8string_view &sql, int num_params,
+                           int num_cols);
+
+        /// \brief get precompiled statement, validated on first use
+        Statement::Ptr prepare(const Session &db) const;
+
+private:
+        void validate(const Statement &stmt) const;
+
+        size_t                    id_;
+        int                       num_params_,
+                                  num_cols_;
+        mutable std::atomic<bool> validated_;
+};
+
+//--------------------------------------
+
+/// \cond
+template <typename Signature> class TypedStatement;  // not defined
+/// \endcond
+
+/**
+ * \class wr::sql::TypedStatement
+ * \brief registered statement with compile-time parameter and result types
+ *
+ * A \c TypedStatement registers its SQL text when constructed, typically
+ * as a \c static object, and fixes the types of the values bound to its
+ * parameters and decoded from its result rows by means of a function
+ * signature: \c Params gives the type of each parameter, in order, and
+ * \c Result the type each row is decoded into by \c Row::as(), which may
+ * be a \c std::tuple, a \c std::pair or any type for which
+ * \c wr::sql::RowFields has been specialized. Arguments are converted to
+ * the parameter types at the call site, and each is bound by a call to the
+ * exact \c Statement::bind() overload for its type.
+ *
+ * The first time the statement is executed, on any \c Session, the number
+ * of parameters it takes is checked against \c Params and the number of
+ * result columns against \c Result, so that a mismatch is reported before
+ * any value is bound or decoded.
+ *
+ * \code
+ * static const wr::sql::TypedStatement<
+ *                 std::tuple<std::string, double> (wr::u8string_view)>
+ *         PRODUCTS_BY_LINE("SELECT name, msrp FROM products WHERE line = ?");
+ *
+ * for (auto &product: PRODUCTS_BY_LINE.fetchAll(db, "Motorcycles")) {
+ *         ...
+ * }
+ * \endcode
+ *
+ * A statement returning no rows may be declared with a \c void result
+ * type, in which case only \c exec() is available.
+ */
+template <typename Result, typename ...Params>
+class TypedStatement<Result (Params...)> : public TypedStatementBase
+{
+public:
+        using this_t = TypedStatement;
+        using base_t = TypedStatementBase;
+        using result_type = Result;
+
+        enum: size_t
+        {
+                NUM_PARAMS = sizeof...(Params),
+                NUM_COLS = RowDecoder<Result>::NUM_COLS
+        };
+
+        /**
+         * \brief constructor
+         * \param [in] sql  SQL text of statement to register
+         */
+        explicit TypedStatement(const u8string_view &sql) :
+                base_t(sql, static_cast<int>(NUM_PARAMS),
+                       static_cast<int>(NUM_COLS)) {}
+
+        /**
+         * \brief execute statement
+         *
+         * \param [in] db
+         *      database connection to execute the statement on
+         * \param [in] args...
+         *      values to bind to the statement's parameters
+         *
+         * \return
+         *      executed \c Statement object positioned at the first result
+         *      row, if any, as per \c Session::exec()
+         *
+         * \throw std::invalid_argument
+         *      the statement takes a number of parameters other than
+         *      \c NUM_PARAMS or returns fewer than \c NUM_COLS columns
+         * \throw wr::sql::Error
+         *      the statement could not be compiled or executed
+         * \throw wr::sql::Busy
+         *      contention occurred with locks held by other database
+         *      connections, or a potential deadlock was detected
+         * \throw wr::sql::Interrupt
+         *      \c Session::interrupt() was invoked
+         */
+        Session::ExecResult exec(const Session &db,
+                                 const Params &...args) const;
+
+        ///@{
+        /**
+         * \brief execute statement and decode result rows
+         *
+         * \c fetchAll() returns a vector of all decoded rows, while
+         * \c fetchInto() appends them to \c out; \c fetchOne() decodes the
+         * first row only.
+         *
+         * \param [out] out
+         *      vector to which decoded rows are appended
+         * \param [in] db
+         *      database connection to execute the statement on
+         * \param [in] args...
+         *      values to bind to the statement's parameters
+         *
+         * \return
+         *      \c fetchAll() returns a vector containing all decoded rows
+         * \return
+         *      \c fetchInto() returns the number of rows appended to \c out
+         * \return
+         *      \c fetchOne() returns the first decoded row, or \c nullopt
+         *      if the statement returned no rows
+         *
+         * \throw std::invalid_argument
+         *      the statement takes a number of parameters other than
+         *      \c NUM_PARAMS or returns fewer than \c NUM_COLS columns
+         * \throw wr::sql::Error
+         *      the statement could not be compiled or executed
+         * \throw wr::sql::Busy
+         *      contention occurred with locks held by other database
+         *      connections, or a potential deadlock was detected
+         * \throw wr::sql::Interrupt
+         *      \c Session::interrupt() was invoked
+         */
+        std::vector<Result> fetchAll(const Session &db,
+                                     const Params &...args) const;
+
+        size_t fetchInto(std::vector<Result> &out, const Session &db,
+                         const Params &...args) const;
+
+        optional<Result> fetchOne(const Session &db,
+                                  const Params &...args) const;
+        ///@}
+};
+
+//--------------------------------------
+
+/// \cond
+template <typename ...Params>
+class TypedStatement<void (Params...)> : public TypedStatementBase
+{
+public:
+        using this_t = TypedStatement;
+        using base_t = TypedStatementBase;
+        using result_type = void;
+
+        enum: size_t { NUM_PARAMS = sizeof...(Params), NUM_COLS = 0 };
+
+        explicit TypedStatement(const u8string_view &sql) :
+                base_t(sql, static_cast<int>(NUM_PARAMS), 0) {}
+
+        Session::ExecResult exec(const Session &db,
+                                 const Params &...args) const;
+};
+/// \endcond
+
+//--------------------------------------
+
+/*
+ * binds each argument by its exact type; begin() without arguments keeps
+ * bindings, and every parameter is rebound, so none need clearing
+ */
+template <typename Result, typename ...Params> inline Session::ExecResult
+TypedStatement<Result (Params...)>::exec(
+        const Session &db,
+        const Params &...args
+) const
+{
+        Statement::Ptr stmt = prepare(db);
+        int            n = 0;
+        int            expand[] = { 0, (stmt->bind(++n, args), 0)... };
+
+        (void) n; (void) expand;
+        stmt->begin();
+        return stmt;
+}
+
+//--------------------------------------
+
+template <typename Result, typename ...Params> inline std::vector<Result>
+TypedStatement<Result (Params...)>::fetchAll(
+        const Session &db,
+        const Params &...args
+) const
+{
+        std::vector<Result> rows;
+        fetchInto(rows, db, args...);
+        return rows;
+}
+
+//--------------------------------------
+
+template <typename Result, typename ...Params> inline size_t
+TypedStatement<Result (Params...)>::fetchInto(
+        std::vector<Result> &out,
+        const Session       &db,
+        const Params     &...args
+) const
+{
+        auto start = out.size();
+        auto result = exec(db, args...);
+
+        try {
+                for (Row row = result.begin(); row; row.next()) {
+                        out.emplace_back();
+                        RowDecoder<Result>::decode(row, out.back());
+                }
+        } catch (...) {
+                out.resize(start);
+                throw;
+        }
+
+        return out.size() - start;
+}
+
+//--------------------------------------
+
+template <typename Result, typename ...Params> inline optional<Result>
+TypedStatement<Result (Params...)>::fetchOne(
+        const Session &db,
+        const Params &...args
+) const
+{
+        auto result = exec(db, args...);
+        Row  row = result.begin();
+
+        if (!row) {
+                return nullopt;
+        }
+
+        Result value;
+        RowDecoder<Result>::decode(row, value);
+        return value;
+}
+
+//--------------------------------------
+
+template <typename ...Params> inline Session::ExecResult
+TypedStatement<void (Params...)>::exec(
+        const Session &db,
+        const Params &...args
+) const
+{
+        Statement::Ptr stmt = prepare(db);
+        int            n = 0;
+        int            expand[] = { 0, (stmt->bind(++n, args), 0)... };
+
+        (void) n; (void) expand;
+        stmt->begin();
+        return stmt;
+}
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_TYPED_STATEMENT_H
@@ -0,0 +1,420 @@
+/**
+ * \file wrsql/VirtualTable.h
+ *
+ * \brief Declaration of class template \c wr::sql::VirtualTable
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_VIRTUAL_TABLE_H
+#define WRSQL_VIRTUAL_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <wrutil/optional.h>
+#include <wrutil/u8string_view.h>
+#include <wrsql/Config.h>
+#include <wrsql/Function.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+class Session;
+
+
+/// \brief properties of a column of a \c wr::sql::VirtualTable
+enum VirtualColumnFlags: unsigned
+{
+        /** rows are sorted in ascending order of this column, so that
+            equality and range constraints on it are answered by binary
+            search; implies \c READ_ONLY_COLUMN */
+        SORTED_KEY_COLUMN = 0x1,
+        /// column cannot be changed by \c UPDATE statements
+        READ_ONLY_COLUMN  = 0x2
+};
+
+//--------------------------------------
+/**
+ * \class wr::sql::VirtualTableBase
+ * \brief type-independent part of \c wr::sql::VirtualTable
+ */
+class WRSQL_API VirtualTableBase
+{
+public:
+        using this_t = VirtualTableBase;
+
+        VirtualTableBase(const this_t &) = delete;
+        this_t &operator=(const this_t &) = delete;
+
+        /// \brief destructor; implies \c detach()
+        virtual ~VirtualTableBase();
+
+        /**
+         * \brief make the table accessible through a database connection
+         *
+         * Creates a temporary table named \c name on \c db through which
+         * SQL statements read (and, unless the table is read-only, update)
+         * the rows in place. A table can be attached to only one connection
+         * at a time; attaching it to another first detaches it.
+         *
+         * \param [in] db    connection to the target database
+         * \param [in] name  name of the temporary table
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      \c db is closed or no columns have been defined
+         * \throw wr::sql::Error
+         *      the temporary table could not be created
+         */
+        this_t &attach(const Session &db, const u8string_view &name);
+
+        /**
+         * \brief remove the table from a previously attached connection
+         *
+         * Has no effect if the table is not attached. Any statement still
+         * reading the table must be finished or reset first.
+         *
+         * \return reference to \c *this
+         */
+        this_t &detach();
+
+        ///@{
+        /**
+         * \brief get table properties
+         * \return
+         *      \c db() returns the attached connection, or \c nullptr if
+         *      not attached; \c name() the name given to \c attach();
+         *      \c numColumns() the number of columns defined and
+         *      \c readOnly() whether \c UPDATE statements are refused
+         */
+        const Session *db() const;
+        u8string_view name() const;
+        int numColumns() const;
+        bool readOnly() const;
+        ///@}
+
+protected:
+        explicit VirtualTableBase(bool read_only);
+
+        /**
+         * \brief declare the next column
+         * \throw std::logic_error
+         *      the table is attached
+         * \throw std::invalid_argument
+         *      \c SORTED_KEY_COLUMN given for a second column, or for a
+         *      column whose type is not integral, floating-point or text
+         */
+        void addColumn(const u8string_view &name, ValueType type,
+                       unsigned flags, bool key_capable);
+
+        /// \brief get the current number of rows
+        virtual size_t numRows() const = 0;
+
+        /// \brief set \c result to the value of column \c col of row \c row
+        virtual void getValue(size_t row, int col,
+                              FunctionResult &result) const = 0;
+
+        /// \brief assign argument \c i of \c args to column \c col of row \c row
+        virtual void setValue(size_t row, int col, const FunctionArgs &args,
+                              int i) = 0;
+
+        /**
+         * \brief compare the key column of row \c row with argument \c i
+         *      of \c args, which is never \c NULL
+         * \return negative, zero or positive as the key is less than, equal
+         *      to or greater than the argument
+         */
+        virtual int compareKey(size_t row, const FunctionArgs &args,
+                               int i) const = 0;
+
+public:
+        class SQLInterface;  // opaque internal type
+        friend SQLInterface;
+
+private:
+        struct Body;
+
+        Body *body_;
+};
+
+//--------------------------------------
+
+/// \cond
+WRSQL_API int compareVirtualKey(int64_t key, const FunctionArgs &args,
+                                int i);
+WRSQL_API int compareVirtualKey(double key, const FunctionArgs &args,
+                                int i);
+WRSQL_API int compareVirtualKey(const u8string_view &key,
+                                const FunctionArgs &args, int i);
+
+/*
+ * SQL type of a member (declared type and key comparison); the primary
+ * template covers text types
+ */
+template <typename M, typename = void>
+struct VirtualColumn
+{
+        static_assert(std::is_convertible<const M &, u8string_view>::value,
+                      "unsupported VirtualTable column type");
+
+        static constexpr ValueType TYPE = TEXT_TYPE;
+        static constexpr bool      KEY_CAPABLE = true;
+
+        static int compare(const M &value, const FunctionArgs &args, int i)
+                { return compareVirtualKey(u8string_view(value), args, i); }
+};
+
+template <typename M>
+struct VirtualColumn<M, typename std::enable_if<
+                                std::is_integral<M>::value>::type>
+{
+        static constexpr ValueType TYPE = INT_TYPE;
+        static constexpr bool      KEY_CAPABLE = true;
+
+        static int compare(M value, const FunctionArgs &args, int i)
+        {
+                return compareVirtualKey(static_cast<int64_t>(value),
+                                         args, i);
+        }
+};
+
+template <typename M>
+struct VirtualColumn<M, typename std::enable_if<
+                                std::is_floating_point<M>::value>::type>
+{
+        static constexpr ValueType TYPE = FLOAT_TYPE;
+        static constexpr bool      KEY_CAPABLE = true;
+
+        static int compare(M value, const FunctionArgs &args, int i)
+        {
+                return compareVirtualKey(static_cast<double>(value),
+                                         args, i);
+        }
+};
+
+template <>
+struct VirtualColumn<std::vector<uint8_t>>
+{
+        static constexpr ValueType TYPE = BLOB_TYPE;
+        static constexpr bool      KEY_CAPABLE = false;
+
+        static int compare(const std::vector<uint8_t> &, const FunctionArgs &,
+                           int) { return 0; }
+};
+
+template <typename M>
+struct VirtualColumn<optional<M>>
+{
+        static constexpr ValueType TYPE = VirtualColumn<M>::TYPE;
+        static constexpr bool      KEY_CAPABLE = false;
+
+        static int compare(const optional<M> &, const FunctionArgs &, int)
+                { return 0; }
+};
+/// \endcond
+
+//--------------------------------------
+/**
+ * \class wr::sql::VirtualTable
+ * \brief SQL table reading and writing an in-memory array of structures
+ *      in place
+ *
+ * A \c VirtualTable exposes an array of \c T objects, each a row, to SQL
+ * statements on one \c Session as a temporary table, without copying the
+ * rows into the database. Each column is a data member of \c T declared by
+ * \c column(); members may be of any type supported by
+ * \c wr::sql::FunctionArg and \c wr::sql::FunctionReturn other than
+ * \c std::nullptr_t, with \c wr::optional members being \c NULL when
+ * empty. The \c rowid of each row is its zero-based index.
+ *
+ * The rows may be held in a \c std::vector, whose current contents are used
+ * by each statement, or in any other contiguous array such as a span of a
+ * larger buffer or a memory-mapped file; the vector or array must outlive
+ * the \c VirtualTable object, must not move while statements are being
+ * executed on it and, while attached, must only be resized between
+ * statements. Arrays given as pointers to \c const are read-only.
+ *
+ * If one column is declared with \c SORTED_KEY_COLUMN, the rows must be
+ * kept in ascending order of that column (\c std::string members comparing
+ * bytewise, as by the \c BINARY collation), and constraints on it are
+ * answered by binary search rather than scanning every row, as are
+ * constraints on \c rowid. Results are also produced in key order, so that
+ * <code>ORDER BY</code> the key needs no sorting.
+ *
+ * Unless the table is read-only, \c UPDATE statements write new values
+ * straight back into the rows; the key column and columns declared with
+ * \c READ_ONLY_COLUMN cannot be changed. Such writes are not undone if the
+ * enclosing transaction is rolled back. Rows cannot be inserted or deleted.
+ *
+ * \code
+ * struct Part { int64_t code; std::string name; double price; };
+ *
+ * std::vector<Part> parts = loadParts();  // sorted by code
+ *
+ * wr::sql::VirtualTable<Part> table(parts);
+ * table.column("code", &Part::code, wr::sql::SORTED_KEY_COLUMN)
+ *      .column("name", &Part::name)
+ *      .column("price", &Part::price)
+ *      .attach(db, "parts");
+ *
+ * db.exec("SELECT o.id, p.name FROM orders o JOIN parts p ON p.code = o.part");
+ * \endcode
+ */
+template <typename T>
+class VirtualTable : public VirtualTableBase
+{
+public:
+        using this_t = VirtualTable;
+        using base_t = VirtualTableBase;
+        using value_type = T;
+
+        ///@{
+        /**
+         * \brief constructor
+         *
+         * \param [in] rows
+         *      vector of rows, or first element of array of rows
+         * \param [in] num_rows
+         *      number of elements in array
+         */
+        explicit VirtualTable(std::vector<T> &rows) :
+                base_t(false), vec_(&rows), data_(nullptr), size_(0) {}
+
+        explicit VirtualTable(const std::vector<T> &rows) :
+                base_t(true), vec_(&rows), data_(nullptr), size_(0) {}
+
+        VirtualTable(std::vector<T> &&) = delete;
+
+        VirtualTable(T *rows, size_t num_rows) :
+                base_t(false), vec_(nullptr), data_(rows), size_(num_rows) {}
+
+        VirtualTable(const T *rows, size_t num_rows) :
+                base_t(true), vec_(nullptr), data_(rows), size_(num_rows) {}
+        ///@}
+
+        /// \brief destructor; implies \c detach()
+        ~VirtualTable() { detach(); }
+
+        /**
+         * \brief declare the next column
+         *
+         * \param [in] name    column name
+         * \param [in] member  data member holding the column's values
+         * \param [in] flags   bitwise-OR of \c VirtualColumnFlags values
+         *
+         * \return reference to \c *this
+         *
+         * \throw std::logic_error
+         *      the table is attached
+         * \throw std::invalid_argument
+         *      \c SORTED_KEY_COLUMN given for a second column, or for a
+         *      member of a type other than integral, floating-point or text
+         */
+        template <typename M>
+        this_t &column(const u8string_view &name, M T::*member,
+                       unsigned flags = 0);
+
+        /**
+         * \brief attach to a database connection
+         * \see \c VirtualTableBase::attach()
+         */
+        this_t &attach(const Session &db, const u8string_view &name)
+                { base_t::attach(db, name); return *this; }
+
+protected:
+        size_t numRows() const override
+                { return vec_ ? vec_->size() : size_; }
+
+        void getValue(size_t row, int col,
+                      FunctionResult &result) const override
+                { cols_[col].get(rows()[row], result); }
+
+        void setValue(size_t row, int col, const FunctionArgs &args,
+                      int i) override
+                { cols_[col].set(const_cast<T &>(rows()[row]), args, i); }
+                        // only called if the rows are not const
+
+        int compareKey(size_t row, const FunctionArgs &args,
+                       int i) const override
+                { return key_(rows()[row], args, i); }
+
+private:
+        struct Column
+        {
+                std::function<void (const T &, FunctionResult &)>          get;
+                std::function<void (T &, const FunctionArgs &, int)>       set;
+        };
+
+        const T *rows() const { return vec_ ? vec_->data() : data_; }
+
+        const std::vector<T>                                 *vec_;
+        const T                                              *data_;
+        size_t                                                size_;
+        std::vector<Column>                                   cols_;
+        std::function<int (const T &, const FunctionArgs &, int)> key_;
+};
+
+//--------------------------------------
+
+template <typename T> template <typename M> inline auto
+VirtualTable<T>::column(
+        const u8string_view &name,
+        M T::               *member,
+        unsigned             flags
+) -> this_t &
+{
+        using Traits = VirtualColumn<M>;
+
+        cols_.reserve(cols_.size() + 1);  // cannot fail after addColumn()
+        addColumn(name, Traits::TYPE, flags, Traits::KEY_CAPABLE);
+
+        cols_.push_back({
+                [member](const T &row, FunctionResult &result) {
+                        FunctionReturn<M>::set(result, row.*member);
+                },
+                [member](T &row, const FunctionArgs &args, int i) {
+                        row.*member = FunctionArg<M>::get(args, i);
+                }
+        });
+
+        if (flags & SORTED_KEY_COLUMN) {
+                key_ = [member](const T &row, const FunctionArgs &args,
+                                int i) {
+                        return Traits::compare(row.*member, args, i);
+                };
+        }
+
+        return *this;
+}
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_VIRTUAL_TABLE_H
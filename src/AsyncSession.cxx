@@ -0,0 +1,254 @@
+/**
+ * \file AsyncSession.cxx
+ *
+ * \brief Implementation of class wr::sql::AsyncSession
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <wrsql/AsyncSession.h>
+#include <wrsql/Session.h>
+
+
+namespace wr {
+namespace sql {
+
+
+struct AsyncSession::Body
+{
+        Body() : running_(false), stopping_(false), open_(false) {}
+
+        void run();
+
+        Session                 session_;   ///< used only by worker_
+        std::thread             worker_;
+        std::deque<Task>        queue_;
+        bool                    running_,
+                                stopping_,
+                                open_;
+        std::exception_ptr      close_error_;
+        mutable std::mutex      lock_;
+        std::condition_variable ready_;
+};
+
+//--------------------------------------
+
+void
+AsyncSession::Body::run()
+{
+        for (;;) {
+                Task task;
+
+                {
+                        std::unique_lock<std::mutex> guard(lock_);
+                        ready_.wait(guard, [this] {
+                                return stopping_ || !queue_.empty();
+                        });
+                        if (queue_.empty()) {  // stopping, queue drained
+                                break;
+                        }
+                        task = std::move(queue_.front());
+                        queue_.pop_front();
+                }
+
+                try {
+                        task(session_);
+                } catch (...) {
+                        // tasks from submit() report via their own futures
+                }
+        }
+
+        try {
+                session_.close();
+        } catch (...) {
+                close_error_ = std::current_exception();
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API AsyncSession::AsyncSession() : body_(new Body) {}
+
+//--------------------------------------
+
+WRSQL_API
+AsyncSession::AsyncSession(
+        const u8string_view &uri
+) :
+        this_t()
+{
+        open(uri);
+}
+
+//--------------------------------------
+
+WRSQL_API
+AsyncSession::AsyncSession(
+        const u8string_view  &uri,
+        const SessionOptions &options
+) :
+        this_t()
+{
+        open(uri, options);
+}
+
+//--------------------------------------
+
+WRSQL_API
+AsyncSession::~AsyncSession()
+{
+        try {
+                close();
+        } catch (...) {
+        }
+        delete body_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+AsyncSession::open(
+        const u8string_view &uri
+)
+{
+        open(uri, SessionOptions());
+}
+
+//--------------------------------------
+
+WRSQL_API void
+AsyncSession::open(
+        const u8string_view  &uri,
+        const SessionOptions &options
+)
+{
+        close();
+
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                body_->running_ = true;
+                body_->stopping_ = false;
+        }
+
+        body_->worker_ = std::thread(&Body::run, body_);
+
+        auto opened = submit([uri = uri.to_string(), options]
+                             (Session &session) {
+                session.open(uri, options);
+        });
+
+        try {
+                opened.get();
+        } catch (...) {
+                close();
+                throw;
+        }
+
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        body_->open_ = true;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+AsyncSession::close()
+{
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                if (!body_->running_) {
+                        return;
+                }
+                body_->stopping_ = true;
+                body_->open_ = false;  // disables interrupt()
+        }
+
+        body_->ready_.notify_all();
+        body_->worker_.join();
+
+        std::exception_ptr err;
+
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                body_->running_ = body_->stopping_ = false;
+                std::swap(err, body_->close_error_);
+        }
+
+        if (err) {
+                std::rethrow_exception(err);
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+AsyncSession::isOpen() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->open_;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+AsyncSession::pending() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->queue_.size();
+}
+
+//--------------------------------------
+
+WRSQL_API void
+AsyncSession::interrupt()
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        if (body_->open_) {
+                body_->session_.interrupt();
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API void
+AsyncSession::post(
+        Task task
+)
+{
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                if (!body_->running_ || body_->stopping_) {
+                        throw std::logic_error("AsyncSession not open");
+                }
+                body_->queue_.push_back(std::move(task));
+        }
+
+        body_->ready_.notify_one();
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,246 @@
+/**
+ * \file Backup.cxx
+ *
+ * \brief Implementation of class wr::sql::Backup
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdexcept>
+#include <thread>
+
+#include <wrsql/Backup.h>
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+
+#include "sqlite3api.h"
+#include "SessionPrivate.h"
+
+
+namespace wr {
+namespace sql {
+
+
+WRSQL_API
+Backup::Backup() :
+        backup_(nullptr),
+        dest_  (nullptr),
+        done_  (false)
+{
+}
+
+//--------------------------------------
+
+WRSQL_API
+Backup::Backup(
+        this_t &&other
+) :
+        backup_(other.backup_),
+        dest_  (other.dest_),
+        done_  (other.done_)
+{
+        other.backup_ = nullptr;
+        other.dest_ = nullptr;
+        other.done_ = false;
+}
+
+//--------------------------------------
+
+WRSQL_API
+Backup::Backup(
+        Session             &dest,
+        const Session       &src,
+        const u8string_view &dest_db,
+        const u8string_view &src_db
+) :
+        this_t()
+{
+        open(dest, src, dest_db, src_db);
+}
+
+//--------------------------------------
+
+WRSQL_API
+Backup::~Backup()
+{
+        close();
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Backup::operator=(
+        this_t &&other
+) -> this_t &
+{
+        if (&other != this) {
+                close();
+                std::swap(backup_, other.backup_);
+                std::swap(dest_, other.dest_);
+                std::swap(done_, other.done_);
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Backup::open(
+        Session             &dest,
+        const Session       &src,
+        const u8string_view &dest_db,
+        const u8string_view &src_db
+) -> this_t &
+{
+        close();
+
+        if (!dest.isOpen() || !src.isOpen()) {
+                throw std::logic_error("cannot back up to or from closed Session");
+        }
+
+        sqlite3_backup *backup = sqlite3_backup_init(
+                                        dest.body_->db(),
+                                        dest_db.to_string().c_str(),
+                                        src.body_->db(),
+                                        src_db.to_string().c_str());
+        if (!backup) {
+                // error details are held by the destination connection
+                int status = sqlite3_errcode(dest.body_->db());
+                if (status == SQLITE_NOMEM) {
+                        throw std::bad_alloc();
+                }
+                throw Error(&dest, status);
+        }
+
+        backup_ = backup;
+        dest_ = &dest;
+        done_ = false;
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+Backup::step(
+        int pages
+)
+{
+        checkOpen();
+
+        if (done_) {
+                return true;
+        }
+
+        int status = sqlite3_backup_step(static_cast<sqlite3_backup *>(backup_),
+                                         pages);
+        switch (status) {
+        case SQLITE_DONE:
+                done_ = true;
+                /* the destination's contents were replaced without passing
+                   through the hooks which track changes for its cache */
+                if (dest_->resultCache()) {
+                        dest_->resultCache()->clear();
+                }
+                return true;
+        case SQLITE_OK: case SQLITE_BUSY: case SQLITE_LOCKED:
+                return false;  // retry later
+        case SQLITE_NOMEM:
+                close();
+                throw std::bad_alloc();
+        default:
+                {
+                        Error err(dest_, status);
+                        close();
+                        throw err;
+                }
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+Backup::run(
+        int                                 pages_per_step,
+        std::chrono::steady_clock::duration pause,
+        const ProgressFn                   &progress
+)
+{
+        checkOpen();
+
+        for (;;) {
+                bool done = step(pages_per_step);
+
+                if (progress && !progress(remaining(), pageCount())) {
+                        close();
+                        return done;
+                } else if (done) {
+                        close();
+                        return true;
+                } else if (pause.count() > 0) {
+                        std::this_thread::sleep_for(pause);
+                }
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API void
+Backup::close()
+{
+        if (backup_) {
+                /* sqlite3_backup_finish() always releases the handle; any
+                   error it reports has already been reported by step() */
+                sqlite3_backup_finish(static_cast<sqlite3_backup *>(backup_));
+                backup_ = nullptr;
+                dest_ = nullptr;
+                done_ = false;
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API int
+Backup::remaining() const
+{
+        return backup_ ? sqlite3_backup_remaining(
+                                static_cast<sqlite3_backup *>(backup_)) : 0;
+}
+
+//--------------------------------------
+
+WRSQL_API int
+Backup::pageCount() const
+{
+        return backup_ ? sqlite3_backup_pagecount(
+                                static_cast<sqlite3_backup *>(backup_)) : 0;
+}
+
+//--------------------------------------
+
+void
+Backup::checkOpen() const
+{
+        if (!backup_) {
+                throw std::logic_error("Backup not open");
+        }
+}
+
+
+} // namespace sql
+} // namespace wr
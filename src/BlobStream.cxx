@@ -0,0 +1,362 @@
+/**
+ * \file BlobStream.cxx
+ *
+ * \brief Implementation of class wr::sql::BlobStream
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <limits.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <wrutil/Format.h>
+
+#include <wrsql/BlobStream.h>
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+
+#include "sqlite3api.h"
+#include "SessionPrivate.h"
+
+
+namespace wr {
+namespace sql {
+
+
+WRSQL_API
+BlobStream::BlobStream() :
+        blob_    (nullptr),
+        session_ (nullptr),
+        row_     (0),
+        size_    (0),
+        pos_     (0),
+        writable_(false)
+{
+}
+
+//--------------------------------------
+
+WRSQL_API
+BlobStream::BlobStream(
+        this_t &&other
+) :
+        blob_    (other.blob_),
+        session_ (other.session_),
+        row_     (other.row_),
+        size_    (other.size_),
+        pos_     (other.pos_),
+        writable_(other.writable_),
+        table_   (std::move(other.table_))
+{
+        other.blob_ = nullptr;
+        other.session_ = nullptr;
+        other.row_ = 0;
+        other.size_ = other.pos_ = 0;
+        other.writable_ = false;
+}
+
+//--------------------------------------
+
+WRSQL_API
+BlobStream::BlobStream(
+        const Session       &session,
+        const u8string_view &table,
+        const u8string_view &column,
+        ID                   row,
+        Mode                 mode,
+        const u8string_view &db_name
+) :
+        this_t()
+{
+        open(session, table, column, row, mode, db_name);
+}
+
+//--------------------------------------
+
+WRSQL_API
+BlobStream::~BlobStream()
+{
+        close();
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+BlobStream::operator=(
+        this_t &&other
+) -> this_t &
+{
+        if (&other != this) {
+                close();
+                std::swap(blob_, other.blob_);
+                std::swap(session_, other.session_);
+                std::swap(row_, other.row_);
+                std::swap(size_, other.size_);
+                std::swap(pos_, other.pos_);
+                std::swap(writable_, other.writable_);
+                std::swap(table_, other.table_);
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+BlobStream::open(
+        const Session       &session,
+        const u8string_view &table,
+        const u8string_view &column,
+        ID                   row,
+        Mode                 mode,
+        const u8string_view &db_name
+) -> this_t &
+{
+        close();
+
+        sqlite3_blob *blob = nullptr;
+
+        int status = sqlite3_blob_open(session.body_->db(),
+                                       db_name.to_string().c_str(),
+                                       table.to_string().c_str(),
+                                       column.to_string().c_str(),
+                                       row, (mode == READ_WRITE) ? 1 : 0,
+                                       &blob);
+        session_ = &session;
+
+        if (status != SQLITE_OK) {
+                sqlite3_blob_close(blob);  // harmless if null
+                session_ = nullptr;
+                if (status == SQLITE_NOMEM) {
+                        throw std::bad_alloc();
+                }
+                throw Error(&session, status);
+        }
+
+        blob_ = blob;
+        row_ = row;
+        size_ = static_cast<size_t>(sqlite3_blob_bytes(blob));
+        pos_ = 0;
+        writable_ = (mode == READ_WRITE);
+
+        if (writable_) {
+                table_ = table.to_string();
+                markDirty();
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+BlobStream::reopen(
+        ID row
+) -> this_t &
+{
+        checkOpen();
+
+        int status = sqlite3_blob_reopen(static_cast<sqlite3_blob *>(blob_),
+                                         row);
+        if (status != SQLITE_OK) {
+                /* the handle is unusable after a failed reopen; capture the
+                   error message before closing it */
+                Error err(session_, status);
+                close();
+                throw err;
+        }
+
+        row_ = row;
+        size_ = static_cast<size_t>(
+                        sqlite3_blob_bytes(static_cast<sqlite3_blob *>(blob_)));
+        pos_ = 0;
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+BlobStream::close()
+{
+        if (blob_) {
+                /* sqlite3_blob_close() always releases the handle; any error
+                   it reports has already been reported by read() or write() */
+                sqlite3_blob_close(static_cast<sqlite3_blob *>(blob_));
+                blob_ = nullptr;
+
+                if (writable_) {
+                        /* changes are committed by sqlite3_blob_close() if
+                           outside a transaction; sqlite3_update_hook() is
+                           never told of them */
+                        markDirty();
+                        session_->body_->dirtyTablesCommitted();
+                        table_.clear();
+                }
+
+                session_ = nullptr;
+                row_ = 0;
+                size_ = pos_ = 0;
+                writable_ = false;
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+BlobStream::seek(
+        size_t pos
+) -> this_t &
+{
+        if (pos > size_) {
+                throw std::out_of_range(
+                        printStr("BlobStream position %u beyond end of %u-byte value",
+                                 pos, size_));
+        }
+        pos_ = pos;
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+BlobStream::read(
+        void   *buf,
+        size_t  bytes
+)
+{
+        size_t n = readAt(pos_, buf, bytes);
+        pos_ += n;
+        return n;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+BlobStream::write(
+        const void *data,
+        size_t      bytes
+) -> this_t &
+{
+        writeAt(pos_, data, bytes);
+        pos_ += bytes;
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+BlobStream::readAt(
+        size_t  offset,
+        void   *buf,
+        size_t  bytes
+) const
+{
+        checkOpen();
+
+        if (offset >= size_) {
+                return 0;
+        }
+
+        bytes = std::min(bytes, size_ - offset);  // size_ never exceeds INT_MAX
+
+        int status = sqlite3_blob_read(static_cast<sqlite3_blob *>(blob_), buf,
+                                       static_cast<int>(bytes),
+                                       static_cast<int>(offset));
+        if (status != SQLITE_OK) {
+                throwError(status);
+        }
+
+        return bytes;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+BlobStream::writeAt(
+        size_t      offset,
+        const void *data,
+        size_t      bytes
+) -> this_t &
+{
+        checkOpen();
+
+        if (!writable_) {
+                throw std::logic_error("BlobStream not opened for writing");
+        } else if ((offset > size_) || (bytes > size_ - offset)) {
+                throw std::length_error(
+                        printStr("cannot write %u bytes at offset %u of %u-byte value",
+                                 bytes, offset, size_));
+        }
+
+        int status = sqlite3_blob_write(static_cast<sqlite3_blob *>(blob_),
+                                        data, static_cast<int>(bytes),
+                                        static_cast<int>(offset));
+        if (status != SQLITE_OK) {
+                throwError(status);
+        }
+
+        markDirty();
+        return *this;
+}
+
+//--------------------------------------
+
+void
+BlobStream::checkOpen() const
+{
+        if (!blob_) {
+                throw std::logic_error("BlobStream not open");
+        }
+}
+
+//--------------------------------------
+
+/*
+ * record the stream's table as changed by the session, so that results
+ * cached from it are invalidated once the changes are committed
+ */
+void
+BlobStream::markDirty() const
+{
+        if (session_->resultCache()) {
+                session_->body_->markDirty(table_.c_str());
+        }
+}
+
+//--------------------------------------
+
+void
+BlobStream::throwError(
+        int status
+) const
+{
+        switch (status) {
+        case SQLITE_ABORT:
+                throw Error(printStr("value at row %d expired by modification of its row",
+                                     row_));
+        case SQLITE_NOMEM:
+                throw std::bad_alloc();
+        default:
+                throw Error(session_, status);
+        }
+}
+
+
+} // namespace sql
+} // namespace wr
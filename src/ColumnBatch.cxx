@@ -0,0 +1,229 @@
+/**
+ * \file ColumnBatch.cxx
+ *
+ * \brief Implementation of class wr::sql::ColumnBatch
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdint.h>
+#include <limits>
+#include <stdexcept>
+
+#include <wrsql/ColumnBatch.h>
+
+#include "sqlite3api.h"
+
+
+namespace wr {
+namespace sql {
+
+
+namespace {
+
+
+using Column = ColumnBatch::Column;
+
+//--------------------------------------
+
+static ValueType
+valueType(
+        int sqlite_type
+)
+{
+        switch (sqlite_type) {
+        case SQLITE_INTEGER:
+                return INT_TYPE;
+        case SQLITE_FLOAT:
+                return FLOAT_TYPE;
+        case SQLITE_TEXT:
+                return TEXT_TYPE;
+        case SQLITE_BLOB:
+                return BLOB_TYPE;
+        default:
+                return NULL_TYPE;
+        }
+}
+
+//--------------------------------------
+
+/*
+ * give a column the type of its first non-NULL value, padding its buffers
+ * for the NULL values preceding it
+ */
+static void
+setType(
+        Column    &col,
+        ValueType  type,
+        size_t     num_rows
+)
+{
+        col.type = type;
+
+        switch (type) {
+        case INT_TYPE:
+                col.ints.assign(num_rows, 0);
+                break;
+        case FLOAT_TYPE:
+                col.floats.assign(num_rows, 0);
+                break;
+        default:
+                col.offsets.assign(num_rows + 1, 0);
+                break;
+        }
+}
+
+//--------------------------------------
+
+static void
+appendBytes(
+        Column     &col,
+        const void *bytes,
+        int         size
+)
+{
+        if (size > std::numeric_limits<int32_t>::max()
+                        - static_cast<int32_t>(col.data.size())) {
+                throw std::length_error("text or BLOB data in ColumnBatch column exceeds 2GiB");
+        }
+
+        auto p = static_cast<const uint8_t *>(bytes);
+        col.data.insert(col.data.end(), p, p + size);
+        col.offsets.push_back(static_cast<int32_t>(col.data.size()));
+}
+
+
+} // anonymous namespace
+
+//--------------------------------------
+
+WRSQL_API void
+ColumnBatch::clear()
+{
+        for (Column &col: cols_) {
+                col.type = NULL_TYPE;
+                col.null_count = 0;
+                col.validity.clear();
+                col.ints.clear();
+                col.floats.clear();
+                col.offsets.clear();
+                col.data.clear();
+        }
+
+        num_rows_ = 0;
+}
+
+//--------------------------------------
+
+void
+ColumnBatch::reset(
+        void *stmt
+)
+{
+        auto s = static_cast<sqlite3_stmt *>(stmt);
+        int  num_cols = s ? sqlite3_column_count(s) : 0;
+
+        clear();
+        cols_.resize(num_cols);
+
+        for (int i = 0; i < num_cols; ++i) {
+                const char *name = sqlite3_column_name(s, i);
+                cols_[i].name = name ? name : "";
+        }
+}
+
+//--------------------------------------
+
+void
+ColumnBatch::appendRow(
+        void *stmt
+)
+{
+        auto   s = static_cast<sqlite3_stmt *>(stmt);
+        size_t row = num_rows_;
+        int    col_no = 0;
+
+        for (Column &col: cols_) {
+                int value_type = sqlite3_column_type(s, col_no);
+
+                if (!(row & 7)) {
+                        col.validity.push_back(0);
+                }
+
+                if (value_type == SQLITE_NULL) {
+                        ++col.null_count;
+
+                        switch (col.type) {
+                        case NULL_TYPE:
+                                break;
+                        case INT_TYPE:
+                                col.ints.push_back(0);
+                                break;
+                        case FLOAT_TYPE:
+                                col.floats.push_back(0);
+                                break;
+                        default:
+                                col.offsets.push_back(static_cast<int32_t>(
+                                                        col.data.size()));
+                                break;
+                        }
+
+                        ++col_no;
+                        continue;
+                }
+
+                col.validity.back() |= static_cast<uint8_t>(1u << (row & 7));
+
+                if (col.type == NULL_TYPE) {
+                        setType(col, valueType(value_type), row);
+                } else if ((col.type == INT_TYPE)
+                           && (value_type == SQLITE_FLOAT)) {
+                        col.floats.assign(col.ints.begin(), col.ints.end());
+                        col.ints.clear();
+                        col.type = FLOAT_TYPE;
+                }
+
+                switch (col.type) {
+                case INT_TYPE:
+                        col.ints.push_back(sqlite3_column_int64(s, col_no));
+                        break;
+                case FLOAT_TYPE:
+                        col.floats.push_back(sqlite3_column_double(s, col_no));
+                        break;
+                case TEXT_TYPE: {
+                        auto text = sqlite3_column_text(s, col_no);
+                        appendBytes(col, text, sqlite3_column_bytes(s, col_no));
+                        break;
+                }
+                default: {
+                        auto blob = sqlite3_column_blob(s, col_no);
+                        appendBytes(col, blob, sqlite3_column_bytes(s, col_no));
+                        break;
+                }
+                }
+
+                ++col_no;
+        }
+
+        ++num_rows_;
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,383 @@
+/**
+ * \file Function.cxx
+ *
+ * \brief Implementation of class wr::sql::Function and supporting types
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include <wrutil/numeric_cast.h>
+#include <wrsql/Function.h>
+
+#include "sqlite3api.h"
+
+
+namespace wr {
+namespace sql {
+
+
+struct Function::Body
+{
+        std::string      name_;
+        int              num_args_;
+        unsigned         flags_;
+        ScalarFn         scalar_;
+        AggregateFactory aggregate_;
+};
+
+//--------------------------------------
+
+static sqlite3_value *
+arg(
+        void **argv,
+        int    i
+)
+{
+        return static_cast<sqlite3_value *>(argv[i]);
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+FunctionArgs::isNull(
+        int i
+) const
+{
+        return sqlite3_value_type(arg(argv_, i)) == SQLITE_NULL;
+}
+
+//--------------------------------------
+
+WRSQL_API ValueType
+FunctionArgs::type(
+        int i
+) const
+{
+        switch (sqlite3_value_type(arg(argv_, i))) {
+        case SQLITE_INTEGER:
+                return INT_TYPE;
+        case SQLITE_FLOAT:
+                return FLOAT_TYPE;
+        case SQLITE_TEXT:
+                return TEXT_TYPE;
+        case SQLITE_BLOB:
+                return BLOB_TYPE;
+        default:
+                return NULL_TYPE;
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API int64_t
+FunctionArgs::intValue(
+        int i
+) const
+{
+        return sqlite3_value_int64(arg(argv_, i));
+}
+
+//--------------------------------------
+
+WRSQL_API double
+FunctionArgs::floatValue(
+        int i
+) const
+{
+        return sqlite3_value_double(arg(argv_, i));
+}
+
+//--------------------------------------
+
+WRSQL_API u8string_view
+FunctionArgs::text(
+        int i
+) const
+{
+        auto text = reinterpret_cast<const char *>(
+                                sqlite3_value_text(arg(argv_, i)));
+        if (!text) {
+                return {};
+        }
+        // length must be taken after conversion to text
+        return { text, static_cast<size_t>(sqlite3_value_bytes(
+                                                        arg(argv_, i))) };
+}
+
+//--------------------------------------
+
+WRSQL_API std::pair<const uint8_t *, size_t>
+FunctionArgs::blob(
+        int i
+) const
+{
+        auto data = static_cast<const uint8_t *>(
+                                sqlite3_value_blob(arg(argv_, i)));
+        return { data, data ? static_cast<size_t>(sqlite3_value_bytes(
+                                                        arg(argv_, i)))
+                            : 0 };
+}
+
+//--------------------------------------
+
+WRSQL_API void
+FunctionResult::setNull()
+{
+        sqlite3_result_null(static_cast<sqlite3_context *>(context_));
+}
+
+//--------------------------------------
+
+WRSQL_API void
+FunctionResult::set(
+        int64_t value
+)
+{
+        sqlite3_result_int64(static_cast<sqlite3_context *>(context_), value);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+FunctionResult::set(
+        double value
+)
+{
+        sqlite3_result_double(static_cast<sqlite3_context *>(context_), value);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+FunctionResult::set(
+        const u8string_view &value
+)
+{
+        sqlite3_result_text64(static_cast<sqlite3_context *>(context_),
+                              value.data(), value.bytes(), SQLITE_TRANSIENT,
+                              SQLITE_UTF8);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+FunctionResult::set(
+        const void *data,
+        size_t      bytes
+)
+{
+        sqlite3_result_blob64(static_cast<sqlite3_context *>(context_),
+                              data ? data : "", bytes, SQLITE_TRANSIENT);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+FunctionResult::setError(
+        const u8string_view &msg
+)
+{
+        sqlite3_result_error(static_cast<sqlite3_context *>(context_),
+                             msg.data(), numeric_cast<int>(msg.bytes()));
+}
+
+//--------------------------------------
+
+WRSQL_API Function::Aggregate::~Aggregate() = default;
+
+//--------------------------------------
+
+WRSQL_API
+Function::Function(
+        const u8string_view &name,
+        int                  num_args,
+        ScalarFn             fn,
+        unsigned             flags
+) :
+        body_(std::make_shared<Body>(Body{ name.to_string(), num_args, flags,
+                                           std::move(fn), {} }))
+{
+}
+
+//--------------------------------------
+
+WRSQL_API
+Function::Function(
+        const u8string_view &name,
+        int                  num_args,
+        AggregateFactory     factory,
+        unsigned             flags
+) :
+        body_(std::make_shared<Body>(Body{ name.to_string(), num_args, flags,
+                                           {}, std::move(factory) }))
+{
+}
+
+//--------------------------------------
+
+WRSQL_API u8string_view
+Function::name() const
+{
+        return body_->name_;
+}
+
+//--------------------------------------
+
+WRSQL_API int
+Function::numArgs() const
+{
+        return body_->num_args_;
+}
+
+//--------------------------------------
+
+WRSQL_API unsigned
+Function::flags() const
+{
+        return body_->flags_;
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+Function::isAggregate() const
+{
+        return static_cast<bool>(body_->aggregate_);
+}
+
+//--------------------------------------
+
+/*
+ * exceptions must not propagate into the database implementation, so are
+ * reported as errors in the invoking statement
+ */
+template <typename Fn> static void
+guard(
+        sqlite3_context *context,
+        Fn             &&fn
+)
+{
+        try {
+                fn();
+        } catch (std::bad_alloc &) {
+                sqlite3_result_error_nomem(context);
+        } catch (std::exception &err) {
+                sqlite3_result_error(context, err.what(), -1);
+        } catch (...) {
+                sqlite3_result_error(context, "unknown exception thrown by SQL function", -1);
+        }
+}
+
+//--------------------------------------
+
+int
+Function::define(
+        void *db
+) const
+{
+        using Ref = std::shared_ptr<const Body>;
+
+        static auto body = [](sqlite3_context *context) -> const Body & {
+                return **static_cast<Ref *>(sqlite3_user_data(context));
+        };
+
+        static auto scalar = [](sqlite3_context  *context, int argc,
+                                sqlite3_value   **argv) {
+                guard(context, [&] {
+                        FunctionResult     result(context);
+                        const FunctionArgs args(argc,
+                                                reinterpret_cast<void **>(argv));
+                        body(context).scalar_(result, args);
+                });
+        };
+
+        // an aggregate context holds a pointer to the evaluation's state
+        static auto step = [](sqlite3_context  *context, int argc,
+                              sqlite3_value   **argv) {
+                guard(context, [&] {
+                        auto state = static_cast<Aggregate **>(
+                                sqlite3_aggregate_context(context,
+                                                          sizeof(Aggregate *)));
+                        if (!state) {
+                                throw std::bad_alloc();
+                        } else if (!*state) {
+                                *state = body(context).aggregate_().release();
+                        }
+                        (*state)->step(FunctionArgs(
+                                argc, reinterpret_cast<void **>(argv)));
+                });
+        };
+
+        static auto final = [](sqlite3_context *context) {
+                auto state = static_cast<Aggregate **>(
+                                sqlite3_aggregate_context(context, 0));
+                std::unique_ptr<Aggregate> owned(state ? *state : nullptr);
+
+                guard(context, [&] {
+                        if (!owned) {  // no rows were aggregated
+                                owned = body(context).aggregate_();
+                        }
+                        FunctionResult result(context);
+                        owned->finish(result);
+                });
+        };
+
+        static auto destroy = [](void *ref) {
+                delete static_cast<Ref *>(ref);
+        };
+
+        int text_rep = SQLITE_UTF8;
+
+        if (body_->flags_ & DETERMINISTIC_FUNCTION) {
+                text_rep |= SQLITE_DETERMINISTIC;
+        }
+#ifdef SQLITE_INNOCUOUS
+        if (body_->flags_ & INNOCUOUS_FUNCTION) {
+                text_rep |= SQLITE_INNOCUOUS;
+        }
+#endif
+#ifdef SQLITE_DIRECTONLY
+        if (body_->flags_ & DIRECT_ONLY_FUNCTION) {
+                text_rep |= SQLITE_DIRECTONLY;
+        }
+#endif
+
+        auto ref = new Ref(body_);  // released by destroy, even on failure
+
+        if (body_->aggregate_) {
+                return sqlite3_create_function_v2(
+                        static_cast<sqlite3 *>(db), body_->name_.c_str(),
+                        body_->num_args_, text_rep, ref, nullptr,
+                        +step, +final, +destroy);
+        } else {
+                return sqlite3_create_function_v2(
+                        static_cast<sqlite3 *>(db), body_->name_.c_str(),
+                        body_->num_args_, text_rep, ref, +scalar,
+                        nullptr, nullptr, +destroy);
+        }
+}
+
+
+} // namespace sql
+} // namespace wr
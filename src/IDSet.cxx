@@ -22,6 +22,7 @@
  *
  * \endparblock
  */
+#include <math.h>
 #include <string.h>
 #include <algorithm>
 #include <iomanip>
@@ -35,6 +36,8 @@
 
 #include "sqlite3api.h"
 #include "SessionPrivate.h"
+#include "IDSetCodec.h"
+#include "IDSetKernels.h"
 #include "IDSetPrivate.h"
 
 
@@ -46,6 +49,318 @@ IDSet::SQLInterface idset_sql_iface;
 
 //--------------------------------------
 
+namespace {
+
+/*
+ * gather the values of column col_no from row and all rows following it
+ */
+std::vector<ID>
+columnIDs(
+        Row row,
+        int col_no
+)
+{
+        std::vector<ID> ids;
+
+        for (; row; ++row) {
+                ids.push_back(row.get<ID>(col_no));
+        }
+
+        return ids;
+}
+
+//--------------------------------------
+
+/*
+ * sort IDs into ascending order and remove duplicates; large inputs are
+ * sorted by least-significant-digit radix sort on bytes of the ID (sign bit
+ * flipped so that unsigned order matches signed order), skipping any byte
+ * position shared by every ID
+ */
+void
+sortUnique(
+        std::vector<ID> &ids
+)
+{
+        const size_t n = ids.size();
+
+        if (n < 1024) {
+                std::sort(ids.begin(), ids.end());
+        } else {
+                const uint64_t sign_bit = uint64_t(1) << 63;
+                size_t         counts[8][256] = { { 0 } };
+
+                for (ID id: ids) {
+                        uint64_t key = static_cast<uint64_t>(id) ^ sign_bit;
+                        for (int d = 0; d < 8; ++d, key >>= 8) {
+                                ++counts[d][key & 0xff];
+                        }
+                }
+
+                std::vector<ID> tmp(n);
+                ID *src = ids.data(), *dst = tmp.data();
+                uint64_t first_key = static_cast<uint64_t>(ids[0]) ^ sign_bit;
+
+                for (int d = 0; d < 8; ++d) {
+                        unsigned shift = d * 8;
+
+                        if (counts[d][(first_key >> shift) & 0xff] == n) {
+                                continue;  // all IDs share this byte
+                        }
+
+                        size_t offsets[256], offset = 0;
+
+                        for (int b = 0; b < 256; ++b) {
+                                offsets[b] = offset;
+                                offset += counts[d][b];
+                        }
+
+                        for (size_t i = 0; i < n; ++i) {
+                                uint64_t key = static_cast<uint64_t>(src[i])
+                                                ^ sign_bit;
+                                dst[offsets[(key >> shift) & 0xff]++] = src[i];
+                        }
+
+                        std::swap(src, dst);
+                }
+
+                if (src != ids.data()) {
+                        ids.swap(tmp);
+                }
+        }
+
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+//--------------------------------------
+
+/*
+ * vector storage counterparts of the IDSet set operations; ids must be
+ * sorted and free of duplicates, and each returns the number of elements
+ * inserted or removed
+ */
+size_t
+uniteIDs(
+        std::vector<ID>       &storage,
+        const std::vector<ID> &ids
+)
+{
+        size_t na = storage.size(), nb = ids.size(), n;
+
+        if (storage.capacity() >= na + nb) {  // keep reserved capacity
+                storage.resize(na + nb);
+                n = sortedUnionInPlace(storage.data(), na, ids.data(), nb);
+        } else {
+                std::vector<ID> result(na + nb);
+                n = sortedUnion(storage.data(), na, ids.data(), nb,
+                                result.data());
+                storage.swap(result);
+        }
+
+        storage.resize(n);
+        return n - na;
+}
+
+//--------------------------------------
+
+size_t
+subtractIDs(
+        std::vector<ID>       &storage,
+        const std::vector<ID> &ids
+)
+{
+        size_t na = storage.size();
+        storage.resize(sortedDifference(storage.data(), na, ids.data(),
+                                        ids.size(), storage.data()));
+        return na - storage.size();
+}
+
+//--------------------------------------
+
+size_t
+intersectIDs(
+        std::vector<ID>       &storage,
+        const std::vector<ID> &ids
+)
+{
+        size_t na = storage.size();
+        storage.resize(sortedIntersection(storage.data(), na, ids.data(),
+                                          ids.size(), storage.data()));
+        return na - storage.size();
+}
+
+//--------------------------------------
+
+void
+symmetricDifferenceIDs(
+        std::vector<ID>       &storage,
+        const std::vector<ID> &ids
+)
+{
+        std::vector<ID> result(storage.size() + ids.size());
+        result.resize(sortedSymmetricDifference(storage.data(), storage.size(),
+                                                ids.data(), ids.size(),
+                                                result.data()));
+        storage.swap(result);
+}
+
+//--------------------------------------
+
+/*
+ * pointer type name passed to sqlite3_bind_pointer() and
+ * sqlite3_value_pointer() for IDSet parameters
+ */
+const char * const IDSET_POINTER_TYPE = "wr::sql::IDSet";
+
+/*
+ * planner's guess at the size of a set bound to idset(), which is unknown
+ * until the statement executes
+ */
+constexpr double FUNCTION_SET_SIZE = 1000;
+
+//--------------------------------------
+
+/*
+ * constraint codes written to idxStr by IDSet::SQLInterface::getBestIndex(),
+ * one per argument passed to IDSet::SQLInterface::filter()
+ */
+enum: char
+{
+        SET_ARG = 'S',  // IDSet bound to the idset() function's argument
+        EQ_ARG = '=',
+        IN_ARG = 'I',  // all values of an IN (...) list at once
+        GT_ARG = '>',
+        GE_ARG = 'G',
+        LT_ARG = '<',
+        LE_ARG = 'L'
+};
+
+//--------------------------------------
+
+/*
+ * get the ID exactly equal to value, if there is one
+ */
+bool
+exactID(
+        sqlite3_value *value,
+        ID            &id
+)
+{
+        switch (sqlite3_value_numeric_type(value)) {
+        case SQLITE_INTEGER:
+                id = sqlite3_value_int64(value);
+                return true;
+        case SQLITE_FLOAT: {
+                double x = sqlite3_value_double(value);
+                if ((x != floor(x)) || (x >= 9223372036854775808.0)
+                                    || (x < -9223372036854775808.0)) {
+                        return false;
+                }
+                id = static_cast<ID>(x);
+                return true;
+        }
+        default:
+                return false;
+        }
+}
+
+//--------------------------------------
+
+/*
+ * narrow [first, last] to the IDs satisfying the constraint "id <op> value",
+ * where code identifies <op>; values are compared as SQLite would compare
+ * them to an INTEGER PRIMARY KEY column, applying numeric affinity first
+ *
+ * returns false if no ID can satisfy the constraint
+ */
+bool
+narrowRange(
+        sqlite3_value *value,
+        char           code,
+        ID            &first,
+        ID            &last
+)
+{
+        static const double LIMIT = 9223372036854775808.0;  // 2^63
+
+        switch (sqlite3_value_numeric_type(value)) {
+        case SQLITE_INTEGER: {
+                ID x = sqlite3_value_int64(value);
+
+                switch (code) {
+                case EQ_ARG:
+                        first = std::max(first, x);
+                        last = std::min(last, x);
+                        return true;
+                case GT_ARG:
+                        if (x == std::numeric_limits<ID>::max()) {
+                                return false;
+                        }
+                        first = std::max(first, x + 1);
+                        return true;
+                case GE_ARG:
+                        first = std::max(first, x);
+                        return true;
+                case LT_ARG:
+                        if (x == std::numeric_limits<ID>::min()) {
+                                return false;
+                        }
+                        last = std::min(last, x - 1);
+                        return true;
+                case LE_ARG:
+                        last = std::min(last, x);
+                        return true;
+                default:
+                        return true;
+                }
+        }
+        case SQLITE_FLOAT: {
+                double x = sqlite3_value_double(value), bound;
+
+                switch (code) {
+                case EQ_ARG: {
+                        ID id;
+                        if (!exactID(value, id)) {
+                                return false;
+                        }
+                        first = std::max(first, id);
+                        last = std::min(last, id);
+                        return true;
+                }
+                case GT_ARG:
+                case GE_ARG:
+                        bound = (code == GT_ARG) ? floor(x) + 1 : ceil(x);
+                        if (bound >= LIMIT) {
+                                return false;
+                        } else if (bound > -LIMIT) {
+                                first = std::max(first, static_cast<ID>(bound));
+                        }
+                        return true;
+                case LT_ARG:
+                case LE_ARG:
+                        bound = (code == LT_ARG) ? ceil(x) - 1 : floor(x);
+                        if (bound < -LIMIT) {
+                                return false;
+                        } else if (bound < LIMIT) {
+                                last = std::min(last, static_cast<ID>(bound));
+                        }
+                        return true;
+                default:
+                        return true;
+                }
+        }
+        case SQLITE_NULL:
+                return false;  // comparisons with NULL are never true
+        default:
+                // TEXT and BLOB values compare greater than any integer
+                return (code == LT_ARG) || (code == LE_ARG);
+        }
+}
+
+} // anonymous namespace
+
+//--------------------------------------
+
 WRSQL_API
 IDSet::IDSet() :
         body_(new Body)
@@ -54,6 +369,17 @@ IDSet::IDSet() :
 
 //--------------------------------------
 
+WRSQL_API
+IDSet::IDSet(
+        StorageMode mode
+) :
+        this_t()
+{
+        body_->mode_ = mode;
+}
+
+//--------------------------------------
+
 WRSQL_API
 IDSet::IDSet(
         std::initializer_list<ID> ids
@@ -76,6 +402,37 @@ IDSet::IDSet(
 
 //--------------------------------------
 
+WRSQL_API
+IDSet::IDSet(
+        const IDSetView &view,
+        StorageMode      mode
+) :
+        this_t(mode)
+{
+        // the view's IDs are already sorted, so can be appended directly
+        if (body_->compressed()) {
+                for (ID id: view) {
+                        body_->bitmap_.append(id);
+                }
+        } else {
+                body_->storage_.assign(view.begin(), view.end());
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API
+IDSet::IDSet(
+        const Session &db,
+        StorageMode    mode
+) :
+        this_t(mode)
+{
+        attach(db);
+}
+
+//--------------------------------------
+
 WRSQL_API
 IDSet::IDSet(
         const Session             &db,
@@ -106,7 +463,7 @@ WRSQL_API
 IDSet::IDSet(
         const this_t &other
 ) :
-        this_t()
+        this_t(other.storageMode())
 {
         *this = other;
 }
@@ -154,7 +511,7 @@ IDSet::operator=(
                 if (!db() && other.db()) {
                         attach(*other.db());
                 }
-                body_->storage_ = other.body_->storage_;
+                body_->assign(*other.body_);
         }
         return *this;        
 }
@@ -238,15 +595,21 @@ IDSet::Body::insert(
         ID id
 ) -> std::pair<iterator, bool>
 {
+        if (compressed()) {
+                std::pair<iterator, bool> result;
+                result.second = bitmap_.insert(id, &result.first);
+                return result;
+        }
+
         auto pos = std::equal_range(storage_.begin(), storage_.end(), id);
 
         std::pair<iterator, bool> result;
 
         if (pos.first == pos.second) {
-                result.first = storage_.insert(pos.first, id);
+                result.first = iter(storage_.insert(pos.first, id));
                 result.second = true;
         } else {
-                result.first = pos.first;
+                result.first = iter(pos.first);
                 result.second = false;
         }
 
@@ -265,41 +628,14 @@ IDSet::insert(
         }
 
         if (empty()) {
-                body_->storage_ = other.body_->storage_;
+                body_->assign(*other.body_);
                 return size();
+        } else if (body_->compressed()) {
+                return body_->bitmap_.unite(other.begin(), other.end());
         }
 
-        auto      dst = body_->storage_.begin();
-        auto      src = other.begin(), src_end = other.end();
-        size_type n   = 0;
-
-        while (src != src_end) {
-                if (dst == body_->storage_.end()) {
-                        body_->storage_.insert(dst, src, src_end);
-                        n += src_end - src;
-                        src = src_end;
-                        dst = body_->storage_.end();
-                        continue;
-                } else if (*src == *dst) {
-                        ++src;
-                        ++dst;
-                } else if (*src < *dst) {
-                        auto src2 = std::lower_bound(next(src), src_end, *dst);
-
-                        /* range-based vector::insert() returns nothing
-                           in some older C++ standard libraries */
-                        size_t offset = dst - body_->storage_.begin();
-                        body_->storage_.insert(dst, src, src2);
-                        n += src2 - src;
-                        src = src2;
-                        dst = body_->storage_.begin() + offset + (src2 - src);
-                } else {  // *src > *dst
-                        dst = std::lower_bound(next(dst),
-                                               body_->storage_.end(), *src);
-                }       
-        }
-
-        return n;
+        storage_type tmp;
+        return uniteIDs(body_->storage_, other.body_->elements(tmp));
 }
 
 //--------------------------------------
@@ -320,15 +656,8 @@ IDSet::insert(
         int        col_no
 ) -> size_type
 {
-        size_type n = 0;
-
-        for (Row row: stmt) {
-                if (insert(row.get<ID>(col_no)).second) {
-                        ++n;
-                }
-        }
-
-        return n;
+        auto ids = columnIDs(stmt.begin(), col_no);
+        return insertBulk(ids);
 }
 
 //--------------------------------------
@@ -340,6 +669,10 @@ IDSet::Body::erase(
         ID id
 ) -> size_type
 {
+        if (compressed()) {
+                return bitmap_.erase(id) ? 1 : 0;
+        }
+
         auto pos = std::equal_range(storage_.begin(), storage_.end(), id);
 
         if (pos.first != pos.second) {
@@ -357,11 +690,15 @@ IDSet::erase(
         const_iterator pos
 ) -> iterator
 {
+        if (body_->compressed()) {
+                ID id = *pos;
+                body_->bitmap_.erase(id);
+                return body_->bitmap_.lowerBound(id);
+        }
+
         /* vector::erase() doesn't take const_iterator with
            some older C++ standard libraries */
-        auto i = body_->storage_.begin();
-        i += pos - i;
-        return body_->storage_.erase(i);
+        return body_->iter(body_->storage_.erase(body_->vecIter(pos)));
 }
 
 //--------------------------------------
@@ -372,12 +709,14 @@ IDSet::erase(
         const_iterator last
 ) -> iterator
 {
+        if (body_->compressed()) {
+                return body_->bitmap_.erase(first, last);
+        }
+
         /* vector::erase() doesn't take const_iterator with
            some older C++ standard libraries */
-        auto first_nc = body_->storage_.begin(), last_nc = first_nc;
-        first_nc += first - first_nc;
-        last_nc += last - last_nc;
-        return body_->storage_.erase(first_nc, last_nc);
+        return body_->iter(body_->storage_.erase(body_->vecIter(first),
+                                                 body_->vecIter(last)));
 }
 
 //--------------------------------------
@@ -393,31 +732,12 @@ IDSet::erase(
                 size_type result = size();
                 clear();
                 return result;
+        } else if (body_->compressed()) {
+                return body_->bitmap_.subtract(other.begin(), other.end());
         }
 
-        auto          &storage = body_->storage_;
-        auto           dst     = storage.begin();
-        const_iterator src     = other.begin(), src_end = other.end();
-        size_t         n       = 0;
-
-        while ((src != src_end) && (dst != storage.end())) {
-                if (*src == *dst) {
-                        auto dst2 = dst;
-                        do {
-                                ++src;
-                                ++dst2;
-                        } while ((src != src_end) && (dst2 != storage.end())
-                                                  && (*src == *dst2));
-                        n += dst2 - dst;
-                        dst = storage.erase(dst, dst2);
-                } else if (*src < *dst) {
-                        src = std::lower_bound(src, src_end, *dst);
-                } else {  // *src > *dst
-                        dst = std::lower_bound(dst, storage.end(), *src);
-                }
-        }
-
-        return n;
+        storage_type tmp;
+        return subtractIDs(body_->storage_, other.body_->elements(tmp));
 }
 
 //--------------------------------------
@@ -427,13 +747,8 @@ IDSet::erase(
         std::initializer_list<ID> ids
 ) -> size_type
 {
-        size_type n = 0;
-
-        for (ID id: ids) {
-                n += erase(id);
-        }
-
-        return n;
+        storage_type buf(ids);
+        return eraseBulk(buf);
 }
 
 //--------------------------------------
@@ -444,13 +759,12 @@ IDSet::erase(
         int        col_no
 ) -> size_type
 {
-        size_type n = 0;
-
-        for (Row row: stmt) {
-                n += erase(row.get<ID>(col_no));
+        if (empty()) {
+                return 0;
         }
 
-        return n;
+        auto ids = columnIDs(stmt.begin(), col_no);
+        return eraseBulk(ids);
 }
 
 //--------------------------------------
@@ -470,32 +784,12 @@ IDSet::intersect(
                 n = size();
                 clear();
                 return n;
+        } else if (body_->compressed()) {
+                return body_->bitmap_.intersect(other.begin(), other.end());
         }
 
-        auto &storage = body_->storage_;
-        auto  dst     = storage.begin();
-        auto  src     = other.begin(), src_end = other.end();
-
-        n = 0;
-
-        while ((src != src_end) && (dst != storage.end())) {
-                if (*src == *dst) {
-                        ++src, ++dst;
-                } else if (*src < *dst) {
-                        src = std::lower_bound(src, src_end, *dst);
-                } else {  // *src > *dst
-                        auto dst2 = std::lower_bound(dst, storage.end(), *src);
-                        n += dst2 - dst;
-                        dst = storage.erase(dst, dst2);
-                }
-        }
-
-        if (dst != storage.end()) {
-                n += storage.end() - dst;
-                storage.erase(dst, storage.end());
-        }
-
-        return n;
+        storage_type tmp;
+        return intersectIDs(body_->storage_, other.body_->elements(tmp));
 }
 
 //--------------------------------------
@@ -510,46 +804,8 @@ IDSet::intersect(
                 return 0;
         }
 
-        size_type n;
-        Row       src = stmt.begin();
-
-        if (!src) {
-                n = size();
-                clear();
-                return n;
-        }
-
-        auto &storage = body_->storage_;
-        auto  dst     = storage.begin();
-
-        n = 0;
-
-        while (src && (dst != storage.end())) {
-                auto src_val = src.get<ID>(col_no);
-                if (src_val == *dst) {
-                        ++src, ++dst;
-                } else if (src_val < *dst) {
-                        do {
-                                if (++src) {
-                                        src_val = src.get<ID>(col_no);
-                                } else {
-                                        break;
-                                }
-                        } while (src_val < *dst);
-                } else {  // src_val > *dst
-                        auto dst2 = std::lower_bound(dst, storage.end(),
-                                                     src_val);
-                        n += dst2 - dst;
-                        dst = storage.erase(dst, dst2);
-                }
-        }
-
-        if (dst != storage.end()) {
-                n += storage.end() - dst;
-                storage.erase(dst, storage.end());
-        }
-
-        return n;
+        auto ids = columnIDs(stmt.begin(), col_no);
+        return intersectBulk(ids);
 }
 
 //--------------------------------------
@@ -574,39 +830,13 @@ IDSet::symmetric_difference(
                 return *this;
         } else if (other.empty()) {
                 return *this;
+        } else if (body_->compressed()) {
+                body_->bitmap_.symmetricDifference(other.begin(), other.end());
+                return *this;
         }
 
-        auto &storage = body_->storage_;
-        auto  dst     = storage.begin();
-
-        for (auto src(other.begin()), src_end(other.end()); src != src_end;) {
-                if (dst == storage.end()) {
-                        storage.insert(dst, src, src_end);
-                        break;
-                } else if (*src == *dst) {  // delete runs of equal values
-                        auto dst2 = dst;
-                        do {
-                                ++src;
-                                ++dst2;
-                        } while ((src != src_end) && (dst2 != storage.end())
-                                                  && (*src == *dst2));
-                        dst = storage.erase(dst, dst2);
-                } else if (*src < *dst) {
-                        auto src2 = std::lower_bound(std::next(src), src_end,
-                                                     *dst);
-
-                        /* range-based vector::insert() returns nothing
-                           in some older C++ standard libraries */
-                        size_t offset = dst - storage.begin();
-                        storage.insert(dst, src, src2);
-                        src = src2;
-                        dst = storage.begin() + offset + (src2 - src);
-                } else {  // *src > *dst
-                        dst = std::lower_bound(std::next(dst), storage.end(),
-                                               *src);
-                }
-        }
-
+        storage_type tmp;
+        symmetricDifferenceIDs(body_->storage_, other.body_->elements(tmp));
         return *this;
 }
 
@@ -618,46 +848,14 @@ IDSet::symmetric_difference(
         int        col_no
 ) -> this_t &
 {
-        auto &storage = body_->storage_;
-        auto  dst     = storage.begin();
-
-        for (auto src = stmt.begin(); src;) {
-                if (dst == storage.end()) {
-                        do {
-                                storage.push_back(src.get<ID>(col_no));
-                        } while (++src);
-                        break;
-                }
-
-                auto src_val = src.get<ID>(col_no);
+        auto ids = columnIDs(stmt.begin(), col_no);
+        sortUnique(ids);
 
-                if (src_val == *dst) {
-                        auto dst2 = dst;
-                        do {
-                                ++dst2;
-                                auto next_src_val = src_val;
-
-                                // skip duplicate source values
-                                while (next_src_val == src_val && (++src)) {
-                                        next_src_val = src.get<ID>(col_no);
-                                }
-
-                                src_val = next_src_val;
-                        } while (src && (dst2 != storage.end())
-                                     && (src_val == *dst2));
-
-                        dst = storage.erase(dst, dst2);
-                } else if (src_val < *dst) {
-                        dst = std::next(storage.insert(dst, src_val));
-                        // skip duplicate values in source result set
-                        auto old_src_val = src_val;
-                        while ((src_val == old_src_val) && (++src)) {
-                                src_val = src.get<ID>(col_no);
-                        }
-                } else {  // src_val > *dst
-                        dst = std::lower_bound(std::next(dst), storage.end(),
-                                               src_val);
-                }
+        if (body_->compressed()) {
+                body_->bitmap_.symmetricDifference(iterator(ids.data()),
+                                        iterator(ids.data() + ids.size()));
+        } else {
+                symmetricDifferenceIDs(body_->storage_, ids);
         }
 
         return *this;
@@ -687,6 +885,8 @@ IDSet::swap(
                    affected queries would have to re-prepare with the swapped
                    table names */
                 body_->storage_.swap(other.body_->storage_);
+                body_->bitmap_.swap(other.body_->bitmap_);
+                std::swap(body_->mode_, other.body_->mode_);
 
                 const Session *db = this->db(), *other_db = other.db();
 
@@ -707,6 +907,64 @@ IDSet::swap(
 
 //--------------------------------------
 
+auto
+IDSet::insertBulk(
+        storage_type &ids
+) -> size_type
+{
+        sortUnique(ids);
+
+        if (body_->compressed()) {
+                return body_->bitmap_.unite(iterator(ids.data()),
+                                            iterator(ids.data() + ids.size()));
+        }
+
+        auto &storage = body_->storage_;
+
+        if (storage.empty() && (storage.capacity() < ids.size())) {
+                storage.swap(ids);
+                return storage.size();
+        }
+
+        return uniteIDs(storage, ids);
+}
+
+//--------------------------------------
+
+auto
+IDSet::eraseBulk(
+        storage_type &ids
+) -> size_type
+{
+        sortUnique(ids);
+
+        if (body_->compressed()) {
+                return body_->bitmap_.subtract(iterator(ids.data()),
+                                            iterator(ids.data() + ids.size()));
+        }
+
+        return subtractIDs(body_->storage_, ids);
+}
+
+//--------------------------------------
+
+auto
+IDSet::intersectBulk(
+        storage_type &ids
+) -> size_type
+{
+        sortUnique(ids);
+
+        if (body_->compressed()) {
+                return body_->bitmap_.intersect(iterator(ids.data()),
+                                            iterator(ids.data() + ids.size()));
+        }
+
+        return intersectIDs(body_->storage_, ids);
+}
+
+//--------------------------------------
+
 WRSQL_API std::string
 IDSet::sql_name() const
 {
@@ -723,6 +981,10 @@ IDSet::Body::count(
         ID id
 ) const -> size_type
 {
+        if (compressed()) {
+                return bitmap_.contains(id) ? 1 : 0;
+        }
+
         auto pos = std::equal_range(storage_.begin(), storage_.end(), id);
 
         if (pos.first == pos.second) {
@@ -755,6 +1017,9 @@ IDSet::lower_bound(
         ID id
 ) const -> iterator
 {
+        if (body_->compressed()) {
+                return body_->bitmap_.lowerBound(id);
+        }
         return std::lower_bound(begin(), end(), id);
 }
 
@@ -765,6 +1030,9 @@ IDSet::upper_bound(
         ID id
 ) const -> iterator
 {
+        if (body_->compressed()) {
+                return body_->bitmap_.upperBound(id);
+        }
         return std::upper_bound(begin(), end(), id);
 }
 
@@ -775,63 +1043,201 @@ IDSet::equal_range(
         ID id
 ) const -> std::pair<iterator, iterator>
 {
+        if (body_->compressed()) {
+                return { body_->bitmap_.lowerBound(id),
+                         body_->bitmap_.upperBound(id) };
+        }
         return std::equal_range(begin(), end(), id);
 }
 
 //--------------------------------------
 
-WRSQL_API const Session *IDSet::db() const     { return body_->db_; }
-WRSQL_API ID IDSet::operator[](size_t i) const { return body_->storage_[i]; }
+WRSQL_API const Session *IDSet::db() const { return body_->db_; }
+
+WRSQL_API auto IDSet::storageMode() const -> StorageMode
+        { return body_->mode_; }
+
+WRSQL_API ID
+IDSet::operator[](
+        size_t i
+) const
+{
+        if (body_->compressed()) {
+                return *body_->bitmap_.select(i);
+        }
+        return body_->storage_[i];
+}
 
-WRSQL_API bool IDSet::empty() const { return body_->storage_.empty(); }
+WRSQL_API bool IDSet::empty() const { return size() == 0; }
 
-WRSQL_API auto IDSet::size() const -> size_type
-        { return body_->storage_.size(); }
+WRSQL_API auto IDSet::size() const -> size_type { return body_->size(); }
 
 WRSQL_API auto IDSet::max_size() const -> size_type
-        { return body_->storage_.max_size(); }
+{
+        return body_->compressed() ? std::numeric_limits<size_type>::max()
+                                   : body_->storage_.max_size();
+}
 
 WRSQL_API auto IDSet::capacity() const -> size_type
-        { return body_->storage_.capacity(); }
+{
+        return body_->compressed() ? body_->bitmap_.capacity()
+                                   : body_->storage_.capacity();
+}
 
 WRSQL_API auto IDSet::cbegin() const -> const_iterator
-        { return body_->storage_.cbegin(); }
+{
+        return body_->compressed() ? body_->bitmap_.begin()
+                                   : const_iterator(body_->storage_.data());
+}
 
 WRSQL_API auto IDSet::cend() const -> const_iterator
-        { return body_->storage_.cend(); }
+{
+        return body_->compressed() ? body_->bitmap_.end()
+                                   : const_iterator(body_->storage_.data()
+                                                    + body_->storage_.size());
+}
 
 WRSQL_API auto IDSet::crbegin() const -> const_reverse_iterator
-        { return body_->storage_.crbegin(); }
+        { return const_reverse_iterator(cend()); }
 
 WRSQL_API auto IDSet::crend() const -> const_reverse_iterator
-        { return body_->storage_.crend(); }
+        { return const_reverse_iterator(cbegin()); }
 
 WRSQL_API auto IDSet::clear() -> this_t &
-        { body_->storage_.clear(); return *this; }
+        { body_->storage_.clear(); body_->bitmap_.clear(); return *this; }
+
+WRSQL_API auto
+IDSet::reserve(
+        size_t n
+) -> this_t &
+{
+        if (!body_->compressed()) {
+                body_->storage_.reserve(n);
+        }
+        return *this;
+}
+
+WRSQL_API auto
+IDSet::shrink_to_fit() -> this_t &
+{
+        if (body_->compressed()) {
+                body_->bitmap_.shrink();
+        } else {
+                body_->storage_.shrink_to_fit();
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+IDSet::serialize() const -> std::vector<uint8_t>
+{
+        std::vector<uint8_t> out;
+
+        out.reserve(size() * 2 + 16);  // typical for closely-spaced IDs
 
-WRSQL_API auto IDSet::reserve(size_t n) -> this_t &
-        { body_->storage_.reserve(n); return *this; }
+        if (body_->compressed()) {
+                serializeIDs(begin(), size(), out);
+        } else {
+                serializeIDs(body_->storage_.begin(), size(), out);
+        }
+
+        return out;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+IDSet::deserialize(
+        const void  *data,
+        size_t       bytes,
+        StorageMode  mode
+) -> this_t // static
+{
+        return this_t(IDSetView(data, bytes), mode);
+}
 
-WRSQL_API auto IDSet::shrink_to_fit() -> this_t &
-        { body_->storage_.shrink_to_fit(); return *this; }
+//--------------------------------------
 
 WRSQL_API bool operator==(const IDSet &a, const IDSet &b)
-        { return (&a == &b) || (a.body_->storage_ == b.body_->storage_); }
+{
+        return (&a == &b) || ((a.size() == b.size())
+                              && std::equal(a.begin(), a.end(), b.begin()));
+}
 
-WRSQL_API bool operator!=(const IDSet &a, const IDSet &b)
-        { return (&a != &b) && (a.body_->storage_ != b.body_->storage_); }
+WRSQL_API bool operator!=(const IDSet &a, const IDSet &b) { return !(a == b); }
 
 WRSQL_API bool operator<(const IDSet &a, const IDSet &b)
-        { return (&a != &b) && (a.body_->storage_ < b.body_->storage_); }
+{
+        return (&a != &b) && std::lexicographical_compare(a.begin(), a.end(),
+                                                          b.begin(), b.end());
+}
+
+WRSQL_API bool operator<=(const IDSet &a, const IDSet &b) { return !(b < a); }
+WRSQL_API bool operator>(const IDSet &a, const IDSet &b)  { return b < a; }
+WRSQL_API bool operator>=(const IDSet &a, const IDSet &b) { return !(a < b); }
 
-WRSQL_API bool operator<=(const IDSet &a, const IDSet &b)
-        { return (&a == &b) || (a.body_->storage_ <= b.body_->storage_); }
+//--------------------------------------
+
+template <> WRSQL_API auto
+Statement::bind(
+        int          param_no,
+        const IDSet &set
+) -> this_t &
+{
+#if SQLITE_VERSION_NUMBER >= 3020000
+        if (isActive()) {
+                reset();
+        }
+
+        auto status = sqlite3_bind_pointer(static_cast<sqlite3_stmt *>(stmt_),
+                                           param_no, const_cast<IDSet *>(&set),
+                                           IDSET_POINTER_TYPE, nullptr);
+        checkBind(param_no, status);
+        return *this;
+#else
+        (void) param_no;
+        (void) set;
+        throw std::logic_error("binding IDSet parameters requires SQLite 3.20 or later");
+#endif
+}
 
-WRSQL_API bool operator>(const IDSet &a, const IDSet &b)
-        { return (&a != &b) && (a.body_->storage_ > b.body_->storage_); }
+//--------------------------------------
 
-WRSQL_API bool operator>=(const IDSet &a, const IDSet &b)
-        { return (&a == &b) || (a.body_->storage_ >= b.body_->storage_); }
+auto
+IDSet::Body::elements(
+        storage_type &tmp
+) const -> const storage_type &
+{
+        if (compressed()) {
+                tmp.assign(bitmap_.begin(), bitmap_.end());
+                return tmp;
+        }
+        return storage_;
+}
+
+//--------------------------------------
+
+void
+IDSet::Body::assign(
+        const this_t &other
+)
+{
+        if (mode_ == other.mode_) {
+                storage_ = other.storage_;
+                bitmap_ = other.bitmap_;
+        } else if (compressed()) {
+                storage_.clear();
+                bitmap_.clear();
+                for (ID id: other.storage_) {
+                        bitmap_.append(id);
+                }
+        } else {
+                bitmap_.clear();
+                storage_.assign(other.bitmap_.begin(), other.bitmap_.end());
+        }
+}
 
 //--------------------------------------
 
@@ -852,11 +1258,29 @@ IDSet::checkAttached(
 struct IDSet::SQLInterface::Cursor :
         public sqlite3_vtab_cursor
 {
-        IDSet::Body  *set_body;  ///< body of target IDSet
-        size_t        pos;       ///< index of current position
-        optional<ID>  id;        /**< if null, cursor is either yet to be
-                                      positioned by filter() or is at the end
-                                      of the result set */
+        IDSet::Body     *set_body;  ///< body of target IDSet
+        size_t           pos = 0;   ///< index of current position
+        const_iterator   i;         /**< current position (compressed
+                                         storage only) */
+        optional<ID>     id;        /**< if null, cursor is either yet to be
+                                         positioned by filter() or is at the
+                                         end of the result set */
+        ID               last = std::numeric_limits<ID>::max();
+                                    ///< upper bound of filtered range
+        bool             use_probes = false;
+        std::vector<ID>  probes;    /**< sorted values of an IN (...) list,
+                                         if use_probes is set */
+        size_t           probe = 0; ///< index of current probe value
+        bool             use_view = false;
+                                    /**< reading a serialized set passed
+                                         to idset() instead of set_body */
+        std::vector<uint8_t>       blob;  ///< copy of serialized set
+        IDSetView                  view;  ///< view of blob, if use_view set
+        IDSetView::const_iterator  vi;    ///< current position in view
+
+        int useBlob(sqlite3_value *value);
+        void locate(ID from);
+        void seek(ID from);
         bool sync();
         void next();
 };
@@ -889,6 +1313,23 @@ IDSet::SQLInterface::SQLInterface()
         xRelease = nullptr;
         xRollbackTo = nullptr;
 
+        /* eponymous-only module: idset(?) is always available and cannot be
+           the subject of CREATE VIRTUAL TABLE */
+        function_ = sqlite3_module();
+        function_.iVersion = 1;
+        function_.xCreate = nullptr;
+        function_.xConnect = &connectFunction;
+        function_.xBestIndex = &getBestFunctionIndex;
+        function_.xDisconnect = &disconnectFunction;
+        function_.xDestroy = &disconnectFunction;
+        function_.xOpen = &openFunctionCursor;
+        function_.xClose = &closeCursor;
+        function_.xFilter = &filter;
+        function_.xNext = &next;
+        function_.xEof = &isEOF;
+        function_.xColumn = &getColumnValue;
+        function_.xRowid = &getRowID;
+
         /*
          * quirk of SQLite API: sqlite3_auto_extension() specifies a function of
          * this type, but really expects it to be:
@@ -918,6 +1359,13 @@ IDSet::SQLInterface::registerWithSession(
         int status = sqlite3_create_module_v2(
                 db, "sdig_idset", &idset_sql_iface, &idset_sql_iface, nullptr);
 
+#if SQLITE_VERSION_NUMBER >= 3020000  // sqlite3_value_pointer()
+        if (status == SQLITE_OK) {
+                status = sqlite3_create_module_v2(
+                        db, "idset", &idset_sql_iface.function_, nullptr,
+                        nullptr);
+        }
+#endif
         if (status != SQLITE_OK) {
                 *out_err_msg = sqlite3_mprintf("%s", sqlite3_errmsg(db));
         }
@@ -987,13 +1435,34 @@ IDSet::SQLInterface::getBestIndex(
         sqlite3_index_info *iinfo
 )
 {
-        int arg_no = 0;
+        return chooseIndex(vtab, iinfo,
+                           static_cast<double>(static_cast<Body *>(vtab)->size()),
+                           false);
+}
+
+//--------------------------------------
+
+/*
+ * common part of getBestIndex() and getBestFunctionIndex(); size is the
+ * (estimated) number of elements, and function is true for idset(), whose
+ * column 1 is the hidden argument column holding the set
+ */
+int
+IDSet::SQLInterface::chooseIndex(
+        sqlite3_vtab       *vtab,
+        sqlite3_index_info *iinfo,
+        double              size,
+        bool                function
+)
+{
+        int  arg_no = 0;
+        bool eq = false, in_list = false, lower = false, upper = false;
 
         iinfo->idxNum = 0;
 
         if (iinfo->nConstraint) {
-                iinfo->idxStr
-                      = static_cast<char *>(sqlite3_malloc(iinfo->nConstraint));
+                iinfo->idxStr = static_cast<char *>(
+                                        sqlite3_malloc(iinfo->nConstraint + 1));
 
                 if (!iinfo->idxStr) {
                         return SQLITE_NOMEM;
@@ -1002,14 +1471,48 @@ IDSet::SQLInterface::getBestIndex(
                 iinfo->needToFreeIdxStr = true;
         }
 
+        if (function) {
+                // the set argument is mandatory and always comes first
+                int set_arg = -1;
+
+                for (int i = 0; i < iinfo->nConstraint; ++i) {
+                        const auto &constraint = iinfo->aConstraint[i];
+
+                        if ((constraint.iColumn == 1)
+                                && (constraint.op == SQLITE_INDEX_CONSTRAINT_EQ)) {
+                                if (!constraint.usable) {
+                                        return SQLITE_CONSTRAINT;
+                                }
+                                set_arg = i;
+                                break;
+                        }
+                }
+
+                if (set_arg < 0) {
+                        sqlite3_free(vtab->zErrMsg);
+                        vtab->zErrMsg = sqlite3_mprintf(
+                                        "idset(): IDSet argument required");
+                        return SQLITE_ERROR;
+                }
+
+                iinfo->idxStr[arg_no] = SET_ARG;
+                iinfo->aConstraintUsage[set_arg].argvIndex = ++arg_no;
+                iinfo->aConstraintUsage[set_arg].omit = true;
+        }
+
         for (int i = 0; i < iinfo->nConstraint; ++i) {
                 const auto &constraint = iinfo->aConstraint[i];
                 auto       &usage      = iinfo->aConstraintUsage[i];
+                char        code;
+
+                if (function && (constraint.iColumn == 1)) {
+                        continue;  // set argument, handled above
+                }
+
+                usage.argvIndex = 0;  // 1-based index, 0 = not used
+                usage.omit = false;
 
                 if (!constraint.usable) {
-                        usage.argvIndex = 0;
-                                // 1-based index, 0 = not used
-                        usage.omit = true;
                         continue;
                 }
 
@@ -1019,20 +1522,72 @@ IDSet::SQLInterface::getBestIndex(
 
                 switch (constraint.op) {
                 case SQLITE_INDEX_CONSTRAINT_EQ:
+#if SQLITE_VERSION_NUMBER >= 3038000
+                        // take the values of one IN (...) list all at once
+                        if (!in_list && sqlite3_vtab_in(iinfo, i, -1)) {
+                                sqlite3_vtab_in(iinfo, i, 1);
+                                code = IN_ARG;
+                                in_list = true;
+                                break;
+                        }
+#endif
+                        code = EQ_ARG;
+                        eq = true;
+                        break;
                 case SQLITE_INDEX_CONSTRAINT_GT:
-                case SQLITE_INDEX_CONSTRAINT_LE:
-                case SQLITE_INDEX_CONSTRAINT_LT:
+                        code = GT_ARG;
+                        lower = true;
+                        break;
                 case SQLITE_INDEX_CONSTRAINT_GE:
-                        iinfo->idxStr[arg_no]
-                                = static_cast<char>(constraint.op);
-                        usage.argvIndex = ++arg_no;
-                        usage.omit = false;
+                        code = GE_ARG;
+                        lower = true;
+                        break;
+                case SQLITE_INDEX_CONSTRAINT_LT:
+                        code = LT_ARG;
+                        upper = true;
+                        break;
+                case SQLITE_INDEX_CONSTRAINT_LE:
+                        code = LE_ARG;
+                        upper = true;
                         break;
                 default:
-                        usage.argvIndex = 0;
-                        usage.omit = true;
                         continue;
                 }
+
+                iinfo->idxStr[arg_no] = code;
+                usage.argvIndex = ++arg_no;
+                usage.omit = true;  // filter() applies the constraint exactly
+        }
+
+        if (iinfo->idxStr) {
+                iinfo->idxStr[arg_no] = '\0';
+        }
+
+        /* costs are in units of element visits; each lookup is a binary
+           search, and range sizes are guessed the same way as SQLite's
+           own planner guesses them for indexed columns */
+        double lookup = log2(size + 1) + 1,
+               rows;
+
+        if (eq) {
+                rows = 1;
+                iinfo->estimatedCost = lookup;
+        } else if (in_list) {
+                rows = std::min(size, 25.0);  // length of list unknown
+                iinfo->estimatedCost = rows * lookup;
+        } else if (lower || upper) {
+                rows = (lower && upper) ? size / 64 : size / 4;
+                iinfo->estimatedCost = lookup + rows;
+        } else {
+                rows = size;
+                iinfo->estimatedCost = size + 1;
+        }
+
+        if (sqlite3_libversion_number() >= 3008002) {
+                iinfo->estimatedRows = static_cast<sqlite3_int64>(rows);
+        }
+        if (eq && (sqlite3_libversion_number() >= 3009000)) {
+                iinfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
         }
 
         iinfo->orderByConsumed = true;  // unless proven otherwise
@@ -1040,6 +1595,10 @@ IDSet::SQLInterface::getBestIndex(
         for (int i = 0; i < iinfo->nOrderBy; ++i) {
                 const auto &order_by = iinfo->aOrderBy[i];
 
+                if (function && (order_by.iColumn == 1)) {
+                        iinfo->orderByConsumed = false;
+                        break;
+                }
                 if ((order_by.iColumn != 0) && (order_by.iColumn != -1)) {
                         return SQLITE_ERROR;
                 }
@@ -1089,13 +1648,76 @@ IDSet::SQLInterface::filter(
 )
 {
         auto &cursor = static_cast<Cursor &>(*vcursor);
+        ID    first = std::numeric_limits<ID>::min(),
+              last  = std::numeric_limits<ID>::max();
+        bool  none  = false;
+
+        cursor.use_probes = false;
+        cursor.use_view = false;
+        cursor.probes.clear();
+        cursor.probe = 0;
+
+        for (int i = 0; i < argc; ++i) {
+                if (idx_str[i] == SET_ARG) {
+                        if (sqlite3_value_type(argv[i]) == SQLITE_BLOB) {
+                                int status = cursor.useBlob(argv[i]);
+                                if (status != SQLITE_OK) {
+                                        return status;
+                                }
+                                continue;
+                        }
+#if SQLITE_VERSION_NUMBER >= 3020000
+                        auto set = static_cast<const IDSet *>(
+                                sqlite3_value_pointer(argv[i],
+                                                      IDSET_POINTER_TYPE));
+                        if (set) {
+                                cursor.set_body = set->body_;
+                        } else {
+                                none = true;  // NULL or not bound
+                        }
+#endif
+                        continue;
+                }
+                if (idx_str[i] != IN_ARG) {
+                        none |= !narrowRange(argv[i], idx_str[i], first, last);
+                        continue;
+                }
+#if SQLITE_VERSION_NUMBER >= 3038000
+                sqlite3_value *value;
+                int            status;
+                ID             id;
+
+                for (status = sqlite3_vtab_in_first(argv[i], &value);
+                     (status == SQLITE_OK) && value;
+                     status = sqlite3_vtab_in_next(argv[i], &value)) {
+                        if (exactID(value, id)) {
+                                cursor.probes.push_back(id);
+                        }
+                }
 
-        if (cursor.set_body->storage_.empty()) {
-                return SQLITE_OK;
+                if ((status != SQLITE_OK) && (status != SQLITE_DONE)) {
+                        return status;
+                }
+
+                cursor.use_probes = true;
+#endif
         }
-        
-        cursor.pos = 0;
-        cursor.id = *cursor.set_body->storage_.begin();
+
+        if (cursor.use_probes) {
+                std::sort(cursor.probes.begin(), cursor.probes.end());
+                cursor.probes.erase(std::unique(cursor.probes.begin(),
+                                                cursor.probes.end()),
+                                    cursor.probes.end());
+        }
+
+        cursor.last = last;
+
+        if (none || (first > last)) {
+                cursor.id = {};
+        } else {
+                cursor.seek(first);
+        }
+
         return SQLITE_OK;
 }
 
@@ -1129,7 +1751,10 @@ IDSet::SQLInterface::getColumnValue(
         int                  col_idx
 )
 {
-        if (col_idx > 0) {
+        if (col_idx == 1) {  // idset() argument; pointers are not readable
+                sqlite3_result_null(ctx);
+                return SQLITE_OK;
+        } else if (col_idx > 0) {
                 return SQLITE_RANGE;
         }
 
@@ -1331,11 +1956,197 @@ IDSet::SQLInterface::rename(
 
 //--------------------------------------
 
+int
+IDSet::SQLInterface::connectFunction(
+        sqlite3             *db,
+        void                * /* aux */,
+        int                  /* argc */,
+        const char * const  * /* argv */,
+        sqlite3_vtab       **vtab,
+        char               **error
+)
+{
+        int status = sqlite3_declare_vtab(
+                db, "CREATE TABLE idset (id INTEGER PRIMARY KEY, "
+                                        "idset HIDDEN);");
+
+        if (status != SQLITE_OK) {
+                *error = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+                return status;
+        }
+
+        *vtab = new sqlite3_vtab();
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+IDSet::SQLInterface::disconnectFunction(
+        sqlite3_vtab *vtab
+)
+{
+        sqlite3_free(vtab->zErrMsg);
+        delete vtab;
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+IDSet::SQLInterface::getBestFunctionIndex(
+        sqlite3_vtab       *vtab,
+        sqlite3_index_info *iinfo
+)
+{
+        return chooseIndex(vtab, iinfo, FUNCTION_SET_SIZE, true);
+}
+
+//--------------------------------------
+
+int
+IDSet::SQLInterface::openFunctionCursor(
+        sqlite3_vtab         * /* vtab */,
+        sqlite3_vtab_cursor **vcursor
+)
+{
+        auto *cursor = new Cursor;
+        cursor->set_body = nullptr;  // assigned by filter()
+        *vcursor = cursor;
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+/*
+ * read the elements from a serialized set passed to idset() as a BLOB; the
+ * data is copied, since the value may not outlive filter(), but is decoded
+ * only as the cursor advances
+ */
+int
+IDSet::SQLInterface::Cursor::useBlob(
+        sqlite3_value *value
+)
+{
+        auto   data = static_cast<const uint8_t *>(sqlite3_value_blob(value));
+        size_t bytes = static_cast<size_t>(sqlite3_value_bytes(value));
+
+        use_view = true;
+
+        // filter() is invoked repeatedly with the same set in joins
+        if (!view.data() || (bytes != blob.size())
+                        || memcmp(data, blob.data(), bytes)) {
+                try {
+                        blob.assign(data, data + bytes);
+                        view = IDSetView(blob);
+                } catch (std::invalid_argument &e) {
+                        blob.clear();
+                        view = {};
+                        sqlite3_free(pVtab->zErrMsg);
+                        pVtab->zErrMsg = sqlite3_mprintf("%s", e.what());
+                        return SQLITE_ERROR;
+                } catch (std::bad_alloc &) {
+                        blob.clear();
+                        view = {};
+                        return SQLITE_NOMEM;
+                }
+        }
+
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+/*
+ * position at the first element not less than from, or at the end of the
+ * result set if that element lies beyond last
+ */
+void
+IDSet::SQLInterface::Cursor::locate(
+        ID from
+)
+{
+        if (use_view) {
+                vi = view.lower_bound(from);
+                if (vi == view.end()) {
+                        id = {};
+                } else {
+                        id = *vi;
+                }
+        } else if (set_body->compressed()) {
+                const auto &bits = set_body->bitmap_;
+
+                i = bits.lowerBound(from);
+                if (i == bits.end()) {
+                        id = {};
+                } else {
+                        id = *i;
+                }
+        } else {
+                const auto &storage = set_body->storage_;
+
+                pos = std::lower_bound(storage.begin(), storage.end(), from)
+                        - storage.begin();
+                if (pos < storage.size()) {
+                        id = storage[pos];
+                } else {
+                        id = {};
+                }
+        }
+
+        if (id.has_value() && (id.value() > last)) {
+                id = {};
+        }
+}
+
+//--------------------------------------
+
+/*
+ * position at the first element of the result set not less than from
+ */
+void
+IDSet::SQLInterface::Cursor::seek(
+        ID from
+)
+{
+        if (!use_probes) {
+                locate(from);
+                return;
+        }
+
+        probe = std::lower_bound(probes.begin() + probe, probes.end(), from)
+                - probes.begin();
+
+        for (; (probe < probes.size()) && (probes[probe] <= last); ++probe) {
+                locate(probes[probe]);
+                if (id == probes[probe]) {
+                        return;
+                }
+        }
+
+        id = {};
+}
+
+//--------------------------------------
+
 bool
 IDSet::SQLInterface::Cursor::sync()
 {
         if (!id.has_value()) {
                 return false;
+        } else if (use_view) {
+                return true;  // serialized sets cannot change
+        }
+
+        if (set_body->compressed()) {
+                const auto &bits = set_body->bitmap_;
+
+                if (!bits.holds(i) || (*i != id)) {
+                        // set has been changed; resume from same value
+                        seek(id.value());
+                }
+
+                return id.has_value();
         }
 
         if (pos < set_body->storage_.size()) {
@@ -1345,16 +2156,14 @@ IDSet::SQLInterface::Cursor::sync()
         }
 
         // set has been changed so cursor no longer points where it thinks
-        auto begin = set_body->storage_.begin(),
-             end   = set_body->storage_.end(),
-             i     = std::lower_bound(begin, end, id.value());
+        ID from = id.value();
 
-        if (i == end) {
-                id = {};
-        } else if ((id == *i) && (++i == end)) {
+        if (!set_body->count(from)) {
+                seek(from);
+        } else if (from == std::numeric_limits<ID>::max()) {
                 id = {};
         } else {
-                id = *i, pos = i - begin;
+                seek(from + 1);
         }
 
         return id.has_value();
@@ -1371,12 +2180,40 @@ IDSet::SQLInterface::Cursor::next()
 
         ID orig_id = id.value();
 
-        if (sync() && (id == orig_id)) {
-                if (++pos < set_body->storage_.size()) {
-                        id = set_body->storage_[pos];
+        if (!sync() || (id != orig_id)) {
+                return;  // set was changed; now at the following element
+        }
+
+        if (use_probes) {
+                if (orig_id == std::numeric_limits<ID>::max()) {
+                        id = {};
                 } else {
-                        id = {};  // no more values
+                        seek(orig_id + 1);
                 }
+                return;
+        }
+
+        if (use_view) {
+                if (++vi == view.end()) {
+                        id = {};
+                } else {
+                        id = *vi;
+                }
+        } else if (set_body->compressed()) {
+                set_body->bitmap_.next(i);
+                if (i == set_body->bitmap_.end()) {
+                        id = {};
+                } else {
+                        id = *i;
+                }
+        } else if (++pos < set_body->storage_.size()) {
+                id = set_body->storage_[pos];
+        } else {
+                id = {};  // no more values
+        }
+
+        if (id.has_value() && (id.value() > last)) {
+                id = {};
         }
 }
 
@@ -0,0 +1,1122 @@
+/**
+ * \file IDSetBitmap.cxx
+ *
+ * \brief Compressed element storage for class wr::sql::IDSet
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <algorithm>
+#include <limits>
+#ifdef _MSC_VER
+#       include <intrin.h>
+#endif
+
+#include <wrsql/IDSet.h>
+
+#include "IDSetBitmap.h"
+
+
+namespace wr {
+namespace sql {
+
+
+namespace {
+
+// all take nonzero w, except popCount()
+#ifdef _MSC_VER
+inline unsigned popCount(uint64_t w)
+        { return static_cast<unsigned>(__popcnt64(w)); }
+inline unsigned lowBit(uint64_t w)
+        { unsigned long i; _BitScanForward64(&i, w); return i; }
+inline unsigned highBit(uint64_t w)
+        { unsigned long i; _BitScanReverse64(&i, w); return i; }
+#else
+inline unsigned popCount(uint64_t w) { return __builtin_popcountll(w); }
+inline unsigned lowBit(uint64_t w)   { return __builtin_ctzll(w); }
+inline unsigned highBit(uint64_t w)  { return 63 - __builtin_clzll(w); }
+#endif
+
+} // anonymous namespace
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::Chunk::contains(
+        uint16_t low
+) const
+{
+        switch (kind) {
+        case ARRAY:
+                return std::binary_search(values.begin(), values.end(), low);
+        case BITS:
+                return (words[low >> 6] >> (low & 63)) & 1;
+        default: {  // RUNS
+                auto r = std::upper_bound(runs.begin(), runs.end(), low,
+                                          [](uint16_t v, const Run &run)
+                                                { return v < run.first; });
+                return (r != runs.begin()) && (low <= std::prev(r)->last);
+        }}
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::Chunk::holds(
+        size_t   sub,
+        uint16_t low
+) const
+{
+        switch (kind) {
+        case ARRAY:
+                return (sub < values.size()) && (values[sub] == low);
+        case BITS:
+                return (words[low >> 6] >> (low & 63)) & 1;
+        default:  // RUNS
+                return (sub < runs.size()) && (runs[sub].first <= low)
+                                           && (low <= runs[sub].last);
+        }
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::Chunk::insert(
+        uint16_t low
+)
+{
+        if (kind == RUNS) {
+                if (contains(low)) {
+                        return false;
+                }
+                unpack();
+        }
+
+        if (kind == ARRAY) {
+                auto i = std::lower_bound(values.begin(), values.end(), low);
+                if ((i != values.end()) && (*i == low)) {
+                        return false;
+                }
+                values.insert(i, low);
+                if (++card > ARRAY_MAX) {
+                        toBits();
+                }
+        } else {  // BITS
+                uint64_t &w = words[low >> 6], mask = uint64_t(1) << (low & 63);
+                if (w & mask) {
+                        return false;
+                }
+                w |= mask;
+                ++card;
+        }
+
+        return true;
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::Chunk::erase(
+        uint16_t low
+)
+{
+        if (kind == RUNS) {
+                if (!contains(low)) {
+                        return false;
+                }
+                unpack();
+        }
+
+        if (kind == ARRAY) {
+                auto i = std::lower_bound(values.begin(), values.end(), low);
+                if ((i == values.end()) || (*i != low)) {
+                        return false;
+                }
+                values.erase(i);
+                --card;
+        } else {  // BITS
+                uint64_t &w = words[low >> 6], mask = uint64_t(1) << (low & 63);
+                if (!(w & mask)) {
+                        return false;
+                }
+                w &= ~mask;
+                if (--card <= ARRAY_MAX) {
+                        toArray();
+                }
+        }
+
+        return true;
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::first(
+        size_t   &sub,
+        uint16_t &low
+) const
+{
+        lowerBound(0, sub, low);  // chunks are never empty
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::last(
+        size_t   &sub,
+        uint16_t &low
+) const
+{
+        switch (kind) {
+        case ARRAY:
+                sub = values.size() - 1;
+                low = values.back();
+                break;
+        case BITS: {
+                size_t w = NUM_WORDS;
+                while (!words[--w]) {}
+                sub = 0;
+                low = static_cast<uint16_t>((w << 6) | highBit(words[w]));
+                break;
+        }
+        case RUNS:
+                sub = runs.size() - 1;
+                low = runs.back().last;
+                break;
+        }
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::Chunk::next(
+        size_t   &sub,
+        uint16_t &low
+) const
+{
+        switch (kind) {
+        case ARRAY:
+                if (++sub >= values.size()) {
+                        return false;
+                }
+                low = values[sub];
+                return true;
+        case BITS:
+                return (low != 0xffff) && lowerBound(low + 1, sub, low);
+        default:  // RUNS
+                if (low < runs[sub].last) {
+                        ++low;
+                } else if (++sub < runs.size()) {
+                        low = runs[sub].first;
+                } else {
+                        return false;
+                }
+                return true;
+        }
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::Chunk::prev(
+        size_t   &sub,
+        uint16_t &low
+) const
+{
+        switch (kind) {
+        case ARRAY:
+                if (!sub) {
+                        return false;
+                }
+                low = values[--sub];
+                return true;
+        case BITS: {
+                if (!low) {
+                        return false;
+                }
+                unsigned bit  = (low - 1) & 63;
+                size_t   w    = (low - 1) >> 6;
+                uint64_t bits = words[w] & (bit == 63 ? ~uint64_t(0)
+                                             : (uint64_t(1) << (bit + 1)) - 1);
+                while (!bits) {
+                        if (!w) {
+                                return false;
+                        }
+                        bits = words[--w];
+                }
+                low = static_cast<uint16_t>((w << 6) | highBit(bits));
+                return true;
+        }
+        default:  // RUNS
+                if (low > runs[sub].first) {
+                        --low;
+                } else if (sub) {
+                        low = runs[--sub].last;
+                } else {
+                        return false;
+                }
+                return true;
+        }
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::Chunk::lowerBound(
+        uint16_t  bound,
+        size_t   &sub,
+        uint16_t &low
+) const
+{
+        switch (kind) {
+        case ARRAY: {
+                auto i = std::lower_bound(values.begin(), values.end(), bound);
+                if (i == values.end()) {
+                        return false;
+                }
+                sub = i - values.begin();
+                low = *i;
+                return true;
+        }
+        case BITS: {
+                size_t   w    = bound >> 6;
+                uint64_t bits = words[w] & (~uint64_t(0) << (bound & 63));
+                while (!bits) {
+                        if (++w == NUM_WORDS) {
+                                return false;
+                        }
+                        bits = words[w];
+                }
+                sub = 0;
+                low = static_cast<uint16_t>((w << 6) | lowBit(bits));
+                return true;
+        }
+        default: {  // RUNS
+                auto r = std::upper_bound(runs.begin(), runs.end(), bound,
+                                          [](uint16_t v, const Run &run)
+                                                { return v < run.first; });
+                if ((r != runs.begin()) && (bound <= std::prev(r)->last)) {
+                        sub = (r - runs.begin()) - 1;
+                        low = bound;
+                } else if (r != runs.end()) {
+                        sub = r - runs.begin();
+                        low = r->first;
+                } else {
+                        return false;
+                }
+                return true;
+        }}
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::Chunk::rank(
+        size_t   sub,
+        uint16_t low
+) const
+{
+        switch (kind) {
+        case ARRAY:
+                return sub;
+        case BITS: {
+                size_t n = 0, w = low >> 6;
+                for (size_t i = 0; i < w; ++i) {
+                        n += popCount(words[i]);
+                }
+                return n + popCount(words[w]
+                                    & ((uint64_t(1) << (low & 63)) - 1));
+        }
+        default:  // RUNS
+                return runs[sub].rank + (low - runs[sub].first);
+        }
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::select(
+        size_t    rank,
+        size_t   &sub,
+        uint16_t &low
+) const
+{
+        switch (kind) {
+        case ARRAY:
+                sub = rank;
+                low = values[rank];
+                break;
+        case BITS: {
+                size_t w = 0;
+                for (;; ++w) {
+                        size_t n = popCount(words[w]);
+                        if (rank < n) {
+                                break;
+                        }
+                        rank -= n;
+                }
+                uint64_t bits = words[w];
+                for (; rank; --rank) {
+                        bits &= bits - 1;
+                }
+                sub = 0;
+                low = static_cast<uint16_t>((w << 6) | lowBit(bits));
+                break;
+        }
+        case RUNS: {
+                auto r = std::upper_bound(runs.begin(), runs.end(), rank,
+                                          [](size_t v, const Run &run)
+                                                { return v < run.rank; });
+                sub = (r - runs.begin()) - 1;
+                low = static_cast<uint16_t>(runs[sub].first
+                                            + (rank - runs[sub].rank));
+                break;
+        }}
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::lows(
+        std::vector<uint16_t> &out
+) const
+{
+        out.clear();
+        out.reserve(card);
+
+        switch (kind) {
+        case ARRAY:
+                out = values;
+                break;
+        case BITS:
+                for (size_t w = 0; w < NUM_WORDS; ++w) {
+                        for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                                out.push_back(static_cast<uint16_t>(
+                                                (w << 6) | lowBit(bits)));
+                        }
+                }
+                break;
+        case RUNS:
+                for (const Run &run: runs) {
+                        for (unsigned v = run.first; v <= run.last; ++v) {
+                                out.push_back(static_cast<uint16_t>(v));
+                        }
+                }
+                break;
+        }
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::assign(
+        const std::vector<uint16_t> &lows,
+        bool                         use_runs
+)
+{
+        std::vector<uint16_t>().swap(values);
+        std::vector<uint64_t>().swap(words);
+        std::vector<Run>().swap(runs);
+
+        card = static_cast<uint32_t>(lows.size());
+
+        if (use_runs) {
+                kind = RUNS;
+                for (size_t i = 0; i < lows.size(); ++i) {
+                        if (runs.empty() || (lows[i] != runs.back().last + 1)) {
+                                runs.push_back({ lows[i], lows[i],
+                                                 static_cast<uint32_t>(i) });
+                        } else {
+                                runs.back().last = lows[i];
+                        }
+                }
+                runs.shrink_to_fit();
+        } else if (card > ARRAY_MAX) {
+                kind = BITS;
+                words.assign(NUM_WORDS, 0);
+                for (uint16_t v: lows) {
+                        words[v >> 6] |= uint64_t(1) << (v & 63);
+                }
+        } else {
+                kind = ARRAY;
+                values = lows;
+        }
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::unpack()
+{
+        std::vector<uint16_t> tmp;
+        lows(tmp);
+        assign(tmp, false);
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::toBits()
+{
+        words.assign(NUM_WORDS, 0);
+        for (uint16_t v: values) {
+                words[v >> 6] |= uint64_t(1) << (v & 63);
+        }
+        std::vector<uint16_t>().swap(values);
+        kind = BITS;
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::Chunk::toArray()
+{
+        std::vector<uint16_t> tmp;
+        lows(tmp);
+        values.swap(tmp);
+        std::vector<uint64_t>().swap(words);
+        kind = ARRAY;
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::Chunk::numRuns() const
+{
+        switch (kind) {
+        case ARRAY: {
+                size_t n = 0;
+                for (size_t i = 0; i < values.size(); ++i) {
+                        if (!i || (values[i] != values[i - 1] + 1)) {
+                                ++n;
+                        }
+                }
+                return n;
+        }
+        case BITS: {
+                // count set bits whose predecessor bit is clear
+                size_t   n     = 0;
+                uint64_t carry = 0;
+                for (uint64_t w: words) {
+                        n += popCount(w & ~((w << 1) | carry));
+                        carry = w >> 63;
+                }
+                return n;
+        }
+        default:  // RUNS
+                return runs.size();
+        }
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::capacity() const
+{
+        size_t n = 0;
+
+        for (const Chunk &chunk: chunks_) {
+                switch (chunk.kind) {
+                case ARRAY: n += chunk.values.capacity(); break;
+                case BITS:  n += NUM_WORDS * 64;          break;
+                case RUNS:  n += chunk.card;              break;
+                }
+        }
+
+        return n;
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::clear()
+{
+        std::vector<Chunk>().swap(chunks_);
+        size_ = 0;
+        modified();
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::swap(
+        this_t &other
+)
+{
+        chunks_.swap(other.chunks_);
+        std::swap(size_, other.size_);
+        modified();
+        other.modified();
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::shrink()
+{
+        std::vector<uint16_t> tmp;
+
+        for (Chunk &chunk: chunks_) {
+                size_t run_bytes   = chunk.numRuns() * sizeof(Run),
+                       other_bytes = (chunk.card > ARRAY_MAX)
+                                     ? NUM_WORDS * sizeof(uint64_t)
+                                     : chunk.card * sizeof(uint16_t);
+
+                if ((run_bytes < other_bytes) != (chunk.kind == RUNS)) {
+                        chunk.lows(tmp);
+                        chunk.assign(tmp, run_bytes < other_bytes);
+                } else {
+                        chunk.values.shrink_to_fit();
+                }
+        }
+
+        chunks_.shrink_to_fit();
+        std::vector<size_t>().swap(ranks_);
+        modified();
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::contains(
+        ID id
+) const
+{
+        uint64_t key = keyOf(id);
+        size_t   c   = findChunk(key);
+
+        return (c < chunks_.size()) && (chunks_[c].key == key)
+                                    && chunks_[c].contains(lowOf(id));
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::insert(
+        ID              id,
+        const_iterator *pos
+)
+{
+        uint64_t key      = keyOf(id);
+        uint16_t low      = lowOf(id);
+        size_t   c        = findChunk(key),
+                 sub      = 0;
+        bool     inserted = true;
+
+        if ((c == chunks_.size()) || (chunks_[c].key != key)) {
+                Chunk &chunk = *chunks_.emplace(chunks_.begin() + c);
+                chunk.key = key;
+                chunk.card = 1;
+                chunk.values.push_back(low);
+        } else {
+                Chunk &chunk = chunks_[c];
+                inserted = chunk.insert(low);
+                if (pos) {
+                        chunk.lowerBound(low, sub, low);
+                }
+        }
+
+        if (inserted) {
+                ++size_;
+                modified();
+        }
+
+        if (pos) {
+                *pos = const_iterator(this, c, sub, id);
+        }
+
+        return inserted;
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::append(
+        ID id
+)
+{
+        uint64_t key = keyOf(id);
+        uint16_t low = lowOf(id);
+
+        if (chunks_.empty() || (chunks_.back().key < key)) {
+                chunks_.emplace_back();
+                Chunk &chunk = chunks_.back();
+                chunk.key = key;
+                chunk.card = 1;
+                chunk.values.push_back(low);
+                ++size_;
+                modified();
+                return;
+        }
+
+        Chunk &chunk = chunks_.back();
+
+        if ((chunk.key == key) && (chunk.kind == ARRAY)
+                               && (chunk.values.back() < low)) {
+                chunk.values.push_back(low);
+                if (++chunk.card > ARRAY_MAX) {
+                        chunk.toBits();
+                }
+                ++size_;
+                modified();
+        } else {
+                insert(id);  // not in ascending order
+        }
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::erase(
+        ID id
+)
+{
+        uint64_t key = keyOf(id);
+        size_t   c   = findChunk(key);
+
+        if ((c == chunks_.size()) || (chunks_[c].key != key)
+                                  || !chunks_[c].erase(lowOf(id))) {
+                return false;
+        }
+
+        if (!chunks_[c].card) {
+                chunks_.erase(chunks_.begin() + c);
+        }
+
+        --size_;
+        modified();
+        return true;
+}
+
+//--------------------------------------
+
+auto
+IDSet::Bitmap::erase(
+        const_iterator first,
+        const_iterator last
+) -> const_iterator
+{
+        if (first == last) {
+                return first;
+        }
+
+        bool     to_end = (last.chunk_ >= chunks_.size());
+        ID       hi     = last.id_;
+        size_t   c      = first.chunk_,
+                 c_end  = to_end ? chunks_.size() : last.chunk_;
+        uint16_t lo_low = lowOf(first.id_),
+                 hi_low = lowOf(hi);
+
+        std::vector<uint16_t> tmp;
+
+        auto trim = [&](size_t idx, unsigned from, unsigned to) {
+                Chunk &chunk = chunks_[idx];
+                chunk.lows(tmp);
+                auto b = std::lower_bound(tmp.begin(), tmp.end(), from),
+                     e = std::lower_bound(b, tmp.end(), to);
+                size_ -= e - b;
+                tmp.erase(b, e);
+                chunk.assign(tmp, false);
+        };
+
+        if (c == c_end) {  // within a single chunk
+                trim(c, lo_low, hi_low);
+        } else {
+                trim(c, lo_low, 65536);
+                if (!to_end) {
+                        trim(c_end, 0, hi_low);
+                }
+                for (size_t i = c + 1; i < c_end; ++i) {
+                        size_ -= chunks_[i].card;
+                }
+                chunks_.erase(chunks_.begin() + c + 1,
+                              chunks_.begin() + c_end);
+        }
+
+        if (!chunks_[c].card) {
+                chunks_.erase(chunks_.begin() + c);
+        }
+
+        modified();
+        return to_end ? end() : lowerBound(hi);
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::unite(
+        const_iterator first,
+        const_iterator last
+)
+{
+        size_t n = last - first, orig_size = size_;
+
+        if (n < size_ / 16) {  // cheaper to insert individually
+                for (; first != last; ++first) {
+                        insert(*first);
+                }
+                return size_ - orig_size;
+        }
+
+        this_t result;
+
+        for (auto i = begin(), end = this->end(); i != end;) {
+                if (first == last) {
+                        for (; i != end; ++i) {
+                                result.append(*i);
+                        }
+                        break;
+                } else if (*i < *first) {
+                        result.append(*i++);
+                } else if (*first < *i) {
+                        result.append(*first++);
+                } else {
+                        result.append(*i++);
+                        ++first;
+                }
+        }
+
+        for (; first != last; ++first) {
+                result.append(*first);
+        }
+
+        swap(result);
+        return size_ - orig_size;
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::subtract(
+        const_iterator first,
+        const_iterator last
+)
+{
+        size_t n = last - first, orig_size = size_;
+
+        if (n < size_ / 16) {
+                for (; first != last; ++first) {
+                        erase(*first);
+                }
+                return orig_size - size_;
+        }
+
+        this_t result;
+
+        for (auto i = begin(), end = this->end(); i != end;) {
+                if ((first == last) || (*i < *first)) {
+                        result.append(*i++);
+                } else if (*first < *i) {
+                        ++first;
+                } else {
+                        ++i, ++first;
+                }
+        }
+
+        swap(result);
+        return orig_size - size_;
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::intersect(
+        const_iterator first,
+        const_iterator last
+)
+{
+        size_t n = last - first, orig_size = size_;
+        this_t result;
+
+        if (n < size_ / 16) {
+                for (; first != last; ++first) {
+                        if (contains(*first)) {
+                                result.append(*first);
+                        }
+                }
+        } else {
+                for (auto i = begin(), end = this->end();
+                                (i != end) && (first != last);) {
+                        if (*i < *first) {
+                                ++i;
+                        } else if (*first < *i) {
+                                ++first;
+                        } else {
+                                result.append(*i++);
+                                ++first;
+                        }
+                }
+        }
+
+        swap(result);
+        return orig_size - size_;
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::symmetricDifference(
+        const_iterator first,
+        const_iterator last
+)
+{
+        size_t n = last - first;
+
+        if (n < size_ / 16) {
+                for (; first != last; ++first) {
+                        if (!erase(*first)) {
+                                insert(*first);
+                        }
+                }
+                return;
+        }
+
+        this_t result;
+
+        for (auto i = begin(), end = this->end(); i != end;) {
+                if ((first == last) || (*i < *first)) {
+                        result.append(*i++);
+                } else if (*first < *i) {
+                        result.append(*first++);
+                } else {
+                        ++i, ++first;
+                }
+        }
+
+        for (; first != last; ++first) {
+                result.append(*first);
+        }
+
+        swap(result);
+}
+
+//--------------------------------------
+
+auto IDSet::Bitmap::begin() const -> const_iterator { return firstOf(0); }
+
+auto IDSet::Bitmap::end() const -> const_iterator
+        { return const_iterator(this, chunks_.size(), 0, 0); }
+
+//--------------------------------------
+
+auto
+IDSet::Bitmap::lowerBound(
+        ID id
+) const -> const_iterator
+{
+        uint64_t key = keyOf(id);
+        size_t   c   = findChunk(key), sub;
+        uint16_t low;
+
+        if ((c < chunks_.size()) && (chunks_[c].key == key)) {
+                if (chunks_[c].lowerBound(lowOf(id), sub, low)) {
+                        return const_iterator(this, c, sub, toID(key, low));
+                }
+                ++c;
+        }
+
+        return firstOf(c);
+}
+
+//--------------------------------------
+
+auto
+IDSet::Bitmap::upperBound(
+        ID id
+) const -> const_iterator
+{
+        if (id == std::numeric_limits<ID>::max()) {
+                return end();
+        }
+        return lowerBound(id + 1);
+}
+
+//--------------------------------------
+
+auto
+IDSet::Bitmap::select(
+        size_t rank
+) const -> const_iterator
+{
+        if (rank >= size_) {
+                return end();
+        }
+
+        syncRanks();
+
+        size_t   c = std::upper_bound(ranks_.begin(), ranks_.end(), rank)
+                                - ranks_.begin() - 1,
+                 sub;
+        uint16_t low;
+
+        chunks_[c].select(rank - ranks_[c], sub, low);
+        return const_iterator(this, c, sub, toID(chunks_[c].key, low));
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::rank(
+        const const_iterator &pos
+) const
+{
+        if (pos.chunk_ >= chunks_.size()) {
+                return size_;
+        }
+
+        syncRanks();
+        return ranks_[pos.chunk_]
+               + chunks_[pos.chunk_].rank(pos.sub_, lowOf(pos.id_));
+}
+
+//--------------------------------------
+
+bool
+IDSet::Bitmap::holds(
+        const const_iterator &pos
+) const
+{
+        return (pos.bits_ == this) && (pos.chunk_ < chunks_.size())
+                        && (chunks_[pos.chunk_].key == keyOf(pos.id_))
+                        && chunks_[pos.chunk_].holds(pos.sub_, lowOf(pos.id_));
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::next(
+        const_iterator &pos
+) const
+{
+        const Chunk &chunk = chunks_[pos.chunk_];
+        uint16_t     low   = lowOf(pos.id_);
+
+        if (chunk.next(pos.sub_, low)) {
+                pos.id_ = toID(chunk.key, low);
+        } else {
+                pos = firstOf(pos.chunk_ + 1);
+        }
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::prev(
+        const_iterator &pos
+) const
+{
+        uint16_t low = lowOf(pos.id_);
+
+        if ((pos.chunk_ >= chunks_.size())
+                        || !chunks_[pos.chunk_].prev(pos.sub_, low)) {
+                if (pos.chunk_ > chunks_.size()) {
+                        pos.chunk_ = chunks_.size();
+                }
+                chunks_[--pos.chunk_].last(pos.sub_, low);
+        }
+
+        pos.id_ = toID(chunks_[pos.chunk_].key, low);
+}
+
+//--------------------------------------
+
+size_t
+IDSet::Bitmap::findChunk(
+        uint64_t key
+) const
+{
+        return std::lower_bound(chunks_.begin(), chunks_.end(), key,
+                                [](const Chunk &chunk, uint64_t k)
+                                        { return chunk.key < k; })
+                - chunks_.begin();
+}
+
+//--------------------------------------
+
+auto
+IDSet::Bitmap::firstOf(
+        size_t chunk_idx
+) const -> const_iterator
+{
+        if (chunk_idx >= chunks_.size()) {
+                return end();
+        }
+
+        size_t   sub;
+        uint16_t low;
+
+        chunks_[chunk_idx].first(sub, low);
+        return const_iterator(this, chunk_idx, sub,
+                              toID(chunks_[chunk_idx].key, low));
+}
+
+//--------------------------------------
+
+void
+IDSet::Bitmap::syncRanks() const
+{
+        if (!ranks_valid_) {
+                ranks_.resize(chunks_.size());
+                size_t n = 0;
+                for (size_t i = 0; i < chunks_.size(); ++i) {
+                        ranks_[i] = n;
+                        n += chunks_[i].card;
+                }
+                ranks_valid_ = true;
+        }
+}
+
+//--------------------------------------
+
+void IDSet::const_iterator::increment() { bits_->next(*this); }
+void IDSet::const_iterator::decrement() { bits_->prev(*this); }
+
+//--------------------------------------
+
+void
+IDSet::const_iterator::advance(
+        difference_type n
+)
+{
+        if ((n >= -4) && (n <= 4)) {  // stepping is cheaper than rank/select
+                for (; n > 0; --n) {
+                        bits_->next(*this);
+                }
+                for (; n < 0; ++n) {
+                        bits_->prev(*this);
+                }
+        } else {
+                *this = bits_->select(bits_->rank(*this) + n);
+        }
+}
+
+//--------------------------------------
+
+auto
+IDSet::const_iterator::distance(
+        const this_t &other
+) const -> difference_type
+{
+        return static_cast<difference_type>(bits_->rank(*this))
+               - static_cast<difference_type>(bits_->rank(other));
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,174 @@
+/**
+ * \file IDSetBitmap.h
+ *
+ * \brief Compressed element storage for class wr::sql::IDSet
+ *
+ * \warning The declarations within this file are not part of the wrSQL API
+ *      and are only intended for use by the wrSQL library source code itself
+ *      (e.g. unit tests). These declarations are subject to change without
+ *      notice.
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_ID_SET_BITMAP_H
+#define WRSQL_ID_SET_BITMAP_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <wrsql/IDSet.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/*
+ * Roaring-style ordered set of IDs, used by IDSet::Body when the set was
+ * constructed with COMPRESSED_STORAGE.
+ *
+ * IDs are biased (sign bit flipped) so that unsigned ordering matches signed
+ * ordering, then split into a 48-bit chunk key and a 16-bit low part. Each
+ * chunk holds its low parts in one of three containers:
+ *
+ *   ARRAY - sorted vector of up to ARRAY_MAX values
+ *   BITS  - 65536-bit bitmap, used once a chunk exceeds ARRAY_MAX values
+ *   RUNS  - sorted list of [first, last] runs; only produced by shrink(),
+ *           and converted back to ARRAY or BITS on the next modification
+ *
+ * An iterator over a Bitmap records the chunk index, the array or run index
+ * within the chunk (unused for BITS) and the element's value.
+ */
+class IDSet::Bitmap
+{
+public:
+        using this_t = Bitmap;
+
+        enum Kind: uint8_t { ARRAY, BITS, RUNS };
+
+        enum: size_t
+        {
+                ARRAY_MAX = 4096,
+                NUM_WORDS = 65536 / 64
+        };
+
+        struct Run
+        {
+                uint16_t first, last;
+                uint32_t rank;  ///< number of chunk elements preceding \c first
+        };
+
+        struct Chunk
+        {
+                uint64_t              key  = 0;      ///< upper 48 bits of ID
+                uint32_t              card = 0;      ///< number of elements
+                Kind                  kind = ARRAY;
+                std::vector<uint16_t> values;        ///< ARRAY contents
+                std::vector<uint64_t> words;         ///< BITS contents
+                std::vector<Run>      runs;          ///< RUNS contents
+
+                bool contains(uint16_t low) const;
+                bool holds(size_t sub, uint16_t low) const;
+                bool insert(uint16_t low);
+                bool erase(uint16_t low);
+
+                void first(size_t &sub, uint16_t &low) const;
+                void last(size_t &sub, uint16_t &low) const;
+                bool next(size_t &sub, uint16_t &low) const;
+                bool prev(size_t &sub, uint16_t &low) const;
+                bool lowerBound(uint16_t bound, size_t &sub,
+                                uint16_t &low) const;
+
+                size_t rank(size_t sub, uint16_t low) const;
+                void select(size_t rank, size_t &sub, uint16_t &low) const;
+
+                void lows(std::vector<uint16_t> &out) const;
+                void assign(const std::vector<uint16_t> &lows, bool use_runs);
+                void unpack();
+                void toBits();
+                void toArray();
+                size_t numRuns() const;
+        };
+
+        Bitmap() : size_(0), ranks_valid_(false) {}
+
+        bool empty() const  { return !size_; }
+        size_t size() const { return size_; }
+        size_t capacity() const;
+
+        void clear();
+        void swap(this_t &other);
+        void shrink();
+
+        bool contains(ID id) const;
+        bool insert(ID id, const_iterator *pos = nullptr);
+        void append(ID id);
+        bool erase(ID id);
+        const_iterator erase(const_iterator first, const_iterator last);
+
+        // source ranges must be sorted and free of duplicates
+        size_t unite(const_iterator first, const_iterator last);
+        size_t subtract(const_iterator first, const_iterator last);
+        size_t intersect(const_iterator first, const_iterator last);
+        void symmetricDifference(const_iterator first, const_iterator last);
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        const_iterator lowerBound(ID id) const;
+        const_iterator upperBound(ID id) const;
+        const_iterator select(size_t rank) const;
+        size_t rank(const const_iterator &pos) const;
+        bool holds(const const_iterator &pos) const;
+
+        void next(const_iterator &pos) const;
+        void prev(const_iterator &pos) const;
+
+        static uint64_t keyOf(ID id)  { return bias(id) >> 16; }
+        static uint16_t lowOf(ID id)
+                { return static_cast<uint16_t>(bias(id) & 0xffff); }
+
+        static ID toID(uint64_t key, uint16_t low)
+                { return static_cast<ID>(((key << 16) | low) ^ SIGN_BIT); }
+
+private:
+        static const uint64_t SIGN_BIT = UINT64_C(1) << 63;
+
+        static uint64_t bias(ID id)
+                { return static_cast<uint64_t>(id) ^ SIGN_BIT; }
+
+        size_t findChunk(uint64_t key) const;
+        const_iterator firstOf(size_t chunk_idx) const;
+        void modified() { ranks_valid_ = false; }
+        void syncRanks() const;
+
+        std::vector<Chunk>          chunks_;
+        size_t                      size_;
+        mutable std::vector<size_t> ranks_;  /**< number of elements preceding
+                                                  each chunk; rebuilt on demand
+                                                  after modification */
+        mutable bool                ranks_valid_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_ID_SET_BITMAP_H
@@ -0,0 +1,178 @@
+/**
+ * \file IDSetCodec.h
+ *
+ * \brief Serialized form of class wr::sql::IDSet, shared by IDSet and
+ *      IDSetView
+ *
+ * \warning The declarations within this file are not part of the wrSQL API
+ *      and are only intended for use by the wrSQL library source code itself
+ *      (e.g. unit tests). These declarations are subject to change without
+ *      notice.
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_ID_SET_CODEC_H
+#define WRSQL_ID_SET_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/*
+ * Serialized layout, all integers being unsigned LEB128 varints:
+ *
+ *   format      one byte, SERIAL_FORMAT
+ *   n           number of IDs
+ *   blocks      ceil(n / SERIAL_BLOCK_SIZE) blocks, each holding
+ *                 first    zigzag-encoded first ID of the block
+ *                 bytes    size of the gaps that follow
+ *                 gaps     (IDs in block - 1) values of (gap - 1), where gap
+ *                          is the difference from the preceding ID
+ *
+ * Only the last block may hold fewer than SERIAL_BLOCK_SIZE IDs.
+ */
+enum: unsigned
+{
+        SERIAL_FORMAT = 1,
+        SERIAL_BLOCK_SIZE = 128,
+        MAX_VARINT_BYTES = 10
+};
+
+//--------------------------------------
+
+inline void
+putVarint(
+        std::vector<uint8_t> &out,
+        uint64_t              v
+)
+{
+        while (v >= 0x80) {
+                out.push_back(static_cast<uint8_t>(v) | 0x80);
+                v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+}
+
+//--------------------------------------
+
+/*
+ * decode a varint already known to be well-formed
+ */
+inline uint64_t
+getVarint(
+        const uint8_t *&p
+)
+{
+        uint64_t v = 0;
+        unsigned shift = 0;
+
+        for (; *p & 0x80; ++p, shift += 7) {
+                v |= static_cast<uint64_t>(*p & 0x7f) << shift;
+        }
+
+        return v | (static_cast<uint64_t>(*p++) << shift);
+}
+
+//--------------------------------------
+
+/*
+ * decode a varint from [p, end), returning false if it is truncated or
+ * longer than MAX_VARINT_BYTES
+ */
+inline bool
+getVarint(
+        const uint8_t *&p,
+        const uint8_t  *end,
+        uint64_t       &v
+)
+{
+        const uint8_t *q = p;
+
+        while ((q != end) && (*q & 0x80)) {
+                ++q;
+        }
+        if ((q == end) || (q - p >= MAX_VARINT_BYTES)) {
+                return false;
+        }
+
+        v = getVarint(p);
+        return true;
+}
+
+//--------------------------------------
+
+inline uint64_t zigzag(ID id)
+        { return (static_cast<uint64_t>(id) << 1) ^ static_cast<uint64_t>(id >> 63); }
+
+inline ID unzigzag(uint64_t v)
+        { return static_cast<ID>((v >> 1) ^ (0 - (v & 1))); }
+
+//--------------------------------------
+
+/*
+ * append n sorted, distinct IDs starting at first to out
+ */
+template <typename Iter> void
+serializeIDs(
+        Iter                  first,
+        size_t                n,
+        std::vector<uint8_t> &out
+)
+{
+        std::vector<uint8_t> gaps;
+
+        out.push_back(SERIAL_FORMAT);
+        putVarint(out, n);
+
+        while (n) {
+                size_t block = std::min<size_t>(n, SERIAL_BLOCK_SIZE);
+                ID     block_first = *first, prev = block_first;
+
+                gaps.clear();
+
+                for (size_t i = 1; i < block; ++i) {
+                        ID id = *++first;
+                        putVarint(gaps, static_cast<uint64_t>(id)
+                                        - static_cast<uint64_t>(prev) - 1);
+                        prev = id;
+                }
+
+                putVarint(out, zigzag(block_first));
+                putVarint(out, gaps.size());
+                out.insert(out.end(), gaps.begin(), gaps.end());
+                ++first;
+                n -= block;
+        }
+}
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_ID_SET_CODEC_H
@@ -0,0 +1,780 @@
+/**
+ * \file IDSetKernels.cxx
+ *
+ * \brief Set algebra kernels on sorted ID arrays, used by class
+ *      wr::sql::IDSet
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) \
+                        || defined(_M_IX86)
+#       define WRSQL_X86_KERNELS 1
+#       include <immintrin.h>
+#       ifdef _MSC_VER
+#               include <intrin.h>
+#       endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#       define WRSQL_NEON_KERNELS 1
+#       include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#       define WRSQL_TARGET(isa) __attribute__((target(isa)))
+#else
+#       define WRSQL_TARGET(isa)
+#endif
+
+#include "IDSetKernels.h"
+
+
+namespace wr {
+namespace sql {
+
+
+namespace {
+
+inline unsigned lowBit(unsigned w)
+{
+#ifdef _MSC_VER
+        unsigned long i; _BitScanForward(&i, w); return i;
+#else
+        return __builtin_ctz(w);
+#endif
+}
+
+//--------------------------------------
+
+/*
+ * exponential search: index of the first element of v[lo, n) not less than
+ * x, or n if there is none
+ */
+inline size_t
+gallop(
+        const ID *v,
+        size_t    lo,
+        size_t    n,
+        ID        x
+)
+{
+        size_t d = 1;
+
+        while ((lo + d <= n) && (v[lo + d - 1] < x)) {
+                d <<= 1;
+        }
+
+        return std::lower_bound(v + lo + (d >> 1), v + std::min(lo + d, n), x)
+                - v;
+}
+
+//--------------------------------------
+
+/*
+ * exponential search backwards from hi: index of the first element of
+ * v[0, hi) greater than x, or hi if there is none
+ */
+inline size_t
+gallopBack(
+        const ID *v,
+        size_t    hi,
+        ID        x
+)
+{
+        size_t d = 1;
+
+        while ((d <= hi) && (v[hi - d] > x)) {
+                d <<= 1;
+        }
+
+        size_t lo = (d <= hi) ? hi - d : 0;
+        return std::upper_bound(v + lo, v + hi - (d >> 1), x) - v;
+}
+
+//--------------------------------------
+
+inline void
+moveIDs(
+        ID       *dst,
+        const ID *src,
+        size_t    n
+)
+{
+        if (n && (dst != src)) {
+                memmove(dst, src, n * sizeof(ID));
+        }
+}
+
+//--------------------------------------
+
+/*
+ * elements of the larger array a[0, na) kept (KEEP = true, intersection) or
+ * dropped (KEEP = false, difference) by looking up each element of the much
+ * smaller array b
+ */
+template <bool KEEP> size_t
+gallopLargeA(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        size_t i = 0, k = 0;
+
+        for (size_t j = 0; (j < nb) && (i < na); ++j) {
+                size_t p = gallop(a, i, na, b[j]);
+
+                if (!KEEP) {
+                        moveIDs(out + k, a + i, p - i);
+                        k += p - i;
+                }
+
+                i = p;
+
+                if ((i < na) && (a[i] == b[j])) {
+                        if (KEEP) {
+                                out[k++] = a[i];
+                        }
+                        ++i;
+                }
+        }
+
+        if (!KEEP) {
+                moveIDs(out + k, a + i, na - i);
+                k += na - i;
+        }
+
+        return k;
+}
+
+//--------------------------------------
+
+/*
+ * as gallopLargeA() but where b is the much larger array
+ */
+template <bool KEEP> size_t
+gallopLargeB(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        size_t i = 0, j = 0, k = 0;
+
+        for (; (i < na) && (j < nb); ++i) {
+                j = gallop(b, j, nb, a[i]);
+                if (((j < nb) && (b[j] == a[i])) == KEEP) {
+                        out[k++] = a[i];
+                }
+        }
+
+        if (!KEEP) {
+                moveIDs(out + k, a + i, na - i);
+                k += na - i;
+        }
+
+        return k;
+}
+
+//--------------------------------------
+
+/*
+ * branch-free merge of a[i, na) against b[j, nb), continuing from output
+ * position k; found flags those of a[i, i + 4) already matched against
+ * elements of b preceding j by one of the block kernels below
+ */
+template <bool KEEP> size_t
+mergeTail(
+        const ID *a,
+        size_t    i,
+        size_t    na,
+        const ID *b,
+        size_t    j,
+        size_t    nb,
+        ID       *out,
+        size_t    k,
+        unsigned  found
+)
+{
+        if (found) {
+                for (size_t end = i + 4; i < end; ++i, found >>= 1) {
+                        bool matched = found & 1;
+                        if (!matched) {
+                                while ((j < nb) && (b[j] < a[i])) {
+                                        ++j;
+                                }
+                                matched = (j < nb) && (b[j] == a[i]);
+                                j += matched;
+                        }
+                        if (matched == KEEP) {
+                                out[k++] = a[i];
+                        }
+                }
+        }
+
+        while ((i < na) && (j < nb)) {
+                ID x = a[i], y = b[j];
+                out[k] = x;
+                k += KEEP ? (x == y) : (x < y);
+                i += (x <= y);
+                j += (y <= x);
+        }
+
+        if (!KEEP) {
+                moveIDs(out + k, a + i, na - i);
+                k += na - i;
+        }
+
+        return k;
+}
+
+//--------------------------------------
+
+/*
+ * output those of a[i, i + 4) flagged (KEEP = true) or not flagged
+ * (KEEP = false) in found
+ */
+template <bool KEEP> inline size_t
+emitBlock(
+        const ID *a,
+        ID       *out,
+        size_t    k,
+        unsigned  found
+)
+{
+        unsigned keep = KEEP ? found : (~found & 0xf);
+
+        while (keep) {
+                out[k++] = a[lowBit(keep)];
+                keep &= keep - 1;
+        }
+
+        return k;
+}
+
+//--------------------------------------
+
+template <bool KEEP> size_t
+scalarKernel(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        return mergeTail<KEEP>(a, 0, na, b, 0, nb, out, 0, 0);
+}
+
+//--------------------------------------
+
+/*
+ * The block kernels compare four elements of a against four elements of b
+ * at a time, accumulating in found which of the four elements of a have been
+ * matched. Whichever block has the lower maximum is then advanced (both if
+ * equal); the elements in a's block are output once that block is advanced.
+ */
+#ifdef WRSQL_X86_KERNELS
+
+template <bool KEEP> WRSQL_TARGET("sse4.1") size_t
+sse4Kernel(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        size_t   i = 0, j = 0, k = 0;
+        unsigned found = 0;
+
+        while ((i + 4 <= na) && (j + 4 <= nb)) {
+                __m128i a0 = _mm_loadu_si128(
+                                reinterpret_cast<const __m128i *>(a + i)),
+                        a1 = _mm_loadu_si128(
+                                reinterpret_cast<const __m128i *>(a + i + 2)),
+                        b0 = _mm_loadu_si128(
+                                reinterpret_cast<const __m128i *>(b + j)),
+                        b1 = _mm_loadu_si128(
+                                reinterpret_cast<const __m128i *>(b + j + 2)),
+                        b0r = _mm_shuffle_epi32(b0, _MM_SHUFFLE(1, 0, 3, 2)),
+                        b1r = _mm_shuffle_epi32(b1, _MM_SHUFFLE(1, 0, 3, 2));
+
+                __m128i m0 = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi64(a0, b0),
+                                     _mm_cmpeq_epi64(a0, b0r)),
+                        _mm_or_si128(_mm_cmpeq_epi64(a0, b1),
+                                     _mm_cmpeq_epi64(a0, b1r)));
+
+                __m128i m1 = _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi64(a1, b0),
+                                     _mm_cmpeq_epi64(a1, b0r)),
+                        _mm_or_si128(_mm_cmpeq_epi64(a1, b1),
+                                     _mm_cmpeq_epi64(a1, b1r)));
+
+                found |= _mm_movemask_pd(_mm_castsi128_pd(m0))
+                         | (_mm_movemask_pd(_mm_castsi128_pd(m1)) << 2);
+
+                ID a_max = a[i + 3], b_max = b[j + 3];
+
+                if (a_max <= b_max) {
+                        k = emitBlock<KEEP>(a + i, out, k, found);
+                        found = 0;
+                        i += 4;
+                }
+                if (b_max <= a_max) {
+                        j += 4;
+                }
+        }
+
+        return mergeTail<KEEP>(a, i, na, b, j, nb, out, k, found);
+}
+
+//--------------------------------------
+
+template <bool KEEP> WRSQL_TARGET("avx2") size_t
+avx2Kernel(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        size_t   i = 0, j = 0, k = 0;
+        unsigned found = 0;
+
+        while ((i + 4 <= na) && (j + 4 <= nb)) {
+                __m256i va = _mm256_loadu_si256(
+                                reinterpret_cast<const __m256i *>(a + i)),
+                        vb = _mm256_loadu_si256(
+                                reinterpret_cast<const __m256i *>(b + j));
+
+                __m256i m = _mm256_or_si256(
+                        _mm256_or_si256(
+                                _mm256_cmpeq_epi64(va, vb),
+                                _mm256_cmpeq_epi64(va,
+                                        _mm256_permute4x64_epi64(vb, 0x39))),
+                        _mm256_or_si256(
+                                _mm256_cmpeq_epi64(va,
+                                        _mm256_permute4x64_epi64(vb, 0x4e)),
+                                _mm256_cmpeq_epi64(va,
+                                        _mm256_permute4x64_epi64(vb, 0x93))));
+
+                found |= _mm256_movemask_pd(_mm256_castsi256_pd(m));
+
+                ID a_max = a[i + 3], b_max = b[j + 3];
+
+                if (a_max <= b_max) {
+                        k = emitBlock<KEEP>(a + i, out, k, found);
+                        found = 0;
+                        i += 4;
+                }
+                if (b_max <= a_max) {
+                        j += 4;
+                }
+        }
+
+        return mergeTail<KEEP>(a, i, na, b, j, nb, out, k, found);
+}
+
+#endif // WRSQL_X86_KERNELS
+
+//--------------------------------------
+
+#ifdef WRSQL_NEON_KERNELS
+
+template <bool KEEP> size_t
+neonKernel(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        size_t   i = 0, j = 0, k = 0;
+        unsigned found = 0;
+
+        while ((i + 4 <= na) && (j + 4 <= nb)) {
+                int64x2_t a0  = vld1q_s64(a + i),
+                          a1  = vld1q_s64(a + i + 2),
+                          b0  = vld1q_s64(b + j),
+                          b1  = vld1q_s64(b + j + 2),
+                          b0r = vextq_s64(b0, b0, 1),
+                          b1r = vextq_s64(b1, b1, 1);
+
+                uint64x2_t m0 = vorrq_u64(
+                        vorrq_u64(vceqq_s64(a0, b0), vceqq_s64(a0, b0r)),
+                        vorrq_u64(vceqq_s64(a0, b1), vceqq_s64(a0, b1r)));
+
+                uint64x2_t m1 = vorrq_u64(
+                        vorrq_u64(vceqq_s64(a1, b0), vceqq_s64(a1, b0r)),
+                        vorrq_u64(vceqq_s64(a1, b1), vceqq_s64(a1, b1r)));
+
+                found |= (vgetq_lane_u64(m0, 0) & 1)
+                         | (vgetq_lane_u64(m0, 1) & 2)
+                         | (vgetq_lane_u64(m1, 0) & 4)
+                         | (vgetq_lane_u64(m1, 1) & 8);
+
+                ID a_max = a[i + 3], b_max = b[j + 3];
+
+                if (a_max <= b_max) {
+                        k = emitBlock<KEEP>(a + i, out, k, found);
+                        found = 0;
+                        i += 4;
+                }
+                if (b_max <= a_max) {
+                        j += 4;
+                }
+        }
+
+        return mergeTail<KEEP>(a, i, na, b, j, nb, out, k, found);
+}
+
+#endif // WRSQL_NEON_KERNELS
+
+//--------------------------------------
+
+using Kernel = size_t (*)(const ID *, size_t, const ID *, size_t, ID *);
+
+struct KernelPair
+{
+        Kernel intersection, difference;
+};
+
+const KernelPair kernels[] = {
+        { &scalarKernel<true>, &scalarKernel<false> },
+#ifdef WRSQL_X86_KERNELS
+        { &sse4Kernel<true>, &sse4Kernel<false> },
+        { &avx2Kernel<true>, &avx2Kernel<false> },
+#else
+        { &scalarKernel<true>, &scalarKernel<false> },
+        { &scalarKernel<true>, &scalarKernel<false> },
+#endif
+#ifdef WRSQL_NEON_KERNELS
+        { &neonKernel<true>, &neonKernel<false> }
+#else
+        { &scalarKernel<true>, &scalarKernel<false> }
+#endif
+};
+
+std::atomic<int> selected_isa(-1);
+
+//--------------------------------------
+
+const KernelPair &
+selectedKernels()
+{
+        int isa = selected_isa.load(std::memory_order_relaxed);
+
+        if (isa < 0) {
+                isa = setKernelISA();
+        }
+
+        return kernels[isa];
+}
+
+} // anonymous namespace
+
+//--------------------------------------
+
+WRSQL_API bool
+setKernelISASupported(
+        SetKernelISA isa
+)
+{
+        switch (isa) {
+        case SCALAR_KERNELS:
+                return true;
+#ifdef WRSQL_X86_KERNELS
+#       ifdef _MSC_VER
+        case SSE4_KERNELS: {
+                int info[4];
+                __cpuid(info, 1);
+                return (info[2] >> 19) & 1;
+        }
+        case AVX2_KERNELS: {
+                int info[4];
+                __cpuid(info, 1);
+                if (!((info[2] >> 27) & 1)  // OSXSAVE
+                    || ((_xgetbv(0) & 6) != 6)) {  // OS saves YMM state
+                        return false;
+                }
+                __cpuidex(info, 7, 0);
+                return (info[1] >> 5) & 1;
+        }
+#       else
+        case SSE4_KERNELS:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("sse4.1");
+        case AVX2_KERNELS:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2");
+#       endif
+#endif
+#ifdef WRSQL_NEON_KERNELS
+        case NEON_KERNELS:
+                return true;  // mandatory on AArch64
+#endif
+        default:
+                return false;
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API SetKernelISA
+setKernelISA()
+{
+        int isa = selected_isa.load(std::memory_order_relaxed);
+
+        if (isa >= 0) {
+                return static_cast<SetKernelISA>(isa);
+        }
+
+        for (auto candidate: { NEON_KERNELS, AVX2_KERNELS, SSE4_KERNELS }) {
+                if (setKernelISASupported(candidate)) {
+                        isa = candidate;
+                        break;
+                }
+        }
+
+        if (isa < 0) {
+                isa = SCALAR_KERNELS;
+        }
+
+        /* a concurrent call to selectSetKernelISA() takes precedence */
+        int expected = -1;
+
+        if (!selected_isa.compare_exchange_strong(expected, isa)) {
+                isa = expected;
+        }
+
+        return static_cast<SetKernelISA>(isa);
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+selectSetKernelISA(
+        SetKernelISA isa
+)
+{
+        if (!setKernelISASupported(isa)) {
+                return false;
+        }
+
+        selected_isa.store(isa);
+        return true;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+sortedIntersection(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        if (!na || !nb) {
+                return 0;
+        } else if (nb * GALLOP_RATIO < na) {
+                return gallopLargeA<true>(a, na, b, nb, out);
+        } else if (na * GALLOP_RATIO < nb) {
+                return gallopLargeB<true>(a, na, b, nb, out);
+        } else {
+                return selectedKernels().intersection(a, na, b, nb, out);
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+sortedDifference(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        if (!na || !nb) {
+                moveIDs(out, a, na);
+                return na;
+        } else if (nb * GALLOP_RATIO < na) {
+                return gallopLargeA<false>(a, na, b, nb, out);
+        } else if (na * GALLOP_RATIO < nb) {
+                return gallopLargeB<false>(a, na, b, nb, out);
+        } else {
+                return selectedKernels().difference(a, na, b, nb, out);
+        }
+}
+
+//--------------------------------------
+
+/*
+ * SIMD merging of 64-bit keys gains little over the branch-free scalar merge
+ * for union and symmetric difference, since every input element produces an
+ * output element; these gallop through the larger operand when sizes are
+ * skewed and merge otherwise
+ */
+WRSQL_API size_t
+sortedUnion(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        if (na < nb) {
+                std::swap(a, b);
+                std::swap(na, nb);
+        }
+
+        size_t i = 0, j = 0, k = 0;
+
+        if (nb * GALLOP_RATIO < na) {
+                for (; j < nb; ++j) {
+                        size_t p = gallop(a, i, na, b[j]);
+                        memcpy(out + k, a + i, (p - i) * sizeof(ID));
+                        k += p - i;
+                        i = p;
+                        if ((i >= na) || (a[i] != b[j])) {
+                                out[k++] = b[j];
+                        }
+                }
+        } else {
+                while ((i < na) && (j < nb)) {
+                        ID x = a[i], y = b[j];
+                        out[k++] = (x <= y) ? x : y;
+                        i += (x <= y);
+                        j += (y <= x);
+                }
+                memcpy(out + k, b + j, (nb - j) * sizeof(ID));
+                k += nb - j;
+        }
+
+        memcpy(out + k, a + i, (na - i) * sizeof(ID));
+        return k + (na - i);
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+sortedUnionInPlace(
+        ID       *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb
+)
+{
+        // merge from the back; the write position never passes the unread
+        // part of a
+        ID     *end = a + na + nb, *w = end;
+        size_t  i = na, j = nb;
+
+        if (nb * GALLOP_RATIO < na) {
+                for (; j; --j) {
+                        ID     y = b[j - 1];
+                        size_t p = gallopBack(a, i, y);
+                        w -= i - p;
+                        moveIDs(w, a + p, i - p);
+                        i = p;
+                        if (!i || (a[i - 1] != y)) {
+                                *--w = y;
+                        }
+                }
+        } else {
+                while (i && j) {
+                        ID x = a[i - 1], y = b[j - 1];
+                        *--w = (x >= y) ? x : y;
+                        i -= (x >= y);
+                        j -= (y >= x);
+                }
+                while (j) {
+                        *--w = b[--j];
+                }
+        }
+
+        // a[0, i) is already in place; close the gap up to the merged part
+        moveIDs(a + i, w, end - w);
+        return i + (end - w);
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+sortedSymmetricDifference(
+        const ID *a,
+        size_t    na,
+        const ID *b,
+        size_t    nb,
+        ID       *out
+)
+{
+        if (na < nb) {
+                std::swap(a, b);
+                std::swap(na, nb);
+        }
+
+        size_t i = 0, j = 0, k = 0;
+
+        if (nb * GALLOP_RATIO < na) {
+                for (; j < nb; ++j) {
+                        size_t p = gallop(a, i, na, b[j]);
+                        memcpy(out + k, a + i, (p - i) * sizeof(ID));
+                        k += p - i;
+                        i = p;
+                        if ((i < na) && (a[i] == b[j])) {
+                                ++i;
+                        } else {
+                                out[k++] = b[j];
+                        }
+                }
+        } else {
+                while ((i < na) && (j < nb)) {
+                        ID x = a[i], y = b[j];
+                        out[k] = (x < y) ? x : y;
+                        k += (x != y);
+                        i += (x <= y);
+                        j += (y <= x);
+                }
+                memcpy(out + k, b + j, (nb - j) * sizeof(ID));
+                k += nb - j;
+        }
+
+        memcpy(out + k, a + i, (na - i) * sizeof(ID));
+        return k + (na - i);
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,109 @@
+/**
+ * \file IDSetKernels.h
+ *
+ * \brief Set algebra kernels on sorted ID arrays, used by class
+ *      wr::sql::IDSet
+ *
+ * \warning The declarations within this file are not part of the wrSQL API
+ *      and are only intended for use by the wrSQL library source code itself
+ *      (e.g. unit tests). These declarations are subject to change without
+ *      notice.
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_ID_SET_KERNELS_H
+#define WRSQL_ID_SET_KERNELS_H
+
+#include <stddef.h>
+
+#include <wrsql/Config.h>
+#include <wrsql/Statement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/*
+ * All kernels take arrays sorted in ascending order and free of duplicates,
+ * and write their (likewise sorted) result to out, returning the number of
+ * elements written.
+ *
+ * When one operand is more than GALLOP_RATIO times the size of the other,
+ * the smaller operand's elements are located in the larger by exponential
+ * search instead of being merged element by element. Otherwise the
+ * intersection and difference kernels compare blocks of four elements at a
+ * time using whichever instruction set was selected at startup (see
+ * setKernelISA()).
+ *
+ * sortedIntersection() and sortedDifference() write at most na elements and
+ * never overtake their reads from a, so out may be the same array as a.
+ * sortedUnion() and sortedSymmetricDifference() require out to have room
+ * for na + nb elements and must not overlap either operand.
+ * sortedUnionInPlace() requires the array at a to have room for na + nb
+ * elements; the union is written back to the start of that array.
+ */
+enum { GALLOP_RATIO = 32 };
+
+WRSQL_API size_t sortedIntersection(const ID *a, size_t na,
+                                    const ID *b, size_t nb, ID *out);
+
+WRSQL_API size_t sortedDifference(const ID *a, size_t na,
+                                  const ID *b, size_t nb, ID *out);
+
+WRSQL_API size_t sortedUnion(const ID *a, size_t na,
+                             const ID *b, size_t nb, ID *out);
+
+WRSQL_API size_t sortedUnionInPlace(ID *a, size_t na, const ID *b, size_t nb);
+
+WRSQL_API size_t sortedSymmetricDifference(const ID *a, size_t na,
+                                           const ID *b, size_t nb, ID *out);
+
+//--------------------------------------
+
+/*
+ * instruction sets available to the block-wise intersection and difference
+ * kernels; the best one supported by both the build and the host CPU is
+ * selected the first time a kernel is called
+ */
+enum SetKernelISA
+{
+        SCALAR_KERNELS,
+        SSE4_KERNELS,   // x86 SSE4.1 (pcmpeqq)
+        AVX2_KERNELS,   // x86 AVX2
+        NEON_KERNELS    // AArch64 Advanced SIMD
+};
+
+WRSQL_API SetKernelISA setKernelISA();
+WRSQL_API bool setKernelISASupported(SetKernelISA isa);
+
+/*
+ * override the automatic selection (e.g. so that unit tests can exercise
+ * every kernel); returns false and leaves the selection unchanged if isa is
+ * not supported
+ */
+WRSQL_API bool selectSetKernelISA(SetKernelISA isa);
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_ID_SET_KERNELS_H
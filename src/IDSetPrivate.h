@@ -30,6 +30,8 @@
 #ifndef WRSQL_ID_SET_PRIVATE_H
 #define WRSQL_ID_SET_PRIVATE_H
 
+#include "IDSetBitmap.h"
+
 
 namespace wr {
 namespace sql {
@@ -77,6 +79,24 @@ private:
                           sqlite_int64 *out_rowid);
 
         static int rename(sqlite3_vtab *vtab, const char *new_name);
+
+        // idset() table-valued function over a set bound as a parameter
+        static int connectFunction(sqlite3 *db, void *aux, int argc,
+                                   const char * const *argv,
+                                   sqlite3_vtab **vtab, char **error);
+
+        static int disconnectFunction(sqlite3_vtab *vtab);
+
+        static int getBestFunctionIndex(sqlite3_vtab *vtab,
+                                        sqlite3_index_info *iinfo);
+
+        static int openFunctionCursor(sqlite3_vtab *vtab,
+                                      sqlite3_vtab_cursor **vcursor);
+
+        static int chooseIndex(sqlite3_vtab *vtab, sqlite3_index_info *iinfo,
+                               double size, bool function);
+
+        sqlite3_module function_;  ///< module implementing idset()
 };
 
 
@@ -94,7 +114,27 @@ struct IDSet::Body :
         size_type erase(ID id);
         size_type count(ID id) const;
 
-        storage_type   storage_;
+        void assign(const this_t &other);
+
+        /* sorted elements as a vector; copied into tmp if compressed, so that
+           merges against vector storage can search them by position */
+        const storage_type &elements(storage_type &tmp) const;
+
+        bool compressed() const { return mode_ == COMPRESSED_STORAGE; }
+
+        size_type size() const
+                { return compressed() ? bitmap_.size() : storage_.size(); }
+
+        // convert between vector and IDSet iterators (VECTOR_STORAGE only)
+        iterator iter(storage_type::const_iterator i) const
+                { return iterator(storage_.data() + (i - storage_.begin())); }
+
+        storage_type::iterator vecIter(const_iterator i)
+                { return storage_.begin() + (i.p_ - storage_.data()); }
+
+        storage_type   storage_;  ///< elements (VECTOR_STORAGE)
+        Bitmap         bitmap_;   ///< elements (COMPRESSED_STORAGE)
+        StorageMode    mode_ = VECTOR_STORAGE;
         const Session *db_ = nullptr;
 };
 
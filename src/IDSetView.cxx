@@ -0,0 +1,233 @@
+/**
+ * \file IDSetView.cxx
+ *
+ * \brief Implementation of class wr::sql::IDSetView
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <algorithm>
+#include <stdexcept>
+
+#include <wrsql/IDSetView.h>
+
+#include "IDSetCodec.h"
+
+
+namespace wr {
+namespace sql {
+
+
+namespace {
+
+[[noreturn]] void
+throwInvalid(
+        const char *what
+)
+{
+        throw std::invalid_argument(
+                std::string("IDSetView: not a serialized IDSet: ") + what);
+}
+
+} // anonymous namespace
+
+//--------------------------------------
+
+WRSQL_API
+IDSetView::IDSetView(
+        const void *data,
+        size_t      bytes
+) :
+        data_(static_cast<const uint8_t *>(data)),
+        bytes_(bytes)
+{
+        const uint8_t *p = data_, *end = data_ + bytes_;
+        uint64_t       n;
+
+        if (!data_ || !bytes_ || (*p++ != SERIAL_FORMAT)) {
+                throwInvalid("unrecognised format");
+        } else if (!getVarint(p, end, n)) {
+                throwInvalid("truncated header");
+        }
+
+        size_ = static_cast<size_t>(n);
+        blocks_ = p;
+
+        /* check the structure without decoding the gaps: each block must
+           hold exactly one varint per ID after the first, and the blocks'
+           first IDs must ascend */
+        bool first_block = true;
+        ID   prev_first = 0;
+
+        while (n) {
+                uint64_t block = std::min<uint64_t>(n, SERIAL_BLOCK_SIZE),
+                         first, gap_bytes;
+
+                if (!getVarint(p, end, first) || !getVarint(p, end, gap_bytes)
+                                || (gap_bytes > static_cast<uint64_t>(end - p))) {
+                        throwInvalid("truncated block");
+                }
+
+                const uint8_t *gaps_end = p + gap_bytes;
+                uint64_t       num_gaps = 0;
+                unsigned       run = 0;
+
+                for (; p != gaps_end; ++p) {
+                        if (*p & 0x80) {
+                                if (++run >= MAX_VARINT_BYTES) {
+                                        throwInvalid("malformed gap");
+                                }
+                        } else {
+                                ++num_gaps;
+                                run = 0;
+                        }
+                }
+
+                if (run || (num_gaps != block - 1)) {
+                        throwInvalid("wrong number of IDs in block");
+                } else if (!first_block && (unzigzag(first) <= prev_first)) {
+                        throwInvalid("blocks out of order");
+                }
+
+                first_block = false;
+                prev_first = unzigzag(first);
+                n -= block;
+        }
+
+        if (p != end) {
+                throwInvalid("trailing data");
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API
+IDSetView::IDSetView(
+        const std::vector<uint8_t> &blob
+) :
+        IDSetView(blob.data(), blob.size())
+{
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+IDSetView::begin() const -> const_iterator
+{
+        return empty() ? end() : blockStart(blocks_, size_ - 1);
+}
+
+//--------------------------------------
+
+/*
+ * obtain an iterator to the first element of the block whose header is at
+ * header, left being the number of elements following it
+ */
+auto
+IDSetView::blockStart(
+        const uint8_t *header,
+        size_t         left
+) const -> const_iterator
+{
+        const_iterator i;
+
+        i.p_ = header;
+        i.id_ = unzigzag(getVarint(i.p_));
+        getVarint(i.p_);  // size of gaps
+        i.left_ = left;
+        return i;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+IDSetView::const_iterator::operator++() -> this_t &
+{
+        if (!left_) {
+                *this = {};
+        } else if (++in_block_ == SERIAL_BLOCK_SIZE) {
+                // p_ is at the start of the next block
+                in_block_ = 0;
+                id_ = unzigzag(getVarint(p_));
+                getVarint(p_);
+                --left_;
+        } else {
+                id_ = static_cast<ID>(static_cast<uint64_t>(id_)
+                                      + getVarint(p_) + 1);
+                --left_;
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+IDSetView::lower_bound(
+        ID id
+) const -> const_iterator
+{
+        if (empty()) {
+                return end();
+        }
+
+        const uint8_t *header = blocks_;
+        size_t         left = size_ - 1;
+
+        // skip whole blocks while the next one starts no later than id
+        while (left >= SERIAL_BLOCK_SIZE) {
+                const uint8_t *p = header;
+
+                getVarint(p);  // first ID of this block
+
+                uint64_t       gap_bytes = getVarint(p);
+                const uint8_t *next = p + gap_bytes;
+
+                p = next;
+
+                if (unzigzag(getVarint(p)) > id) {
+                        break;
+                }
+
+                header = next;
+                left -= SERIAL_BLOCK_SIZE;
+        }
+
+        auto i = blockStart(header, left);
+
+        while ((i != end()) && (*i < id)) {
+                ++i;
+        }
+
+        return i;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+IDSetView::find(
+        ID id
+) const -> const_iterator
+{
+        auto i = lower_bound(id);
+        return ((i != end()) && (*i == id)) ? i : end();
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,430 @@
+/**
+ * \file ResultCache.cxx
+ *
+ * \brief Implementation of class wr::sql::ResultCache
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <string.h>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <wrutil/u8string_view.h>
+#include <wrutil/string_view.h>
+
+#include <wrsql/ResultCache.h>
+
+#include "sqlite3api.h"
+#include "ResultCachePrivate.h"
+
+
+namespace wr {
+namespace sql {
+
+
+namespace {
+
+// type tags preceding each value appended to a Key
+enum: char
+{
+        NULL_TAG  = 'N',
+        INT_TAG   = 'I',
+        FLOAT_TAG = 'F',
+        TEXT_TAG  = 'T',
+        BLOB_TAG  = 'B'
+};
+
+// approximate bookkeeping overhead of each entry beyond its rows and key
+enum: size_t { ENTRY_OVERHEAD = 128 };
+
+} // anonymous namespace
+
+//--------------------------------------
+
+WRSQL_API
+ResultCache::Key::Key(
+        const std::string &database,
+        size_t             stmt_id
+)
+{
+        size_t db_bytes = database.size();
+
+        bytes_.reserve(2 * sizeof(size_t) + db_bytes);
+        bytes_.append(reinterpret_cast<const char *>(&db_bytes),
+                      sizeof(db_bytes));
+        bytes_ += database;
+        bytes_.append(reinterpret_cast<const char *>(&stmt_id),
+                      sizeof(stmt_id));
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+ResultCache::Key::append(
+        const char *val
+) -> this_t &
+{
+        return val ? appendText(val, strlen(val)) : appendNull();
+}
+
+//--------------------------------------
+
+template <> WRSQL_API auto
+ResultCache::Key::append(
+        const std::string &val
+) -> this_t &
+{
+        return appendText(val.data(), val.size());
+}
+
+//--------------------------------------
+
+template <> WRSQL_API auto
+ResultCache::Key::append(
+        const u8string_view &val
+) -> this_t &
+{
+        return appendText(val.char_data(), val.bytes());
+}
+
+//--------------------------------------
+
+template <> WRSQL_API auto
+ResultCache::Key::append(
+        const string_view &val
+) -> this_t &
+{
+        return appendText(val.data(), val.size());
+}
+
+//--------------------------------------
+
+template <> WRSQL_API auto
+ResultCache::Key::append(
+        const std::vector<uint8_t> &val
+) -> this_t &
+{
+        return appendBlob(val.data(), val.size());
+}
+
+//--------------------------------------
+
+auto
+ResultCache::Key::appendNull() -> this_t &
+{
+        bytes_ += NULL_TAG;
+        return *this;
+}
+
+//--------------------------------------
+
+auto
+ResultCache::Key::appendInt(
+        long long val
+) -> this_t &
+{
+        bytes_ += INT_TAG;
+        bytes_.append(reinterpret_cast<const char *>(&val), sizeof(val));
+        return *this;
+}
+
+//--------------------------------------
+
+auto
+ResultCache::Key::appendFloat(
+        double val
+) -> this_t &
+{
+        bytes_ += FLOAT_TAG;
+        bytes_.append(reinterpret_cast<const char *>(&val), sizeof(val));
+        return *this;
+}
+
+//--------------------------------------
+
+auto
+ResultCache::Key::appendText(
+        const char *text,
+        size_t      bytes
+) -> this_t &
+{
+        bytes_ += TEXT_TAG;
+        bytes_.append(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+        bytes_.append(text, bytes);
+        return *this;
+}
+
+//--------------------------------------
+
+auto
+ResultCache::Key::appendBlob(
+        const void *data,
+        size_t      bytes
+) -> this_t &
+{
+        bytes_ += BLOB_TAG;
+        bytes_.append(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+        bytes_.append(static_cast<const char *>(data), bytes);
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API
+ResultCache::ResultCache(
+        size_t max_bytes,
+        size_t max_entries
+) :
+        body_(new Body(max_bytes, max_entries))
+{
+}
+
+//--------------------------------------
+
+WRSQL_API
+ResultCache::~ResultCache()
+{
+        delete body_;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+ResultCache::maxBytes() const
+{
+        return body_->max_bytes_;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+ResultCache::maxEntries() const
+{
+        return body_->max_entries_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+ResultCache::invalidate(
+        const u8string_view &table
+)
+{
+        body_->invalidate({ TableRefs::key(table.to_string().c_str()) });
+}
+
+//--------------------------------------
+
+WRSQL_API void
+ResultCache::invalidate(
+        const std::vector<std::string> &tables
+)
+{
+        std::vector<std::string> keys;
+
+        keys.reserve(tables.size());
+        for (auto &table: tables) {
+                keys.push_back(TableRefs::key(table.c_str()));
+        }
+
+        body_->invalidate(keys);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+ResultCache::clear()
+{
+        body_->clear();
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+ResultCache::stats() const -> Stats
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        Stats                       stats = body_->stats_;
+
+        stats.entries = body_->lru_.size();
+        stats.bytes = body_->bytes_;
+        return stats;
+}
+
+//--------------------------------------
+
+auto
+ResultCache::Body::find(
+        const std::string &key
+) -> Rows
+{
+        std::lock_guard<std::mutex> guard(lock_);
+        auto                        i = index_.find(key);
+
+        if (i == index_.end()) {
+                ++stats_.misses;
+                return {};
+        }
+
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, i->second);
+        return i->second->rows;
+}
+
+//--------------------------------------
+
+uint64_t
+ResultCache::Body::generation() const
+{
+        std::lock_guard<std::mutex> guard(lock_);
+        return generation_;
+}
+
+//--------------------------------------
+
+void
+ResultCache::Body::insert(
+        const std::string &key,
+        Rows               rows,
+        Tables             tables,
+        uint64_t           generation
+)
+{
+        size_t bytes = sizeOf(*rows) + key.size() + ENTRY_OVERHEAD;
+
+        std::lock_guard<std::mutex> guard(lock_);
+
+        if ((generation != generation_) || (bytes > max_bytes_)) {
+                return;  // possibly stale, or would displace everything else
+        }
+
+        auto ins = index_.insert({ key, lru_.end() });
+
+        if (!ins.second) {  // computed concurrently by another session
+                erase(ins.first->second);
+                ins = index_.insert({ key, lru_.end() });
+        }
+
+        try {
+                lru_.push_front({ &ins.first->first, std::move(rows),
+                                  std::move(tables), bytes });
+        } catch (...) {
+                index_.erase(ins.first);
+                throw;
+        }
+
+        ins.first->second = lru_.begin();
+        bytes_ += bytes;
+        evict();
+}
+
+//--------------------------------------
+
+void
+ResultCache::Body::bypassed()
+{
+        std::lock_guard<std::mutex> guard(lock_);
+        ++stats_.bypasses;
+}
+
+//--------------------------------------
+
+void
+ResultCache::Body::invalidate(
+        const std::vector<std::string> &tables
+)
+{
+        std::lock_guard<std::mutex> guard(lock_);
+
+        ++generation_;
+
+        for (auto i = lru_.begin(); i != lru_.end(); ) {
+                auto entry = i++;
+                if (entry->tables->readsAny(tables)) {
+                        erase(entry);
+                        ++stats_.invalidations;
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+ResultCache::Body::clear()
+{
+        std::lock_guard<std::mutex> guard(lock_);
+
+        ++generation_;
+        stats_.invalidations += lru_.size();
+        index_.clear();
+        lru_.clear();
+        bytes_ = 0;
+}
+
+//--------------------------------------
+
+void
+ResultCache::Body::erase(
+        LRUList::iterator i
+)
+{
+        bytes_ -= i->bytes;
+        index_.erase(*i->key);
+        lru_.erase(i);
+}
+
+//--------------------------------------
+
+void
+ResultCache::Body::evict()
+{
+        while (!lru_.empty() && ((bytes_ > max_bytes_)
+                                 || (max_entries_
+                                     && (lru_.size() > max_entries_)))) {
+                erase(std::prev(lru_.end()));
+                ++stats_.evictions;
+        }
+}
+
+//--------------------------------------
+
+size_t
+ResultCache::Body::sizeOf(
+        const ColumnBatch &batch
+) // static
+{
+        size_t bytes = sizeof(batch);
+
+        for (size_t col_no = 0; col_no < batch.numColumns(); ++col_no) {
+                auto &col = batch.column(col_no);
+                bytes += sizeof(col) + col.name.size() + col.validity.size()
+                         + col.ints.size() * sizeof(col.ints[0])
+                         + col.floats.size() * sizeof(col.floats[0])
+                         + col.offsets.size() * sizeof(col.offsets[0])
+                         + col.data.size();
+        }
+
+        return bytes;
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,106 @@
+/**
+ * \file ResultCachePrivate.h
+ *
+ * \brief Internal declarations relating to class wr::sql::ResultCache
+ *
+ * \warning The declarations within this file are not part of the wrSQL API
+ *      and are only intended for use by the wrSQL library source code itself
+ *      (e.g. Session.cxx and unit tests). These declarations are subject
+ *      to change without notice.
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_RESULT_CACHE_PRIVATE_H
+#define WRSQL_RESULT_CACHE_PRIVATE_H
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <wrutil/CityHash.h>
+
+#include <wrsql/ResultCache.h>
+
+#include "StatementPrivate.h"
+
+
+namespace wr {
+namespace sql {
+
+
+struct ResultCache::Body
+{
+        using this_t = Body;
+        using Tables = std::shared_ptr<const TableRefs>;
+
+        Body(size_t max_bytes, size_t max_entries) :
+                max_bytes_(max_bytes), max_entries_(max_entries) {}
+
+        // look up results, counting a hit or miss
+        Rows find(const std::string &key);
+
+        /* value to be passed to insert() for results about to be computed;
+           any invalidation in the meantime causes insert() to discard them */
+        uint64_t generation() const;
+
+        void insert(const std::string &key, Rows rows, Tables tables,
+                    uint64_t generation);
+
+        void bypassed();  // count an execution not eligible for caching
+
+        void invalidate(const std::vector<std::string> &tables);
+                                                // names already lower-cased
+        void clear();
+
+        static size_t sizeOf(const ColumnBatch &batch);
+
+        struct Entry
+        {
+                const std::string *key;   // owned by index_
+                Rows               rows;
+                Tables             tables;
+                size_t             bytes;
+        };
+
+        using LRUList = std::list<Entry>;  // most recently used first
+
+        void erase(LRUList::iterator i);
+        void evict();  // enforce limits; lock_ must be held
+
+        mutable std::mutex  lock_;
+        LRUList             lru_;
+        std::unordered_map<std::string, LRUList::iterator, CityHash> index_;
+        size_t              max_bytes_,
+                            max_entries_,
+                            bytes_ = 0;
+        uint64_t            generation_ = 0;
+        Stats               stats_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_RESULT_CACHE_PRIVATE_H
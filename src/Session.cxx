@@ -23,11 +23,17 @@
  *
  * \endparblock
  */
+#include <atomic>
 #include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
 
 #include <wrutil/codecvt.h>
 #include <wrutil/ctype.h>
 #include <wrutil/Format.h>
+#include <wrutil/numeric_cast.h>
 
 #include <wrsql/Error.h>
 #include <wrsql/Session.h>
@@ -35,15 +41,99 @@
 #include <wrsql/Transaction.h>
 
 #include "sqlite3api.h"
+#include "ResultCachePrivate.h"
 #include "SessionPrivate.h"
+#include "StatementPrivate.h"
+#include "StatsCollector.h"
 
 
 namespace wr {
 namespace sql {
 
 
+static std::string databaseID(sqlite3 *db);
+static bool writeInProgress(sqlite3 *db);
+static int callBusyHandler(void *handler, int attempts);
 static int collateAlphaNum(void *context, int a_len, const void *a,
                            int b_len, const void *b);
+static optional<std::vector<uint8_t>> alphaNumKey(
+                                        const optional<u8string_view> &text);
+
+//--------------------------------------
+
+/*
+ * apply settings to a newly opened connection, before it is handed to the
+ * Session object
+ */
+static void
+applyOptions(
+        sqlite3              *db,
+        const SessionOptions &options
+)
+{
+        static const char * const JOURNAL_MODES[] = {
+                "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"
+        };
+
+        std::string pragmas;
+
+        // lookaside memory cannot be reconfigured once any is in use
+        if (options.lookaside) {
+                int status = sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE,
+                                               nullptr,
+                                               options.lookaside->slot_size,
+                                               options.lookaside->slots);
+                if (status != SQLITE_OK) {
+                        throw Error(printStr("cannot apply session options: %s",
+                                             sqlite3_errstr(status)));
+                }
+        }
+
+        /* busy handling first, so that changing the journal mode can wait;
+           the handler is reinstalled once the Session holds its own copy
+           of the options */
+        if (options.busy_handler) {
+                sqlite3_busy_handler(db, &callBusyHandler,
+                                     const_cast<SessionOptions::BusyHandler *>(
+                                                &options.busy_handler));
+        } else if (options.busy_timeout.count() > 0) {
+                sqlite3_busy_timeout(db, numeric_cast<int>(
+                                                options.busy_timeout.count()));
+        }
+        if (options.journal_mode) {
+                pragmas += printStr("PRAGMA journal_mode=%s;",
+                                    JOURNAL_MODES[*options.journal_mode]);
+        }
+        if (options.synchronous) {
+                pragmas += printStr("PRAGMA synchronous=%d;",
+                                    static_cast<int>(*options.synchronous));
+        }
+        if (options.mmap_size) {
+                pragmas += printStr("PRAGMA mmap_size=%d;",
+                                    *options.mmap_size);
+        }
+        if (options.cache_size) {
+                pragmas += printStr("PRAGMA cache_size=%d;",
+                                    *options.cache_size);
+        }
+        if (options.temp_store) {
+                pragmas += printStr("PRAGMA temp_store=%d;",
+                                    static_cast<int>(*options.temp_store));
+        }
+
+        if (!pragmas.empty()) {
+                char *msg = nullptr;
+
+                if (sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, &msg)
+                                != SQLITE_OK) {
+                        std::string what = msg ? msg : sqlite3_errmsg(db);
+                        sqlite3_free(msg);
+                        throw Error(printStr("cannot apply session options: %s",
+                                             utf8_narrow_cvt().from_utf8(what)),
+                                    pragmas);
+                }
+        }
+}
 
 //--------------------------------------
 
@@ -60,10 +150,15 @@ Session::ExecResult::release()
 Session::Body::Body(
         Session &me
 ) :
-        me_       (me),
-        db_       (nullptr),
-        inner_txn_(nullptr),
-        waiting_  (false)
+        me_          (me),
+        db_          (nullptr),
+        inner_txn_   (nullptr),
+        waiting_     (false),
+        progress_interval_(10000),
+        deadline_    (Clock::time_point::max()),
+        table_refs_  (nullptr),
+        dirty_actions_(false),
+        locking_mode_(DEFERRED_LOCKING)
 {
 }
 
@@ -71,7 +166,8 @@ Session::Body::Body(
 
 WRSQL_API Session::Session() : body_(new Body(*this)) {}
 
-WRSQL_API Session::Session(const this_t &other) : this_t(other.uri()) {}
+WRSQL_API Session::Session(const this_t &other) : this_t()
+        { *this = other; }
 
 WRSQL_API Session::Session(this_t &&other) : this_t()
         { std::swap(body_, other.body_); }
@@ -89,6 +185,18 @@ Session::Session(
 
 //--------------------------------------
 
+WRSQL_API
+Session::Session(
+        const u8string_view  &uri,
+        const SessionOptions &options
+) :
+        this_t()
+{
+        open(uri, options);
+}
+
+//--------------------------------------
+
 WRSQL_API
 Session::~Session()
 {
@@ -109,7 +217,11 @@ Session::operator=(
 {
         if (&other != this) {
                 close();
-                open(other.uri());
+                if (other.isOpen()) {
+                        open(other.uri(), other.options());
+                }
+                body_->locking_mode_ = other.body_->locking_mode_;
+                body_->retry_policy_ = other.body_->retry_policy_;
         }
         return *this;
 }
@@ -134,6 +246,17 @@ WRSQL_API void
 Session::open(
         const u8string_view &uri
 )
+{
+        open(uri, SessionOptions());
+}
+
+//--------------------------------------
+
+WRSQL_API void
+Session::open(
+        const u8string_view  &uri,
+        const SessionOptions &options
+)
 {
         auto        scheme = uri.split('\x3a');  // ASCII ':'
         std::string body_uri = uri.to_string(),  // moved to body_->uri later
@@ -160,12 +283,28 @@ Session::open(
         }
 
         sqlite3 *db;
+        int      flags = SQLITE_OPEN_URI;
+
+        if (options.read_only) {
+                flags |= SQLITE_OPEN_READONLY;
+        } else {
+                flags |= SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+        }
+
+        if (options.no_mutex) {
+                flags |= SQLITE_OPEN_NOMUTEX;
+        }
 
-        int status = sqlite3_open_v2(uri_copy.c_str(), &db,
-                SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI,
-                nullptr);
+        int status = sqlite3_open_v2(uri_copy.c_str(), &db, flags, nullptr);
 
         if (status == SQLITE_OK) {
+                try {
+                        applyOptions(db, options);
+                } catch (...) {
+                        sqlite3_close(db);
+                        close();  // regardless of outcome, as documented
+                        throw;
+                }
                 if (isOpen()) try {
                         close();
                 } catch (...) {
@@ -175,7 +314,36 @@ Session::open(
                 body_->db_ = db;
                 sqlite3_create_collation_v2(body_->db_, "ALPHANUM", SQLITE_UTF8,
                                             nullptr, &collateAlphaNum, nullptr);
+                static const Function ALPHANUM_KEY =
+                        Function::scalar("alphanum_key", &alphaNumKey,
+                                         DETERMINISTIC_FUNCTION
+                                                | INNOCUOUS_FUNCTION);
+                status = ALPHANUM_KEY.define(db);
+                for (auto fn = options.functions.begin();
+                     (status == SQLITE_OK) && (fn != options.functions.end());
+                     ++fn) {
+                        status = fn->define(db);
+                }
+                if (status != SQLITE_OK) {
+                        Error err(this, status);
+                        close();
+                        throw err;
+                }
                 body_->uri_ = std::move(body_uri);
+                body_->options_ = options;
+                body_->database_id_ = databaseID(db);
+                if (options.busy_handler) {
+                        sqlite3_busy_handler(db, &callBusyHandler,
+                                             &body_->options_.busy_handler);
+                }
+                body_->updateProgressHandler();
+                if (options.result_cache) {
+                        body_->result_cache_ = options.result_cache;
+                }
+                body_->updateCacheHooks();
+                if (options.statistics) {
+                        enableStatistics();
+                }
         } else if (body_->db_) {
                 Error err(this, lastStatusCode());
                 try {
@@ -205,6 +373,10 @@ Session::close()
 
                 body_->db_ = nullptr;
                 body_->uri_ = {};
+                body_->database_id_.clear();
+                body_->options_ = {};
+                body_->stats_.reset();
+                body_->discardDirtyTables();
         }
 }
 
@@ -237,6 +409,159 @@ Session::lastInsertRowID() const
 
 //--------------------------------------
 
+WRSQL_API size_t
+Session::execBatch_(
+        size_t              stmt_id,
+        size_t              commit_every,
+        const BatchChunkFn &exec_chunk
+)
+{
+        Statement::Ptr stmt = statement(stmt_id);
+        size_t         max_rows = commit_every ? commit_every : SIZE_MAX,
+                       total = 0, n;
+
+        do {
+                bool retry = false;
+                n = 0;
+                Transaction::begin(*this, [&](Transaction &) {
+                        bool again = retry;
+                        retry = true;
+                        n = exec_chunk(*stmt, max_rows, again);
+                });
+                total += n;
+        } while (n == max_rows);  // fewer rows means end of sequence reached
+
+        return total;
+}
+
+//--------------------------------------
+
+auto
+Session::execScript_(
+        const u8string_view &sql,
+        const BindFn        &bind
+) const -> Statement
+{
+        std::vector<std::string> stmts = splitScript(sql);
+        Statement                q;
+
+        for (size_t i = 0; i < stmts.size(); ++i) {
+                q.prepare(*this, stmts[i]);
+                bind(q);
+                if (q.begin() && (i + 1 < stmts.size())) {
+                        q.reset();  // discard result rows
+                }
+        }
+
+        return q;
+}
+
+//--------------------------------------
+
+auto
+Session::execScript_(
+        size_t        script_id,
+        const BindFn &bind
+) const -> ExecResult
+{
+        const std::vector<size_t> &stmt_ids = registeredScript(script_id);
+        Statement::Ptr             stmt;
+
+        for (size_t id: stmt_ids) {
+                if (stmt) {
+                        stmt->reset();  // discard result rows
+                }
+                stmt = statement(id);  // compiled here upon first use
+                stmt->clearBindings();
+                bind(*stmt);
+                stmt->begin();
+        }
+
+        return stmt ? std::move(stmt) : Statement::Ptr(new Statement);
+}
+
+//--------------------------------------
+
+auto
+Session::execCached_(
+        size_t                  stmt_id,
+        const ResultCache::Key &key,
+        const BindFn           &bind
+) const -> ResultCache::Rows
+{
+        Statement::Ptr stmt = statement(stmt_id);
+
+        if (!stmt->isReadOnly()) {
+                throw std::invalid_argument(
+                        printStr("statement ID %u is not read-only", stmt_id));
+        }
+
+        ResultCache                      *cache = body_->result_cache_.get();
+        std::shared_ptr<const TableRefs>  tables;
+        uint64_t                          generation = 0;
+
+        if (cache) {
+                if (!stmt->body_ || !stmt->body_->tables_) {
+                        // compiled before the cache was attached
+                        stmt->prepare(*this, registeredStatement(stmt_id));
+                }
+                tables = stmt->body_->tables_;
+                if (tables->temp || body_->isDirty(*tables)) {
+                        cache->body_->bypassed();
+                        cache = nullptr;
+                } else if (auto rows = cache->body_->find(key.bytes())) {
+                        return rows;
+                } else {
+                        generation = cache->body_->generation();
+                }
+        }
+
+        auto batch = std::make_shared<ColumnBatch>();
+
+        bind(*stmt);
+        stmt->begin();
+        stmt->fetchBatch(*batch, SIZE_MAX);
+
+        /* a transaction may be reading a snapshot older than the changes
+           last invalidated, so only results read outside one are stored */
+        if (cache && sqlite3_get_autocommit(body_->db_)) {
+                cache->body_->insert(key.bytes(), batch, std::move(tables),
+                                     generation);
+        }
+
+        return batch;
+}
+
+//--------------------------------------
+
+auto
+Session::databaseID_() const -> const std::string &
+{
+        return body_->database_id_;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::setResultCache(
+        ResultCache::Ptr cache
+) -> this_t &
+{
+        body_->result_cache_ = std::move(cache);
+        body_->updateCacheHooks();
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::resultCache() const -> const ResultCache::Ptr &
+{
+        return body_->result_cache_;
+}
+
+//--------------------------------------
+
 WRSQL_API void
 Session::interrupt()
 {
@@ -311,11 +636,71 @@ Session::releaseMemory()
 
 //--------------------------------------
 
+WRSQL_API MemoryStats
+Session::memoryStats() const
+{
+        MemoryStats stats = {};
+
+        if (!isOpen()) {
+                return stats;
+        }
+
+        auto get = [this](int op, bool highwater = false) -> uint64_t {
+                int current = 0, high = 0;
+                sqlite3_db_status(body_->db_, op, &current, &high, false);
+                return static_cast<uint64_t>(highwater ? high : current);
+        };
+
+        stats.cache_used = get(SQLITE_DBSTATUS_CACHE_USED);
+        stats.cache_used_shared = get(SQLITE_DBSTATUS_CACHE_USED_SHARED);
+        stats.schema_used = get(SQLITE_DBSTATUS_SCHEMA_USED);
+        stats.stmt_used = get(SQLITE_DBSTATUS_STMT_USED);
+        stats.cache_hits = get(SQLITE_DBSTATUS_CACHE_HIT);
+        stats.cache_misses = get(SQLITE_DBSTATUS_CACHE_MISS);
+        stats.cache_writes = get(SQLITE_DBSTATUS_CACHE_WRITE);
+        stats.cache_spills = get(SQLITE_DBSTATUS_CACHE_SPILL);
+        stats.lookaside_used = get(SQLITE_DBSTATUS_LOOKASIDE_USED);
+        stats.lookaside_highwater = get(SQLITE_DBSTATUS_LOOKASIDE_USED, true);
+        // hit and miss counts are reported as high-water marks
+        stats.lookaside_hits = get(SQLITE_DBSTATUS_LOOKASIDE_HIT, true);
+        stats.lookaside_misses = get(SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, true)
+                                 + get(SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL,
+                                       true);
+
+        for (auto &instances: body_->statements_) {
+                stats.cached_stmts += instances.size();
+        }
+
+        return stats;
+}
+
+//--------------------------------------
+
+WRSQL_API int64_t
+Session::softHeapLimit(
+        int64_t bytes
+) // static
+{
+        return sqlite3_soft_heap_limit64(bytes);
+}
+
+//--------------------------------------
+
+WRSQL_API int64_t
+Session::hardHeapLimit(
+        int64_t bytes
+) // static
+{
+        return sqlite3_hard_heap_limit64(bytes);
+}
+
+//--------------------------------------
+
 WRSQL_API void
 Session::vacuum()
 {
-        for (auto &stmt: body_->statements_) {
-                stmt.reset();
+        for (auto &instances: body_->statements_) {
+                instances.clear();
         }
 
         exec("VACUUM");
@@ -323,6 +708,167 @@ Session::vacuum()
 
 //--------------------------------------
 
+WRSQL_API bool
+Session::loadFrom(
+        const u8string_view      &uri,
+        const Backup::ProgressFn &progress,
+        const u8string_view      &db_name
+)
+{
+        SessionOptions options;
+        options.read_only = true;
+
+        Session src(uri, options);
+        Backup  backup(*this, src, db_name);
+
+        // copied as fast as possible; nothing else is expected to want src
+        return backup.run(LOAD_STEP_PAGES, {}, progress);
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+Session::backupTo(
+        const u8string_view                 &uri,
+        const Backup::ProgressFn            &progress,
+        int                                  pages_per_step,
+        std::chrono::steady_clock::duration  pause,
+        const u8string_view                 &db_name
+) const
+{
+        Session dest(uri);
+        Backup  backup(dest, *this, u8"main", db_name);
+
+        return backup.run(pages_per_step, pause, progress);
+}
+
+//--------------------------------------
+
+WRSQL_API std::vector<uint8_t>
+Session::serialize(
+        const u8string_view &db_name
+) const
+{
+        std::string name = db_name.to_string();
+
+        if (!isOpen()) {
+                throw std::logic_error("cannot serialize closed Session");
+        } else if (!sqlite3_db_filename(body_->db_, name.c_str())) {
+                throw std::invalid_argument(
+                        printStr("no database named \"%s\" is attached",
+                                 name));
+        }
+
+        sqlite3_int64  size = 0;
+        unsigned char *data = sqlite3_serialize(body_->db_, name.c_str(),
+                                                &size,
+                                                SQLITE_SERIALIZE_NOCOPY);
+        if (data) {  // in-memory database held contiguously; copy once only
+                return std::vector<uint8_t>(data, data + size);
+        }
+
+        data = sqlite3_serialize(body_->db_, name.c_str(), &size, 0);
+
+        if (!data) {
+                if (size <= 0) {
+                        return {};  // no pages
+                }
+                throw std::bad_alloc();
+        }
+
+        try {
+                std::vector<uint8_t> image(data, data + size);
+                sqlite3_free(data);
+                return image;
+        } catch (...) {
+                sqlite3_free(data);
+                throw;
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::deserialize(
+        const std::vector<uint8_t> &image,
+        const u8string_view        &db_name
+) -> this_t &
+{
+        if (!isOpen()) {
+                throw std::logic_error("cannot deserialize into closed Session");
+        }
+
+        // at least one byte, to avoid a null result when image is empty
+        auto data = static_cast<uint8_t *>(sqlite3_malloc64(image.size() + 1));
+
+        if (!data) {
+                throw std::bad_alloc();
+        }
+
+        memcpy(data, image.data(), image.size());
+        deserialize_(data, image.size(), SQLITE_DESERIALIZE_FREEONCLOSE
+                                         | SQLITE_DESERIALIZE_RESIZEABLE,
+                     db_name);
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::deserializeView(
+        const void          *data,
+        size_t               bytes,
+        const u8string_view &db_name
+) -> this_t &
+{
+        if (!isOpen()) {
+                throw std::logic_error("cannot deserialize into closed Session");
+        }
+
+        /* the image is never written to or resized while read-only, so
+           casting away const is safe */
+        deserialize_(static_cast<uint8_t *>(const_cast<void *>(data)), bytes,
+                     SQLITE_DESERIALIZE_READONLY, db_name);
+        return *this;
+}
+
+//--------------------------------------
+
+void
+Session::deserialize_(
+        uint8_t             *data,
+        size_t               bytes,
+        unsigned             flags,
+        const u8string_view &db_name
+)
+{
+        std::string name = db_name.to_string();
+
+        // sqlite3_deserialize() frees data on failure if so instructed
+        int status = sqlite3_deserialize(body_->db_, name.c_str(), data,
+                                         bytes, bytes, flags);
+        if (status != SQLITE_OK) {
+                if (status == SQLITE_NOMEM) {
+                        throw std::bad_alloc();
+                }
+                throw Error(this, status);
+        }
+
+        /* main is no longer backed by its file, so its results must not be
+           shared with other connections to that file */
+        if (name == "main") {
+                body_->database_id_ = databaseID(body_->db_);
+        }
+
+        /* the contents were replaced without passing through the hooks which
+           track changes for the result cache */
+        if (body_->result_cache_) {
+                body_->result_cache_->clear();
+        }
+}
+
+//--------------------------------------
+
 WRSQL_API Statement::Ptr
 Session::statement(
         size_t id
@@ -336,14 +882,21 @@ Session::statement(
                 body_->statements_.resize(id + 1);
         }
 
-        Statement::Ptr &cached_stmt = body_->statements_[id],
-                        stmt        = cached_stmt;
+        StmtInstances  &instances = body_->statements_[id];
+        Statement::Ptr  stmt;
+
+        for (auto &instance: instances) {
+                if (!instance->isActive()) {
+                        stmt = instance;
+                        break;
+                }
+        }
 
-        if (!cached_stmt) {
-                cached_stmt.reset(new Statement);
-                stmt = cached_stmt;
-        } else if (stmt->isActive()) {
-                stmt.reset(new Statement(*cached_stmt));
+        if (!stmt) {  // all cached instances in use, e.g. by an outer loop
+                stmt.reset(new Statement);
+                if (instances.size() < Body::MAX_STMT_INSTANCES) {
+                        instances.push_back(stmt);
+                }
         }
 
         if (!stmt->isPrepared()) {
@@ -358,8 +911,8 @@ Session::statement(
 WRSQL_API void
 Session::finalizeRegisteredStatements()
 {
-        for (auto &stmt: body_->statements_) {
-                if (stmt) {
+        for (auto &instances: body_->statements_) {
+                for (auto &stmt: instances) {
                         stmt->finalize();
                 }
         }
@@ -367,11 +920,43 @@ Session::finalizeRegisteredStatements()
 
 //--------------------------------------
 
+WRSQL_API size_t
+Session::prepareRegisteredStatements()
+{
+        size_t num_stmts = numRegisteredStatements(), num_prepared = 0;
+
+        if (body_->statements_.size() < num_stmts) {
+                body_->statements_.resize(num_stmts);
+        }
+
+        for (size_t id = 0; id < num_stmts; ++id) {
+                StmtInstances &instances = body_->statements_[id];
+
+                if (instances.empty()) {
+                        instances.emplace_back(new Statement);
+                }
+
+                Statement::Ptr &stmt = instances.front();
+
+                if (!stmt->isPrepared()) try {
+                        stmt->prepare(*this, registeredStatement(id));
+                } catch (const Error &) {
+                        continue;  // compile on demand in statement()
+                }
+
+                ++num_prepared;
+        }
+
+        return num_prepared;
+}
+
+//--------------------------------------
+
 WRSQL_API void
 Session::resetRegisteredStatements()
 {
-        for (auto &stmt: body_->statements_) {
-                if (stmt) {
+        for (auto &instances: body_->statements_) {
+                for (auto &stmt: instances) {
                         stmt->reset();
                 }
         }
@@ -384,50 +969,419 @@ Session::setProgressHandler(
         ProgressHandler handler
 ) -> this_t &
 {
-        int    period;
-        int  (*sqlite_handler)(void *);
-        void  *context;
-
-        if (handler) {
-                period = 10000;
-                sqlite_handler = &Body::callProgressHandler;
-                context = body_;
-        } else {
-                period = 0;
-                sqlite_handler = nullptr;
-                context = nullptr;
-        }
-
         body_->progress_handler_ = std::move(handler);
-        sqlite3_progress_handler(body_->db_, period, sqlite_handler, context);
+        body_->updateProgressHandler();
         return *this;
 }
 
 //--------------------------------------
 
-int
-Session::Body::callProgressHandler(
-        void *me
-) // static
+WRSQL_API auto
+Session::setProgressInterval(
+        unsigned vm_steps
+) -> this_t &
 {
-        return static_cast<this_t *>(me)->progress_handler_();
+        body_->progress_interval_ = vm_steps ? vm_steps : 1;
+        body_->updateProgressHandler();
+        return *this;
 }
 
 //--------------------------------------
 
-WRSQL_API Transaction
-Session::beginTransaction(
-        std::function<void (Transaction &)> code
-)
+WRSQL_API unsigned
+Session::progressInterval() const
 {
-        return Transaction::begin(*this, code);
+        return body_->progress_interval_;
 }
 
 //--------------------------------------
 
-WRSQL_API void
-Session::onFinalCommit(
-        CommitAction action
+WRSQL_API auto
+Session::setDeadline(
+        Clock::time_point when
+) -> this_t &
+{
+        bool had_deadline = body_->deadline_ != Clock::time_point::max();
+
+        body_->deadline_ = when;
+        if (had_deadline != (when != Clock::time_point::max())) {
+                body_->updateProgressHandler();
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::clearDeadline() -> this_t &
+{
+        return setDeadline(Clock::time_point::max());
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::deadline() const -> Clock::time_point
+{
+        return body_->deadline_;
+}
+
+//--------------------------------------
+
+void
+Session::Body::updateProgressHandler()
+{
+        if (!db_) {
+                return;  // installed by Session::open()
+        } else if (progress_handler_ || (deadline_ != Clock::time_point::max())) {
+                sqlite3_progress_handler(db_,
+                                         numeric_cast<int>(progress_interval_),
+                                         &callProgressHandler, this);
+        } else {
+                sqlite3_progress_handler(db_, 0, nullptr, nullptr);
+        }
+}
+
+//--------------------------------------
+
+void
+Session::Body::updateCacheHooks()
+{
+        if (!db_) {
+                return;  // installed by Session::open()
+        } else if (result_cache_) {
+                sqlite3_set_authorizer(db_, &authorize, this);
+                sqlite3_update_hook(db_, &onUpdate, this);
+        } else {
+                sqlite3_set_authorizer(db_, nullptr, nullptr);
+                sqlite3_update_hook(db_, nullptr, nullptr);
+                discardDirtyTables();
+        }
+}
+
+//--------------------------------------
+
+/*
+ * Gathers the tables read and written by each statement compiled while a
+ * ResultCache is attached. Tables written are recorded here as well as by
+ * onUpdate() since the update hook does not report rows removed by
+ * "DELETE FROM table" without a WHERE clause, nor changes to WITHOUT ROWID
+ * tables.
+ */
+int
+Session::Body::authorize(
+        void       *me,
+        int         action,
+        const char *arg1,
+        const char *arg2,
+        const char *db_name,
+        const char *trigger
+) // static
+{
+        (void) trigger;
+
+        TableRefs *tables = static_cast<this_t *>(me)->table_refs_;
+
+        if (!tables) {
+                return SQLITE_OK;  // e.g. recompiling after schema change
+        }
+
+        switch (action) {
+        case SQLITE_READ:
+                if (db_name && !strcmp(db_name, "temp")) {
+                        tables->temp = true;
+                }
+                tables->addRead(arg1);
+                break;
+        case SQLITE_INSERT: case SQLITE_UPDATE: case SQLITE_DELETE:
+        case SQLITE_DROP_TABLE: case SQLITE_DROP_TEMP_TABLE:
+                tables->addWrite(arg1);
+                break;
+        case SQLITE_ALTER_TABLE:
+                tables->addWrite(arg2);
+                break;
+        }
+
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+void
+Session::Body::onUpdate(
+        void          *me,
+        int            op,
+        const char    *db_name,
+        const char    *table,
+        sqlite3_int64  rowid
+) // static
+{
+        (void) op;
+        (void) db_name;
+        (void) rowid;
+        static_cast<this_t *>(me)->markDirty(table);
+}
+
+//--------------------------------------
+
+bool
+Session::Body::isDirty(
+        const TableRefs &tables
+) const
+{
+        return tables.readsAny(dirty_tables_);
+}
+
+//--------------------------------------
+
+void
+Session::Body::markDirty(
+        const char *table
+)
+{
+        // called for every row changed, so avoid allocating where possible
+        bool found = false;
+
+        for (auto &dirty: dirty_tables_) {
+                if (!sqlite3_stricmp(dirty.c_str(), table)) {
+                        found = true;
+                        break;
+                }
+        }
+
+        if (!found) {
+                dirty_tables_.push_back(TableRefs::key(table));
+        }
+
+        if (inner_txn_ && !dirty_actions_) {
+                commit_actions_.emplace_back([this] { flushDirtyTables(); });
+                rollback_actions_.emplace_back([this] {
+                        discardDirtyTables();
+                });
+                dirty_actions_ = true;
+        }
+}
+
+//--------------------------------------
+
+void
+Session::Body::markDirty(
+        const TableRefs &tables
+)
+{
+        for (auto &table: tables.writes) {
+                markDirty(table.c_str());
+        }
+}
+
+//--------------------------------------
+
+void
+Session::Body::dirtyTablesCommitted()
+{
+        /* autocommit mode alone does not mean the changes are committed:
+           another statement's implicit write transaction may still be open,
+           and flushing now would let other connections cache what they read
+           before it commits under the new generation */
+        if (!inner_txn_ && sqlite3_get_autocommit(db_)
+                        && !writeInProgress(db_)) {
+                flushDirtyTables();
+        }
+}
+
+//--------------------------------------
+
+void
+Session::Body::flushDirtyTables()
+{
+        if (result_cache_ && !dirty_tables_.empty()) {
+                result_cache_->body_->invalidate(dirty_tables_);
+        }
+        discardDirtyTables();
+}
+
+//--------------------------------------
+
+void
+Session::Body::discardDirtyTables()
+{
+        dirty_tables_.clear();
+        dirty_actions_ = false;
+}
+
+//--------------------------------------
+
+int
+Session::Body::callProgressHandler(
+        void *me
+) // static
+{
+        auto body = static_cast<this_t *>(me);
+
+        if (body->deadlinePassed()) {
+                return 1;
+        }
+        return body->progress_handler_ ? body->progress_handler_() : 0;
+}
+
+//--------------------------------------
+
+WRSQL_API const SessionOptions &
+Session::options() const
+{
+        return body_->options_;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::defineFunction(
+        const Function &fn
+) -> this_t &
+{
+        if (!isOpen()) {
+                throw std::logic_error("cannot define function on closed Session");
+        }
+
+        int status = fn.define(body_->db_);
+
+        if (status != SQLITE_OK) {
+                throw Error(this, status);
+        }
+
+        body_->options_.functions.push_back(fn);
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API Transaction
+Session::beginTransaction(
+        std::function<void (Transaction &)> code
+)
+{
+        return Transaction::begin(*this, code);
+}
+
+//--------------------------------------
+
+WRSQL_API Transaction
+Session::beginTransaction(
+        LockingMode                         mode,
+        std::function<void (Transaction &)> code
+)
+{
+        return Transaction::begin(*this, mode, code);
+}
+
+//--------------------------------------
+
+WRSQL_API LockingMode
+Session::lockingMode() const
+{
+        return body_->locking_mode_;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::setLockingMode(
+        LockingMode mode
+) -> this_t &
+{
+        body_->locking_mode_ = mode;
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API const RetryPolicy &
+Session::retryPolicy() const
+{
+        return body_->retry_policy_;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::setRetryPolicy(
+        const RetryPolicy &policy
+) -> this_t &
+{
+        body_->retry_policy_ = policy;
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API TransactionStats
+Session::transactionStats() const
+{
+        return body_->txn_stats_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+Session::resetTransactionStats()
+{
+        body_->txn_stats_ = {};
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Session::enableStatistics(
+        bool enable
+) -> this_t &
+{
+        if (enable) {
+                if (!isOpen()) {
+                        throw std::logic_error("cannot collect statistics for closed Session");
+                } else if (!body_->stats_) {
+                        body_->stats_.reset(new StatsCollector(body_->db_));
+                }
+                body_->stats_->enable();
+        } else if (body_->stats_) {
+                body_->stats_->disable();
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+Session::statisticsEnabled() const
+{
+        return body_->stats_ && body_->stats_->enabled();
+}
+
+//--------------------------------------
+
+WRSQL_API std::vector<StatementStats>
+Session::statistics() const
+{
+        if (!body_->stats_) {
+                return {};
+        }
+        return body_->stats_->snapshot();
+}
+
+//--------------------------------------
+
+WRSQL_API void
+Session::resetStatistics()
+{
+        if (body_->stats_) {
+                body_->stats_->reset();
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API void
+Session::onFinalCommit(
+        CommitAction action
 )
 {
         if (body_->inner_txn_) {
@@ -461,9 +1415,21 @@ Session::Body::waitForUnlock()
         if (result) {
                 std::unique_lock<std::mutex> guard(wait_lock_);
                 while (waiting_) {
-                        unlock_notifier_.wait(guard);
+                        if (deadline_ == Clock::time_point::max()) {
+                                unlock_notifier_.wait(guard);
+                        } else if (unlock_notifier_.wait_until(guard, deadline_)
+                                        == std::cv_status::timeout) {
+                                result = !deadlinePassed();
+                                if (!result) {
+                                        break;
+                                }
+                        }
                 }
+                /* onUnlock() cannot run once the notification is cancelled,
+                   and may itself be waiting for wait_lock_ until then */
+                guard.unlock();
                 sqlite3_unlock_notify(db_, nullptr, nullptr);
+                waiting_ = false;
         } else {
                 waiting_ = false;
         }
@@ -570,24 +1536,80 @@ Session::Body::transactionRolledBack()
 
 //--------------------------------------
 
-static int
-collateAlphaNum(
-        void       * /* context */,
-        int         a_len,
-        const void *a,
-        int         b_len,
-        const void *b
+void
+Session::Body::rollbackAbandoned()
+{
+        static const size_t ROLLBACK = registerStatement("ROLLBACK");
+
+        if (db_ && !sqlite3_get_autocommit(db_)) {
+                me_.exec(ROLLBACK);
+        }
+
+        /* Transaction objects left behind must not affect the next user of
+           the connection, whether or not SQLite had already rolled back */
+        transactionRolledBack();
+        discardDirtyTables();
+}
+
+//--------------------------------------
+
+/*
+ * discard commit actions and invoke rollback actions registered since a
+ * nested transaction began, given the number of each pending at that time;
+ * outer transactions are unaffected
+ */
+void
+Session::Body::transactionRolledBackTo(
+        size_t commit_mark,
+        size_t rollback_mark
 )
 {
-        int           diff = 0;
-        u8string_view a1  (static_cast<const char *>(a),
-                           static_cast<size_t>(a_len)),
-                      b1  (static_cast<const char *>(b),
-                           static_cast<size_t>(b_len));
+        if (commit_actions_.size() > commit_mark) {
+                commit_actions_.resize(commit_mark);
+        }
+
+        while (rollback_actions_.size() > rollback_mark) {
+                rollback_actions_.back()();
+                rollback_actions_.pop_back();
+        }
+}
 
-        auto ia = a1.begin(), ib = b1.begin();
+//--------------------------------------
 
-        while (!diff && (ia < a1.end()) && (ib < b1.end())) {
+void
+Session::Body::statementFinalized(
+        sqlite3_stmt *stmt
+)
+{
+        if (stats_) {
+                stats_->forget(stmt);
+        }
+}
+
+//--------------------------------------
+
+/*
+ * The ALPHANUM collation compares strings by their letters and digits
+ * alone, ignoring case; other characters are skipped, except that where
+ * the letters and digits of both strings are the same, the string with
+ * more characters remaining after its last letter or digit sorts last.
+ *
+ * collateAlphaNumUnicode() is the reference implementation, decoding every
+ * character; collateAlphaNum() handles runs of ASCII characters itself,
+ * passing the remainder of both strings to collateAlphaNumUnicode() at the
+ * first non-ASCII byte in either. As the comparison keeps no state other
+ * than its position in each string, the result is the same either way.
+ */
+static int
+collateAlphaNumUnicode(
+        const u8string_view &a,
+        const u8string_view &b
+)
+{
+        int  diff = 0;
+        auto ia = a.begin(), ib = b.begin();
+
+        while (!diff && (ia < a.end()) && (ib < b.end())) {
                 if (!isualnum(*ia)) {
                         ++ia;
                         if (!isualnum(*ib)) {
@@ -603,8 +1625,8 @@ collateAlphaNum(
         }
 
         if (!diff) {
-                if (ia >= a1.end()) {
-                        if (ib >= b1.end()) {
+                if (ia >= a.end()) {
+                        if (ib >= b.end()) {
                                 return 0;
                         } else {
                                 return -1;
@@ -617,6 +1639,277 @@ collateAlphaNum(
         return diff;
 }
 
+//--------------------------------------
+
+namespace {
+
+/*
+ * upper-case equivalent of each ASCII letter and digit, zero for all other
+ * ASCII characters; agrees with touupper() and isualnum()
+ */
+struct AlphaNumASCII
+{
+        AlphaNumASCII()
+        {
+                for (int c = 0; c < 128; ++c) {
+                        fold[c] = 0;
+                }
+                for (int c = '0'; c <= '9'; ++c) {
+                        fold[c] = static_cast<uint8_t>(c);
+                }
+                for (int c = 'A'; c <= 'Z'; ++c) {
+                        fold[c] = static_cast<uint8_t>(c);
+                        fold[c - 'A' + 'a'] = static_cast<uint8_t>(c);
+                }
+        }
+
+        uint8_t fold[128];
+};
+
+const AlphaNumASCII ALPHANUM_ASCII;
+
+} // anonymous namespace
+
+//--------------------------------------
+
+/*
+ * advance p and q past any identical ASCII text, eight bytes at a time;
+ * identical characters never affect the result of the comparison
+ */
+static void
+skipSameASCII(
+        const uint8_t *&p,
+        const uint8_t  *p_end,
+        const uint8_t *&q,
+        const uint8_t  *q_end
+)
+{
+        while ((p_end - p >= 8) && (q_end - q >= 8)) {
+                uint64_t wp, wq;
+                memcpy(&wp, p, 8);
+                memcpy(&wq, q, 8);
+                if ((wp != wq) || (wp & UINT64_C(0x8080808080808080))) {
+                        break;
+                }
+                p += 8;
+                q += 8;
+        }
+}
+
+//--------------------------------------
+
+static int
+collateAlphaNum(
+        void       * /* context */,
+        int         a_len,
+        const void *a,
+        int         b_len,
+        const void *b
+)
+{
+        auto pa = static_cast<const uint8_t *>(a), a_end = pa + a_len,
+             pb = static_cast<const uint8_t *>(b), b_end = pb + b_len;
+
+        skipSameASCII(pa, a_end, pb, b_end);
+
+        while ((pa < a_end) && (pb < b_end)) {
+                if ((*pa | *pb) & 0x80) {
+                        return collateAlphaNumUnicode(
+                                { reinterpret_cast<const char *>(pa),
+                                  static_cast<size_t>(a_end - pa) },
+                                { reinterpret_cast<const char *>(pb),
+                                  static_cast<size_t>(b_end - pb) });
+                }
+
+                int ua = ALPHANUM_ASCII.fold[*pa],
+                    ub = ALPHANUM_ASCII.fold[*pb];
+
+                if (!ua) {
+                        ++pa;
+                        if (!ub) {
+                                ++pb;
+                        }
+                } else if (!ub) {
+                        ++pb;
+                } else if (ua != ub) {
+                        return ua - ub;
+                } else {
+                        ++pa;
+                        ++pb;
+                        skipSameASCII(pa, a_end, pb, b_end);
+                }
+        }
+
+        if (pa >= a_end) {
+                return (pb >= b_end) ? 0 : -1;
+        } else {
+                return 1;
+        }
+}
+
+//--------------------------------------
+
+/*
+ * append the sort key element for one letter or digit: its upper-case
+ * equivalent plus one, encoded in the manner of UTF-8 so that keys compare
+ * bytewise in the same order as their characters and no element begins
+ * with the zero byte terminating the sequence
+ */
+static void
+appendKeyChar(
+        std::vector<uint8_t> &key,
+        char32_t              c
+)
+{
+        uint32_t v = static_cast<uint32_t>(touupper(c)) + 1;
+
+        if (v < 0x80) {
+                key.push_back(static_cast<uint8_t>(v));
+        } else if (v < 0x800) {
+                key.push_back(static_cast<uint8_t>(0xc0 | (v >> 6)));
+                key.push_back(static_cast<uint8_t>(0x80 | (v & 0x3f)));
+        } else if (v < 0x10000) {
+                key.push_back(static_cast<uint8_t>(0xe0 | (v >> 12)));
+                key.push_back(static_cast<uint8_t>(0x80 | ((v >> 6) & 0x3f)));
+                key.push_back(static_cast<uint8_t>(0x80 | (v & 0x3f)));
+        } else {
+                key.push_back(static_cast<uint8_t>(0xf0 + (v >> 18)));
+                key.push_back(static_cast<uint8_t>(0x80 | ((v >> 12) & 0x3f)));
+                key.push_back(static_cast<uint8_t>(0x80 | ((v >> 6) & 0x3f)));
+                key.push_back(static_cast<uint8_t>(0x80 | (v & 0x3f)));
+        }
+}
+
+//--------------------------------------
+
+/*
+ * implementation of the alphanum_key() SQL function: a BLOB comparing
+ * bytewise as its argument does under the ALPHANUM collation, consisting
+ * of the sequence of letters and digits, a zero terminator and the number
+ * of characters after the last letter or digit (32 bits, big-endian)
+ */
+static optional<std::vector<uint8_t>>
+alphaNumKey(
+        const optional<u8string_view> &text
+)
+{
+        if (!text) {
+                return nullopt;
+        }
+
+        std::vector<uint8_t> key;
+        uint32_t             tail = 0;
+        auto                 p = reinterpret_cast<const uint8_t *>(text->data()),
+                             end = p + text->bytes();
+
+        key.reserve(text->bytes() + 5);
+
+        for (; (p < end) && !(*p & 0x80); ++p) {
+                if (uint8_t c = ALPHANUM_ASCII.fold[*p]) {
+                        key.push_back(c + 1);
+                        tail = 0;
+                } else {
+                        ++tail;
+                }
+        }
+
+        /* SQLite does not validate UTF-8, so a truncated sequence at the
+           end may carry the iterator beyond end() */
+        u8string_view rest(reinterpret_cast<const char *>(p),
+                           static_cast<size_t>(end - p));
+
+        for (auto i = rest.begin(); i < rest.end(); ++i) {
+                char32_t c = *i;
+                if (isualnum(c)) {
+                        appendKeyChar(key, c);
+                        tail = 0;
+                } else {
+                        ++tail;
+                }
+        }
+
+        key.push_back(0);
+
+        for (int shift = 24; shift >= 0; shift -= 8) {
+                key.push_back(static_cast<uint8_t>(tail >> shift));
+        }
+
+        return key;
+}
+
+//--------------------------------------
+
+/*
+ * identify the main database of connection db for ResultCache keys: its
+ * file's full path, or failing that a value never given to any other
+ * connection, since an in-memory or temporary database is private to its
+ * connection (barring shared cache, which merely forgoes sharing results)
+ */
+static std::string
+databaseID(
+        sqlite3 *db
+)
+{
+        static std::atomic<uint64_t> next_private_id(0);
+
+        const char *path = sqlite3_db_filename(db, "main");
+
+        if (path && *path) {
+                return path;
+        }
+
+        uint64_t id = next_private_id++;
+
+        // no file path begins with NUL
+        return std::string(1, '\0')
+               + std::string(reinterpret_cast<const char *>(&id), sizeof(id));
+}
+
+//--------------------------------------
+
+/*
+ * determine whether the connection holds an uncommitted write transaction,
+ * such as that of a writing statement not yet run to completion or reset
+ */
+static bool
+writeInProgress(
+        sqlite3 *db
+)
+{
+#if SQLITE_VERSION_NUMBER >= 3034000
+        return sqlite3_txn_state(db, nullptr) == SQLITE_TXN_WRITE;
+#else
+        for (auto stmt = sqlite3_next_stmt(db, nullptr); stmt;
+                        stmt = sqlite3_next_stmt(db, stmt)) {
+                if (sqlite3_stmt_busy(stmt) && !sqlite3_stmt_readonly(stmt)) {
+                        return true;
+                }
+        }
+        return false;
+#endif
+}
+
+//--------------------------------------
+
+/*
+ * sqlite3 busy handler callback invoking the SessionOptions::BusyHandler
+ * given as its user data
+ */
+static int
+callBusyHandler(
+        void *handler,
+        int   attempts
+)
+{
+        // exceptions must not propagate through SQLite; give up instead
+        try {
+                return (*static_cast<SessionOptions::BusyHandler *>(handler))(
+                                                                attempts);
+        } catch (...) {
+                return 0;
+        }
+}
+
 
 } // namespace sql
 } // namespace wr
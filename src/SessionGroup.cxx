@@ -0,0 +1,462 @@
+/**
+ * \file SessionGroup.cxx
+ *
+ * \brief Implementation of class wr::sql::SessionGroup
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/SessionGroup.h>
+#include <wrsql/Transaction.h>
+
+#include "sqlite3api.h"
+#include "SessionPrivate.h"
+
+
+namespace wr {
+namespace sql {
+
+
+namespace {
+
+
+struct Write
+{
+        SessionGroup::WriteFn code_;
+        std::promise<void>    done_;
+};
+
+
+} // anonymous namespace
+
+//--------------------------------------
+
+struct SessionGroup::Body
+{
+        Body() :
+                max_batch_   (64),
+                commit_delay_(0),
+                running_     (false),
+                stopping_    (false),
+                num_writes_  (0),
+                num_commits_ (0)
+        {
+        }
+
+        void run();
+        void commitBatch(std::vector<Write> &batch);
+
+        Session                   writer_;   ///< used only by worker_
+        SessionPool               readers_;
+        std::thread               worker_;
+        std::deque<Write>         queue_;
+        size_t                    max_batch_;
+        std::chrono::microseconds commit_delay_;
+        bool                      running_,
+                                  stopping_;
+        size_t                    num_writes_,
+                                  num_commits_;
+        mutable std::mutex        lock_;
+        std::condition_variable   ready_;
+};
+
+//--------------------------------------
+
+void
+SessionGroup::Body::run()
+{
+        std::vector<Write> batch;
+
+        for (;;) {
+                {
+                        std::unique_lock<std::mutex> guard(lock_);
+
+                        ready_.wait(guard, [this] {
+                                return stopping_ || !queue_.empty();
+                        });
+
+                        if (queue_.empty()) {  // stopping, queue drained
+                                break;
+                        }
+
+                        if ((commit_delay_.count() > 0)
+                            && (queue_.size() < max_batch_)) {
+                                ready_.wait_for(guard, commit_delay_, [this] {
+                                        return stopping_
+                                               || (queue_.size() >= max_batch_);
+                                });
+                        }
+
+                        size_t n = std::min(queue_.size(), max_batch_);
+
+                        for (; n; --n) {
+                                batch.push_back(std::move(queue_.front()));
+                                queue_.pop_front();
+                        }
+                }
+
+                commitBatch(batch);
+                batch.clear();
+        }
+}
+
+//--------------------------------------
+
+void
+SessionGroup::Body::commitBatch(
+        std::vector<Write> &batch
+)
+{
+        std::vector<std::exception_ptr> errors(batch.size());
+        size_t                          num_run = 0;
+        std::exception_ptr              abort_err;
+
+        try {
+                Transaction::begin(writer_, IMMEDIATE_LOCKING,
+                                   [&](Transaction &txn) {
+                        abort_err = nullptr;  // in case of retry
+
+                        for (size_t i = 0; i < batch.size(); ++i) {
+                                errors[i] = nullptr;
+                                num_run = i + 1;
+                                try {
+                                        Transaction::begin(writer_,
+                                                           [&](Transaction &) {
+                                                batch[i].code_(writer_);
+                                        });
+                                } catch (Busy &) {
+                                        throw;  // retry the whole batch
+                                } catch (...) {
+                                        // only this write is rolled back
+                                        errors[i] = std::current_exception();
+                                }
+
+                                if (!txn.active() || sqlite3_get_autocommit(
+                                                        writer_.body_->db())) {
+                                        /* the write ended the shared
+                                           transaction (e.g. INSERT OR
+                                           ROLLBACK), undoing every write
+                                           in the batch so far */
+                                        abort_err = errors[i];
+                                        if (!abort_err) {
+                                                abort_err = std::make_exception_ptr(
+                                                        std::logic_error("write ended the SessionGroup's shared transaction"));
+                                        }
+                                        std::rethrow_exception(abort_err);
+                                }
+                        }
+                });
+        } catch (...) {
+                auto   err = abort_err ? abort_err : std::current_exception();
+                size_t num_failed = abort_err ? num_run : batch.size();
+
+                for (size_t i = 0; i < num_failed; ++i) {
+                        batch[i].done_.set_exception(err);
+                }
+
+                {
+                        std::lock_guard<std::mutex> guard(lock_);
+                        num_writes_ += num_failed;
+                }
+
+                if (num_failed < batch.size()) {
+                        // writes not yet run are committed in a batch of their own
+                        std::vector<Write> rest(
+                                std::make_move_iterator(batch.begin() + num_failed),
+                                std::make_move_iterator(batch.end()));
+                        commitBatch(rest);
+                }
+                return;
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+                if (errors[i]) {
+                        batch[i].done_.set_exception(errors[i]);
+                } else {
+                        batch[i].done_.set_value();
+                }
+        }
+
+        std::lock_guard<std::mutex> guard(lock_);
+        num_writes_ += batch.size();
+        ++num_commits_;
+}
+
+//--------------------------------------
+
+WRSQL_API SessionGroup::SessionGroup() : body_(new Body) {}
+
+//--------------------------------------
+
+WRSQL_API
+SessionGroup::SessionGroup(
+        const u8string_view &uri,
+        size_t               num_readers,
+        bool                 prepare
+) :
+        this_t()
+{
+        open(uri, num_readers, prepare);
+}
+
+//--------------------------------------
+
+WRSQL_API
+SessionGroup::SessionGroup(
+        const u8string_view  &uri,
+        const SessionOptions &options,
+        size_t                num_readers,
+        bool                  prepare
+) :
+        this_t()
+{
+        open(uri, options, num_readers, prepare);
+}
+
+//--------------------------------------
+
+WRSQL_API
+SessionGroup::~SessionGroup()
+{
+        close();
+        delete body_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionGroup::open(
+        const u8string_view &uri,
+        size_t               num_readers,
+        bool                 prepare
+)
+{
+        open(uri, SessionOptions(), num_readers, prepare);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionGroup::open(
+        const u8string_view  &uri,
+        const SessionOptions &options,
+        size_t                num_readers,
+        bool                  prepare
+)
+{
+        if (!num_readers) {
+                throw std::invalid_argument("SessionGroup must have at least one reader");
+        }
+
+        close();
+
+        SessionOptions writer_options = options,
+                       reader_options = options;
+
+        if (!writer_options.journal_mode) {
+                writer_options.journal_mode = SessionOptions::WAL_JOURNAL;
+        }
+
+        // journal mode is persistent and cannot be changed by a reader
+        reader_options.journal_mode = nullopt;
+        reader_options.read_only = true;
+
+        body_->writer_.open(uri, writer_options);
+
+        try {
+                body_->readers_.open(uri, reader_options, num_readers, prepare);
+        } catch (...) {
+                body_->writer_.close();
+                throw;
+        }
+
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                body_->running_ = true;
+                body_->stopping_ = false;
+                body_->num_writes_ = body_->num_commits_ = 0;
+        }
+
+        body_->worker_ = std::thread(&Body::run, body_);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionGroup::close()
+{
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                if (!body_->running_) {
+                        return;
+                }
+                body_->stopping_ = true;
+        }
+
+        body_->ready_.notify_all();
+        body_->worker_.join();
+
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                body_->running_ = body_->stopping_ = false;
+        }
+
+        body_->readers_.close();
+        body_->writer_.close();
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+SessionGroup::read() -> Lease
+{
+        return body_->readers_.acquire();
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+SessionGroup::tryRead() -> Lease
+{
+        return body_->readers_.tryAcquire();
+}
+
+//--------------------------------------
+
+WRSQL_API std::future<void>
+SessionGroup::write(
+        WriteFn code
+)
+{
+        std::future<void> result;
+
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+
+                if (!body_->running_ || body_->stopping_) {
+                        throw std::logic_error("SessionGroup not open");
+                }
+
+                body_->queue_.push_back({ std::move(code), {} });
+                result = body_->queue_.back().done_.get_future();
+        }
+
+        body_->ready_.notify_one();
+        return result;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionGroup::maxBatchSize() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->max_batch_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionGroup::setMaxBatchSize(
+        size_t size
+)
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        body_->max_batch_ = std::max(size, size_t(1));
+}
+
+//--------------------------------------
+
+WRSQL_API std::chrono::microseconds
+SessionGroup::commitDelay() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->commit_delay_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionGroup::setCommitDelay(
+        std::chrono::microseconds delay
+)
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        body_->commit_delay_ = delay;
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+SessionGroup::isOpen() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->running_ && !body_->stopping_;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionGroup::numReaders() const
+{
+        return body_->readers_.size();
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionGroup::pendingWrites() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->queue_.size();
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionGroup::numWrites() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->num_writes_;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionGroup::numCommits() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->num_commits_;
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,582 @@
+/**
+ * \file SessionPool.cxx
+ *
+ * \brief Implementation of class wr::sql::SessionPool
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdint.h>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/SessionPool.h>
+#include <wrsql/Statement.h>
+
+#include "sqlite3api.h"
+#include "SessionPrivate.h"
+
+
+namespace wr {
+namespace sql {
+
+
+namespace {
+
+
+struct Slot
+{
+        Slot(const u8string_view &uri, const SessionOptions &options) :
+                session_(uri, options), num_stmts_(0), memory_(0),
+                reopen_(false) {}
+
+        Session         session_;
+        std::thread::id last_thread_;
+        size_t          num_stmts_;  ///< registered statements last prepared
+        uint64_t        memory_;     ///< memory used when last returned
+        bool            reopen_;     ///< to be reopened before next lent out
+};
+
+
+} // anonymous namespace
+
+//--------------------------------------
+
+struct SessionPool::Body
+{
+        Body() :
+                prepare_(false), closing_(false), budget_(0), num_trims_(0) {}
+
+        Slot *takeIdle();
+        std::vector<Slot *> pickTrims(Slot *returned);
+
+        std::string                        uri_;
+        SessionOptions                     options_;
+        bool                               prepare_,
+                                           closing_;
+        uint64_t                           budget_;
+        size_t                             num_trims_;
+        std::vector<std::unique_ptr<Slot>> slots_;
+        std::vector<Slot *>                idle_;  ///< most recent last
+        mutable std::mutex                 lock_;
+        std::condition_variable            returned_;
+};
+
+//--------------------------------------
+
+Slot *
+SessionPool::Body::takeIdle()
+{
+        auto me = std::this_thread::get_id();
+        auto i = idle_.rbegin(), found = idle_.rend();
+
+        // prefer the session last used by this thread, then a session not
+        // yet used by any thread, then the most recently returned session
+        for (; i != idle_.rend(); ++i) {
+                if ((*i)->last_thread_ == me) {
+                        found = i;
+                        break;
+                } else if ((found == idle_.rend())
+                           && ((*i)->last_thread_ == std::thread::id())) {
+                        found = i;
+                }
+        }
+
+        if (found == idle_.rend()) {
+                found = idle_.rbegin();
+        }
+
+        Slot *slot = *found;
+        idle_.erase(std::next(found).base());
+        slot->last_thread_ = me;
+        return slot;
+}
+
+//--------------------------------------
+
+/*
+ * with lock_ held: if the pool is over budget, choose sessions to trim,
+ * largest first, from those idle and the one being returned, removing any
+ * chosen from idle_ so that they cannot be lent out while being trimmed
+ */
+std::vector<Slot *>
+SessionPool::Body::pickTrims(
+        Slot *returned
+)
+{
+        std::vector<Slot *> trims;
+        uint64_t            total = 0;
+
+        for (auto &slot: slots_) {
+                total += slot->memory_;
+        }
+
+        if (!budget_ || (total <= budget_)) {
+                return trims;
+        }
+
+        std::vector<Slot *> candidates(idle_);
+        candidates.push_back(returned);
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Slot *a, const Slot *b) {
+                return a->memory_ > b->memory_;
+        });
+
+        for (Slot *slot: candidates) {
+                if ((total <= budget_) || !slot->memory_) {
+                        break;
+                }
+                total -= slot->memory_;
+                trims.push_back(slot);
+                if (slot != returned) {
+                        idle_.erase(std::find(idle_.begin(), idle_.end(),
+                                              slot));
+                }
+        }
+
+        return trims;
+}
+
+//--------------------------------------
+
+WRSQL_API SessionPool::SessionPool() : body_(new Body) {}
+
+//--------------------------------------
+
+WRSQL_API
+SessionPool::SessionPool(
+        const u8string_view &uri,
+        size_t               size,
+        bool                 prepare
+) :
+        this_t()
+{
+        open(uri, size, prepare);
+}
+
+//--------------------------------------
+
+WRSQL_API
+SessionPool::SessionPool(
+        const u8string_view  &uri,
+        const SessionOptions &options,
+        size_t                size,
+        bool                  prepare
+) :
+        this_t()
+{
+        open(uri, options, size, prepare);
+}
+
+//--------------------------------------
+
+WRSQL_API
+SessionPool::~SessionPool()
+{
+        close();
+        delete body_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionPool::open(
+        const u8string_view &uri,
+        size_t               size,
+        bool                 prepare
+)
+{
+        open(uri, SessionOptions(), size, prepare);
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionPool::open(
+        const u8string_view  &uri,
+        const SessionOptions &options,
+        size_t                size,
+        bool                  prepare
+)
+{
+        if (!size) {
+                throw std::invalid_argument("SessionPool size must be nonzero");
+        }
+
+        std::vector<std::unique_ptr<Slot>> slots;
+        slots.reserve(size);
+
+        for (size_t i = 0; i < size; ++i) {
+                slots.emplace_back(new Slot(uri, options));
+                if (prepare) {
+                        auto &slot = *slots.back();
+                        auto  num_stmts = numRegisteredStatements();
+                        slot.session_.prepareRegisteredStatements();
+                        slot.num_stmts_ = num_stmts;
+                }
+        }
+
+        close();
+
+        std::lock_guard<std::mutex> guard(body_->lock_);
+
+        for (auto &slot: slots) {
+                body_->idle_.push_back(slot.get());
+        }
+
+        body_->slots_ = std::move(slots);
+        body_->uri_ = uri.to_string();
+        body_->options_ = options;
+        body_->prepare_ = prepare;
+        body_->closing_ = false;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionPool::close()
+{
+        std::unique_lock<std::mutex> guard(body_->lock_);
+
+        body_->closing_ = true;
+        body_->returned_.notify_all();  // wake up waiting acquire() calls
+
+        while (body_->idle_.size() < body_->slots_.size()) {
+                body_->returned_.wait(guard);
+        }
+
+        body_->idle_.clear();
+        body_->slots_.clear();
+        body_->uri_.clear();
+        body_->options_ = {};
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+SessionPool::acquire() -> Lease
+{
+        return acquire_(true);
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+SessionPool::tryAcquire() -> Lease
+{
+        return acquire_(false);
+}
+
+//--------------------------------------
+
+auto
+SessionPool::acquire_(
+        bool wait
+) -> Lease
+{
+        Slot          *slot;
+        bool           prepare;
+        std::string    uri;
+        SessionOptions options;
+
+        {
+                std::unique_lock<std::mutex> guard(body_->lock_);
+
+                for (;;) {
+                        if (body_->closing_ || body_->slots_.empty()) {
+                                throw std::logic_error("SessionPool not open");
+                        } else if (!body_->idle_.empty()) {
+                                break;
+                        } else if (!wait) {
+                                return {};
+                        }
+                        body_->returned_.wait(guard);
+                }
+
+                slot = body_->takeIdle();
+                prepare = body_->prepare_;
+                if (slot->reopen_) {
+                        uri = body_->uri_;
+                        options = body_->options_;
+                }
+        }
+
+        // if reopening or preparing fails, the Lease returns the slot
+        Lease lease(this, slot);
+
+        if (slot->reopen_) {
+                if (slot->session_.isOpen()) {
+                        slot->session_.close();
+                }
+                slot->session_.open(uri, options);
+                slot->num_stmts_ = 0;
+                slot->reopen_ = false;
+        }
+
+        if (prepare) {
+                auto num_stmts = numRegisteredStatements();
+                if (slot->num_stmts_ < num_stmts) {
+                        slot->session_.prepareRegisteredStatements();
+                        slot->num_stmts_ = num_stmts;
+                }
+        }
+
+        return lease;
+}
+
+//--------------------------------------
+
+void
+SessionPool::giveBack(
+        void *slot
+)
+{
+        auto s = static_cast<Slot *>(slot);
+
+        // restore the state in which the session was first lent out
+        s->session_.clearDeadline();
+        s->session_.setProgressHandler({});
+        s->session_.resetRegisteredStatements();
+
+        try {
+                s->session_.body_->rollbackAbandoned();
+        } catch (...) {
+                /* cannot lend out a connection stuck in a transaction; close
+                   it now if possible, releasing its locks, and reopen it when
+                   next acquired, as this is called from ~Lease() and so must
+                   not throw */
+                try {
+                        s->session_.close();
+                } catch (...) {
+                        // still open; closed again before reopening
+                }
+                s->reopen_ = true;
+        }
+
+        if (!s->session_.isOpen()) {  // closed by the borrower
+                s->reopen_ = true;
+        }
+
+        auto memory = s->session_.memoryStats().memoryUsed();
+
+        std::vector<Slot *> trims;
+
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                s->memory_ = memory;
+                trims = body_->pickTrims(s);
+                if (trims.empty()) {
+                        body_->idle_.push_back(s);
+                        body_->returned_.notify_all();
+                        return;
+                }
+        }
+
+        // trimmed sessions are cold, so are lent out after all others
+        for (Slot *trim: trims) {
+                trim->session_.releaseMemory();
+                trim->num_stmts_ = 0;
+                memory = trim->session_.memoryStats().memoryUsed();
+
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                trim->memory_ = memory;
+                trim->last_thread_ = {};
+                body_->idle_.insert(body_->idle_.begin(), trim);
+                ++body_->num_trims_;
+                body_->returned_.notify_all();
+        }
+
+        if (std::find(trims.begin(), trims.end(), s) == trims.end()) {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                body_->idle_.push_back(s);
+                body_->returned_.notify_all();
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionPool::prepareRegisteredStatements()
+{
+        std::vector<Slot *> idle;
+
+        {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                idle.swap(body_->idle_);
+        }
+
+        auto num_stmts = numRegisteredStatements();
+
+        try {
+                for (Slot *slot: idle) {
+                        slot->session_.prepareRegisteredStatements();
+                        slot->num_stmts_ = num_stmts;
+                }
+        } catch (...) {
+                std::lock_guard<std::mutex> guard(body_->lock_);
+                body_->idle_.insert(body_->idle_.begin(),
+                                    idle.begin(), idle.end());
+                body_->returned_.notify_all();
+                throw;
+        }
+
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        body_->idle_.insert(body_->idle_.begin(), idle.begin(), idle.end());
+        body_->returned_.notify_all();
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+SessionPool::isOpen() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return !body_->slots_.empty();
+}
+
+//--------------------------------------
+
+WRSQL_API u8string_view
+SessionPool::uri() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->uri_;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionPool::size() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->slots_.size();
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionPool::available() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->idle_.size();
+}
+
+//--------------------------------------
+
+WRSQL_API uint64_t
+SessionPool::memoryBudget() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->budget_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionPool::setMemoryBudget(
+        uint64_t bytes
+)
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        body_->budget_ = bytes;
+}
+
+//--------------------------------------
+
+WRSQL_API uint64_t
+SessionPool::memoryUsed() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        uint64_t                    total = 0;
+
+        for (auto &slot: body_->slots_) {
+                total += slot->memory_;
+        }
+
+        return total;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+SessionPool::numTrims() const
+{
+        std::lock_guard<std::mutex> guard(body_->lock_);
+        return body_->num_trims_;
+}
+
+//--------------------------------------
+
+WRSQL_API
+SessionPool::Lease::Lease(
+        this_t &&other
+) :
+        pool_(other.pool_),
+        slot_(other.slot_)
+{
+        other.pool_ = nullptr;
+        other.slot_ = nullptr;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+SessionPool::Lease::operator=(
+        this_t &&other
+) -> this_t &
+{
+        if (&other != this) {
+                release();
+                std::swap(pool_, other.pool_);
+                std::swap(slot_, other.slot_);
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API Session *
+SessionPool::Lease::get() const
+{
+        return slot_ ? &static_cast<Slot *>(slot_)->session_ : nullptr;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+SessionPool::Lease::release()
+{
+        if (slot_) {
+                pool_->giveBack(slot_);
+                pool_ = nullptr;
+                slot_ = nullptr;
+        }
+}
+
+
+} // namespace sql
+} // namespace wr
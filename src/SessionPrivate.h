@@ -43,9 +43,12 @@ namespace wr {
 namespace sql {
 
 
+class StatsCollector;
 class Transaction;
+struct TableRefs;
 
-using RegisteredStmts = std::vector<Statement::Ptr>;
+using StmtInstances   = std::vector<Statement::Ptr>;
+using RegisteredStmts = std::vector<StmtInstances>;  // indexed by statement ID
 using CommitActions   = std::list<Session::CommitAction>;
 using RollbackActions = std::list<Session::RollbackAction>;
 
@@ -56,12 +59,37 @@ class Session::Body
 public:
         using this_t = Body;
 
+        enum { MAX_STMT_INSTANCES = 4 };  /* compiled instances cached for
+                                             each registered statement */
+
         Body(Session &me);
         ~Body();
 
         sqlite3 *db() const { return db_; }
 
         static int callProgressHandler(void *me);
+        void updateProgressHandler();  // (un)install as deadline/handler need
+
+        bool deadlinePassed() const
+                { return (deadline_ != Clock::time_point::max())
+                                && (Clock::now() >= deadline_); }
+
+        // result cache support
+        void updateCacheHooks();  // (un)install authorizer and update hook
+        static int authorize(void *me, int action, const char *arg1,
+                             const char *arg2, const char *db_name,
+                             const char *trigger);
+        static void onUpdate(void *me, int op, const char *db_name,
+                             const char *table, sqlite3_int64 rowid);
+
+        bool hasDirtyTables() const { return !dirty_tables_.empty(); }
+        bool isDirty(const TableRefs &tables) const;  // reads dirty tables
+        void markDirty(const char *table);
+        void markDirty(const TableRefs &tables);  // tables' writes only
+        void dirtyTablesCommitted();  /* invalidate if changes were
+                                         committed outside a Transaction */
+        void flushDirtyTables();      // invalidate, then forget
+        void discardDirtyTables();    // forget only
 
         bool waitForUnlock();
         static void onUnlock(void **blocked, int num_blocked);
@@ -74,22 +102,48 @@ public:
 
         void transactionCommitted();
         void transactionRolledBack();
+        void transactionRolledBackTo(size_t commit_mark, size_t rollback_mark);
+                                        // nested transaction rolled back
+        void rollbackAbandoned();  /* roll back any transaction left open,
+                                      e.g. by a SessionPool borrower */
+
+        void statementFinalized(sqlite3_stmt *stmt);
 
 private:
         friend Session;
+        friend Statement;
+        friend Transaction;
 
         Session                 &me_;
         sqlite3                 *db_;
         int                      flags_;
         std::string              uri_;
+        SessionOptions           options_;
         Transaction             *inner_txn_;
         mutable RegisteredStmts  statements_;
         std::condition_variable  unlock_notifier_;
         std::mutex               wait_lock_;
         std::atomic<bool>        waiting_;
         ProgressHandler          progress_handler_;
+        unsigned                 progress_interval_;
+        Clock::time_point        deadline_;
+        ResultCache::Ptr         result_cache_;
+        std::string              database_id_;   /* main database file path,
+                                                    or unique to connection
+                                                    if in memory */
+        TableRefs               *table_refs_;    /* gathers tables referenced
+                                                    by statement being
+                                                    compiled */
+        std::vector<std::string> dirty_tables_;  /* tables with uncommitted
+                                                    changes, lower case */
+        bool                     dirty_actions_; /* commit/rollback actions
+                                                    queued for them */
         CommitActions            commit_actions_;
         RollbackActions          rollback_actions_;
+        LockingMode              locking_mode_;
+        RetryPolicy              retry_policy_;
+        TransactionStats         txn_stats_;
+        std::unique_ptr<StatsCollector> stats_;  // null until first enabled
 };
 
 
@@ -25,11 +25,14 @@
  */
 #include <wrsql/Config.h>
 #include <stdint.h>
+#include <ctype.h>
 #include <limits.h>
 #include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <limits>
-#include <map>
 #include <mutex>
 #include <stdexcept>
 #include <string>
@@ -44,12 +47,14 @@
 #include <wrutil/u8string_view.h>
 #include <wrutil/string_view.h>
 
+#include <wrsql/ColumnBatch.h>
 #include <wrsql/Error.h>
 #include <wrsql/Session.h>
 #include <wrsql/Statement.h>
 
 #include "sqlite3api.h"
 #include "SessionPrivate.h"
+#include "StatementPrivate.h"
 
 
 namespace wr {
@@ -59,17 +64,53 @@ namespace sql {
 namespace {
 
 
+/*
+ * Registered statements are only ever appended, and an entry never changes
+ * once published, so lookups by ID need no lock: entries are stored in
+ * fixed-size chunks which are never reallocated, and a reader only accesses
+ * entries whose IDs are below the published count. Writers serialise on
+ * the mutex, which also guards the SQL-to-ID map.
+ */
 struct RegistrationData
 {
         using Statements = std::unordered_map<std::string, size_t, CityHash>;
+        using Entry = const std::string *;  // key of stmts_by_sql element
+
+        enum: size_t
+        {
+                CHUNK_BITS = 8,
+                CHUNK_SIZE = size_t(1) << CHUNK_BITS,
+                MAX_CHUNKS = 4096   // permits over a million statements
+        };
+
+        RegistrationData() : count(0) {}
+        ~RegistrationData();
+
+        const std::string &entry(size_t id) const
+        {
+                auto chunk = chunks[id >> CHUNK_BITS].load(
+                                                std::memory_order_relaxed);
+                        // ordered by count's acquire load in the caller
+                return *chunk[id & (CHUNK_SIZE - 1)];
+        }
 
-        Statements                        stmts_by_sql;
-        std::vector<Statements::iterator> stmts_by_index;
-        std::mutex                        lock;
+        Statements           stmts_by_sql;
+        std::atomic<Entry *> chunks[MAX_CHUNKS] = {};
+        std::atomic<size_t>  count;
+        std::mutex           lock;
 };
 
 //--------------------------------------
 
+RegistrationData::~RegistrationData()
+{
+        for (auto &chunk: chunks) {
+                delete[] chunk.load(std::memory_order_relaxed);
+        }
+}
+
+//--------------------------------------
+
 static RegistrationData &
 registrationData()
 {
@@ -77,6 +118,56 @@ registrationData()
         return data;
 }
 
+//--------------------------------------
+
+/*
+ * Registered scripts are looked up far less often than statements, so a
+ * plain mutex suffices; std::deque never moves its elements when appended
+ * to, so a reference to a script's statement IDs stays valid once returned.
+ */
+struct ScriptRegistrationData
+{
+        std::unordered_map<std::string, size_t, CityHash> scripts_by_sql;
+        std::deque<std::vector<size_t>>                   scripts;
+        std::mutex                                        lock;
+};
+
+//--------------------------------------
+
+static ScriptRegistrationData &
+scriptRegistrationData()
+{
+        static ScriptRegistrationData data;
+        return data;
+}
+
+//--------------------------------------
+
+/*
+ * skip whitespace and comments from the start of [p, end)
+ */
+static const char *
+skipSpaceAndComments(
+        const char *p,
+        const char *end
+)
+{
+        for (;;) {
+                while ((p != end) && isspace(static_cast<unsigned char>(*p))) {
+                        ++p;
+                }
+                if ((end - p >= 2) && (p[0] == '-') && (p[1] == '-')) {
+                        p = std::find(p, end, '\n');
+                } else if ((end - p >= 2) && (p[0] == '/') && (p[1] == '*')) {
+                        static const char CLOSE[] = "*/";
+                        p = std::search(p + 2, end, CLOSE, CLOSE + 2);
+                        p = (p == end) ? end : p + 2;
+                } else {
+                        return p;
+                }
+        }
+}
+
 
 } // anonymous namespace
 
@@ -87,18 +178,35 @@ registerStatement(
         const u8string_view &sql
 )
 {
+        using Entry = RegistrationData::Entry;
+
         auto &regdata = registrationData();
         std::string sql_copy = sql.to_string();
         std::lock_guard<std::mutex> guard(regdata.lock);
-        auto id  = regdata.stmts_by_index.size();
+        auto id  = regdata.count.load(std::memory_order_relaxed);
         auto ins = regdata.stmts_by_sql.insert({ std::move(sql_copy), id });
 
-        if (ins.second) {
-                regdata.stmts_by_index.push_back(ins.first);
-        } else {
-                id = ins.first->second;
+        if (!ins.second) {
+                return ins.first->second;
+        } else if (id >= RegistrationData::MAX_CHUNKS
+                                * RegistrationData::CHUNK_SIZE) {
+                regdata.stmts_by_sql.erase(ins.first);
+                throw std::length_error("too many registered statements");
         }
 
+        auto   &chunk   = regdata.chunks[id >> RegistrationData::CHUNK_BITS];
+        Entry  *entries = chunk.load(std::memory_order_relaxed);
+
+        if (!entries) try {
+                entries = new Entry[RegistrationData::CHUNK_SIZE];
+                chunk.store(entries, std::memory_order_relaxed);
+        } catch (...) {
+                regdata.stmts_by_sql.erase(ins.first);
+                throw;
+        }
+
+        entries[id & (RegistrationData::CHUNK_SIZE - 1)] = &ins.first->first;
+        regdata.count.store(id + 1, std::memory_order_release);  // publish
         return id;
 }
 
@@ -107,9 +215,7 @@ registerStatement(
 WRSQL_API size_t
 numRegisteredStatements()
 {
-        auto                        &regdata = registrationData();
-        std::lock_guard<std::mutex>  guard  (regdata.lock);
-        return regdata.stmts_by_index.size();
+        return registrationData().count.load(std::memory_order_acquire);
 }
 
 //--------------------------------------
@@ -119,17 +225,174 @@ registeredStatement(
         size_t id
 )
 {
-        auto                        &regdata = registrationData();
-        std::lock_guard<std::mutex>  guard  (regdata.lock);
-        u8string_view                sql;
+        auto &regdata = registrationData();
 
-        if (id < regdata.stmts_by_index.size()) {
-                sql = regdata.stmts_by_index[id]->first;
-        } else {
+        if (id >= regdata.count.load(std::memory_order_acquire)) {
+                throw std::invalid_argument("index out of bounds");
+        }
+
+        return regdata.entry(id);
+}
+
+//--------------------------------------
+
+size_t
+findRegisteredStatement(
+        const u8string_view &sql
+)
+{
+        auto &regdata = registrationData();
+        std::lock_guard<std::mutex> guard(regdata.lock);
+        auto i = regdata.stmts_by_sql.find(sql.to_string());
+
+        return (i != regdata.stmts_by_sql.end()) ? i->second : ~size_t(0);
+}
+
+//--------------------------------------
+
+std::vector<std::string>
+splitScript(
+        const u8string_view &sql
+)
+{
+        std::vector<std::string> stmts;
+        std::string              text = sql.to_string(), stmt;
+        size_t                   start = 0;
+
+        auto add = [&](size_t pos, size_t len) {
+                const char *p = text.data() + pos, *end = p + len;
+                const char *first = skipSpaceAndComments(p, end);
+
+                if ((first != end) && (*first != ';')) {
+                        stmts.emplace_back(first, end);
+                }
+        };
+
+        for (size_t pos = text.find(';'); pos != text.npos;
+             pos = text.find(';', pos + 1)) {
+                stmt.assign(text, start, pos + 1 - start);
+                if (sqlite3_complete(stmt.c_str())) {
+                        add(start, pos + 1 - start);
+                        start = pos + 1;
+                }
+        }
+
+        add(start, text.size() - start);  // final statement may omit ';'
+        return stmts;
+}
+
+//--------------------------------------
+
+std::string
+TableRefs::key(
+        const char *table
+) // static
+{
+        std::string key(table);
+
+        for (auto &c: key) {
+                if ((c >= 'A') && (c <= 'Z')) {
+                        c += 'a' - 'A';
+                }
+        }
+
+        return key;
+}
+
+//--------------------------------------
+
+void
+TableRefs::add(
+        std::vector<std::string> &tables,
+        const char               *table
+) // static
+{
+        std::string name = key(table);
+
+        if (std::find(tables.begin(), tables.end(), name) == tables.end()) {
+                tables.push_back(std::move(name));
+        }
+}
+
+//--------------------------------------
+
+bool
+TableRefs::readsAny(
+        const std::vector<std::string> &tables
+) const
+{
+        for (auto &table: tables) {
+                if (std::find(reads.begin(), reads.end(), table)
+                                != reads.end()) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+registerScript(
+        const u8string_view &sql
+)
+{
+        auto &regdata = scriptRegistrationData();
+
+        {
+                std::lock_guard<std::mutex> guard(regdata.lock);
+                auto i = regdata.scripts_by_sql.find(sql.to_string());
+                if (i != regdata.scripts_by_sql.end()) {
+                        return i->second;
+                }
+        }
+
+        // split and register the statements before taking the lock again
+        std::vector<size_t> stmt_ids;
+
+        for (const auto &stmt: splitScript(sql)) {
+                stmt_ids.push_back(registerStatement(stmt));
+        }
+
+        std::lock_guard<std::mutex> guard(regdata.lock);
+        auto ins = regdata.scripts_by_sql.insert({ sql.to_string(),
+                                                   regdata.scripts.size() });
+
+        if (ins.second) try {
+                regdata.scripts.push_back(std::move(stmt_ids));
+        } catch (...) {
+                regdata.scripts_by_sql.erase(ins.first);
+                throw;
+        }
+
+        return ins.first->second;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+numRegisteredScripts()
+{
+        auto &regdata = scriptRegistrationData();
+        std::lock_guard<std::mutex> guard(regdata.lock);
+        return regdata.scripts.size();
+}
+
+//--------------------------------------
+
+WRSQL_API const std::vector<size_t> &
+registeredScript(
+        size_t id
+)
+{
+        auto &regdata = scriptRegistrationData();
+        std::lock_guard<std::mutex> guard(regdata.lock);
+
+        if (id >= regdata.scripts.size()) {
                 throw std::invalid_argument("index out of bounds");
         }
 
-        return sql;
+        return regdata.scripts[id];
 }
 
 //--------------------------------------
@@ -137,7 +400,8 @@ registeredStatement(
 WRSQL_API
 Statement::Statement() :
         stmt_   (nullptr),
-        session_(nullptr)
+        session_(nullptr),
+        body_   (nullptr)
 {
 }
 
@@ -196,6 +460,18 @@ WRSQL_API
 Statement::~Statement()
 {
         finalize();
+        delete body_;
+}
+
+//--------------------------------------
+
+auto
+Statement::body() -> Body &
+{
+        if (!body_) {
+                body_ = new Body;
+        }
+        return *body_;
 }
 
 //--------------------------------------
@@ -222,19 +498,30 @@ Statement::prepare(
         finalize();
         session_ = &session;
 
-        int status;
+        int                        status;
+        std::shared_ptr<TableRefs> tables;
 
         do {
                 sqlite3_stmt *stmt;
                 const char   *end;
 
+                if (session.body_->result_cache_) {
+                        // gathered by Session::Body::authorize()
+                        tables = std::make_shared<TableRefs>();
+                        session.body_->table_refs_ = tables.get();
+                }
                 status = sqlite3_prepare_v2(session.body_->db(),
                                             sql.char_data(),
                                             numeric_cast<int>(sql.bytes()),
                                             &stmt, &end);
+                session.body_->table_refs_ = nullptr;
+
                 switch (status) {
                 case SQLITE_OK:
                         stmt_ = stmt;
+                        if (tables) {
+                                body().tables_ = std::move(tables);
+                        }
                         tail = u8string_view(end,
                                 sql.bytes() - numeric_cast<size_t>(
                                                         end - sql.char_data())).
@@ -243,6 +530,8 @@ Statement::prepare(
                 case SQLITE_LOCKED:
                         if (session_->body_->waitForUnlock()) {
                                 break;
+                        } else if (session_->body_->deadlinePassed()) {
+                                throw Interrupt();
                         }
                         // possible deadlock, fall through
                 case SQLITE_BUSY:
@@ -263,9 +552,16 @@ Statement::finalize()
         if (isPrepared()) {
                 reset();
                 sqlite3_finalize(static_cast<sqlite3_stmt *>(stmt_));
+                session_->body_->statementFinalized(
+                                static_cast<sqlite3_stmt *>(stmt_));
                 stmt_ = nullptr;
                 stmt_.tag(false);
         }
+        if (body_) {
+                body_->clearColumns();
+                body_->releaseParams();
+                body_->tables_.reset();
+        }
         session_ = nullptr;
 }
 
@@ -282,11 +578,56 @@ Statement::sql() const
 
 //--------------------------------------
 
+WRSQL_API int
+Statement::numParams() const
+{
+        return isPrepared() ? sqlite3_bind_parameter_count(
+                                        static_cast<sqlite3_stmt *>(stmt_))
+                            : 0;
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+Statement::isReadOnly() const
+{
+        return !isPrepared()
+               || sqlite3_stmt_readonly(static_cast<sqlite3_stmt *>(stmt_));
+}
+
+//--------------------------------------
+
+WRSQL_API int
+Statement::paramNo(
+        const u8string_view &name
+) const
+{
+        return isPrepared() ? sqlite3_bind_parameter_index(
+                                        static_cast<sqlite3_stmt *>(stmt_),
+                                        name.to_string().c_str())
+                            : 0;
+}
+
+//--------------------------------------
+
+WRSQL_API int
+Statement::numCols() const
+{
+        return isPrepared() ? sqlite3_column_count(
+                                        static_cast<sqlite3_stmt *>(stmt_))
+                            : 0;
+}
+
+//--------------------------------------
+
 WRSQL_API auto
 Statement::reset() -> this_t &
 {
         if (isPrepared()) {
                 sqlite3_reset(static_cast<sqlite3_stmt *>(stmt_));
+                if (session_->body_->hasDirtyTables()) {
+                        session_->body_->dirtyTablesCommitted();
+                }
         }
         stmt_.tag(false);
         return *this;
@@ -302,6 +643,10 @@ Statement::clearBindings() -> this_t &
         }
 
         sqlite3_clear_bindings(static_cast<sqlite3_stmt *>(stmt_));
+
+        if (body_) {
+                body_->releaseParams();
+        }
         return *this;
 }
 
@@ -318,9 +663,7 @@ Statement::bindNull(
 
         auto status = sqlite3_bind_null(static_cast<sqlite3_stmt *>(stmt_),
                                         param_no);
-        if (status != SQLITE_OK) {
-                throwBindError(param_no, status);
-        }
+        checkBind(param_no, status);
         return *this;
 }
 
@@ -393,9 +736,7 @@ Statement::bind(
 
         auto status = sqlite3_bind_int(static_cast<sqlite3_stmt *>(stmt_),
                                        param_no, val);
-        if (status != SQLITE_OK) {
-                throwBindError(param_no, status);
-        }
+        checkBind(param_no, status);
 
         return *this;
 }
@@ -451,9 +792,7 @@ Statement::bind(
 
         auto status = sqlite3_bind_int64(static_cast<sqlite3_stmt *>(stmt_),
                                          param_no, val);
-        if (status != SQLITE_OK) {
-                throwBindError(param_no, status);
-        }
+        checkBind(param_no, status);
         return *this;
 }
 
@@ -493,9 +832,7 @@ Statement::bind(
 
         auto status = sqlite3_bind_double(static_cast<sqlite3_stmt *>(stmt_),
                                           param_no, val);
-        if (status != SQLITE_OK) {
-                throwBindError(param_no, status);
-        }
+        checkBind(param_no, status);
         return *this;
 }
 
@@ -514,83 +851,184 @@ Statement::bind(
         auto status = sqlite3_bind_text64(static_cast<sqlite3_stmt *>(stmt_),
                                           param_no, text, strlen(text),
                                           SQLITE_STATIC, SQLITE_UTF8);
-        if (status != SQLITE_OK) {
-                throwBindError(param_no, status);
-        }
+        checkBind(param_no, status);
         return *this;
 }
 
 //--------------------------------------
 
-static std::map<const void *, Statement::FreeBlobFn> blob_free_fn_map;
-std::mutex                                           blob_free_fn_map_mutex;
+WRSQL_API auto
+Statement::bind(
+        int         param_no,
+        const void *data,
+        size_t      bytes,
+        FreeBlobFn  free_blob
+) -> this_t &
+{
+        if (!data) {
+                return bindNull(param_no);
+        } else if (free_blob) {
+                ParamData owned;
+                owned.data = const_cast<void *>(data);
+                owned.bytes = bytes;
+                owned.free_blob = std::move(free_blob);
+                return bindOwned(param_no, std::move(owned), false);
+        }
+
+        if (isActive()) {
+                reset();
+        }
+
+        auto status = sqlite3_bind_blob64(static_cast<sqlite3_stmt *>(stmt_),
+                                          param_no, data, bytes,
+                                          SQLITE_STATIC);
+        checkBind(param_no, status);
+        return *this;
+}
 
 //--------------------------------------
 
-static void
-freeBlob(
-        void *data
-)
+WRSQL_API auto
+Statement::bind(
+        int             param_no,
+        std::string &&text
+) -> this_t &
 {
-        std::unique_lock<std::mutex> lock(blob_free_fn_map_mutex);
-
-        auto i = blob_free_fn_map.find(data);
+        if (text.size() < ParamData::MIN_MOVE_BYTES) {
+                if (isActive()) {
+                        reset();
+                }
 
-        if (i != blob_free_fn_map.end()) {
-                i->second(data);
-                blob_free_fn_map.erase(i);
+                auto status = sqlite3_bind_text64(
+                                    static_cast<sqlite3_stmt *>(stmt_),
+                                    param_no, text.data(), text.size(),
+                                    SQLITE_TRANSIENT, SQLITE_UTF8);
+                checkBind(param_no, status);
+                return *this;
         }
+
+        ParamData owned;
+        owned.bytes = text.size();
+        owned.text = std::move(text);
+        return bindOwned(param_no, std::move(owned), true);
 }
 
 //--------------------------------------
 
 WRSQL_API auto
 Statement::bind(
-        int         param_no,
-        const void *data,
-        size_t      bytes,
-        FreeBlobFn  free_blob
+        int                     param_no,
+        std::vector<uint8_t> &&blob
 ) -> this_t &
 {
-        if (!data) {
-                bindNull(param_no);
-        } else {
+        if (blob.size() < ParamData::MIN_MOVE_BYTES) {
                 if (isActive()) {
                         reset();
                 }
 
-                int status;
+                auto status = sqlite3_bind_blob64(
+                                    static_cast<sqlite3_stmt *>(stmt_),
+                                    param_no, blob.empty() ? static_cast<const void *>("")
+                                                   : blob.data(),
+                                    blob.size(), SQLITE_TRANSIENT);
+                checkBind(param_no, status);
+                return *this;
+        }
 
-                if (free_blob) {
-                        bool ok;
+        ParamData owned;
+        owned.bytes = blob.size();
+        owned.blob = std::move(blob);
+        return bindOwned(param_no, std::move(owned), false);
+}
 
-                        {
-                                std::unique_lock<std::mutex> lock(
-                                                        blob_free_fn_map_mutex);
-                                ok = blob_free_fn_map.
-                                            insert({ data, free_blob }).second;
-                        }
+//--------------------------------------
 
-                        if (!ok) {
-                                throw Error(printStr("bind(%d): destructor already registered for blob %p",
-                                                     param_no, data));
-                        }
+WRSQL_API auto
+Statement::bindZeroBlob(
+        int    param_no,
+        size_t bytes
+) -> this_t &
+{
+        if (isActive()) {
+                reset();
+        }
 
-                        status = sqlite3_bind_blob64(
-                                            static_cast<sqlite3_stmt *>(stmt_),
-                                            param_no, data, bytes, &freeBlob);
+        auto status = sqlite3_bind_zeroblob64(
+                                static_cast<sqlite3_stmt *>(stmt_), param_no,
+                                bytes);
+        checkBind(param_no, status);
+        return *this;
+}
+
+//--------------------------------------
+
+/*
+ * bind data held by a ParamData object as SQLITE_STATIC, keeping the object
+ * in the parameter's slot until SQLite next lets go of the parameter
+ */
+auto
+Statement::bindOwned(
+        int         param_no,
+        ParamData &&owned,
+        bool        is_text
+) -> this_t &
+{
+        if (isActive()) {
+                reset();
+        }
+
+        if (param_no < 1) {  // SQLite would reject it anyway
+                owned.release();
+                throwBindError(param_no, SQLITE_RANGE);
+        }
+
+        auto      &slot = body().param(param_no);
+        ParamData  old  = std::move(slot);  // in use by SQLite until rebound
+        int        status;
+
+        slot = std::move(owned);
+
+        if (is_text) {
+                status = sqlite3_bind_text64(
+                                static_cast<sqlite3_stmt *>(stmt_), param_no,
+                                static_cast<const char *>(slot.ptr()),
+                                slot.bytes, SQLITE_STATIC, SQLITE_UTF8);
+        } else {
+                status = sqlite3_bind_blob64(
+                                static_cast<sqlite3_stmt *>(stmt_), param_no,
+                                slot.ptr(), slot.bytes, SQLITE_STATIC);
+        }
+
+        if (status != SQLITE_OK) {
+                if (status == SQLITE_MISUSE) {
+                        std::swap(slot, old);  // previous binding still held
                 } else {
-                        status = sqlite3_bind_blob64(
-                                            static_cast<sqlite3_stmt *>(stmt_),
-                                            param_no, data, bytes,
-                                            SQLITE_STATIC);
+                        slot.release();
                 }
+                throwBindError(param_no, status);
+        }
 
-                if (status != SQLITE_OK) {
-                        throwBindError(param_no, status);
-                }
+        return *this;  // previous binding's data released with old
+}
+
+//--------------------------------------
+
+/*
+ * release any data owned for the previous binding of param_no, which
+ * SQLite has just replaced, then throw if the new binding failed
+ */
+void
+Statement::checkBind(
+        int param_no,
+        int status
+)
+{
+        if (body_ && (status != SQLITE_MISUSE)) {
+                body_->releaseParam(param_no);
+        }
+        if (status != SQLITE_OK) {
+                throwBindError(param_no, status);
         }
-        return *this;
 }
 
 //--------------------------------------
@@ -609,9 +1047,7 @@ Statement::bind(
                                           param_no, text.char_data(),
                                           text.bytes(), SQLITE_STATIC,
                                           SQLITE_UTF8);
-        if (status != SQLITE_OK) {
-                throwBindError(param_no, status);
-        }
+        checkBind(param_no, status);
         return *this;
 }
 
@@ -641,9 +1077,7 @@ Statement::bind(
         auto status = sqlite3_bind_text64(static_cast<sqlite3_stmt *>(stmt_),
                                           param_no, text.data(), text.size(),
                                           SQLITE_TRANSIENT, SQLITE_UTF8);
-        if (status != SQLITE_OK) {
-                throwBindError(param_no, status);
-        }
+        checkBind(param_no, status);
         return *this;
 }
 
@@ -710,6 +1144,22 @@ Statement::throwBindError(
 
 //--------------------------------------
 
+WRSQL_API void
+Statement::checkNumCols(
+        int expected
+) const
+{
+        int num_cols = sqlite3_column_count(static_cast<sqlite3_stmt *>(stmt_));
+
+        if (num_cols < expected) {
+                throw std::invalid_argument(
+                        printStr("statement returns %d columns, %d expected (SQL: %s)",
+                                 num_cols, expected, sql()));
+        }
+}
+
+//--------------------------------------
+
 WRSQL_API auto
 Statement::begin() -> Row
 {
@@ -718,6 +1168,9 @@ Statement::begin() -> Row
         } else if (isActive()) {
                 reset();
         }
+        if (body_ && body_->tables_ && !body_->tables_->writes.empty()) {
+                session_->body_->markDirty(*body_->tables_);
+        }
         stmt_.tag(true);
         return next();
 }
@@ -756,6 +1209,9 @@ Statement::next() -> Row
                 case SQLITE_LOCKED:
                         if (session_->body_->waitForUnlock()) {
                                 break;
+                        } else if (session_->body_->deadlinePassed()) {
+                                reset();
+                                throw Interrupt();
                         }
                         // possible deadlock, fall through
                 case SQLITE_BUSY:
@@ -772,6 +1228,41 @@ Statement::next() -> Row
 
 //--------------------------------------
 
+WRSQL_API auto
+Statement::fetchBatch(
+        size_t max_rows
+) -> ColumnBatch
+{
+        ColumnBatch batch;
+        fetchBatch(batch, max_rows);
+        return batch;
+}
+
+//--------------------------------------
+
+WRSQL_API size_t
+Statement::fetchBatch(
+        ColumnBatch &out,
+        size_t       max_rows
+)
+{
+        out.reset(isPrepared() ? static_cast<void *>(stmt_) : nullptr);
+
+        try {
+                while (isActive() && (out.numRows() < max_rows)) {
+                        out.appendRow(stmt_);
+                        next();
+                }
+        } catch (...) {
+                out.clear();
+                throw;
+        }
+
+        return out.numRows();
+}
+
+//--------------------------------------
+
 WRSQL_API auto
 Statement::end() -> Row
 {
@@ -808,6 +1299,7 @@ Statement::operator=(
                 session_ = other.session_;
                 stmt_ = other.stmt_;
                 other.stmt_ = nullptr;
+                std::swap(body_, other.body_);
         }
 
         return *this;
@@ -1216,15 +1708,35 @@ Row::colNo(
         const u8string_view &col_name
 ) const
 {
-        int col_no = -1;
+        if (!stmt_->isPrepared()) {
+                return -1;
+        }
 
-        for (int i = 0, n = numCols(); i < n && col_no < 0; ++i) {
-                if (colName(i) == col_name) {
-                        col_no = i;
-                }
+        return stmt_->body().colNo(static_cast<sqlite3_stmt *>(stmt_->stmt_),
+                                   col_name);
+}
+
+//--------------------------------------
+
+WRSQL_API int
+Row::colNo(
+        const ColumnRef &col
+) const
+{
+        if (!stmt_->isPrepared()) {
+                return -1;
         }
 
-        return col_no;
+        auto &body = stmt_->body();
+        body.syncColumns(static_cast<sqlite3_stmt *>(stmt_->stmt_));
+
+        if (col.col_index_id_ != body.col_index_id_) {
+                auto i = body.col_index_.find(col.name_);
+                col.col_no_ = (i != body.col_index_.end()) ? i->second : -1;
+                col.col_index_id_ = body.col_index_id_;
+        }
+
+        return col.col_no_;
 }
 
 //--------------------------------------
@@ -1244,6 +1756,174 @@ Row::colNo_throw(
         return col_no;
 }
 
+//--------------------------------------
+
+WRSQL_API int
+Row::colNo_throw(
+        const ColumnRef &col
+) const
+{
+        int col_no = colNo(col);
+
+        if (col_no < 0) {
+                throw std::invalid_argument(printStr(
+                        "no such column '%s' in result set", col.name()));
+        }
+
+        return col_no;
+}
+
+//--------------------------------------
+
+WRSQL_API
+ColumnRef::ColumnRef(
+        const u8string_view &col_name
+) :
+        name_        (col_name.to_string()),
+        col_index_id_(0),
+        col_no_      (-1)
+{
+}
+
+//--------------------------------------
+
+WRSQL_API u8string_view
+ColumnRef::name() const
+{
+        return name_;
+}
+
+//--------------------------------------
+
+static std::atomic<uint64_t> next_col_index_id(1);
+
+//--------------------------------------
+
+void
+Statement::Body::syncColumns(
+        sqlite3_stmt *stmt
+)
+{
+        int reprepare_count = sqlite3_stmt_status(
+                                stmt, SQLITE_STMTSTATUS_REPREPARE, false);
+
+        if (col_index_id_ && (reprepare_count == reprepare_count_)) {
+                return;  // up to date
+        }
+
+        clearColumns();
+
+        int num_cols = sqlite3_column_count(stmt);
+
+        col_names_.reserve(num_cols);  // no reallocation while adding below
+        col_index_.reserve(num_cols);
+
+        for (int i = 0; i < num_cols; ++i) {
+                const char *name = sqlite3_column_name(stmt, i);
+                col_names_.emplace_back(name ? name : "");
+                col_index_.emplace(col_names_.back(), i);
+                        // first column takes precedence over duplicate names
+        }
+
+        col_index_id_ = next_col_index_id++;
+        reprepare_count_ = reprepare_count;
+}
+
+//--------------------------------------
+
+void
+Statement::Body::clearColumns()
+{
+        col_index_.clear();
+        col_names_.clear();
+        col_index_id_ = 0;
+}
+
+//--------------------------------------
+
+int
+Statement::Body::colNo(
+        sqlite3_stmt        *stmt,
+        const u8string_view &col_name
+)
+{
+        syncColumns(stmt);
+
+        auto i = col_index_.find(col_name);
+        return (i != col_index_.end()) ? i->second : -1;
+}
+
+//--------------------------------------
+
+auto
+Statement::Body::param(
+        int param_no
+) -> ParamData &
+{
+        if (params_.size() < static_cast<size_t>(param_no)) {
+                params_.resize(param_no);
+        }
+        return params_[param_no - 1];
+}
+
+//--------------------------------------
+
+void
+Statement::Body::releaseParam(
+        int param_no
+)
+{
+        if ((param_no > 0) && (static_cast<size_t>(param_no) <= params_.size())) {
+                params_[param_no - 1].release();
+        }
+}
+
+//--------------------------------------
+
+void
+Statement::Body::releaseParams()
+{
+        for (auto &param: params_) {
+                param.release();
+        }
+}
+
+//--------------------------------------
+
+auto
+Statement::ParamData::operator=(
+        this_t &&other
+) -> this_t &
+{
+        if (&other != this) {
+                release();
+                data = other.data;
+                bytes = other.bytes;
+                free_blob.swap(other.free_blob);
+                text.swap(other.text);
+                blob.swap(other.blob);
+                other.data = nullptr;
+                other.bytes = 0;
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+void
+Statement::ParamData::release()
+{
+        if (free_blob) {
+                FreeBlobFn free_fn;
+                free_fn.swap(free_blob);
+                free_fn(data);
+        }
+        data = nullptr;
+        bytes = 0;
+        std::string().swap(text);
+        std::vector<uint8_t>().swap(blob);
+}
+
 
 } // namespace sql
 } // namespace wr
@@ -0,0 +1,156 @@
+/**
+ * \file StatementPrivate.h
+ *
+ * \brief Internal declarations relating to class wr::sql::Statement
+ *
+ * \warning The declarations within this file are not part of the wrSQL API
+ *      and are only intended for use by the wrSQL library source code itself
+ *      (e.g. unit tests). These declarations are subject to change without
+ *      notice.
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_STATEMENT_PRIVATE_H
+#define WRSQL_STATEMENT_PRIVATE_H
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <wrutil/CityHash.h>
+#include <wrutil/u8string_view.h>
+
+
+namespace wr {
+namespace sql {
+
+
+/*
+ * data owned on behalf of one bound parameter; the data is bound as
+ * SQLITE_STATIC and released by the Statement itself once SQLite no longer
+ * refers to it, so no registry of destructors is needed
+ */
+struct Statement::ParamData
+{
+        using this_t = ParamData;
+
+        ParamData() = default;
+        ParamData(this_t &&other) { *this = std::move(other); }
+        ~ParamData() { release(); }
+
+        this_t &operator=(this_t &&other);
+
+        void release();
+
+        /* strings and vectors shorter than this are copied by SQLite rather
+           than moved in, since their contents may live inside the object
+           itself (small string optimization) and so move with it */
+        enum { MIN_MOVE_BYTES = 64 };
+
+        const void *ptr() const
+        {
+                return !text.empty() ? static_cast<const void *>(text.data())
+                     : !blob.empty() ? static_cast<const void *>(blob.data())
+                     : data;
+        }
+
+        void                 *data = nullptr;
+        size_t                bytes = 0;
+        FreeBlobFn            free_blob;  // releases data if set
+        std::string           text;       // moved-in text, if any
+        std::vector<uint8_t>  blob;       // moved-in blob, if any
+};
+
+/*
+ * look up the ID of a registered statement by its SQL text; returns
+ * ~size_t(0) if the text was never registered
+ */
+size_t findRegisteredStatement(const u8string_view &sql);
+
+/*
+ * split the text of an SQL script into its constituent statements, omitting
+ * empty statements and any consisting only of comments
+ */
+std::vector<std::string> splitScript(const u8string_view &sql);
+
+//--------------------------------------
+
+/*
+ * tables referenced by a compiled statement, as reported by the authorizer
+ * callback while compiling it; collected only on connections with a
+ * ResultCache attached. Names are held in ASCII lower case.
+ */
+struct TableRefs
+{
+        std::vector<std::string> reads,   // read by SELECT or subqueries
+                                 writes;  // modified, dropped or altered
+        bool                     temp = false;  // reads a TEMP table
+
+        static std::string key(const char *table);  // lower-cased name
+
+        void addRead(const char *table)  { add(reads, table); }
+        void addWrite(const char *table) { add(writes, table); }
+
+        static void add(std::vector<std::string> &tables, const char *table);
+
+        bool readsAny(const std::vector<std::string> &tables) const;
+};
+
+//--------------------------------------
+
+struct Statement::Body
+{
+        using this_t = Body;
+        using ColumnIndex = std::unordered_map<u8string_view, int, CityHash>;
+
+        Body() : col_index_id_(0), reprepare_count_(0) {}
+
+        /* (re)build col_index_ if not yet built or if the statement was
+           recompiled by SQLite since (following a schema change) */
+        void syncColumns(sqlite3_stmt *stmt);
+        void clearColumns();
+
+        int colNo(sqlite3_stmt *stmt, const u8string_view &col_name);
+
+        // owned data slot for parameter param_no, allocated on demand
+        ParamData &param(int param_no);
+
+        // release data owned for parameter param_no, or for all parameters
+        void releaseParam(int param_no);
+        void releaseParams();
+
+        std::vector<std::string> col_names_;  // own the keys of col_index_
+        ColumnIndex              col_index_;
+        uint64_t                 col_index_id_;  // 0 if not built
+        int                      reprepare_count_;
+        std::vector<ParamData>   params_;  // indexed by param_no - 1
+        std::shared_ptr<const TableRefs> tables_;  /* null unless compiled
+                                                      with a ResultCache
+                                                      attached */
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_STATEMENT_PRIVATE_H
@@ -0,0 +1,282 @@
+/**
+ * \file StatsCollector.cxx
+ *
+ * \brief Internal per-statement statistics collection for
+ *      class wr::sql::Session
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <algorithm>
+
+#include <wrsql/Session.h>
+#include <wrsql/Statement.h>
+
+#include "sqlite3api.h"
+#include "StatementPrivate.h"
+#include "StatsCollector.h"
+
+
+namespace wr {
+namespace sql {
+
+
+void
+StatsCollector::enable()
+{
+        if (!enabled_) {
+                trackAll();
+                sqlite3_trace_v2(db_, SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW,
+                                 &onTrace, this);
+                enabled_ = true;
+        }
+}
+
+//--------------------------------------
+
+void
+StatsCollector::disable()
+{
+        if (enabled_) {
+                sqlite3_trace_v2(db_, 0, nullptr, nullptr);
+                enabled_ = false;
+        }
+}
+
+//--------------------------------------
+
+auto
+StatsCollector::snapshot() const -> std::vector<StatementStats>
+{
+        std::vector<StatementStats> result;
+
+        result.reserve(by_sql_.size());
+
+        for (auto &i: by_sql_) {
+                const Entry &entry = i.second;
+
+                if (!entry.stats.executions) {
+                        continue;
+                }
+
+                result.push_back(entry.stats);
+
+                // find the bucket containing the 99th percentile execution
+                auto rank = entry.stats.executions
+                                - entry.stats.executions / 100;
+                uint64_t seen = 0;
+
+                for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+                        seen += entry.histogram[b];
+                        if (seen >= rank) {
+                                result.back().p99_time = std::min(
+                                        StatementStats::Duration(
+                                                bucketLimit(b)),
+                                        entry.stats.max_time);
+                                break;
+                        }
+                }
+        }
+
+        std::sort(result.begin(), result.end(),
+                  [](const StatementStats &a, const StatementStats &b) {
+                return a.total_time > b.total_time;
+        });
+
+        return result;
+}
+
+//--------------------------------------
+
+void
+StatsCollector::reset()
+{
+        by_stmt_.clear();  // refers into by_sql_
+        by_sql_.clear();
+
+        if (enabled_) {
+                trackAll();
+        }
+}
+
+//--------------------------------------
+
+int
+StatsCollector::onTrace(
+        unsigned  type,
+        void     *me,
+        void     *p,
+        void     *x
+) // static
+{
+        auto self = static_cast<StatsCollector *>(me);
+        auto stmt = static_cast<sqlite3_stmt *>(p);
+
+        if (type == SQLITE_TRACE_ROW) {
+                if (Entry *entry = self->resolve(stmt, self->by_stmt_[stmt])) {
+                        ++entry->stats.rows;
+                }
+        } else if (type == SQLITE_TRACE_PROFILE) {
+                self->profile(stmt, *static_cast<sqlite3_int64 *>(x));
+        }
+
+        return 0;
+}
+
+//--------------------------------------
+
+auto
+StatsCollector::resolve(
+        sqlite3_stmt *stmt,
+        Tracked      &tracked
+) -> Entry *
+{
+        const char *sql = sqlite3_sql(stmt);
+
+        if (!sql) {
+                return nullptr;  // statement internal to SQLite
+        } else if (tracked.sql != sql) {
+                /* first event for this statement, or the handle was reused
+                   for a new statement after one not finalized by Statement */
+                if (tracked.sql) {
+                        tracked.reprepares = 0;
+                }
+
+                auto i = by_sql_.find(sql);
+
+                if (i == by_sql_.end()) {
+                        Entry entry = {};
+                        entry.stats.sql = sql;
+                        entry.stats.stmt_id = findRegisteredStatement(sql);
+                        i = by_sql_.emplace(sql, std::move(entry)).first;
+                }
+
+                tracked.sql = sql;
+                tracked.entry = &i->second;
+        }
+
+        return tracked.entry;
+}
+
+//--------------------------------------
+
+void
+StatsCollector::profile(
+        sqlite3_stmt *stmt,
+        int64_t       ns
+)
+{
+        Tracked &tracked = by_stmt_[stmt];
+        Entry   *entry   = resolve(stmt, tracked);
+
+        if (!entry) {
+                return;
+        }
+
+        StatementStats &stats = entry->stats;
+        auto            time  = StatementStats::Duration(ns);
+
+        ++stats.executions;
+        stats.total_time += time;
+        stats.max_time = std::max(stats.max_time, time);
+        ++entry->histogram[bucket(static_cast<uint64_t>(ns))];
+
+        stats.fullscan_steps += sqlite3_stmt_status(
+                        stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, true);
+        stats.sorts += sqlite3_stmt_status(
+                        stmt, SQLITE_STMTSTATUS_SORT, true);
+        stats.autoindexes += sqlite3_stmt_status(
+                        stmt, SQLITE_STMTSTATUS_AUTOINDEX, true);
+        stats.vm_steps += sqlite3_stmt_status(
+                        stmt, SQLITE_STMTSTATUS_VM_STEP, true);
+
+        /* the reprepare counter is never reset, since Statement relies upon
+           it to detect when to rebuild its column index */
+        int reprepares = sqlite3_stmt_status(
+                        stmt, SQLITE_STMTSTATUS_REPREPARE, false);
+        stats.reprepares += reprepares - tracked.reprepares;
+        tracked.reprepares = reprepares;
+}
+
+//--------------------------------------
+
+void
+StatsCollector::trackAll()
+{
+        for (auto stmt = sqlite3_next_stmt(db_, nullptr); stmt;
+             stmt = sqlite3_next_stmt(db_, stmt)) {
+                // discard counts accumulated while not collecting
+                sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, true);
+                sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, true);
+                sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, true);
+                sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, true);
+
+                Tracked &tracked = by_stmt_[stmt];
+                tracked.sql = nullptr;
+                tracked.entry = nullptr;
+                tracked.reprepares = sqlite3_stmt_status(
+                                stmt, SQLITE_STMTSTATUS_REPREPARE, false);
+        }
+}
+
+//--------------------------------------
+
+size_t
+StatsCollector::bucket(
+        uint64_t ns
+) // static
+{
+        if (ns < SUB_BUCKETS) {
+                return static_cast<size_t>(ns);
+        }
+
+        unsigned exp = 63;
+
+        while (!(ns >> exp)) {
+                --exp;
+        }
+
+        // exp >= SUB_BITS; keep the SUB_BITS bits following the leading 1
+        size_t sub = static_cast<size_t>(ns >> (exp - SUB_BITS))
+                        & (SUB_BUCKETS - 1);
+        return (exp - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+//--------------------------------------
+
+uint64_t
+StatsCollector::bucketLimit(
+        size_t bucket
+) // static
+{
+        if (bucket < SUB_BUCKETS) {
+                return bucket;
+        }
+
+        unsigned exp = static_cast<unsigned>(bucket / SUB_BUCKETS)
+                        + SUB_BITS - 1;
+        uint64_t sub = bucket % SUB_BUCKETS;
+
+        // largest value falling into this bucket
+        return ((SUB_BUCKETS + sub + 1) << (exp - SUB_BITS)) - 1;
+}
+
+
+} // namespace sql
+} // namespace wr
@@ -0,0 +1,111 @@
+/**
+ * \file StatsCollector.h
+ *
+ * \brief Internal per-statement statistics collection for
+ *      class wr::sql::Session
+ *
+ * \warning The declarations within this file are not part of the wrSQL API
+ *      and are only intended for use by the wrSQL library source code itself.
+ *      These declarations are subject to change without notice.
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#ifndef WRSQL_STATS_COLLECTOR_H
+#define WRSQL_STATS_COLLECTOR_H
+
+#include <stdint.h>
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <wrsql/Session.h>
+
+#include "sqlite3api.h"
+
+
+namespace wr {
+namespace sql {
+
+
+/*
+ * accumulates StatementStats from sqlite3_trace_v2() profile and row events;
+ * statements are tracked by handle and their statistics keyed by SQL text
+ */
+class StatsCollector
+{
+public:
+        StatsCollector(sqlite3 *db) : db_(db), enabled_(false) {}
+                // may outlive db; the trace callback dies with the connection
+
+        void enable();
+        void disable();
+        bool enabled() const { return enabled_; }
+
+        void forget(sqlite3_stmt *stmt) { by_stmt_.erase(stmt); }
+                                        // statement has been finalized
+
+        std::vector<StatementStats> snapshot() const;
+        void reset();
+
+private:
+        /* log-linear histogram of execution times: values below 8ns have
+           their own buckets, larger values share each power of two between
+           8 buckets, bounding the relative error of a percentile to 1/8 */
+        enum { SUB_BUCKETS = 8, SUB_BITS = 3,
+               NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS };
+
+        using Histogram = std::array<uint32_t, NUM_BUCKETS>;
+
+        struct Entry
+        {
+                StatementStats stats;
+                Histogram      histogram;
+        };
+
+        struct Tracked
+        {
+                const char *sql = nullptr;    // identifies the statement
+                Entry      *entry = nullptr;  // resolved on first event
+                int         reprepares = 0;   /* SQLITE_STMTSTATUS_REPREPARE
+                                                 seen so far */
+        };
+
+        static int onTrace(unsigned type, void *me, void *p, void *x);
+
+        Entry *resolve(sqlite3_stmt *stmt, Tracked &tracked);
+        void profile(sqlite3_stmt *stmt, int64_t ns);
+        void trackAll();  // baseline every statement prepared so far
+
+        static size_t bucket(uint64_t ns);
+        static uint64_t bucketLimit(size_t bucket);
+
+        sqlite3                                    *db_;
+        bool                                        enabled_;
+        std::unordered_map<std::string, Entry>      by_sql_;
+        std::unordered_map<sqlite3_stmt *, Tracked> by_stmt_;
+};
+
+
+} // namespace sql
+} // namespace wr
+
+
+#endif // !WRSQL_STATS_COLLECTOR_H
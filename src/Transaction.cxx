@@ -23,7 +23,10 @@
  * \endparblock
  */
 #include <assert.h>
-#include <stdarg.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
 
 #include <wrsql/Error.h>
 #include <wrsql/Session.h>
@@ -38,10 +41,103 @@ namespace wr {
 namespace sql {
 
 
+/*
+ * determine whether the connection has already acquired a write lock, in
+ * which case a Busy condition in a nested transaction cannot be caused by
+ * another connection waiting for us to release our own locks
+ */
+static bool
+holdsWriteLock(
+        sqlite3 *db
+)
+{
+#if SQLITE_VERSION_NUMBER >= 3034000
+        return sqlite3_txn_state(db, nullptr) == SQLITE_TXN_WRITE;
+#else
+        (void) db;
+        return false;  // cannot tell; let the outermost transaction retry
+#endif
+}
+
+//--------------------------------------
+
+/*
+ * lifts any deadline in force on a connection for the lifetime of the
+ * object, so that undoing work halted by the deadline cannot itself be
+ * interrupted
+ */
+struct DeadlineSuspension
+{
+        DeadlineSuspension(Session &session) :
+                session_(session), prev_(session.deadline())
+                { session_.clearDeadline(); }
+
+        ~DeadlineSuspension() { session_.setDeadline(prev_); }
+
+        Session                    &session_;
+        Session::Clock::time_point  prev_;
+};
+
+//--------------------------------------
+
+WRSQL_API
+RetryPolicy::RetryPolicy() :
+        max_attempts (0),
+        initial_delay(100),
+        max_delay    (100000),
+        time_limit   (0),
+        growth       (2.0),
+        jitter       (true)
+{
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+RetryPolicy::retry(
+        unsigned  failures,
+        Duration  elapsed,
+        Duration &delay
+) const
+{
+        if (decide) {
+                return decide(failures, elapsed, delay);
+        } else if (max_attempts && (failures >= max_attempts)) {
+                return false;
+        }
+
+        double wait = static_cast<double>(initial_delay.count())
+                      * std::pow(growth, static_cast<double>(failures - 1));
+
+        wait = std::min(wait, static_cast<double>(max_delay.count()));
+
+        if (jitter && (wait >= 2)) {
+                static thread_local std::minstd_rand rng(
+                        static_cast<std::minstd_rand::result_type>(
+                                std::hash<std::thread::id>()(
+                                        std::this_thread::get_id())));
+                std::uniform_real_distribution<double> dist(wait / 2, wait);
+                wait = dist(rng);
+        }
+
+        Duration next(static_cast<Duration::rep>(wait));
+
+        if (time_limit.count() && (elapsed + next >= time_limit)) {
+                return false;
+        }
+
+        delay = next;
+        return true;
+}
+
+//--------------------------------------
+
 WRSQL_API
 Transaction::Transaction() :
-        session_(nullptr),
-        outer_  (nullptr)
+        session_      (nullptr),
+        outer_        (nullptr),
+        commit_mark_  (0),
+        rollback_mark_(0)
 {
         session_.tag(DEFAULT);
 }
@@ -80,6 +176,8 @@ Transaction::operator=(
                 }
                 std::swap(session_, other.session_);
                 std::swap(outer_, other.outer_);
+                std::swap(commit_mark_, other.commit_mark_);
+                std::swap(rollback_mark_, other.rollback_mark_);
                 if (active()) {
                         session_.ptr()->body_->replaceTransaction(&other, this);
                 }
@@ -95,20 +193,83 @@ Transaction::begin(
         TransactionFn  code
 ) -> this_t  // static
 {
-        this_t txn;
-        bool   nested = session.body_->innerTransaction() != nullptr;
+        return begin(session, session.body_->locking_mode_,
+                     session.body_->retry_policy_, std::move(code));
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Transaction::begin(
+        Session       &session,
+        LockingMode    mode,
+        TransactionFn  code
+) -> this_t  // static
+{
+        return begin(session, mode, session.body_->retry_policy_,
+                     std::move(code));
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Transaction::begin(
+        Session           &session,
+        LockingMode        mode,
+        const RetryPolicy &policy,
+        TransactionFn      code
+) -> this_t  // static
+{
+        using Clock = std::chrono::steady_clock;
+
+        this_t            txn;
+        TransactionStats &stats    = session.body_->txn_stats_;
+        unsigned          failures = 0;
+        auto              first    = Clock::now();
 
         do {
+                auto attempt = Clock::now();
+
                 try {
-                        txn.begin_(&session);
+                        txn.begin_(&session, mode);
                         code(txn);
                         txn.commit();
                         break;
                 } catch (Busy &) {
-                        if (txn.nested()) {
+                        if (txn.nested() && !holdsWriteLock(session.body_->db())) {
+                                /* our read lock is what the other connection
+                                   is waiting for, so only releasing it by
+                                   retrying the outermost transaction can
+                                   resolve the contention */
                                 throw;
-                        } else {
-                                txn.rollback();
+                        }
+
+                        txn.rollback();
+
+                        auto                  now = Clock::now();
+                        RetryPolicy::Duration delay;
+
+                        stats.wasted_time += now - attempt;
+
+                        if (!policy.retry(++failures,
+                                          std::chrono::duration_cast<
+                                                RetryPolicy::Duration>(
+                                                        now - first),
+                                          delay)) {
+                                ++stats.busy_failures;
+                                throw;
+                        }
+
+                        if (now + delay >= session.deadline()) {
+                                ++stats.busy_failures;
+                                throw Interrupt();  // would wait past deadline
+                        }
+
+                        ++stats.busy_retries;
+
+                        if (delay.count() > 0) {
+                                std::this_thread::sleep_for(delay);
+                                stats.backoff_time += Clock::now() - now;
                         }
                 }
         } while (true);
@@ -118,19 +279,58 @@ Transaction::begin(
 
 //--------------------------------------
 
+WRSQL_API auto
+Transaction::begin(
+        Session                             &session,
+        std::chrono::steady_clock::duration  timeout,
+        TransactionFn                        code
+) -> this_t  // static
+{
+        return begin(session, session.body_->locking_mode_,
+                     session.body_->retry_policy_, timeout, std::move(code));
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+Transaction::begin(
+        Session                             &session,
+        LockingMode                          mode,
+        const RetryPolicy                   &policy,
+        std::chrono::steady_clock::duration  timeout,
+        TransactionFn                        code
+) -> this_t  // static
+{
+        Session::ScopedDeadline deadline(session, timeout);
+        return begin(session, mode, policy, std::move(code));
+}
+
+//--------------------------------------
+
 WRSQL_API void
 Transaction::begin_(
-        Session *session,
-        ...
+        Session     *session,
+        LockingMode  mode
 )
 {
-        int mode;
-
         if (!session->body_->innerTransaction()) {  // will not be nested
-                static const size_t BEGIN_TXN = registerStatement("BEGIN");
-                session->exec(BEGIN_TXN);  // may throw
+                static const size_t BEGIN[] = {
+                        registerStatement("BEGIN DEFERRED"),
+                        registerStatement("BEGIN IMMEDIATE"),
+                        registerStatement("BEGIN EXCLUSIVE")
+                };
+                session->exec(BEGIN[mode]);  // may throw
+        } else {
+                /* all nested transactions use the same savepoint name;
+                   SQLite resolves RELEASE and ROLLBACK TO to the most recent
+                   savepoint of that name, i.e. the innermost transaction's */
+                static const size_t SAVEPOINT
+                        = registerStatement("SAVEPOINT wrsql_nested");
+                session->exec(SAVEPOINT);  // may throw
         }
 
+        commit_mark_ = session->body_->commit_actions_.size();
+        rollback_mark_ = session->body_->rollback_actions_.size();
         outer_ = session->body_->addTransaction(this);
         session_ = session;
 }
@@ -140,7 +340,9 @@ Transaction::begin_(
 WRSQL_API auto
 Transaction::commit() -> this_t &
 {
-        static const size_t COMMIT = sql::registerStatement("COMMIT");
+        static const size_t COMMIT = sql::registerStatement("COMMIT"),
+                            RELEASE = sql::registerStatement(
+                                                "RELEASE wrsql_nested");
 
         if (active()) {
                 auto &session = *session_;
@@ -148,7 +350,14 @@ Transaction::commit() -> this_t &
                 if (!nested()) {  // this is the outermost transaction
                         session.exec(COMMIT);
                         session.body_->transactionCommitted();
-                }
+                } else if (!sqlite3_get_autocommit(session.body_->db())) {
+                        // inner savepoints must be released before ours
+                        while (session.body_->innerTransaction() != this) {
+                                session.body_->innerTransaction()->commit();
+                        }
+                        session.exec(RELEASE);
+                } /* else no transaction active, probably rolled back
+                     automatically by SQLite error */
 
                 session_ = nullptr;
                 session_.tag(COMMITTED);
@@ -167,10 +376,31 @@ Transaction::commit() -> this_t &
 WRSQL_API auto
 Transaction::rollback() -> this_t &
 {
-        static const size_t ROLLBACK = sql::registerStatement("ROLLBACK");
+        static const size_t ROLLBACK = sql::registerStatement("ROLLBACK"),
+                            ROLLBACK_TO = sql::registerStatement(
+                                                "ROLLBACK TO wrsql_nested"),
+                            RELEASE = sql::registerStatement(
+                                                "RELEASE wrsql_nested");
 
         if (active()) {
-                auto &session = *session_;
+                auto               &session = *session_;
+                DeadlineSuspension  suspended(session);
+
+                if (nested() && !sqlite3_get_autocommit(session.body_->db())) {
+                        // undo only the changes made since our savepoint
+                        while (session.body_->innerTransaction() != this) {
+                                session.body_->innerTransaction()->rollback();
+                        }
+                        session.exec(ROLLBACK_TO);
+                        session.exec(RELEASE);
+                        session_ = nullptr;
+                        session_.tag(ROLLED_BACK);
+                        session.body_->removeTransaction(this);
+                        session.body_->transactionRolledBackTo(commit_mark_,
+                                                               rollback_mark_);
+                        return *this;
+                }
+
                 session_ = nullptr;
 
                 if (!sqlite3_get_autocommit(session.body_->db())) {
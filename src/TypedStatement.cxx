@@ -0,0 +1,85 @@
+/**
+ * \file TypedStatement.cxx
+ *
+ * \brief Implementation of class wr::sql::TypedStatementBase
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdexcept>
+
+#include <wrutil/Format.h>
+#include <wrsql/TypedStatement.h>
+
+
+namespace wr {
+namespace sql {
+
+
+WRSQL_API
+TypedStatementBase::TypedStatementBase(
+        const u8string_view &sql,
+        int                  num_params,
+        int                  num_cols
+) :
+        id_        (registerStatement(sql)),
+        num_params_(num_params),
+        num_cols_  (num_cols),
+        validated_ (false)
+{
+}
+
+//--------------------------------------
+
+WRSQL_API Statement::Ptr
+TypedStatementBase::prepare(
+        const Session &db
+) const
+{
+        Statement::Ptr stmt = db.statement(id_);
+
+        if (!validated_.load(std::memory_order_relaxed)) {
+                validate(*stmt);  // harmless if repeated by another thread
+                validated_.store(true, std::memory_order_relaxed);
+        }
+
+        return stmt;
+}
+
+//--------------------------------------
+
+void
+TypedStatementBase::validate(
+        const Statement &stmt
+) const
+{
+        if (stmt.numParams() != num_params_) {
+                throw std::invalid_argument(
+                        printStr("statement takes %d parameters, %d declared (SQL: %s)",
+                                 stmt.numParams(), num_params_, stmt.sql()));
+        } else if (stmt.numCols() < num_cols_) {
+                throw std::invalid_argument(
+                        printStr("statement returns %d columns, %d expected (SQL: %s)",
+                                 stmt.numCols(), num_cols_, stmt.sql()));
+        }
+}
+
+
+} // namespace sql
+} // namespace wr
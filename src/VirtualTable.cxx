@@ -0,0 +1,973 @@
+/**
+ * \file VirtualTable.cxx
+ *
+ * \brief Implementation of class wr::sql::VirtualTableBase
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <wrutil/Format.h>
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/VirtualTable.h>
+
+#include "sqlite3api.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class VirtualTableBase::SQLInterface :
+        private sqlite3_module
+{
+public:
+        using this_t = SQLInterface;
+
+        SQLInterface();
+
+private:
+        struct Cursor;
+
+        static int registerWithSession(sqlite3 *db, const char **out_err_msg,
+                                      const struct sqlite3_api_routines *thunk);
+
+        static int attach(sqlite3 *db, void *aux, int argc,
+                          const char * const *argv, sqlite3_vtab **vtab,
+                          char **error);
+
+        static int detach(sqlite3_vtab *vtab);
+        static int getBestIndex(sqlite3_vtab *vtab, sqlite3_index_info *iinfo);
+
+        static int openCursor(sqlite3_vtab *vtab,
+                              sqlite3_vtab_cursor **vcursor);
+
+        static int closeCursor(sqlite3_vtab_cursor *vcursor);
+
+        static int filter(sqlite3_vtab_cursor *vcursor, int idx_num,
+                          const char *idx_str, int argc, sqlite3_value **argv);
+
+        static int next(sqlite3_vtab_cursor *vcursor);
+        static int isEOF(sqlite3_vtab_cursor *vcursor);
+
+        static int getColumnValue(sqlite3_vtab_cursor *vcursor,
+                                  sqlite3_context *ctx, int col_idx);
+
+        static int getRowID(sqlite3_vtab_cursor *vcursor, sqlite_int64 *rowid);
+
+        static int update(sqlite3_vtab *vtab, int argc, sqlite3_value **argv,
+                          sqlite_int64 *out_rowid);
+};
+
+//--------------------------------------
+
+struct VirtualTableBase::Body :
+        public sqlite3_vtab
+{
+        struct ColumnInfo
+        {
+                std::string name;
+                ValueType   type;
+                unsigned    flags;
+        };
+
+        Body(VirtualTableBase &table, bool read_only) :
+                sqlite3_vtab(), table_(table), read_only_(read_only) {}
+
+        int fail(int status, const char *what);
+
+        size_t lowerBound(size_t first, size_t last, const FunctionArgs &args,
+                          int i, bool strict) const;
+
+        VirtualTableBase        &table_;
+        const Session           *db_ = nullptr;
+        std::string              name_;
+        std::vector<ColumnInfo>  cols_;
+        int                      key_col_ = -1;
+        bool                     read_only_;
+};
+
+//--------------------------------------
+
+namespace {
+
+
+VirtualTableBase::SQLInterface vtab_sql_iface;
+
+/*
+ * bodies of existing VirtualTableBase objects, so that a pointer given in
+ * the arguments of CREATE VIRTUAL TABLE can be checked before use
+ */
+std::mutex                    live_bodies_mutex;
+std::set<const void *>        live_bodies;
+
+//--------------------------------------
+
+/*
+ * constraint codes written to idxStr by getBestIndex(), one per argument
+ * passed to filter()
+ */
+enum: char
+{
+        ROWID_ARG = 'R',  // rowid = value
+        EQ_ARG    = '=',  // key = value
+        GT_ARG    = '>',
+        GE_ARG    = 'G',
+        LT_ARG    = '<',
+        LE_ARG    = 'L'
+};
+
+
+} // anonymous namespace
+
+//--------------------------------------
+
+/*
+ * quote an identifier for use in SQL text
+ */
+static std::string
+quoteName(
+        const std::string &name
+)
+{
+        std::string quoted = "\"";
+
+        for (char c: name) {
+                quoted += c;
+                if (c == '"') {
+                        quoted += c;
+                }
+        }
+
+        return quoted += '"';
+}
+
+//--------------------------------------
+
+static int
+compareIntFloat(
+        int64_t i,
+        double  x
+)
+{
+        if (x != x) {  // NaN; never a stored value
+                return 1;
+        } else if (x >= 9223372036854775808.0) {
+                return -1;
+        } else if (x < -9223372036854775808.0) {
+                return 1;
+        }
+
+        double  f = floor(x);
+        int64_t fi = static_cast<int64_t>(f);
+
+        if (i != fi) {
+                return (i < fi) ? -1 : 1;
+        }
+        return (f == x) ? 0 : -1;
+}
+
+//--------------------------------------
+
+WRSQL_API int
+compareVirtualKey(
+        int64_t             key,
+        const FunctionArgs &args,
+        int                 i
+)
+{
+        switch (args.type(i)) {
+        case INT_TYPE: {
+                int64_t value = args.intValue(i);
+                return (key < value) ? -1 : (key > value);
+        }
+        case FLOAT_TYPE:
+                return compareIntFloat(key, args.floatValue(i));
+        default:
+                return -1;  // numbers sort before text and BLOBs
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API int
+compareVirtualKey(
+        double              key,
+        const FunctionArgs &args,
+        int                 i
+)
+{
+        switch (args.type(i)) {
+        case INT_TYPE:
+                return -compareIntFloat(args.intValue(i), key);
+        case FLOAT_TYPE: {
+                double value = args.floatValue(i);
+                return (key < value) ? -1 : (key > value);
+        }
+        default:
+                return -1;
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API int
+compareVirtualKey(
+        const u8string_view &key,
+        const FunctionArgs  &args,
+        int                  i
+)
+{
+        switch (args.type(i)) {
+        case TEXT_TYPE: {
+                u8string_view value = args.text(i);
+                size_t        n = std::min(key.bytes(), value.bytes());
+                int           diff = n ? memcmp(key.data(), value.data(), n)
+                                       : 0;
+                if (diff) {
+                        return diff;
+                }
+                return (key.bytes() < value.bytes()) ? -1
+                                : (key.bytes() > value.bytes());
+        }
+        case BLOB_TYPE:
+                return -1;  // text sorts before BLOBs
+        default:
+                return 1;   // numbers are never passed; see filter()
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API
+VirtualTableBase::VirtualTableBase(
+        bool read_only
+) :
+        body_(new Body(*this, read_only))
+{
+        std::lock_guard<std::mutex> lock(live_bodies_mutex);
+
+        try {
+                live_bodies.insert(body_);
+        } catch (...) {
+                delete body_;
+                throw;
+        }
+}
+
+//--------------------------------------
+
+WRSQL_API
+VirtualTableBase::~VirtualTableBase()
+{
+        try {
+                detach();
+        } catch (...) {
+                // nothing further can be done
+        }
+
+        {
+                std::lock_guard<std::mutex> lock(live_bodies_mutex);
+                live_bodies.erase(body_);
+        }
+
+        delete body_;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+VirtualTableBase::attach(
+        const Session       &db,
+        const u8string_view &name
+) -> this_t &
+{
+        if ((&db == body_->db_) && (name == body_->name_)) {
+                return *this;
+        } else if (!db.isOpen()) {
+                throw std::logic_error("cannot attach VirtualTable to closed Session");
+        } else if (body_->cols_.empty()) {
+                throw std::logic_error("cannot attach VirtualTable without columns");
+        }
+
+        detach();
+
+        body_->db_ = &db;
+        body_->name_ = name.to_string();
+
+        try {
+                db.exec(printStr("CREATE VIRTUAL TABLE temp.%s USING wrsql_vtab(%p)",
+                                 quoteName(body_->name_),
+                                 static_cast<const void *>(body_)));
+        } catch (...) {
+                body_->db_ = nullptr;
+                body_->name_.clear();
+                throw;
+        }
+
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API auto
+VirtualTableBase::detach() -> this_t &
+{
+        if (body_->db_) {
+                if (body_->db_->isOpen()) {
+                        body_->db_->exec(printStr("DROP TABLE temp.%s",
+                                                  quoteName(body_->name_)));
+                }
+                body_->db_ = nullptr;
+                body_->name_.clear();
+        }
+        return *this;
+}
+
+//--------------------------------------
+
+WRSQL_API const Session *
+VirtualTableBase::db() const
+{
+        return body_->db_;
+}
+
+//--------------------------------------
+
+WRSQL_API u8string_view
+VirtualTableBase::name() const
+{
+        return body_->name_;
+}
+
+//--------------------------------------
+
+WRSQL_API int
+VirtualTableBase::numColumns() const
+{
+        return static_cast<int>(body_->cols_.size());
+}
+
+//--------------------------------------
+
+WRSQL_API bool
+VirtualTableBase::readOnly() const
+{
+        return body_->read_only_;
+}
+
+//--------------------------------------
+
+WRSQL_API void
+VirtualTableBase::addColumn(
+        const u8string_view &name,
+        ValueType            type,
+        unsigned             flags,
+        bool                 key_capable
+)
+{
+        if (body_->db_) {
+                throw std::logic_error("cannot add columns to attached VirtualTable");
+        } else if (flags & SORTED_KEY_COLUMN) {
+                if (body_->key_col_ >= 0) {
+                        throw std::invalid_argument("VirtualTable may have only one SORTED_KEY_COLUMN");
+                } else if (!key_capable) {
+                        throw std::invalid_argument(printStr("type of VirtualTable column \"%s\" cannot be a SORTED_KEY_COLUMN",
+                                                             name));
+                }
+                flags |= READ_ONLY_COLUMN;
+        }
+
+        body_->cols_.push_back({ name.to_string(), type, flags });
+
+        if (flags & SORTED_KEY_COLUMN) {
+                body_->key_col_ = static_cast<int>(body_->cols_.size()) - 1;
+        }
+}
+
+//--------------------------------------
+
+/*
+ * report failure of a call from the database implementation through the
+ * table's error message, as the return status of that call
+ */
+int
+VirtualTableBase::Body::fail(
+        int         status,
+        const char *what
+)
+{
+        sqlite3_free(zErrMsg);
+        zErrMsg = sqlite3_mprintf("%s", what);
+        return status;
+}
+
+//--------------------------------------
+
+/*
+ * find the first row in [first, last) whose key is not less than (or, if
+ * strict, greater than) argument i
+ */
+size_t
+VirtualTableBase::Body::lowerBound(
+        size_t              first,
+        size_t              last,
+        const FunctionArgs &args,
+        int                 i,
+        bool                strict
+) const
+{
+        while (first < last) {
+                size_t mid = first + (last - first) / 2;
+                int    cmp = table_.compareKey(mid, args, i);
+
+                if ((cmp < 0) || (strict && !cmp)) {
+                        first = mid + 1;
+                } else {
+                        last = mid;
+                }
+        }
+        return first;
+}
+
+//--------------------------------------
+
+struct VirtualTableBase::SQLInterface::Cursor :
+        public sqlite3_vtab_cursor
+{
+        size_t pos = 0,  ///< index of current row
+               end = 0;  ///< index after last row of result set
+};
+
+//--------------------------------------
+
+VirtualTableBase::SQLInterface::SQLInterface()
+{
+        iVersion = 1;
+        xCreate = &attach;
+        xConnect = &attach;
+        xBestIndex = &getBestIndex;
+        xDisconnect = &detach;
+        xDestroy = &detach;
+        xOpen = &openCursor;
+        xClose = &closeCursor;
+        xFilter = &filter;
+        xNext = &next;
+        xEof = &isEOF;
+        xColumn = &getColumnValue;
+        xRowid = &getRowID;
+        xUpdate = &update;
+        xFindFunction = nullptr;
+        xBegin = nullptr;
+        xSync = nullptr;
+        xCommit = nullptr;
+        xRollback = nullptr;
+        xRename = nullptr;
+        xSavepoint = nullptr;
+        xRelease = nullptr;
+        xRollbackTo = nullptr;
+
+        // see IDSet::SQLInterface::SQLInterface()
+        union {
+                int (*a)(sqlite3 *, const char **,
+                         const struct sqlite3_api_routines *);
+
+                void (*b)();
+        };
+
+        a = &registerWithSession;
+        sqlite3_auto_extension(b);
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::registerWithSession(
+        sqlite3                            *db,
+        const char                        **out_err_msg,
+        const struct sqlite3_api_routines  * /* thunk */
+)
+{
+        int status = sqlite3_create_module_v2(
+                db, "wrsql_vtab", &vtab_sql_iface, &vtab_sql_iface, nullptr);
+
+        if (status != SQLITE_OK) {
+                *out_err_msg = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+        }
+
+        return status;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::attach(
+        sqlite3             *db,
+        void                * /* aux */,
+        int                  argc,
+        const char * const  *argv,
+        sqlite3_vtab       **vtab,
+        char               **error
+)
+{
+        if (argc < 4) {
+                *error = sqlite3_mprintf("VirtualTable: missing table object pointer");
+                return SQLITE_ERROR;
+        }
+
+        auto body = reinterpret_cast<Body *>(static_cast<uintptr_t>(
+                                        strtoull(argv[3], nullptr, 0)));
+        {
+                std::lock_guard<std::mutex> lock(live_bodies_mutex);
+
+                if (!live_bodies.count(body)) {
+                        *error = sqlite3_mprintf("VirtualTable: invalid table object pointer");
+                        return SQLITE_ERROR;
+                }
+        }
+
+        std::string decl = "CREATE TABLE x (";
+
+        for (auto &col: body->cols_) {
+                static const char * const TYPES[] = {
+                        "", " INTEGER", " REAL", " TEXT", " BLOB"
+                };
+                if (&col != &body->cols_.front()) {
+                        decl += ", ";
+                }
+                decl += quoteName(col.name) + TYPES[col.type];
+        }
+
+        decl += ")";
+
+        int status = sqlite3_declare_vtab(db, decl.c_str());
+
+        if (status != SQLITE_OK) {
+                *error = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+                return status;
+        }
+
+        *vtab = body;
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::detach(
+        sqlite3_vtab *vtab
+)
+{
+        auto &body = static_cast<Body &>(*vtab);
+        sqlite3_free(body.zErrMsg);
+        body.zErrMsg = nullptr;
+        body.db_ = nullptr;
+        body.name_.clear();
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::getBestIndex(
+        sqlite3_vtab       *vtab,
+        sqlite3_index_info *iinfo
+)
+{
+        auto &body = static_cast<Body &>(*vtab);
+        int   arg_no = 0;
+        bool  rowid_eq = false, eq = false, lower = false, upper = false;
+
+        iinfo->idxNum = 0;
+
+        if (iinfo->nConstraint) {
+                iinfo->idxStr = static_cast<char *>(
+                                        sqlite3_malloc(iinfo->nConstraint + 1));
+
+                if (!iinfo->idxStr) {
+                        return SQLITE_NOMEM;
+                }
+
+                iinfo->needToFreeIdxStr = true;
+        }
+
+        for (int i = 0; i < iinfo->nConstraint; ++i) {
+                const auto &constraint = iinfo->aConstraint[i];
+                auto       &usage      = iinfo->aConstraintUsage[i];
+                char        code;
+
+                usage.argvIndex = 0;  // 1-based index, 0 = not used
+                usage.omit = false;   // filter() narrows, SQLite verifies
+
+                if (!constraint.usable) {
+                        continue;
+                }
+
+                if (constraint.iColumn == -1) {
+                        if (constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) {
+                                continue;
+                        }
+                        code = ROWID_ARG;
+                        rowid_eq = true;
+                } else if (constraint.iColumn != body.key_col_) {
+                        continue;
+                } else {
+#if SQLITE_VERSION_NUMBER >= 3022000
+                        // text keys are sorted for the BINARY collation only
+                        if ((body.cols_[body.key_col_].type == TEXT_TYPE)
+                                        && sqlite3_stricmp(
+                                                sqlite3_vtab_collation(iinfo, i),
+                                                "BINARY")) {
+                                continue;
+                        }
+#endif
+                        switch (constraint.op) {
+                        case SQLITE_INDEX_CONSTRAINT_EQ:
+                                code = EQ_ARG;
+                                eq = true;
+                                break;
+                        case SQLITE_INDEX_CONSTRAINT_GT:
+                                code = GT_ARG;
+                                lower = true;
+                                break;
+                        case SQLITE_INDEX_CONSTRAINT_GE:
+                                code = GE_ARG;
+                                lower = true;
+                                break;
+                        case SQLITE_INDEX_CONSTRAINT_LT:
+                                code = LT_ARG;
+                                upper = true;
+                                break;
+                        case SQLITE_INDEX_CONSTRAINT_LE:
+                                code = LE_ARG;
+                                upper = true;
+                                break;
+                        default:
+                                continue;
+                        }
+                }
+
+                iinfo->idxStr[arg_no] = code;
+                usage.argvIndex = ++arg_no;
+        }
+
+        if (iinfo->idxStr) {
+                iinfo->idxStr[arg_no] = '\0';
+        }
+
+        // costs are estimated as for IDSet::SQLInterface::getBestIndex()
+        double size = static_cast<double>(body.table_.numRows()),
+               lookup = log2(size + 1) + 1,
+               rows;
+
+        if (rowid_eq) {
+                rows = 1;
+                iinfo->estimatedCost = 1;
+        } else if (eq) {
+                rows = std::min(size, 4.0);  // key need not be unique
+                iinfo->estimatedCost = lookup + rows;
+        } else if (lower || upper) {
+                rows = (lower && upper) ? size / 64 : size / 4;
+                iinfo->estimatedCost = lookup + rows;
+        } else {
+                rows = size;
+                iinfo->estimatedCost = size + 1;
+        }
+
+        if (sqlite3_libversion_number() >= 3008002) {
+                iinfo->estimatedRows = static_cast<sqlite3_int64>(rows);
+        }
+        if (rowid_eq && (sqlite3_libversion_number() >= 3009000)) {
+                iinfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+        }
+
+        // rows are visited in rowid order, which is also key order
+        iinfo->orderByConsumed = true;
+
+        for (int i = 0; i < iinfo->nOrderBy; ++i) {
+                const auto &order_by = iinfo->aOrderBy[i];
+
+                if (order_by.desc || ((order_by.iColumn != -1)
+                                      && (order_by.iColumn != body.key_col_))) {
+                        iinfo->orderByConsumed = false;
+                        break;
+                }
+        }
+
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::openCursor(
+        sqlite3_vtab         * /* vtab */,
+        sqlite3_vtab_cursor **vcursor
+)
+{
+        *vcursor = new (std::nothrow) Cursor;
+        return *vcursor ? SQLITE_OK : SQLITE_NOMEM;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::closeCursor(
+        sqlite3_vtab_cursor *vcursor
+)
+{
+        delete static_cast<Cursor *>(vcursor);
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::filter(
+        sqlite3_vtab_cursor *vcursor,
+        int                  /* idx_num (always 0) */,
+        const char          *idx_str,
+        int                  argc,
+        sqlite3_value      **argv
+)
+{
+        auto        &cursor = static_cast<Cursor &>(*vcursor);
+        auto        &body = static_cast<Body &>(*cursor.pVtab);
+        size_t       first = 0, last = body.table_.numRows();
+        FunctionArgs args(argc, reinterpret_cast<void **>(argv));
+        bool         numeric_key = (body.key_col_ >= 0)
+                                   && (body.cols_[body.key_col_].type
+                                                        != TEXT_TYPE);
+
+        for (int i = 0; (i < argc) && (first < last); ++i) {
+                if (idx_str[i] == ROWID_ARG) {
+                        int type = sqlite3_value_numeric_type(argv[i]);
+                        double x = sqlite3_value_double(argv[i]);
+                        int64_t rowid = sqlite3_value_int64(argv[i]);
+
+                        if (((type != SQLITE_INTEGER) && ((type != SQLITE_FLOAT)
+                                                          || (x != floor(x))))
+                                        || (rowid < static_cast<int64_t>(first))
+                                        || (rowid >= static_cast<int64_t>(last))) {
+                                last = first;  // no such row
+                        } else {
+                                first = static_cast<size_t>(rowid);
+                                last = first + 1;
+                        }
+                        continue;
+                }
+
+                if (numeric_key) {
+                        // as applied by SQLite when comparing with the column
+                        sqlite3_value_numeric_type(argv[i]);
+                } else if ((args.type(i) == INT_TYPE)
+                                        || (args.type(i) == FLOAT_TYPE)) {
+                        continue;  // affinity depends on the other operand
+                }
+
+                if (args.isNull(i)) {
+                        last = first;  // comparisons with NULL are never true
+                        continue;
+                }
+
+                try {
+                        switch (idx_str[i]) {
+                        case EQ_ARG:
+                                first = body.lowerBound(first, last, args, i,
+                                                        false);
+                                last = body.lowerBound(first, last, args, i,
+                                                       true);
+                                break;
+                        case GT_ARG:
+                                first = body.lowerBound(first, last, args, i,
+                                                        true);
+                                break;
+                        case GE_ARG:
+                                first = body.lowerBound(first, last, args, i,
+                                                        false);
+                                break;
+                        case LT_ARG:
+                                last = body.lowerBound(first, last, args, i,
+                                                       false);
+                                break;
+                        case LE_ARG:
+                                last = body.lowerBound(first, last, args, i,
+                                                       true);
+                                break;
+                        }
+                } catch (std::bad_alloc &) {
+                        return SQLITE_NOMEM;
+                } catch (std::exception &err) {
+                        return body.fail(SQLITE_ERROR, err.what());
+                }
+        }
+
+        cursor.pos = first;
+        cursor.end = std::max(first, last);
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::next(
+        sqlite3_vtab_cursor *vcursor
+)
+{
+        ++static_cast<Cursor &>(*vcursor).pos;
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::isEOF(
+        sqlite3_vtab_cursor *vcursor
+)
+{
+        auto &cursor = static_cast<Cursor &>(*vcursor);
+        return cursor.pos >= cursor.end;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::getColumnValue(
+        sqlite3_vtab_cursor *vcursor,
+        sqlite3_context     *ctx,
+        int                  col_idx
+)
+{
+        auto &cursor = static_cast<Cursor &>(*vcursor);
+        auto &body = static_cast<Body &>(*cursor.pVtab);
+
+        if ((col_idx < 0) || (col_idx >= static_cast<int>(body.cols_.size()))) {
+                return SQLITE_RANGE;
+        }
+
+#if SQLITE_VERSION_NUMBER >= 3022000
+        // an UPDATE leaving a read-only column unchanged need not fetch it
+        if ((body.cols_[col_idx].flags & READ_ONLY_COLUMN)
+                        && sqlite3_vtab_nochange(ctx)) {
+                return SQLITE_OK;
+        }
+#endif
+
+        try {
+                FunctionResult result(ctx);
+                body.table_.getValue(cursor.pos, col_idx, result);
+        } catch (std::bad_alloc &) {
+                sqlite3_result_error_nomem(ctx);
+        } catch (std::exception &err) {
+                sqlite3_result_error(ctx, err.what(), -1);
+        }
+
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::getRowID(
+        sqlite3_vtab_cursor *vcursor,
+        sqlite_int64        *rowid
+)
+{
+        *rowid = static_cast<sqlite_int64>(
+                        static_cast<Cursor &>(*vcursor).pos);
+        return SQLITE_OK;
+}
+
+//--------------------------------------
+
+int
+VirtualTableBase::SQLInterface::update(
+        sqlite3_vtab   *vtab,
+        int             argc,
+        sqlite3_value **argv,
+        sqlite_int64   * /* out_rowid */
+)
+{
+        auto &body = static_cast<Body &>(*vtab);
+
+        if ((argc == 1) || (sqlite3_value_type(argv[0]) == SQLITE_NULL)) {
+                return body.fail(SQLITE_CONSTRAINT,
+                                 "rows cannot be inserted into or deleted from a VirtualTable");
+        } else if (body.read_only_) {
+                return body.fail(SQLITE_READONLY, "VirtualTable is read-only");
+        }
+
+        auto row = sqlite3_value_int64(argv[0]);
+
+        if (sqlite3_value_int64(argv[1]) != row) {
+                return body.fail(SQLITE_CONSTRAINT,
+                                 "rowid of VirtualTable row cannot be changed");
+        } else if ((row < 0)
+                   || (static_cast<uint64_t>(row) >= body.table_.numRows())) {
+                return SQLITE_OK;  // no such row
+        }
+
+        // check every column before changing any, so that rows are not
+        // left partially updated
+        for (size_t col = 0; col < body.cols_.size(); ++col) {
+                if (!(body.cols_[col].flags & READ_ONLY_COLUMN)) {
+                        continue;
+                }
+#if SQLITE_VERSION_NUMBER >= 3022000
+                if (!sqlite3_value_nochange(argv[col + 2])) {
+                        return body.fail(SQLITE_CONSTRAINT,
+                                         printStr("column \"%s\" of VirtualTable is read-only",
+                                                  body.cols_[col].name).c_str());
+                }
+#endif
+        }
+
+        FunctionArgs args(argc, reinterpret_cast<void **>(argv));
+
+        try {
+                for (size_t col = 0; col < body.cols_.size(); ++col) {
+                        if (!(body.cols_[col].flags & READ_ONLY_COLUMN)) {
+                                body.table_.setValue(
+                                        static_cast<size_t>(row),
+                                        static_cast<int>(col), args,
+                                        static_cast<int>(col) + 2);
+                        }
+                }
+        } catch (std::bad_alloc &) {
+                return SQLITE_NOMEM;
+        } catch (std::exception &err) {
+                return body.fail(SQLITE_ERROR, err.what());
+        }
+
+        return SQLITE_OK;
+}
+
+
+} // namespace sql
+} // namespace wr
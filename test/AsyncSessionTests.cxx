@@ -0,0 +1,312 @@
+/**
+ * \file AsyncSessionTests.cxx
+ *
+ * \brief Unit test module for class \c wr::sql::AsyncSession
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <wrsql/AsyncSession.h>
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/Statement.h>
+
+#include "SampleDB.h"
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class AsyncSessionTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        AsyncSessionTests(int argc, const char **argv) :
+                base_t("AsyncSession", argc, argv)
+        {
+                db_.init(defaultURI());
+        }
+
+        virtual ~AsyncSessionTests() { db_.close(); }
+
+        int runAll();
+
+        static void defaultConstruct(),
+                    openInvalid(),
+                    submit(),
+                    execAsync(),
+                    fetchAsync(),
+                    fetchBatchesAsync(),
+                    errorPropagation(),
+                    closeDrainsQueue();
+
+private:
+        static SampleDB db_;
+};
+
+
+SampleDB AsyncSessionTests::db_;
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::AsyncSessionTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::AsyncSessionTests::runAll()
+{
+        run("defaultConstruct", 1, &defaultConstruct);
+        run("open", 1, &openInvalid);
+        run("submit", 1, &submit);
+        run("execAsync", 1, &execAsync);
+        run("fetchAsync", 1, &fetchAsync);
+        run("fetchBatchesAsync", 1, &fetchBatchesAsync);
+        run("error", 1, &errorPropagation);
+        run("close", 1, &closeDrainsQueue);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::defaultConstruct() // static
+{
+        AsyncSession db;
+
+        if (db.isOpen()) {
+                throw TestFailure("db.isOpen() returned true, expected false");
+        }
+
+        try {
+                db.post([](Session &) {});
+        } catch (std::logic_error &) {
+                return;
+        }
+
+        throw TestFailure("post() to closed AsyncSession did not throw std::logic_error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::openInvalid() // static
+{
+        AsyncSession db;
+
+        try {
+                db.open("dummy://foo.darkstar.org:43210");
+        } catch (Error &) {
+                if (db.isOpen()) {
+                        throw TestFailure("db.isOpen() returned true after failed open()");
+                }
+                return;
+        }
+
+        throw TestFailure("db.open() did not throw exception for unrecognised database type");
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::submit() // static
+{
+        AsyncSession db(defaultURI());
+
+        auto caller = std::this_thread::get_id();
+        auto worker = db.submit([](Session &session) {
+                if (!session.isOpen()) {
+                        throw TestFailure("worker's Session not open");
+                }
+                return std::this_thread::get_id();
+        }).get();
+
+        if (worker == caller) {
+                throw TestFailure("task executed by submitting thread");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::execAsync() // static
+{
+        static const size_t INSERT_OFFICE = registerStatement(
+                "INSERT INTO offices (code, city, phone, address_line_1, "
+                                     "country, postal_code, territory) "
+                "VALUES (?, ?, '+49 30 0000 0000', '1 Unter den Linden', "
+                        "'Germany', '10117', 'EMEA')");
+
+        AsyncSession db(defaultURI());
+
+        auto inserted = db.execAsync(INSERT_OFFICE, std::string("8"),
+                                     std::string("Berlin"));
+        auto removed  = db.execAsync("DELETE FROM offices WHERE code = ?",
+                                     std::string("8"));
+        auto count    = db.submit([](Session &session) {
+                return session.exec("SELECT COUNT(*) FROM offices WHERE code = '8'")
+                                .currentRow().get<int>(0);
+        });
+
+        inserted.get();
+        removed.get();
+
+        if (count.get() != 0) {
+                throw TestFailure("statements not executed in submission order");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::fetchAsync() // static
+{
+        static const size_t GET_EMEA_OFFICES = registerStatement(
+                "SELECT code, city FROM offices WHERE territory = ? "
+                "ORDER BY code");
+
+        AsyncSession db(defaultURI());
+
+        auto offices = db.fetchAsync<std::tuple<std::string, std::string>>(
+                                GET_EMEA_OFFICES, std::string("EMEA")).get();
+
+        if (offices.size() != 2) {
+                throw TestFailure("fetchAsync() returned %u rows, expected 2",
+                                  offices.size());
+        }
+        if (std::get<1>(offices[0]) != "Paris") {
+                throw TestFailure("first row has city \"%s\", expected \"Paris\"",
+                                  std::get<1>(offices[0]));
+        }
+        if (std::get<1>(offices[1]) != "London") {
+                throw TestFailure("second row has city \"%s\", expected \"London\"",
+                                  std::get<1>(offices[1]));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::fetchBatchesAsync() // static
+{
+        static const size_t GET_EMPLOYEE_NOS = registerStatement(
+                "SELECT number FROM employees ORDER BY number");
+
+        size_t expected = db_.exec("SELECT COUNT(*) FROM employees")
+                                .currentRow().get<size_t>(0);
+
+        AsyncSession                 db(defaultURI());
+        std::vector<size_t>          batch_sizes;
+        std::vector<std::tuple<int>> rows;
+
+        auto total = db.fetchBatchesAsync<std::tuple<int>>(
+                GET_EMPLOYEE_NOS, 10,
+                [&](std::vector<std::tuple<int>> &&batch) {
+                        batch_sizes.push_back(batch.size());
+                        rows.insert(rows.end(), batch.begin(), batch.end());
+                }).get();
+
+        if (total != expected) {
+                throw TestFailure("fetchBatchesAsync() delivered %u rows, expected %u",
+                                  total, expected);
+        }
+        if (rows.size() != expected) {
+                throw TestFailure("batches contained %u rows, expected %u",
+                                  rows.size(), expected);
+        }
+
+        for (size_t i = 0; i < batch_sizes.size(); ++i) {
+                if ((batch_sizes[i] != 10) && (i + 1 != batch_sizes.size())) {
+                        throw TestFailure("batch %u contained %u rows, expected 10",
+                                          i, batch_sizes[i]);
+                }
+        }
+
+        for (size_t i = 1; i < rows.size(); ++i) {
+                if (std::get<0>(rows[i - 1]) >= std::get<0>(rows[i])) {
+                        throw TestFailure("rows delivered out of order at row %u",
+                                          i);
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::errorPropagation() // static
+{
+        AsyncSession db(defaultURI());
+
+        auto failed = db.execAsync("SELECT * FROM no_such_table");
+        auto after  = db.submit([](Session &) { return 42; });
+
+        try {
+                failed.get();
+                throw TestFailure("invalid statement did not throw wr::sql::Error");
+        } catch (Error &) {
+        }
+
+        if (after.get() != 42) {
+                throw TestFailure("task following failed task did not execute");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::AsyncSessionTests::closeDrainsQueue() // static
+{
+        AsyncSession db(defaultURI());
+        int          executed = 0;
+
+        for (int i = 0; i < 100; ++i) {
+                db.post([&executed](Session &) { ++executed; });
+        }
+
+        db.close();
+
+        if (executed != 100) {
+                throw TestFailure("%d tasks executed before close() returned, expected 100",
+                                  executed);
+        }
+        if (db.isOpen()) {
+                throw TestFailure("db.isOpen() returned true after close()");
+        }
+}
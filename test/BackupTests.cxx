@@ -0,0 +1,465 @@
+/**
+ * \file BackupTests.cxx
+ *
+ * \brief Unit test module for class \c wr::sql::Backup and the related
+ *      members of class \c wr::sql::Session
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <wrsql/Backup.h>
+#include <wrsql/Error.h>
+#include <wrsql/ResultCache.h>
+#include <wrsql/Session.h>
+#include <wrsql/Transaction.h>
+
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class BackupTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        BackupTests(int argc, const char **argv);
+        virtual ~BackupTests();
+
+        int runAll();
+
+        static void stepwise(),
+                    abandoned(),
+                    sourceModified(),
+                    load(),
+                    backupToFile(),
+                    roundTrip(),
+                    sharedCache(),
+                    readOnlyView(),
+                    invalidUse();
+
+        static std::string copyURI()   { return copy_uri_; }
+
+private:
+        static std::string copy_uri_;
+};
+
+
+//--------------------------------------
+
+std::string BackupTests::copy_uri_;
+
+//--------------------------------------
+
+static const int NUM_ROWS = 2000;
+
+//--------------------------------------
+
+/*
+ * (re)create bk_rows in the default database with NUM_ROWS rows of ~200
+ * bytes, giving a database of around 100 pages
+ */
+static void
+createRows(
+        Session &db
+)
+{
+        db.exec("DROP TABLE IF EXISTS bk_rows");
+        db.exec("CREATE TABLE bk_rows (id INTEGER PRIMARY KEY, val TEXT)");
+        db.beginTransaction([&](Transaction &) {
+                for (int id = 1; id <= NUM_ROWS; ++id) {
+                        db.exec("INSERT INTO bk_rows VALUES (?, printf('%0200d', ?))",
+                                id, id);
+                }
+        });
+}
+
+//--------------------------------------
+
+static int
+countRows(
+        Session &db
+)
+{
+        return db.exec("SELECT COUNT(*) FROM bk_rows").currentRow().get<int>(0);
+}
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::BackupTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+wr::sql::BackupTests::BackupTests(
+        int          argc,
+        const char **argv
+) :
+        base_t("Backup", argc, argv)
+{
+        copy_uri_ = defaultURI().to_string() + "-copy";
+}
+
+//--------------------------------------
+
+wr::sql::BackupTests::~BackupTests()
+{
+        if (isParentProcess()) {
+                fs_error_code err;
+                remove(path(defaultPath().native() + "-copy"), err);
+        }
+}
+
+//--------------------------------------
+
+int
+wr::sql::BackupTests::runAll()
+{
+        run("step", 1, &stepwise);
+        run("step", 2, &abandoned);
+        run("step", 3, &sourceModified);
+        run("loadFrom", 1, &load);
+        run("backupTo", 1, &backupToFile);
+        run("serialize", 1, &roundTrip);
+        run("deserialize", 1, &sharedCache);
+        run("deserializeView", 1, &readOnlyView);
+        run("invalid", 1, &invalidUse);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::stepwise() // static
+{
+        Session src(defaultURI()), dest(":memory:");
+
+        createRows(src);
+
+        Backup backup(dest, src);
+        int    steps = 0;
+
+        while (!backup.step(10)) {
+                ++steps;
+                if (backup.remaining() != backup.pageCount() - 10 * steps) {
+                        throw TestFailure("%d pages remaining of %d after %d steps",
+                                          backup.remaining(),
+                                          backup.pageCount(), steps);
+                }
+        }
+
+        if (steps < 5) {
+                throw TestFailure("backup completed in %d steps, expected at least 5",
+                                  steps + 1);
+        } else if (backup.remaining() != 0) {
+                throw TestFailure("%d pages remaining after completion",
+                                  backup.remaining());
+        }
+
+        backup.close();
+
+        if (backup.isOpen()) {
+                throw TestFailure("backup still open after close()");
+        } else if (countRows(dest) != NUM_ROWS) {
+                throw TestFailure("copy holds %d rows, expected %d",
+                                  countRows(dest), NUM_ROWS);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::abandoned() // static
+{
+        Session src(defaultURI()), dest(":memory:");
+
+        createRows(src);
+        dest.exec("CREATE TABLE bk_rows (id INTEGER PRIMARY KEY, val TEXT)");
+        dest.exec("INSERT INTO bk_rows VALUES (1, 'original')");
+
+        int  calls = 0;
+        bool done = Backup(dest, src).run(10, {}, [&](int, int) {
+                return ++calls < 3;
+        });
+
+        if (done) {
+                throw TestFailure("run() reported completion after being abandoned");
+        } else if (calls != 3) {
+                throw TestFailure("progress callback called %d times, expected 3",
+                                  calls);
+        } else if (countRows(dest) != 1) {
+                throw TestFailure("abandoned backup changed the destination");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::sourceModified() // static
+{
+        Session src(defaultURI()), writer(defaultURI()), dest(":memory:");
+
+        createRows(src);
+
+        int  restarts = 0, last_remaining = INT_MAX;
+        bool done = Backup(dest, src).run(10, {}, [&](int remaining,
+                                                      int page_count) {
+                if (remaining > last_remaining) {
+                        ++restarts;
+                }
+                last_remaining = remaining;
+
+                /* another connection writes between steps part way through:
+                   the copy restarts */
+                if (remaining && (remaining < page_count - 30)
+                                && (countRows(writer) == NUM_ROWS)) {
+                        writer.exec("INSERT INTO bk_rows VALUES (NULL, 'late')");
+                }
+                return true;
+        });
+
+        if (!done) {
+                throw TestFailure("backup did not complete");
+        } else if (restarts != 1) {
+                throw TestFailure("backup restarted %d times, expected 1",
+                                  restarts);
+        } else if (countRows(dest) != NUM_ROWS + 1) {
+                throw TestFailure("copy holds %d rows, expected %d",
+                                  countRows(dest), NUM_ROWS + 1);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::load() // static
+{
+        {
+                Session src(defaultURI());
+                createRows(src);
+        }
+
+        auto    cache = std::make_shared<ResultCache>();
+        Session mem(":memory:");
+        int     calls = 0;
+
+        mem.setResultCache(cache);
+        mem.exec("CREATE TABLE bk_rows (id INTEGER PRIMARY KEY, val TEXT)");
+
+        static const size_t COUNT_ROWS = registerStatement(
+                                "SELECT COUNT(*) FROM bk_rows");
+        mem.execCached(COUNT_ROWS);
+
+        if (!mem.loadFrom(defaultURI(), [&](int, int) {
+                ++calls;
+                return true;
+        })) {
+                throw TestFailure("loadFrom() reported no completion");
+        } else if (calls != 1) {
+                throw TestFailure("progress callback called %d times for a small database, expected 1",
+                                  calls);
+        } else if (mem.execCached(COUNT_ROWS)->column(0).ints[0] != NUM_ROWS) {
+                throw TestFailure("cached results survived loadFrom()");
+        }
+
+        try {
+                mem.loadFrom(defaultURI().to_string() + "-missing");
+                throw TestFailure("loadFrom() accepted a nonexistent database");
+        } catch (Error &) {
+                // expected: opened read-only, so not created
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::backupToFile() // static
+{
+        Session src(defaultURI());
+
+        createRows(src);
+
+        int steps = 0;
+
+        if (!src.backupTo(copyURI(), [&](int, int) {
+                ++steps;
+                return true;
+        }, 20, std::chrono::milliseconds(1))) {
+                throw TestFailure("backupTo() reported no completion");
+        } else if (steps < 3) {
+                throw TestFailure("backup completed in %d steps, expected at least 3",
+                                  steps);
+        }
+
+        Session copy(copyURI());
+
+        if (countRows(copy) != NUM_ROWS) {
+                throw TestFailure("copy holds %d rows, expected %d",
+                                  countRows(copy), NUM_ROWS);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::roundTrip() // static
+{
+        Session src(defaultURI());
+
+        createRows(src);
+
+        auto image = src.serialize();
+
+        if (image.size() < 100 * 1024) {
+                throw TestFailure("image of %u bytes too small", image.size());
+        }
+
+        Session mem(":memory:");
+
+        mem.deserialize(image);
+
+        if (countRows(mem) != NUM_ROWS) {
+                throw TestFailure("deserialized database holds %d rows, expected %d",
+                                  countRows(mem), NUM_ROWS);
+        }
+
+        // writable and resizable, and its own image serializable in turn
+        mem.exec("INSERT INTO bk_rows SELECT NULL, val FROM bk_rows");
+
+        auto grown = mem.serialize();
+
+        if (grown.size() <= image.size()) {
+                throw TestFailure("image did not grow after insertions");
+        }
+
+        if (!Session(":memory:").serialize().empty()) {
+                throw TestFailure("image of empty database is not empty");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::sharedCache() // static
+{
+        static const size_t SELECT_VAL = registerStatement(
+                                "SELECT length(val) FROM bk_rows WHERE id = 1");
+
+        auto    cache = std::make_shared<ResultCache>();
+        Session a(defaultURI()), b(defaultURI()), mem(":memory:");
+
+        createRows(a);
+        a.setResultCache(cache);
+        b.setResultCache(cache);
+
+        mem.exec("CREATE TABLE bk_rows (id INTEGER PRIMARY KEY, val TEXT)");
+        mem.exec("INSERT INTO bk_rows VALUES (1, 'image')");
+        b.deserialize(mem.serialize());
+
+        if (b.execCached(SELECT_VAL)->column(0).ints[0] != 5) {
+                throw TestFailure("deserialized contents not returned");
+        } else if (a.execCached(SELECT_VAL)->column(0).ints[0] != 200) {
+                throw TestFailure("deserialized contents returned for original database");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::readOnlyView() // static
+{
+        Session src(defaultURI());
+
+        createRows(src);
+
+        auto    image = src.serialize();
+        Session mem(":memory:");
+
+        mem.deserializeView(image.data(), image.size());
+
+        if (countRows(mem) != NUM_ROWS) {
+                throw TestFailure("deserialized database holds %d rows, expected %d",
+                                  countRows(mem), NUM_ROWS);
+        }
+
+        try {
+                mem.exec("DELETE FROM bk_rows");
+                throw TestFailure("read-only image was modified");
+        } catch (Error &) {
+                // expected
+        }
+
+        mem.close();  // before image is destroyed
+}
+
+//--------------------------------------
+
+void
+wr::sql::BackupTests::invalidUse() // static
+{
+        Session db(":memory:"), closed;
+
+        try {
+                db.serialize("nonexistent");
+                throw TestFailure("serialize() accepted an unknown database name");
+        } catch (std::invalid_argument &) {
+                // expected
+        }
+
+        try {
+                db.deserialize({}, "nonexistent");
+                throw TestFailure("deserialize() accepted an unknown database name");
+        } catch (Error &) {
+                // expected
+        }
+
+        try {
+                Backup backup(db, closed);
+                throw TestFailure("Backup accepted a closed Session");
+        } catch (std::logic_error &) {
+                // expected
+        }
+
+        try {
+                Backup().step();
+                throw TestFailure("step() succeeded on unopened Backup");
+        } catch (std::logic_error &) {
+                // expected
+        }
+}
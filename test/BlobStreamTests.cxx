@@ -0,0 +1,415 @@
+/**
+ * \file BlobStreamTests.cxx
+ *
+ * \brief Unit test module for class \c wr::sql::BlobStream
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <wrsql/BlobStream.h>
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/Statement.h>
+
+#include "SampleDB.h"
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class BlobStreamTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        BlobStreamTests(int argc, const char **argv) :
+                base_t("BlobStream", argc, argv)
+        {
+                db_.init(defaultURI());
+                db_.exec("CREATE TABLE IF NOT EXISTS documents "
+                         "(id INTEGER PRIMARY KEY, body BLOB)");
+        }
+
+        virtual ~BlobStreamTests() { db_.close(); }
+
+        int runAll();
+
+        static void defaultConstruct(),
+                    openMissing(),
+                    writeChunked(),
+                    readChunked(),
+                    writeOutOfBounds(),
+                    writeReadOnly(),
+                    seek(),
+                    reopen(),
+                    reopenMissing(),
+                    expired();
+
+private:
+        static ID insertZeroBlob(size_t bytes);
+        static uint8_t pattern(size_t offset)
+                { return static_cast<uint8_t>((offset * 7) ^ (offset >> 8)); }
+
+        static SampleDB db_;
+};
+
+
+SampleDB BlobStreamTests::db_;
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::BlobStreamTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::BlobStreamTests::runAll()
+{
+        run("defaultConstruct", 1, &defaultConstruct);
+        run("open", 1, &openMissing);
+        run("write", 1, &writeChunked);
+        run("write", 2, &writeOutOfBounds);
+        run("write", 3, &writeReadOnly);
+        run("read", 1, &readChunked);
+        run("seek", 1, &seek);
+        run("reopen", 1, &reopen);
+        run("reopen", 2, &reopenMissing);
+        run("expired", 1, &expired);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+wr::sql::ID
+wr::sql::BlobStreamTests::insertZeroBlob(
+        size_t bytes
+) // static
+{
+        Statement insert(db_, "INSERT INTO documents (body) VALUES (?)");
+        insert.bindZeroBlob(1, bytes).begin();
+        return db_.lastInsertRowID();
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::defaultConstruct() // static
+{
+        BlobStream blob;
+
+        if (blob.isOpen()) {
+                throw TestFailure("blob.isOpen() returned true, expected false");
+        }
+        if (blob.size() != 0) {
+                throw TestFailure("blob.size() returned %u, expected 0",
+                                  blob.size());
+        }
+
+        char buf[16];
+
+        try {
+                blob.read(buf, sizeof(buf));
+        } catch (std::logic_error &) {
+                return;
+        }
+
+        throw TestFailure("read() from closed stream did not throw std::logic_error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::openMissing() // static
+{
+        try {
+                BlobStream blob(db_, "documents", "body", -1);
+        } catch (Error &) {
+                return;
+        }
+
+        throw TestFailure("opening nonexistent row did not throw wr::sql::Error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::writeChunked() // static
+{
+        static const size_t SIZE = 300000, CHUNK = 4096;
+
+        ID         id = insertZeroBlob(SIZE);
+        BlobStream blob(db_, "documents", "body", id, BlobStream::READ_WRITE);
+
+        if (!blob.isWritable()) {
+                throw TestFailure("blob.isWritable() returned false, expected true");
+        }
+        if (blob.size() != SIZE) {
+                throw TestFailure("blob.size() returned %u, expected %u",
+                                  blob.size(), SIZE);
+        }
+
+        uint8_t buf[CHUNK];
+
+        while (blob.tell() < SIZE) {
+                size_t n = std::min(CHUNK, SIZE - blob.tell());
+                for (size_t i = 0; i < n; ++i) {
+                        buf[i] = pattern(blob.tell() + i);
+                }
+                blob.write(buf, n);
+        }
+
+        blob.close();
+
+        Statement query(db_, "SELECT length(body), body FROM documents WHERE id=?");
+        auto      row = query.begin(id);
+        auto      len = row.get<size_t>(0);
+
+        if (len != SIZE) {
+                throw TestFailure("stored value has length %u, expected %u",
+                                  len, SIZE);
+        }
+
+        auto data = static_cast<const uint8_t *>(row.get<const void *>(1));
+
+        for (size_t i = 0; i < SIZE; ++i) {
+                if (data[i] != pattern(i)) {
+                        throw TestFailure("stored byte %u is %u, expected %u",
+                                          i, data[i], pattern(i));
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::writeOutOfBounds() // static
+{
+        ID         id = insertZeroBlob(100);
+        BlobStream blob(db_, "documents", "body", id, BlobStream::READ_WRITE);
+        char       buf[32] = {};
+
+        blob.seek(80);
+
+        try {
+                blob.write(buf, sizeof(buf));
+        } catch (std::length_error &) {
+                if (blob.tell() != 80) {
+                        throw TestFailure("failed write() moved position to %u, expected 80",
+                                          blob.tell());
+                }
+                return;
+        }
+
+        throw TestFailure("write() past end of value did not throw std::length_error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::writeReadOnly() // static
+{
+        ID         id = insertZeroBlob(100);
+        BlobStream blob(db_, "documents", "body", id);
+        char       buf[32] = {};
+
+        if (blob.isWritable()) {
+                throw TestFailure("blob.isWritable() returned true, expected false");
+        }
+
+        try {
+                blob.write(buf, sizeof(buf));
+        } catch (std::logic_error &) {
+                return;
+        }
+
+        throw TestFailure("write() to read-only stream did not throw std::logic_error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::readChunked() // static
+{
+        static const size_t SIZE = 10007, CHUNK = 1000;
+
+        std::vector<uint8_t> data(SIZE);
+
+        for (size_t i = 0; i < SIZE; ++i) {
+                data[i] = pattern(i);
+        }
+
+        Statement insert(db_, "INSERT INTO documents (body) VALUES (?)");
+        insert.bind(1, data.data(), data.size()).begin();
+
+        BlobStream blob(db_, "documents", "body", db_.lastInsertRowID());
+        uint8_t    buf[CHUNK];
+        size_t     total = 0, n;
+
+        while ((n = blob.read(buf, sizeof(buf))) != 0) {
+                if ((n != CHUNK) && (total + n != SIZE)) {
+                        throw TestFailure("read() returned %u bytes at offset %u, expected %u",
+                                          n, total, CHUNK);
+                }
+                if (memcmp(buf, &data[total], n) != 0) {
+                        throw TestFailure("data read at offset %u does not match data stored",
+                                          total);
+                }
+                total += n;
+        }
+
+        if (total != SIZE) {
+                throw TestFailure("read %u bytes in total, expected %u",
+                                  total, SIZE);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::seek() // static
+{
+        ID id = insertZeroBlob(64);
+
+        {
+                BlobStream blob(db_, "documents", "body", id,
+                                BlobStream::READ_WRITE);
+                blob.writeAt(60, "wxyz", 4);
+
+                if (blob.tell() != 0) {
+                        throw TestFailure("writeAt() moved position to %u, expected 0",
+                                          blob.tell());
+                }
+        }
+
+        BlobStream blob(db_, "documents", "body", id);
+        char       buf[8];
+
+        blob.seek(62);
+
+        size_t n = blob.read(buf, sizeof(buf));
+
+        if ((n != 2) || (memcmp(buf, "yz", 2) != 0)) {
+                throw TestFailure("read() after seek(62) returned %u bytes, expected \"yz\"",
+                                  n);
+        }
+        if (blob.tell() != 64) {
+                throw TestFailure("blob.tell() returned %u, expected 64",
+                                  blob.tell());
+        }
+        if (blob.readAt(64, buf, sizeof(buf)) != 0) {
+                throw TestFailure("readAt() at end of value returned data");
+        }
+
+        try {
+                blob.seek(65);
+        } catch (std::out_of_range &) {
+                return;
+        }
+
+        throw TestFailure("seek() past end of value did not throw std::out_of_range");
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::reopen() // static
+{
+        ID id1 = insertZeroBlob(10), id2 = insertZeroBlob(20);
+
+        BlobStream blob(db_, "documents", "body", id1);
+
+        blob.seek(5).reopen(id2);
+
+        if (blob.row() != id2) {
+                throw TestFailure("blob.row() returned %d, expected %d",
+                                  blob.row(), id2);
+        }
+        if (blob.size() != 20) {
+                throw TestFailure("blob.size() returned %u after reopen(), expected 20",
+                                  blob.size());
+        }
+        if (blob.tell() != 0) {
+                throw TestFailure("blob.tell() returned %u after reopen(), expected 0",
+                                  blob.tell());
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::reopenMissing() // static
+{
+        BlobStream blob(db_, "documents", "body", insertZeroBlob(10));
+
+        try {
+                blob.reopen(-1);
+        } catch (Error &) {
+                if (blob.isOpen()) {
+                        throw TestFailure("stream still open after failed reopen()");
+                }
+                return;
+        }
+
+        throw TestFailure("reopen() on nonexistent row did not throw wr::sql::Error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::BlobStreamTests::expired() // static
+{
+        ID         id = insertZeroBlob(10);
+        BlobStream blob(db_, "documents", "body", id);
+        char       buf[10];
+
+        db_.exec("UPDATE documents SET body=zeroblob(5) WHERE id=?", id);
+
+        try {
+                blob.read(buf, sizeof(buf));
+        } catch (Error &) {
+                blob.open(db_, "documents", "body", id);
+                if (blob.size() != 5) {
+                        throw TestFailure("blob.size() returned %u after open(), expected 5",
+                                          blob.size());
+                }
+                return;
+        }
+
+        throw TestFailure("read() from expired stream did not throw wr::sql::Error");
+}
@@ -0,0 +1,392 @@
+/**
+ * \file FunctionTests.cxx
+ *
+ * \brief Unit test module for class \c wr::sql::Function
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdint.h>
+#include <stdexcept>
+#include <string>
+
+#include <wrutil/optional.h>
+#include <wrutil/string_view.h>
+#include <wrutil/u8string_view.h>
+#include <wrsql/Error.h>
+#include <wrsql/Function.h>
+#include <wrsql/Session.h>
+#include <wrsql/SessionPool.h>
+
+#include "SampleDB.h"
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class FunctionTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        FunctionTests(int argc, const char **argv) :
+                base_t("Function", argc, argv)
+                { db_.init(defaultURI()); }
+
+        virtual ~FunctionTests() { db_.close(); }
+
+        int runAll();
+
+        static void scalarTyped(),
+                    scalarNull(),
+                    scalarVariadic(),
+                    deterministicIndex(),
+                    nonDeterministicIndex(),
+                    aggregateRows(),
+                    aggregateNoRows(),
+                    exceptionToError(),
+                    copySession(),
+                    sessionOptions();
+
+private:
+        static SampleDB db_;
+};
+
+
+SampleDB FunctionTests::db_;
+
+//--------------------------------------
+
+static int64_t
+fnv1a(
+        u8string_view s
+)
+{
+        uint64_t h = 14695981039346656037u;
+
+        // hash the UTF-8 bytes, not the code points
+        for (const char *p = s.data(), *e = p + s.bytes(); p != e; ++p) {
+                h = (h ^ static_cast<unsigned char>(*p)) * 1099511628211u;
+        }
+
+        return static_cast<int64_t>(h);
+}
+
+//--------------------------------------
+
+struct Product
+{
+        double value = 1;
+        int    rows = 0;
+};
+
+static Function
+productFunction()
+{
+        return Function::aggregate<Product>("product",
+                [](Product &p, double x) { p.value *= x; ++p.rows; },
+                [](Product &p) -> optional<double> {
+                        if (!p.rows) {
+                                return nullopt;
+                        }
+                        return p.value;
+                });
+}
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::FunctionTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::FunctionTests::runAll()
+{
+        run("scalar", 1, &scalarTyped);
+        run("scalar", 2, &scalarNull);
+        run("scalar", 3, &scalarVariadic);
+        run("flags", 1, &deterministicIndex);
+        run("flags", 2, &nonDeterministicIndex);
+        run("aggregate", 1, &aggregateRows);
+        run("aggregate", 2, &aggregateNoRows);
+        run("error", 1, &exceptionToError);
+        run("defineFunction", 1, &copySession);
+        run("SessionOptions", 1, &sessionOptions);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::scalarTyped() // static
+{
+        db_.defineFunction(Function::scalar("fnv1a", &fnv1a,
+                                            DETERMINISTIC_FUNCTION));
+
+        auto result = db_.exec("SELECT fnv1a(city) FROM offices "
+                               "WHERE code = 4");
+        auto hash = result.currentRow().get<int64_t>(0);
+
+        if (hash != fnv1a("Paris")) {
+                throw TestFailure("fnv1a('Paris') returned %d, expected %d",
+                                  hash, fnv1a("Paris"));
+        }
+
+        db_.defineFunction(Function::scalar("repeat",
+                [](std::string s, int n) {
+                        std::string out;
+                        while (n-- > 0) {
+                                out += s;
+                        }
+                        return out;
+                }));
+
+        result = db_.exec("SELECT repeat('ab', 3)");
+
+        if (result.currentRow().get<std::string>(0) != "ababab") {
+                throw TestFailure("repeat('ab', 3) returned \"%s\", expected \"ababab\"",
+                                  result.currentRow().get<std::string>(0));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::scalarNull() // static
+{
+        db_.defineFunction(Function::scalar("twice",
+                [](optional<int64_t> x) -> optional<int64_t> {
+                        if (!x) {
+                                return nullopt;
+                        }
+                        return *x * 2;
+                }));
+
+        auto result = db_.exec("SELECT twice(21), twice(NULL)");
+        Row  row = result.currentRow();
+
+        if (row.get<int64_t>(0) != 42) {
+                throw TestFailure("twice(21) returned %d, expected 42",
+                                  row.get<int64_t>(0));
+        } else if (!row.isNull(1)) {
+                throw TestFailure("twice(NULL) did not return NULL");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::scalarVariadic() // static
+{
+        db_.defineFunction(Function("num_nulls", -1,
+                [](FunctionResult &result, const FunctionArgs &args) {
+                        int64_t n = 0;
+                        for (int i = 0; i < args.size(); ++i) {
+                                n += args.isNull(i);
+                        }
+                        result.set(n);
+                }));
+
+        auto result = db_.exec("SELECT num_nulls(), "
+                               "num_nulls(1, NULL, 'x', NULL, NULL)");
+        Row  row = result.currentRow();
+
+        if ((row.get<int>(0) != 0) || (row.get<int>(1) != 3)) {
+                throw TestFailure("num_nulls() returned %d and %d, expected 0 and 3",
+                                  row.get<int>(0), row.get<int>(1));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::deterministicIndex() // static
+{
+        db_.defineFunction(Function::scalar("fnv1a", &fnv1a,
+                                            DETERMINISTIC_FUNCTION));
+
+        db_.exec("CREATE TEMP TABLE IF NOT EXISTS fn_words (word TEXT)");
+        db_.exec("DELETE FROM fn_words");
+        db_.exec("INSERT INTO fn_words VALUES ('alpha'), ('beta'), ('gamma')");
+        db_.exec("CREATE INDEX IF NOT EXISTS temp.fn_words_hash "
+                 "ON fn_words (fnv1a(word))");
+
+        auto result = db_.exec("SELECT word FROM fn_words "
+                               "WHERE fnv1a(word) = ?", fnv1a("beta"));
+
+        if (result.currentRow().get<std::string>(0) != "beta") {
+                throw TestFailure("lookup by indexed expression failed");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::nonDeterministicIndex() // static
+{
+        db_.defineFunction(Function::scalar("fnv1a_nd", &fnv1a));
+        db_.exec("CREATE TEMP TABLE IF NOT EXISTS fn_words (word TEXT)");
+
+        try {
+                db_.exec("CREATE INDEX temp.fn_words_hash_nd "
+                         "ON fn_words (fnv1a_nd(word))");
+        } catch (Error &) {
+                return;
+        }
+
+        throw TestFailure("index on non-deterministic function was created");
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::aggregateRows() // static
+{
+        db_.defineFunction(productFunction());
+
+        auto result = db_.exec("SELECT product(code) FROM offices "
+                               "WHERE code <= 5");
+        auto value = result.currentRow().get<double>(0);
+
+        if (value != 120) {
+                throw TestFailure("product(code) returned %g, expected 120",
+                                  value);
+        }
+
+        // each group is evaluated with its own state
+        result = db_.exec("SELECT country, product(code) FROM offices "
+                          "WHERE country IN ('USA', 'France') "
+                          "GROUP BY country ORDER BY country");
+
+        Row row = result.currentRow();
+
+        if ((row.get<std::string>(0) != "France")
+                        || (row.get<double>(1) != 4)) {
+                throw TestFailure("product(code) for France returned %g, expected 4",
+                                  row.get<double>(1));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::aggregateNoRows() // static
+{
+        db_.defineFunction(productFunction());
+
+        auto result = db_.exec("SELECT product(code) FROM offices "
+                               "WHERE 0");
+
+        if (!result.currentRow().isNull(0)) {
+                throw TestFailure("product() over no rows did not return NULL");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::exceptionToError() // static
+{
+        db_.defineFunction(Function::scalar("checked_sqrt",
+                [](double x) {
+                        if (x < 0) {
+                                throw std::domain_error("negative argument to checked_sqrt()");
+                        }
+                        return x;
+                }));
+
+        try {
+                db_.exec("SELECT checked_sqrt(-1)");
+        } catch (Error &e) {
+                string_view msg = e.what();
+                if (msg.find("negative argument") == msg.npos) {
+                        throw TestFailure("unexpected error message \"%s\"",
+                                          e.what());
+                }
+                return;
+        }
+
+        throw TestFailure("exception thrown by function did not cause wr::sql::Error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::copySession() // static
+{
+        db_.defineFunction(Function::scalar("answer", [] { return 42; }));
+
+        Session copy(db_);
+        auto    result = copy.exec("SELECT answer()");
+
+        if (result.currentRow().get<int>(0) != 42) {
+                throw TestFailure("function not defined on copy of Session");
+        }
+
+        Session closed;
+
+        try {
+                closed.defineFunction(Function::scalar("answer",
+                                                       [] { return 42; }));
+        } catch (std::logic_error &) {
+                return;
+        }
+
+        throw TestFailure("defineFunction() on closed Session did not throw std::logic_error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::FunctionTests::sessionOptions() // static
+{
+        SessionOptions options;
+        options.functions.push_back(productFunction());
+        options.functions.push_back(Function::scalar("fnv1a", &fnv1a,
+                                                     DETERMINISTIC_FUNCTION));
+
+        SessionPool pool(defaultURI(), options, 2);
+        auto        lease1 = pool.acquire(),
+                    lease2 = pool.acquire();
+
+        for (Session *db: { lease1.get(), lease2.get() }) {
+                auto result = db->exec("SELECT product(code), fnv1a('x') "
+                                       "FROM offices WHERE code <= 3");
+                Row  row = result.currentRow();
+
+                if ((row.get<double>(0) != 6)
+                                || (row.get<int64_t>(1) != fnv1a("x"))) {
+                        throw TestFailure("functions in SessionOptions not defined on pooled Session");
+                }
+        }
+}
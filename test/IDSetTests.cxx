@@ -22,8 +22,11 @@
  *
  * \endparblock
  */
+#include <algorithm>
+#include <iterator>
 #include <limits>
 #include <list>
+#include <set>
 #include <sstream>
 #include <vector>
 #include <sqlite3.h>
@@ -34,6 +37,7 @@
 
 #include "SampleDB.h"
 #include "SQLTestManager.h"
+#include "../src/IDSetKernels.h"
 #include "../src/IDSetPrivate.h"
 
 
@@ -58,6 +62,8 @@ public:
                                         bool expect_null),
                     checkContents_(const IDSet &set, const char *set_name,
                                    std::initializer_list<ID> expected_contents),
+                    checkMatches_(const IDSet &set, const char *set_name,
+                                  const std::set<ID> &expected),
                     defaultConstruct(),
                     constructFromInitializerList(),
                     constructFromSession(),
@@ -99,6 +105,8 @@ public:
                     insertStatementNonDefaultColumn(),
                     insertSQLNoBinding(),
                     insertSQLWithBinding(),
+                    insertRangeUnorderedLarge(),
+                    insertStatementUnorderedLarge(),
                     sqlInsert(),
                     eraseNonExistentID(),
                     eraseByIDSingle(),
@@ -131,6 +139,10 @@ public:
                     eraseSQLNoBinding(),
                     eraseSQLWithBinding(),
                     sqlDelete(),
+                    sqlSelectRange(),
+                    sqlSelectIn(),
+                    sqlJoinPlan(),
+                    sqlBoundSet(),
                     intersectThis(),
                     intersectIDSetEmptySet(),
                     intersectIDSetWithEmpty(),
@@ -154,6 +166,7 @@ public:
                     intersectInitializerListEqual(),
                     intersectSQLNoBinding(),
                     intersectSQLWithBinding(),
+                    intersectStatementUnordered(),
                     symmetricDifferenceThis(),
                     symmetricDifferenceIDSetEmptySet(),
                     symmetricDifferenceIDSetWithEmpty(),
@@ -206,7 +219,19 @@ public:
                     compareLess(),
                     compareLessOrEqual(),
                     compareGreater(),
-                    compareGreaterOrEqual();
+                    compareGreaterOrEqual(),
+                    compressedInsertErase(),
+                    compressedDense(),
+                    compressedEraseRange(),
+                    compressedSetOperations(),
+                    compressedSQL(),
+                    compressedCopyAndSwap(),
+                    kernelsMatchReference(),
+                    kernelsSkewedSets(),
+                    serializeRoundTrip(),
+                    serializeViewSearch(),
+                    serializeMalformed(),
+                    serializeSQL();
 
 private:
         static SampleDB db_;
@@ -281,6 +306,8 @@ wr::sql::IDSetTests::runAll()
         run("insert", 15, &insertStatementNonDefaultColumn);
         run("insert", 16, &insertSQLNoBinding);
         run("insert", 17, &insertSQLWithBinding);
+        run("insert", 18, &insertRangeUnorderedLarge);
+        run("insert", 19, &insertStatementUnorderedLarge);
         run("sqlInsert", 1, &sqlInsert);
 
         run("erase", 1, &eraseNonExistentID);
@@ -315,6 +342,11 @@ wr::sql::IDSetTests::runAll()
         run("erase", 30, &eraseSQLWithBinding);
         run("sqlDelete", 1, &sqlDelete);
 
+        run("sqlSelect", 1, &sqlSelectRange);
+        run("sqlSelect", 2, &sqlSelectIn);
+        run("sqlSelect", 3, &sqlJoinPlan);
+        run("sqlSelect", 4, &sqlBoundSet);
+
         run("intersect", 1, &intersectThis);
         run("intersect", 2, &intersectIDSetEmptySet);
         run("intersect", 3, &intersectIDSetWithEmpty);
@@ -338,6 +370,7 @@ wr::sql::IDSetTests::runAll()
         run("intersect", 21, &intersectInitializerListEqual);
         run("intersect", 22, &intersectSQLNoBinding);
         run("intersect", 23, &intersectSQLWithBinding);
+        run("intersect", 24, &intersectStatementUnordered);
 
         run("symmetricDifference", 1, &symmetricDifferenceThis);
         run("symmetricDifference", 2, &symmetricDifferenceIDSetEmptySet);
@@ -403,6 +436,21 @@ wr::sql::IDSetTests::runAll()
         run("compareGreater", 1, &compareGreater);
         run("compareGreaterOrEqual", 1, &compareGreaterOrEqual);
 
+        run("compressed", 1, &compressedInsertErase);
+        run("compressed", 2, &compressedDense);
+        run("compressed", 3, &compressedEraseRange);
+        run("compressed", 4, &compressedSetOperations);
+        run("compressed", 5, &compressedSQL);
+        run("compressed", 6, &compressedCopyAndSwap);
+
+        run("kernels", 1, &kernelsMatchReference);
+        run("kernels", 2, &kernelsSkewedSets);
+
+        run("serialize", 1, &serializeRoundTrip);
+        run("serialize", 2, &serializeViewSearch);
+        run("serialize", 3, &serializeMalformed);
+        run("serialize", 4, &serializeSQL);
+
         return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
@@ -449,9 +497,9 @@ wr::sql::IDSetTests::checkContents_(
         std::initializer_list<ID>  expected_contents
 ) // static
 {
-        if (set.body_->storage_.size() != expected_contents.size()) {
+        if (set.size() != expected_contents.size()) {
                 throw TestFailure("%s contains %u element(s), expected %u",
-                                  set_name, set.body_->storage_.size(),
+                                  set_name, set.size(),
                                   expected_contents.size());
         }
 
@@ -465,10 +513,9 @@ wr::sql::IDSetTests::checkContents_(
         auto j = expected_contents.begin();
 
         for (IDSet::size_type i = 0; i < expected_contents.size(); ++i, ++j) {
-                if (set.body_->storage_[i] != *j) {
-                        throw TestFailure("%s.body_->storage_[%u] is %d, expected %d",
-                                          set_name, i,
-                                          set.body_->storage_[i], *j);
+                if (set[i] != *j) {
+                        throw TestFailure("%s[%u] is %d, expected %d",
+                                          set_name, i, set[i], *j);
                 }
                 if (query) {
                         if (!query.currentRow()) {
@@ -488,6 +535,54 @@ wr::sql::IDSetTests::checkContents_(
 
 #define checkContents(set, ...) checkContents_(set, #set, {__VA_ARGS__})
 
+#define checkMatches(set, expected) checkMatches_(set, #set, expected)
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::checkMatches_(
+        const IDSet        &set,
+        const char         *set_name,
+        const std::set<ID> &expected
+) // static
+{
+        if (set.size() != expected.size()) {
+                throw TestFailure("%s contains %u element(s), expected %u",
+                                  set_name, set.size(), expected.size());
+        }
+
+        IDSet::size_type i = 0;
+        auto             j = set.begin();
+
+        for (ID id: expected) {
+                if (*j != id) {
+                        throw TestFailure("element %u of %s is %d, expected %d",
+                                          i, set_name, *j, id);
+                }
+                ++i, ++j;
+        }
+
+        if (j != set.end()) {
+                throw TestFailure("iteration of %s did not finish at end()",
+                                  set_name);
+        }
+
+        if (!std::equal(set.rbegin(), set.rend(), expected.rbegin())) {
+                throw TestFailure("reverse iteration of %s does not match",
+                                  set_name);
+        }
+
+        if (!expected.empty()) {
+                for (i = 0; i < expected.size(); i += expected.size() / 7 + 1) {
+                        ID id = *std::next(expected.begin(), i);
+                        if (set[i] != id) {
+                                throw TestFailure("%s[%u] is %d, expected %d",
+                                                  set_name, i, set[i], id);
+                        }
+                }
+        }
+}
+
 //--------------------------------------
 
 void
@@ -984,7 +1079,7 @@ wr::sql::IDSetTests::insertSingleIntoEmpty() // static
         IDSet set(db_);
         auto  ins = set.insert(1);
 
-        if (ins.first != set.body_->storage_.begin()) {
+        if (ins.first != set.begin()) {
                 throw TestFailure("returned iterator invalid, expected iterator to beginning of set");
         }
         if (!ins.second) {
@@ -1002,7 +1097,7 @@ wr::sql::IDSetTests::insertSingleExisting() // static
         IDSet set(db_, { 1 });
         auto  ins = set.insert(1);
 
-        if (ins.first != set.body_->storage_.begin()) {
+        if (ins.first != set.begin()) {
                 throw TestFailure("returned iterator invalid, expected iterator to beginning of set");
         }
         if (ins.second) {
@@ -1020,7 +1115,7 @@ wr::sql::IDSetTests::insertSingleAtStart() // static
         IDSet set(db_, { 1, 2, 3 });
         auto  ins = set.insert(0);
 
-        if (ins.first != set.body_->storage_.begin()) {
+        if (ins.first != set.begin()) {
                 throw TestFailure("returned iterator invalid, expected iterator to beginning of set");
         }
         if (!ins.second) {
@@ -1038,7 +1133,7 @@ wr::sql::IDSetTests::insertSingleAtEnd() // static
         IDSet set(db_, { 1, 2, 3 });
         auto  ins = set.insert(4);
 
-        if (ins.first != std::prev(set.body_->storage_.end())) {
+        if (ins.first != std::prev(set.end())) {
                 throw TestFailure("returned iterator invalid, expected iterator to last element of set");
         }
         if (!ins.second) {
@@ -1056,7 +1151,7 @@ wr::sql::IDSetTests::insertSingleInMiddle() // static
         IDSet set(db_, { 0, 2 });
         auto  ins = set.insert(1);
 
-        if (ins.first != std::next(set.body_->storage_.begin())) {
+        if (ins.first != std::next(set.begin())) {
                 throw TestFailure("returned iterator invalid, expected iterator to second element of set");
         }
         if (!ins.second) {
@@ -1268,6 +1363,69 @@ wr::sql::IDSetTests::sqlInsert() // static
 
 //--------------------------------------
 
+void
+wr::sql::IDSetTests::insertRangeUnorderedLarge() // static
+{
+        std::vector<ID> src;
+        std::set<ID>    expected;
+        uint64_t        seed = 1;
+
+        for (int i = 0; i < 50000; ++i) {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                ID id = static_cast<ID>(seed >> 40) - (1 << 23);
+                src.push_back(id);
+                src.push_back(id);  // duplicates must be ignored
+                expected.insert(id);
+        }
+
+        IDSet set(db_, { 0, 5, 7 });
+        expected.insert({ 0, 5, 7 });
+
+        auto n = set.insert(src.begin(), src.end()),
+             expected_n = expected.size() - 3;
+
+        if (n != expected_n) {
+                throw TestFailure("set.insert(first, last) returned %u, expected %u",
+                                  n, expected_n);
+        }
+
+        checkMatches(set, expected);
+
+        n = set.insert(src.rbegin(), src.rend());
+
+        if (n != 0) {
+                throw TestFailure("second set.insert(first, last) returned %u, expected 0",
+                                  n);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::insertStatementUnorderedLarge() // static
+{
+        IDSet        set(db_);
+        std::set<ID> expected;
+
+        for (ID i = 1; i <= 20000; ++i) {
+                expected.insert((i * 7919) % 100003);
+        }
+
+        auto n = set.insert_sql("WITH RECURSIVE seq(i) AS (SELECT 1 UNION ALL "
+                                "SELECT i + 1 FROM seq WHERE i < 20000) "
+                                "SELECT (i * 7919) % 100003 FROM seq "
+                                "UNION ALL SELECT 7919");
+
+        if (n != expected.size()) {
+                throw TestFailure("set.insert_sql() returned %u, expected %u",
+                                  n, expected.size());
+        }
+
+        checkMatches(set, expected);
+}
+
+//--------------------------------------
+
 void
 wr::sql::IDSetTests::eraseNonExistentID() // static
 {
@@ -1775,6 +1933,238 @@ wr::sql::IDSetTests::sqlDelete() // static
 
 //--------------------------------------
 
+namespace {
+
+std::vector<wr::sql::ID>
+queryIDs(
+        wr::sql::Session           &db,
+        const wr::sql::IDSet       &set,
+        const char                 *where
+)
+{
+        std::vector<wr::sql::ID> ids;
+
+        for (auto row: db.exec(wr::printStr("SELECT id FROM %s WHERE %s "
+                                              "ORDER BY id", set, where))) {
+                ids.push_back(row.get<wr::sql::ID>(0));
+        }
+
+        return ids;
+}
+
+} // anonymous namespace
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::sqlSelectRange() // static
+{
+        static const struct
+        {
+                const char      *where;
+                std::vector<ID>  expected;
+        } cases[] = {
+                { "id > 5 AND id <= 15",         { 10, 15 } },
+                { "id >= 5.5",                   { 10, 15, 20 } },
+                { "id < 5.5",                    { 1, 5 } },
+                { "id = 10",                     { 10 } },
+                { "id = 10.0",                   { 10 } },
+                { "id = 10.5",                   {} },
+                { "id = '15'",                   { 15 } },
+                { "id > 'abc'",                  {} },
+                { "id < 'abc'",                  { 1, 5, 10, 15, 20 } },
+                { "id = NULL",                   {} },
+                { "id > 20",                     {} },
+                { "rowid BETWEEN 2 AND 14",      { 5, 10 } },
+                { "id > 9223372036854775807",    {} },
+                { "id >= -1e300 AND id < 1e300", { 1, 5, 10, 15, 20 } },
+                { "id > 3 AND id < 4",           {} }
+        };
+
+        for (auto mode: { IDSet::VECTOR_STORAGE, IDSet::COMPRESSED_STORAGE }) {
+                IDSet set(db_, mode);
+                set.insert({ 1, 5, 10, 15, 20 });
+
+                for (const auto &c: cases) {
+                        auto ids = queryIDs(db_, set, c.where);
+                        if (ids != c.expected) {
+                                throw TestFailure("storage mode %d: \"WHERE %s\" returned %u row(s), expected %u",
+                                                  static_cast<int>(mode),
+                                                  c.where, ids.size(),
+                                                  c.expected.size());
+                        }
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::sqlSelectIn() // static
+{
+        for (auto mode: { IDSet::VECTOR_STORAGE, IDSet::COMPRESSED_STORAGE }) {
+                IDSet set(db_, mode);
+                set.insert({ 1, 5, 10, 15, 20, 1002, 1056, 9999 });
+
+                auto ids = queryIDs(db_, set, "id IN (20, 1, 7, 15, 1)");
+                if (ids != std::vector<ID>({ 1, 15, 20 })) {
+                        throw TestFailure("storage mode %d: IN list returned %u row(s), expected 3",
+                                          static_cast<int>(mode), ids.size());
+                }
+
+                ids = queryIDs(db_, set,
+                               "id IN (5, 10.0, 10.5, 'x', NULL) AND id > 5");
+                if (ids != std::vector<ID>({ 10 })) {
+                        throw TestFailure("storage mode %d: mixed IN list returned %u row(s), expected 1",
+                                          static_cast<int>(mode), ids.size());
+                }
+
+                ids = queryIDs(db_, set,
+                               "id IN (SELECT number FROM employees)");
+                if (ids != std::vector<ID>({ 1002, 1056 })) {
+                        throw TestFailure("storage mode %d: IN subquery returned %u row(s), expected 2",
+                                          static_cast<int>(mode), ids.size());
+                }
+
+                // unordered output when the IN list is not taken all at once
+                size_t n = 0;
+                for (auto row: db_.exec(printStr(
+                                "SELECT id FROM %s WHERE id IN (15, 1) "
+                                "AND id IN (1, 15, 20)", set))) {
+                        (void) row;
+                        ++n;
+                }
+                if (n != 2) {
+                        throw TestFailure("storage mode %d: two IN lists returned %u row(s), expected 2",
+                                          static_cast<int>(mode), n);
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::sqlJoinPlan() // static
+{
+        /* without ANALYZE data SQLite assumes the employees table holds
+           about a million rows, so the large set must exceed that */
+        std::vector<ID> ids;
+        for (ID id = 0; id < 4000000; id += 2) {
+                ids.push_back(id);
+        }
+
+        IDSet large(db_), small(db_, { 1002, 1056, 1 });
+        large.insert(ids.begin(), ids.end());
+
+        auto plan = [](const IDSet &set) {
+                std::vector<std::string> details;
+                for (auto row: db_.exec(printStr(
+                                "EXPLAIN QUERY PLAN SELECT e.number "
+                                "FROM employees e JOIN %s s "
+                                "ON s.id = e.number", set))) {
+                        details.push_back(row.get<std::string>(3));
+                }
+                return details;
+        };
+
+        // probe a large set from each row of the much smaller table
+        auto details = plan(large);
+        if ((details.size() != 2)
+                        || (details[0].find("VIRTUAL TABLE") != std::string::npos)
+                        || (details[1].find("VIRTUAL TABLE INDEX 0:=")
+                                                        == std::string::npos)) {
+                throw TestFailure("join with large set not planned with set as inner lookup (%s / %s)",
+                                  details.empty() ? "" : details[0],
+                                  details.size() < 2 ? "" : details[1]);
+        }
+
+        // scan a small set, looking up each element in the table
+        details = plan(small);
+        if (details.empty()
+                        || (details[0].find("VIRTUAL TABLE") == std::string::npos)) {
+                throw TestFailure("join with small set not planned with set as outer loop (%s)",
+                                  details.empty() ? "" : details[0]);
+        }
+
+        size_t n = 0;
+        for (auto row: db_.exec(printStr("SELECT e.number FROM employees e "
+                                         "JOIN %s s ON s.id = e.number",
+                                         large))) {
+                if (row.get<ID>(0) % 2) {
+                        throw TestFailure("join returned odd ID %d",
+                                          row.get<ID>(0));
+                }
+                ++n;
+        }
+        if (!n) {
+                throw TestFailure("join with large set returned no rows");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::sqlBoundSet() // static
+{
+        auto schemaVersion = [] {
+                return db_.exec("PRAGMA temp.schema_version").currentRow()
+                          .get<int64_t>(0);
+        };
+
+        for (auto mode: { IDSet::VECTOR_STORAGE, IDSet::COMPRESSED_STORAGE }) {
+                IDSet a(mode), b(mode);  // neither is attached
+                a.insert({ 1, 1002, 1056 });
+                b.insert({ 1056, 1076, 1088, 9999 });
+
+                Statement count(db_, "SELECT COUNT(*) FROM employees "
+                                     "WHERE number IN idset(?)");
+                auto      version = schemaVersion();
+
+                // one statement reused with different sets
+                for (auto &c: { std::make_pair(&a, 2), std::make_pair(&b, 3),
+                                std::make_pair(&a, 2) }) {
+                        int n = count.begin(*c.first).get<int>(0);
+                        if (n != c.second) {
+                                throw TestFailure("storage mode %d: IN idset(?) matched %d row(s), expected %d",
+                                                  static_cast<int>(mode), n,
+                                                  c.second);
+                        }
+                }
+
+                if (schemaVersion() != version) {
+                        throw TestFailure("storage mode %d: binding IDSet changed temp schema",
+                                          static_cast<int>(mode));
+                }
+
+                std::vector<ID> ids;
+                for (auto row: db_.exec("SELECT id FROM idset(?) "
+                                        "WHERE id > 1056 ORDER BY id", b)) {
+                        ids.push_back(row.get<ID>(0));
+                }
+                if (ids != std::vector<ID>({ 1076, 1088, 9999 })) {
+                        throw TestFailure("storage mode %d: range over idset(?) returned %u row(s), expected 3",
+                                          static_cast<int>(mode), ids.size());
+                }
+
+                auto result = db_.exec("SELECT COUNT(*) FROM employees e "
+                                       "JOIN idset(?) s ON s.id = e.number",
+                                       b);
+                if (result.currentRow().get<int>(0) != 3) {
+                        throw TestFailure("storage mode %d: join with idset(?) returned %d row(s), expected 3",
+                                          static_cast<int>(mode),
+                                          result.currentRow().get<int>(0));
+                }
+        }
+
+        // a parameter left unbound is an empty set
+        Statement count(db_, "SELECT COUNT(*) FROM idset(?)");
+        if (count.begin().get<int>(0) != 0) {
+                throw TestFailure("idset(NULL) was not empty");
+        }
+}
+
+//--------------------------------------
+
 void
 wr::sql::IDSetTests::intersectThis() // static
 {
@@ -2165,6 +2555,24 @@ wr::sql::IDSetTests::intersectSQLWithBinding() // static
 
 //--------------------------------------
 
+void
+wr::sql::IDSetTests::intersectStatementUnordered() // static
+{
+        IDSet set(db_, { 1002, 1056, 1076, 1143, 1165, 1500, 1611 });
+        Statement stmt(db_, "SELECT number FROM employees "
+                            "ORDER BY number DESC");
+        auto  n = set.intersect(stmt);
+
+        if (n != 1) {
+                throw TestFailure("set.intersect(stmt) returned %u, expected 1",
+                                  n);
+        }
+
+        checkContents(set, 1002, 1056, 1076, 1143, 1165, 1611);
+}
+
+//--------------------------------------
+
 void
 wr::sql::IDSetTests::symmetricDifferenceThis() // static
 {
@@ -3290,3 +3698,739 @@ wr::sql::IDSetTests::compareGreaterOrEqual() // static
                 throw TestFailure("set5 should compare greater than set4");
         }
 }
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::compressedInsertErase() // static
+{
+        IDSet        set(IDSet::COMPRESSED_STORAGE);
+        std::set<ID> expected;
+        uint64_t     seed = 12345;
+
+        if (set.storageMode() != IDSet::COMPRESSED_STORAGE) {
+                throw TestFailure("set.storageMode() is %d, expected COMPRESSED_STORAGE",
+                                  static_cast<int>(set.storageMode()));
+        }
+
+        for (int i = 0; i < 20000; ++i) {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                ID   id  = static_cast<ID>(seed >> 44) - 300000;
+                auto ins = set.insert(id);
+
+                if (ins.second != expected.insert(id).second) {
+                        throw TestFailure("set.insert(%d) returned insertion flag %s",
+                                          id, ins.second ? "true" : "false");
+                }
+                if (*ins.first != id) {
+                        throw TestFailure("set.insert(%d) returned iterator to %d",
+                                          id, *ins.first);
+                }
+        }
+
+        checkMatches(set, expected);
+
+        size_t n = 0;
+
+        for (auto i = expected.begin(); i != expected.end(); ++n) {
+                if (n % 3) {
+                        ++i;
+                } else {
+                        if (set.erase(*i) != 1) {
+                                throw TestFailure("set.erase(%d) returned 0, expected 1",
+                                                  *i);
+                        }
+                        i = expected.erase(i);
+                }
+        }
+
+        if (set.erase(-300001) != 0) {
+                throw TestFailure("set.erase(-300001) returned 1, expected 0");
+        }
+
+        checkMatches(set, expected);
+
+        if (set.lower_bound(1 << 20) != set.end()) {
+                throw TestFailure("set.lower_bound(1 << 20) did not return set.end()");
+        }
+
+        for (ID id: { ID(-300000), ID(0), ID(5), ID(700000) }) {
+                if (*set.lower_bound(id) != *expected.lower_bound(id)) {
+                        throw TestFailure("*set.lower_bound(%d) is %d, expected %d",
+                                          id, *set.lower_bound(id),
+                                          *expected.lower_bound(id));
+                }
+                if (set.count(id) != expected.count(id)) {
+                        throw TestFailure("set.count(%d) is %u, expected %u",
+                                          id, set.count(id),
+                                          expected.count(id));
+                }
+        }
+
+        auto i = set.find(*std::next(expected.begin(), 100));
+
+        if (set.erase(i) != set.upper_bound(*std::next(expected.begin(), 100))) {
+                throw TestFailure("set.erase(iterator) did not return iterator to following element");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::compressedDense() // static
+{
+        IDSet        set(IDSet::COMPRESSED_STORAGE);
+        std::set<ID> expected;
+
+        for (ID id = 200000; id >= 0; --id) {  // descending insertion
+                set.insert(id);
+                expected.insert(id);
+        }
+
+        checkMatches(set, expected);
+
+        // punch holes, forcing some chunks back from bitmaps to arrays
+        for (ID id = 65536; id < 131072; ++id) {
+                if (id % 32) {
+                        set.erase(id);
+                        expected.erase(id);
+                }
+        }
+
+        checkMatches(set, expected);
+
+        auto range = set.equal_range(65568);
+
+        if ((range.second - range.first != 1) || (*range.first != 65568)) {
+                throw TestFailure("set.equal_range(65568) returned wrong range");
+        }
+        if (*set.upper_bound(65568) != 65600) {
+                throw TestFailure("*set.upper_bound(65568) is %d, expected 65600",
+                                  *set.upper_bound(65568));
+        }
+        if (set.end() - set.begin() != static_cast<ptrdiff_t>(expected.size())) {
+                throw TestFailure("set.end() - set.begin() is %d, expected %u",
+                                  set.end() - set.begin(), expected.size());
+        }
+
+        set.shrink_to_fit();  // encode runs
+        checkMatches(set, expected);
+
+        if (set.capacity() < set.size()) {
+                throw TestFailure("set.capacity() returned %u after set.shrink_to_fit(), expected at least %u",
+                                  set.capacity(), set.size());
+        }
+
+        set.insert(65537);
+        set.erase(5);
+        expected.insert(65537);
+        expected.erase(5);
+        checkMatches(set, expected);
+
+        auto i = set.lower_bound(150000);
+        if ((*(i + 1000) != 151000) || (*(i - 1000) != 149000)
+                                    || (i[-3] != 149997)) {
+                throw TestFailure("iterator arithmetic within runs failed");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::compressedEraseRange() // static
+{
+        IDSet        set(IDSet::COMPRESSED_STORAGE);
+        std::set<ID> expected;
+
+        for (ID id = -100000; id < 300000; id += 3) {
+                set.insert(id);
+                expected.insert(id);
+        }
+
+        auto i = set.erase(set.lower_bound(-50000), set.lower_bound(250000));
+        expected.erase(expected.lower_bound(-50000),
+                       expected.lower_bound(250000));
+
+        if (*i != *expected.lower_bound(250000)) {
+                throw TestFailure("set.erase(first, last) returned iterator to %d, expected %d",
+                                  *i, *expected.lower_bound(250000));
+        }
+
+        checkMatches(set, expected);
+
+        set.erase(set.lower_bound(260000), set.lower_bound(260100));
+        expected.erase(expected.lower_bound(260000),
+                       expected.lower_bound(260100));
+        checkMatches(set, expected);
+
+        i = set.erase(set.lower_bound(0), set.end());
+        expected.erase(expected.lower_bound(0), expected.end());
+
+        if (i != set.end()) {
+                throw TestFailure("set.erase(first, set.end()) did not return set.end()");
+        }
+
+        checkMatches(set, expected);
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::compressedSetOperations() // static
+{
+        IDSet vec1, comp1(IDSet::COMPRESSED_STORAGE),
+              small, large(IDSet::COMPRESSED_STORAGE);
+
+        for (ID id = 0; id < 100000; id += 2) {
+                vec1.insert(id);
+                comp1.insert(id);
+        }
+        for (ID id = 50000; id < 55000; id += 3) {
+                small.insert(id);
+        }
+        for (ID id = 40000; id < 160000; id += 5) {
+                large.insert(id);
+        }
+
+        if (vec1 != comp1) {
+                throw TestFailure("vec1 should compare equal to comp1");
+        }
+
+        for (const IDSet *other: { &small, &large }) {
+                IDSet vec2 = vec1, comp2 = comp1;
+
+                if (comp2.storageMode() != IDSet::COMPRESSED_STORAGE) {
+                        throw TestFailure("copy of comp1 does not use COMPRESSED_STORAGE");
+                }
+
+                auto n = vec2.insert(*other), m = comp2.insert(*other);
+                if ((n != m) || (vec2 != comp2)) {
+                        throw TestFailure("insert() results differ (%u vs %u)",
+                                          n, m);
+                }
+
+                vec2 = vec1, comp2 = comp1;
+                n = vec2.erase(*other), m = comp2.erase(*other);
+                if ((n != m) || (vec2 != comp2)) {
+                        throw TestFailure("erase() results differ (%u vs %u)",
+                                          n, m);
+                }
+
+                vec2 = vec1, comp2 = comp1;
+                n = vec2.intersect(*other), m = comp2.intersect(*other);
+                if ((n != m) || (vec2 != comp2)) {
+                        throw TestFailure("intersect() results differ (%u vs %u)",
+                                          n, m);
+                }
+
+                vec2 = vec1, comp2 = comp1;
+                vec2.symmetric_difference(*other);
+                comp2.symmetric_difference(*other);
+                if (vec2 != comp2) {
+                        throw TestFailure("symmetric_difference() results differ");
+                }
+
+                // vector-mode set operating on a compressed one
+                vec2 = vec1;
+                vec2.intersect(comp1);
+                if (vec2 != comp1) {
+                        throw TestFailure("vec2 should compare equal to comp1");
+                }
+        }
+
+        if (!(comp1 < small) || (small < comp1) || !(vec1 <= comp1)) {
+                throw TestFailure("ordering of compressed and vector sets is inconsistent");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::compressedSQL() // static
+{
+        IDSet set(db_, IDSet::COMPRESSED_STORAGE);
+        db_.exec(printStr("INSERT INTO %s SELECT number FROM employees "
+                                "WHERE office_code IN (1, 2, 3)", set));
+        checkContents(set, 1002, 1056, 1076, 1143, 1165, 1166, 1188, 1216,
+                      1286, 1323);
+
+        db_.exec(printStr("DELETE FROM %s WHERE id > 1200", set));
+        checkContents(set, 1002, 1056, 1076, 1143, 1165, 1166, 1188);
+
+        set.insert_sql("SELECT number FROM customers");
+        IDSet vec(db_);
+        vec.insert_sql("SELECT number FROM customers");
+        vec.insert({ 1002, 1056, 1076, 1143, 1165, 1166, 1188 });
+
+        if (set != vec) {
+                throw TestFailure("set should compare equal to vec");
+        }
+
+        auto n = db_.exec(printStr("SELECT COUNT(*) FROM %s", set))
+                    .currentRow().get<ID>(0);
+
+        if (n != static_cast<ID>(set.size())) {
+                throw TestFailure("SQL access of set returned %u value(s), expected %u",
+                                  n, set.size());
+        }
+
+        set.intersect_sql(printStr("SELECT id FROM %s WHERE id %% 2 = 0 "
+                                   "ORDER BY id", vec));
+        vec.intersect_sql(printStr("SELECT id FROM %s WHERE id %% 2 = 0 "
+                                   "ORDER BY id", vec));
+
+        if (set != vec) {
+                throw TestFailure("set should compare equal to vec after intersect_sql()");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::compressedCopyAndSwap() // static
+{
+        IDSet comp(db_, IDSet::COMPRESSED_STORAGE), vec(db_, { 7, 8, 9 });
+        comp.insert({ 1, 2, 3 });
+
+        IDSet copy(comp);
+
+        if (copy.storageMode() != IDSet::COMPRESSED_STORAGE) {
+                throw TestFailure("copy.storageMode() is not COMPRESSED_STORAGE");
+        }
+
+        copy = vec;
+
+        if (copy.storageMode() != IDSet::COMPRESSED_STORAGE) {
+                throw TestFailure("copy assignment changed storage mode");
+        }
+        checkContents(copy, 7, 8, 9);
+
+        vec.swap(comp);
+
+        if ((vec.storageMode() != IDSet::COMPRESSED_STORAGE)
+                        || (comp.storageMode() != IDSet::VECTOR_STORAGE)) {
+                throw TestFailure("swap() did not exchange storage modes");
+        }
+        checkContents(vec, 1, 2, 3);
+        checkContents(comp, 7, 8, 9);
+
+        IDSet moved(std::move(vec));
+
+        if (moved.storageMode() != IDSet::COMPRESSED_STORAGE) {
+                throw TestFailure("moved.storageMode() is not COMPRESSED_STORAGE");
+        }
+        checkContents(moved, 1, 2, 3);
+}
+
+//--------------------------------------
+
+namespace {
+
+/*
+ * sorted, duplicate-free vector of up to n IDs drawn from [0, range)
+ */
+std::vector<wr::sql::ID>
+randomIDs(
+        uint64_t   &seed,
+        size_t      n,
+        wr::sql::ID range
+)
+{
+        std::set<wr::sql::ID> ids;
+
+        for (size_t i = 0; i < n; ++i) {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                ids.insert(static_cast<wr::sql::ID>((seed >> 16) % range) - range / 2);
+        }
+
+        return std::vector<wr::sql::ID>(ids.begin(), ids.end());
+}
+
+} // anonymous namespace
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::kernelsMatchReference() // static
+{
+        static const size_t sizes[] = { 0, 1, 3, 4, 5, 8, 17, 100, 1000, 5000 };
+        SetKernelISA        orig_isa = setKernelISA();
+        uint64_t            seed = 1;
+
+        for (auto isa: { SCALAR_KERNELS, SSE4_KERNELS, AVX2_KERNELS,
+                         NEON_KERNELS }) {
+                if (!selectSetKernelISA(isa)) {
+                        continue;
+                }
+
+                for (size_t na: sizes) for (size_t nb: sizes) {
+                        // vary density so that overlap ranges from none to most
+                        ID   range = static_cast<ID>(std::max(na, nb) * 2 + 1);
+                        auto a = randomIDs(seed, na, range),
+                             b = randomIDs(seed, nb, range);
+
+                        std::vector<ID> expected, out(a.size() + b.size()),
+                                        in_place;
+                        size_t          n;
+
+                        expected.clear();
+                        std::set_intersection(a.begin(), a.end(), b.begin(),
+                                              b.end(),
+                                              std::back_inserter(expected));
+                        in_place = a;
+                        n = sortedIntersection(in_place.data(), a.size(),
+                                               b.data(), b.size(),
+                                               in_place.data());
+                        in_place.resize(n);
+                        if (in_place != expected) {
+                                throw TestFailure("ISA %d: sortedIntersection() of %u and %u elements gave %u elements, expected %u",
+                                                  static_cast<int>(isa),
+                                                  na, nb, n, expected.size());
+                        }
+
+                        expected.clear();
+                        std::set_difference(a.begin(), a.end(), b.begin(),
+                                            b.end(),
+                                            std::back_inserter(expected));
+                        in_place = a;
+                        n = sortedDifference(in_place.data(), a.size(),
+                                             b.data(), b.size(),
+                                             in_place.data());
+                        in_place.resize(n);
+                        if (in_place != expected) {
+                                throw TestFailure("ISA %d: sortedDifference() of %u and %u elements gave %u elements, expected %u",
+                                                  static_cast<int>(isa),
+                                                  na, nb, n, expected.size());
+                        }
+
+                        expected.clear();
+                        std::set_union(a.begin(), a.end(), b.begin(), b.end(),
+                                       std::back_inserter(expected));
+                        n = sortedUnion(a.data(), a.size(), b.data(),
+                                        b.size(), out.data());
+                        if (!std::equal(expected.begin(), expected.end(),
+                                        out.begin()) || (n != expected.size())) {
+                                throw TestFailure("sortedUnion() of %u and %u elements gave %u elements, expected %u",
+                                                  na, nb, n, expected.size());
+                        }
+
+                        in_place = a;
+                        in_place.resize(a.size() + b.size());
+                        n = sortedUnionInPlace(in_place.data(), a.size(),
+                                               b.data(), b.size());
+                        in_place.resize(n);
+                        if (in_place != expected) {
+                                throw TestFailure("sortedUnionInPlace() of %u and %u elements gave %u elements, expected %u",
+                                                  na, nb, n, expected.size());
+                        }
+
+                        expected.clear();
+                        std::set_symmetric_difference(a.begin(), a.end(),
+                                                b.begin(), b.end(),
+                                                std::back_inserter(expected));
+                        n = sortedSymmetricDifference(a.data(), a.size(),
+                                                      b.data(), b.size(),
+                                                      out.data());
+                        if (!std::equal(expected.begin(), expected.end(),
+                                        out.begin()) || (n != expected.size())) {
+                                throw TestFailure("sortedSymmetricDifference() of %u and %u elements gave %u elements, expected %u",
+                                                  na, nb, n, expected.size());
+                        }
+                }
+        }
+
+        selectSetKernelISA(orig_isa);
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::kernelsSkewedSets() // static
+{
+        // sizes differ by more than GALLOP_RATIO in both directions
+        IDSet        large, small;
+        std::set<ID> expected_large, expected_small;
+
+        for (ID id = 0; id < 200000; id += 3) {
+                large.insert(id);
+                expected_large.insert(id);
+        }
+        for (ID id = -30; id < 250000; id += 997) {
+                small.insert(id);
+                expected_small.insert(id);
+        }
+
+        std::set<ID> expected;
+        IDSet        set;
+
+        for (int pass = 0; pass < 2; ++pass) {
+                const IDSet        &a  = pass ? small : large,
+                                   &b  = pass ? large : small;
+                const std::set<ID> &ea = pass ? expected_small : expected_large,
+                                   &eb = pass ? expected_large : expected_small;
+
+                set = a;
+                expected.clear();
+                std::set_intersection(ea.begin(), ea.end(), eb.begin(),
+                                      eb.end(),
+                                      std::inserter(expected, expected.end()));
+                auto n = set.intersect(b);
+                if (n != ea.size() - expected.size()) {
+                        throw TestFailure("set.intersect() returned %u, expected %u",
+                                          n, ea.size() - expected.size());
+                }
+                checkMatches(set, expected);
+
+                set = a;
+                expected.clear();
+                std::set_difference(ea.begin(), ea.end(), eb.begin(), eb.end(),
+                                    std::inserter(expected, expected.end()));
+                n = set.erase(b);
+                if (n != ea.size() - expected.size()) {
+                        throw TestFailure("set.erase() returned %u, expected %u",
+                                          n, ea.size() - expected.size());
+                }
+                checkMatches(set, expected);
+
+                set = a;
+                expected.clear();
+                std::set_union(ea.begin(), ea.end(), eb.begin(), eb.end(),
+                               std::inserter(expected, expected.end()));
+                n = set.insert(b);
+                if (n != expected.size() - ea.size()) {
+                        throw TestFailure("set.insert() returned %u, expected %u",
+                                          n, expected.size() - ea.size());
+                }
+                checkMatches(set, expected);
+
+                set = a;
+                set.reserve(ea.size() + eb.size());  // merges in place
+                set.insert(b);
+                checkMatches(set, expected);
+
+                set = a;
+                expected.clear();
+                std::set_symmetric_difference(ea.begin(), ea.end(), eb.begin(),
+                                        eb.end(),
+                                        std::inserter(expected, expected.end()));
+                set.symmetric_difference(b);
+                checkMatches(set, expected);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::serializeRoundTrip() // static
+{
+        static const ID MIN = std::numeric_limits<ID>::min(),
+                        MAX = std::numeric_limits<ID>::max();
+        uint64_t        seed = 7;
+
+        std::vector<std::vector<ID>> cases = {
+                {}, { 0 }, { -1 }, { MIN, MAX }, { MIN, -1, 0, 1, MAX },
+                randomIDs(seed, 127, 1000), randomIDs(seed, 128, 1000),
+                randomIDs(seed, 129, 1000), randomIDs(seed, 5000, 1 << 20),
+                randomIDs(seed, 300, MAX)
+        };
+
+        std::vector<ID> dense;
+        for (ID id = 100000; id < 200000; ++id) {
+                dense.push_back(id);
+        }
+        cases.push_back(dense);
+
+        for (auto mode: { IDSet::VECTOR_STORAGE, IDSet::COMPRESSED_STORAGE }) {
+                for (const auto &ids: cases) {
+                        IDSet set(mode);
+                        set.insert(ids.begin(), ids.end());
+
+                        auto      blob = set.serialize();
+                        IDSetView view(blob);
+
+                        if ((view.size() != ids.size())
+                                        || !std::equal(ids.begin(), ids.end(),
+                                                       view.begin())
+                                        || (std::distance(view.begin(),
+                                                          view.end())
+                                                != static_cast<ptrdiff_t>(ids.size()))) {
+                                throw TestFailure("storage mode %d: view of %u serialized ID(s) does not match",
+                                                  static_cast<int>(mode),
+                                                  ids.size());
+                        }
+
+                        for (auto out_mode: { IDSet::VECTOR_STORAGE,
+                                              IDSet::COMPRESSED_STORAGE }) {
+                                auto copy = IDSet::deserialize(blob.data(),
+                                                               blob.size(),
+                                                               out_mode);
+                                if ((copy != set)
+                                        || (copy.storageMode() != out_mode)) {
+                                        throw TestFailure("storage mode %d: deserialized set of %u ID(s) does not match",
+                                                          static_cast<int>(mode),
+                                                          ids.size());
+                                }
+                        }
+                }
+        }
+
+        IDSet set(dense.begin(), dense.end());
+        auto  bytes = set.serialize().size();
+
+        if (bytes > dense.size() + 16 + dense.size() / 128 * 8) {
+                throw TestFailure("%u consecutive IDs serialized to %u bytes",
+                                  dense.size(), bytes);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::serializeViewSearch() // static
+{
+        uint64_t seed = 11;
+
+        for (size_t n: { 0, 1, 100, 128, 129, 1000, 20000 }) {
+                auto            ids = randomIDs(seed, n, 100000);
+                std::set<ID>    expected(ids.begin(), ids.end());
+                IDSet           set(ids.begin(), ids.end());
+                auto            blob = set.serialize();
+                IDSetView       view(blob);
+
+                for (ID id = -50010; id <= 50010; id += 7) {
+                        auto i = view.lower_bound(id);
+                        auto j = expected.lower_bound(id);
+
+                        if ((i == view.end()) != (j == expected.end())) {
+                                throw TestFailure("%u IDs: lower_bound(%d) %s end()",
+                                                  n, id, (i == view.end())
+                                                        ? "returned" : "did not return");
+                        } else if ((i != view.end()) && (*i != *j)) {
+                                throw TestFailure("%u IDs: lower_bound(%d) returned %d, expected %d",
+                                                  n, id, *i, *j);
+                        } else if (view.count(id) != expected.count(id)) {
+                                throw TestFailure("%u IDs: count(%d) returned %u",
+                                                  n, id, view.count(id));
+                        }
+                }
+
+                // iteration continues correctly from a located position
+                if (n) {
+                        ID   mid = ids[n / 2];
+                        auto i = view.find(mid);
+                        if (!std::equal(ids.begin() + n / 2, ids.end(), i)) {
+                                throw TestFailure("%u IDs: iteration from find(%d) does not match",
+                                                  n, mid);
+                        }
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::serializeMalformed() // static
+{
+        uint64_t seed = 13;
+        auto     ids = randomIDs(seed, 300, 100000);
+        auto     blob = IDSet(ids.begin(), ids.end()).serialize();
+
+        std::vector<std::vector<uint8_t>> cases = {
+                {},
+                { 0 },                          // unknown format
+                { 1 },                          // no count
+                { 1, 0x80 },                    // truncated count
+                { 1, 1 },                       // no blocks
+                { 1, 0, 0 },                    // trailing data
+                { 1, 2, 0, 0 },                 // too few gaps
+                { 1, 1, 0, 1, 0 },              // too many gaps
+                std::vector<uint8_t>(blob.begin(), blob.end() - 1),
+                blob
+        };
+        cases.back().push_back(0);
+
+        for (const auto &data: cases) {
+                try {
+                        IDSetView view(data.data(), data.size());
+                } catch (std::invalid_argument &) {
+                        continue;
+                }
+                throw TestFailure("malformed data of %u byte(s) accepted",
+                                  data.size());
+        }
+
+        // blocks out of order
+        std::vector<uint8_t> swapped = { 1 };
+        uint8_t              n = 128 + 1;
+        swapped.push_back(n | 0x80), swapped.push_back(1);  // 129 IDs
+        swapped.push_back(20), swapped.push_back(127);      // first = 10
+        swapped.insert(swapped.end(), 127, 0);
+        swapped.push_back(2), swapped.push_back(0);         // first = 1
+
+        try {
+                IDSetView view(swapped);
+        } catch (std::invalid_argument &) {
+                return;
+        }
+        throw TestFailure("serialized blocks out of order accepted");
+}
+
+//--------------------------------------
+
+void
+wr::sql::IDSetTests::serializeSQL() // static
+{
+        IDSet set(IDSet::COMPRESSED_STORAGE);
+        set.insert({ 1002, 1056, 1076, 5 });
+
+        std::vector<ID> big;
+        for (ID id = 2000; id < 6000; id += 3) {  // no employee numbers
+                big.push_back(id);
+        }
+        set.insert(big.begin(), big.end());
+
+        auto blob = set.serialize();
+
+        db_.exec("CREATE TEMP TABLE IF NOT EXISTS cached_sets "
+                 "(name TEXT PRIMARY KEY, ids BLOB)");
+        db_.exec("INSERT OR REPLACE INTO cached_sets VALUES ('test', ?)",
+                 std::vector<uint8_t>(blob));
+
+        auto result = db_.exec("SELECT COUNT(*) FROM employees "
+                               "WHERE number IN idset((SELECT ids "
+                               "FROM cached_sets WHERE name = 'test'))");
+        if (result.currentRow().get<int>(0) != 3) {
+                throw TestFailure("IN idset(<BLOB>) matched %d row(s), expected 3",
+                                  result.currentRow().get<int>(0));
+        }
+
+        result = db_.exec("SELECT COUNT(*), MIN(id), MAX(id) FROM idset(?) "
+                          "WHERE id BETWEEN 3000 AND 3100",
+                          std::vector<uint8_t>(blob));
+        Row  row = result.currentRow();
+        auto expected = std::count_if(set.begin(), set.end(), [](ID id) {
+                                return (id >= 3000) && (id <= 3100);
+                        });
+
+        if ((row.get<int>(0) != expected) || (row.get<ID>(1) != 3002)
+                        || (row.get<ID>(2) != 3098)) {
+                throw TestFailure("range over idset(<BLOB>) returned (%d, %d, %d)",
+                                  row.get<int>(0), row.get<ID>(1),
+                                  row.get<ID>(2));
+        }
+
+        result = db_.exec("SELECT COUNT(*) FROM employees e "
+                          "JOIN idset(?) s ON s.id = e.number",
+                          std::vector<uint8_t>(blob));
+        if (result.currentRow().get<int>(0) != 3) {
+                throw TestFailure("join with idset(<BLOB>) returned %d row(s), expected 3",
+                                  result.currentRow().get<int>(0));
+        }
+
+        try {
+                db_.exec("SELECT COUNT(*) FROM idset(x'0102')");
+        } catch (Error &) {
+                return;
+        }
+        throw TestFailure("malformed BLOB passed to idset() did not cause wr::sql::Error");
+}
@@ -0,0 +1,602 @@
+/**
+ * \file ResultCacheTests.cxx
+ *
+ * \brief Unit test module for class \c wr::sql::ResultCache
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdint.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <wrsql/BlobStream.h>
+#include <wrsql/Error.h>
+#include <wrsql/ResultCache.h>
+#include <wrsql/Session.h>
+#include <wrsql/SessionPool.h>
+#include <wrsql/Transaction.h>
+
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class ResultCacheTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        ResultCacheTests(int argc, const char **argv) :
+                base_t("ResultCache", argc, argv) {}
+
+        int runAll();
+
+        static void hitAndMiss(),
+                    uncached(),
+                    updateInvalidates(),
+                    deleteAllInvalidates(),
+                    withoutRowIDInvalidates(),
+                    blobWriteInvalidates(),
+                    uncommittedChanges(),
+                    rolledBackChanges(),
+                    unfinishedStatement(),
+                    sizeLimits(),
+                    sharedByPool(),
+                    separateDatabases(),
+                    notCacheable();
+};
+
+
+//--------------------------------------
+
+static const size_t SELECT_PRICE = registerStatement(
+                "SELECT price FROM rc_items WHERE id = ?"),
+                    SELECT_TOTAL = registerStatement(
+                "SELECT SUM(price) FROM rc_items"),
+                    SELECT_KEYED = registerStatement(
+                "SELECT COUNT(*) FROM rc_keyed"),
+                    SELECT_BLOB = registerStatement(
+                "SELECT b FROM rc_blobs WHERE id = ?"),
+                    SELECT_TEMP = registerStatement(
+                "SELECT COUNT(*) FROM temp.rc_temp"),
+                    UPDATE_PRICE = registerStatement(
+                "UPDATE rc_items SET price = ? WHERE id = ?");
+
+//--------------------------------------
+
+static SessionOptions
+cacheOptions(
+        ResultCache::Ptr cache
+)
+{
+        SessionOptions options;
+        options.journal_mode = SessionOptions::WAL_JOURNAL;
+        options.result_cache = std::move(cache);
+        return options;
+}
+
+//--------------------------------------
+
+/*
+ * (re)create rc_items with prices 1.5, 3.0, ... 15.0 for IDs 1 to 10
+ */
+static void
+createItems(
+        Session &db
+)
+{
+        db.exec("DROP TABLE IF EXISTS rc_items");
+        db.exec("CREATE TABLE rc_items (id INTEGER PRIMARY KEY, price REAL)");
+        db.beginTransaction([&](Transaction &) {
+                for (int id = 1; id <= 10; ++id) {
+                        db.exec("INSERT INTO rc_items VALUES (?, ?)",
+                                id, id * 1.5);
+                }
+        });
+}
+
+//--------------------------------------
+
+static double
+cachedPrice(
+        Session &db,
+        int      id
+)
+{
+        auto rows = db.execCached(SELECT_PRICE, id);
+
+        if (rows->numRows() != 1) {
+                throw TestFailure("price query for item %d returned %u rows, expected 1",
+                                  id, rows->numRows());
+        }
+        return rows->column(0).floats[0];
+}
+
+//--------------------------------------
+
+static double
+cachedTotal(
+        Session &db
+)
+{
+        return db.execCached(SELECT_TOTAL)->column(0).floats[0];
+}
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::ResultCacheTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::ResultCacheTests::runAll()
+{
+        run("execCached", 1, &hitAndMiss);
+        run("execCached", 2, &uncached);
+        run("invalidate", 1, &updateInvalidates);
+        run("invalidate", 2, &deleteAllInvalidates);
+        run("invalidate", 3, &withoutRowIDInvalidates);
+        run("invalidate", 4, &blobWriteInvalidates);
+        run("transaction", 1, &uncommittedChanges);
+        run("transaction", 2, &rolledBackChanges);
+        run("transaction", 3, &unfinishedStatement);
+        run("limits", 1, &sizeLimits);
+        run("pool", 1, &sharedByPool);
+        run("pool", 2, &separateDatabases);
+        run("notCacheable", 1, &notCacheable);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::hitAndMiss() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session db(defaultURI(), cacheOptions(cache));
+
+        createItems(db);
+
+        auto first = db.execCached(SELECT_PRICE, 3),
+             again = db.execCached(SELECT_PRICE, 3),
+             other = db.execCached(SELECT_PRICE, 4L);
+        auto stats = cache->stats();
+
+        if (first != again) {
+                throw TestFailure("repeated query not answered from cache");
+        } else if (other == first) {
+                throw TestFailure("query with different argument answered from cache");
+        } else if (other->column(0).floats[0] != 6.0) {
+                throw TestFailure("price of item 4 is %g, expected 6",
+                                  other->column(0).floats[0]);
+        } else if ((stats.hits != 1) || (stats.misses != 2)
+                        || (stats.entries != 2)) {
+                throw TestFailure("stats report %u hits, %u misses, %u entries; expected 1, 2, 2",
+                                  stats.hits, stats.misses, stats.entries);
+        } else if (!stats.bytes) {
+                throw TestFailure("stats report no memory held");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::uncached() // static
+{
+        Session db(defaultURI());
+
+        createItems(db);
+
+        auto first = db.execCached(SELECT_PRICE, 3),
+             again = db.execCached(SELECT_PRICE, 3);
+
+        if ((first == again) || (again->column(0).floats[0] != 4.5)) {
+                throw TestFailure("execCached() without a cache did not execute the statement");
+        }
+
+        // statements compiled before the cache is attached are recompiled
+        auto cache = std::make_shared<ResultCache>();
+
+        db.setResultCache(cache);
+        db.execCached(SELECT_PRICE, 3);
+        db.exec(UPDATE_PRICE, 99.0, 3);
+
+        if (cachedPrice(db, 3) != 99.0) {
+                throw TestFailure("stale price returned after update");
+        } else if (cache->stats().invalidations != 1) {
+                throw TestFailure("stats report %u invalidations, expected 1",
+                                  cache->stats().invalidations);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::updateInvalidates() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session db(defaultURI(), cacheOptions(cache));
+
+        createItems(db);
+        cachedTotal(db);
+        cachedPrice(db, 5);
+
+        db.exec("CREATE TABLE IF NOT EXISTS rc_other (id INTEGER PRIMARY KEY)");
+        db.exec("INSERT INTO rc_other VALUES (NULL)");
+
+        if (cache->stats().entries != 2) {
+                throw TestFailure("change to unrelated table invalidated results");
+        }
+
+        db.exec(UPDATE_PRICE, 100.0, 5);
+
+        if (cachedTotal(db) != 82.5 - 7.5 + 100.0) {
+                throw TestFailure("stale total %g returned after update",
+                                  cachedTotal(db));
+        } else if (cachedPrice(db, 5) != 100.0) {
+                throw TestFailure("stale price returned after update");
+        }
+
+        cache->invalidate("RC_ITEMS");  // names compared regardless of case
+
+        if (cache->stats().entries != 0) {
+                throw TestFailure("%u entries remain after invalidate()",
+                                  cache->stats().entries);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::deleteAllInvalidates() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session db(defaultURI(), cacheOptions(cache));
+
+        createItems(db);
+        cachedTotal(db);
+
+        // not reported by sqlite3_update_hook()
+        db.exec("DELETE FROM rc_items");
+
+        if (!db.execCached(SELECT_TOTAL)->column(0).isNull(0)) {
+                throw TestFailure("stale total returned after deleting all rows");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::withoutRowIDInvalidates() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session db(defaultURI(), cacheOptions(cache));
+
+        db.exec("DROP TABLE IF EXISTS rc_keyed");
+        db.exec("CREATE TABLE rc_keyed (k TEXT PRIMARY KEY) WITHOUT ROWID");
+        db.execCached(SELECT_KEYED);
+        db.exec("INSERT INTO rc_keyed VALUES ('a')");
+
+        auto n = db.execCached(SELECT_KEYED)->column(0).ints[0];
+
+        if (n != 1) {
+                throw TestFailure("count is %d after insert, expected 1",
+                                  static_cast<int>(n));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::blobWriteInvalidates() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session db(defaultURI(), cacheOptions(cache));
+
+        db.exec("DROP TABLE IF EXISTS rc_blobs");
+        db.exec("CREATE TABLE rc_blobs (id INTEGER PRIMARY KEY, b BLOB)");
+        db.exec("INSERT INTO rc_blobs VALUES (1, zeroblob(4))");
+
+        auto first_byte = [&] {
+                return db.execCached(SELECT_BLOB, 1)->column(0).data[0];
+        };
+
+        first_byte();
+
+        {
+                // not reported by sqlite3_update_hook()
+                BlobStream blob(db, "rc_blobs", "b", 1, BlobStream::READ_WRITE);
+                blob.write("ABCD", 4);
+
+                if (first_byte() != 'A') {
+                        throw TestFailure("writer did not see its own change through the cache");
+                }
+        }
+
+        if (first_byte() != 'A') {
+                throw TestFailure("stale value returned after BlobStream write");
+        }
+
+        db.beginTransaction([&](Transaction &) {
+                BlobStream blob(db, "rc_blobs", "b", 1, BlobStream::READ_WRITE);
+                blob.write("WXYZ", 4);
+        });
+
+        if (first_byte() != 'W') {
+                throw TestFailure("stale value returned after BlobStream write in transaction");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::uncommittedChanges() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session writer(defaultURI(), cacheOptions(cache)),
+                reader(defaultURI(), cacheOptions(cache));
+
+        createItems(writer);
+        cachedPrice(reader, 2);
+
+        writer.beginTransaction([&](Transaction &) {
+                writer.exec(UPDATE_PRICE, 50.0, 2);
+
+                if (cachedPrice(writer, 2) != 50.0) {
+                        throw TestFailure("writer did not see its own uncommitted change");
+                } else if (cachedPrice(reader, 2) != 3.0) {
+                        throw TestFailure("uncommitted change visible to reader");
+                }
+
+                // results computed by the writer must not be stored either
+                cachedPrice(writer, 7);
+                if (cache->stats().entries != 1) {
+                        throw TestFailure("results stored from within a transaction");
+                }
+        });
+
+        if (cachedPrice(reader, 2) != 50.0) {
+                throw TestFailure("stale price returned to reader after commit");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::rolledBackChanges() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session db(defaultURI(), cacheOptions(cache));
+
+        createItems(db);
+        cachedPrice(db, 2);
+
+        db.beginTransaction([&](Transaction &txn) {
+                db.exec(UPDATE_PRICE, 50.0, 2);
+                txn.rollback();
+        });
+
+        auto stats = cache->stats();
+
+        if (stats.invalidations != 0) {
+                throw TestFailure("rolled back change invalidated %u results",
+                                  stats.invalidations);
+        } else if (cachedPrice(db, 2) != 3.0) {
+                throw TestFailure("price changed by rolled back transaction");
+        }
+
+        // nested transaction rolled back while the outer one commits
+        db.beginTransaction([&](Transaction &) {
+                db.beginTransaction([&](Transaction &inner) {
+                        db.exec(UPDATE_PRICE, 60.0, 2);
+                        inner.rollback();
+                });
+                db.exec(UPDATE_PRICE, 70.0, 2);
+        });
+
+        if (cachedPrice(db, 2) != 70.0) {
+                throw TestFailure("stale price returned after outer transaction committed");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::unfinishedStatement() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session a(defaultURI(), cacheOptions(cache)),
+                b(defaultURI(), cacheOptions(cache));
+
+        createItems(a);
+
+        /* the UPDATE's implicit transaction stays open until the statement
+           is finished, even while other statements run through a */
+        auto update = a.exec("UPDATE rc_items SET price = price + 1"
+                             " WHERE id = 1 RETURNING price");
+
+        a.exec("SELECT 1");
+
+        if (cachedPrice(b, 1) != 1.5) {
+                throw TestFailure("uncommitted price visible to other connection");
+        }
+
+        update.reset();
+
+        if (a.exec("SELECT price FROM rc_items WHERE id = 1")
+                        .currentRow().get<double>(0) != 2.5) {
+                throw TestFailure("update not committed");
+        } else if (cachedPrice(b, 1) != 2.5) {
+                throw TestFailure("stale price returned after unfinished statement committed");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::sizeLimits() // static
+{
+        auto    cache = std::make_shared<ResultCache>(
+                                ResultCache::DEFAULT_MAX_BYTES, 3);
+        Session db(defaultURI(), cacheOptions(cache));
+
+        createItems(db);
+
+        for (int id = 1; id <= 3; ++id) {
+                cachedPrice(db, id);
+        }
+        cachedPrice(db, 1);  // now most recently used
+        cachedPrice(db, 4);  // evicts item 2
+
+        auto stats = cache->stats();
+
+        if ((stats.entries != 3) || (stats.evictions != 1)) {
+                throw TestFailure("stats report %u entries, %u evictions; expected 3, 1",
+                                  stats.entries, stats.evictions);
+        }
+
+        cachedPrice(db, 1);
+        cachedPrice(db, 2);
+
+        if (cache->stats().hits != stats.hits + 1) {
+                throw TestFailure("least recently used entry not the one evicted");
+        }
+
+        // results larger than the limit are never stored
+        auto tiny = std::make_shared<ResultCache>(64);
+
+        db.setResultCache(tiny);
+        cachedTotal(db);
+
+        if (tiny->stats().entries != 0) {
+                throw TestFailure("result larger than cache limit was stored");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::sharedByPool() // static
+{
+        auto cache = std::make_shared<ResultCache>();
+
+        {
+                Session db(defaultURI(), cacheOptions(cache));
+                createItems(db);
+        }
+
+        SessionPool pool(defaultURI(), cacheOptions(cache), 2);
+        auto        a = pool.acquire(), b = pool.acquire();
+
+        cachedPrice(*a, 8);
+
+        if ((cachedPrice(*b, 8) != 12.0) || (cache->stats().hits != 1)) {
+                throw TestFailure("result not shared between pooled sessions");
+        }
+
+        a->exec(UPDATE_PRICE, 1.0, 8);
+
+        if (cachedPrice(*b, 8) != 1.0) {
+                throw TestFailure("stale price returned to other pooled session");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::separateDatabases() // static
+{
+        auto        cache = std::make_shared<ResultCache>();
+        std::string other_uri = defaultURI().to_string() + "-other";
+        path        other_path(defaultPath().native() + "-other");
+
+        {
+                Session db(defaultURI(), cacheOptions(cache)),
+                        other(other_uri, cacheOptions(cache));
+
+                createItems(db);
+                createItems(other);
+                other.exec(UPDATE_PRICE, 99.0, 1);
+
+                if ((cachedPrice(db, 1) != 1.5)
+                                || (cachedPrice(other, 1) != 99.0)) {
+                        throw TestFailure("result from one database returned for another");
+                }
+
+                Session mem1(":memory:", cacheOptions(cache)),
+                        mem2(":memory:", cacheOptions(cache));
+
+                createItems(mem1);
+                createItems(mem2);
+                mem2.exec(UPDATE_PRICE, 42.0, 1);
+
+                if ((cachedPrice(mem1, 1) != 1.5)
+                                || (cachedPrice(mem2, 1) != 42.0)) {
+                        throw TestFailure("result from one in-memory database returned for another");
+                }
+        }
+
+        fs_error_code err;
+        remove(other_path, err);
+}
+
+//--------------------------------------
+
+void
+wr::sql::ResultCacheTests::notCacheable() // static
+{
+        auto    cache = std::make_shared<ResultCache>();
+        Session db(defaultURI(), cacheOptions(cache));
+
+        createItems(db);
+
+        try {
+                db.execCached(UPDATE_PRICE, 1.0, 1);
+                throw TestFailure("execCached() accepted an UPDATE statement");
+        } catch (std::invalid_argument &) {
+                // expected
+        }
+
+        db.exec("CREATE TEMP TABLE rc_temp (id INTEGER)");
+        db.execCached(SELECT_TEMP);
+        db.execCached(SELECT_TEMP);
+
+        auto stats = cache->stats();
+
+        if ((stats.entries != 0) || (stats.bypasses != 2)) {
+                throw TestFailure("TEMP table results cached (%u entries, %u bypasses)",
+                                  stats.entries, stats.bypasses);
+        }
+}
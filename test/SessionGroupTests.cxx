@@ -0,0 +1,375 @@
+/**
+ * \file SessionGroupTests.cxx
+ *
+ * \brief Unit test module for class \c wr::sql::SessionGroup
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/SessionGroup.h>
+
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class SessionGroupTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        SessionGroupTests(int argc, const char **argv) :
+                base_t("SessionGroup", argc, argv)
+        {
+                Session db(defaultURI());
+                db.exec("CREATE TABLE IF NOT EXISTS events "
+                        "(id INTEGER PRIMARY KEY, name TEXT NOT NULL)");
+        }
+
+        int runAll();
+
+        static void defaultConstruct(),
+                    openNoReaders(),
+                    journalMode(),
+                    writeThenRead(),
+                    readOnlyReaders(),
+                    groupCommit(),
+                    failedWriteIsolated(),
+                    batchRolledBack();
+
+private:
+        static void clearEvents(SessionGroup &group);
+        static int countEvents(SessionGroup &group,
+                               const char *where = "1");
+};
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::SessionGroupTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::SessionGroupTests::runAll()
+{
+        run("defaultConstruct", 1, &defaultConstruct);
+        run("open", 1, &openNoReaders);
+        run("open", 2, &journalMode);
+        run("write", 1, &writeThenRead);
+        run("read", 1, &readOnlyReaders);
+        run("write", 2, &groupCommit);
+        run("write", 3, &failedWriteIsolated);
+        run("write", 4, &batchRolledBack);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::clearEvents(
+        SessionGroup &group
+) // static
+{
+        group.write([](Session &writer) {
+                writer.exec("DELETE FROM events");
+        }).get();
+}
+
+//--------------------------------------
+
+int
+wr::sql::SessionGroupTests::countEvents(
+        SessionGroup &group,
+        const char   *where
+) // static
+{
+        auto reader = group.read();
+        return reader->exec(std::string("SELECT COUNT(*) FROM events WHERE ")
+                            + where).currentRow().get<int>(0);
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::defaultConstruct() // static
+{
+        SessionGroup group;
+
+        if (group.isOpen()) {
+                throw TestFailure("group.isOpen() returned true, expected false");
+        }
+
+        try {
+                group.write([](Session &) {});
+        } catch (std::logic_error &) {
+                return;
+        }
+
+        throw TestFailure("write() to closed SessionGroup did not throw std::logic_error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::openNoReaders() // static
+{
+        SessionGroup group;
+
+        try {
+                group.open(defaultURI(), 0);
+        } catch (std::invalid_argument &) {
+                return;
+        }
+
+        throw TestFailure("open() with no readers did not throw std::invalid_argument");
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::journalMode() // static
+{
+        SessionGroup group(defaultURI(), 2);
+        auto         reader = group.read();
+        auto         mode = reader->exec("PRAGMA journal_mode")
+                                .currentRow().get<std::string>(0);
+
+        if (mode != "wal") {
+                throw TestFailure("journal mode is \"%s\", expected \"wal\"",
+                                  mode);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::writeThenRead() // static
+{
+        SessionGroup group(defaultURI(), 2);
+
+        clearEvents(group);
+
+        group.write([](Session &writer) {
+                writer.exec("INSERT INTO events (name) VALUES ('started')");
+        }).get();
+
+        int n = countEvents(group, "name = 'started'");
+
+        if (n != 1) {
+                throw TestFailure("reader found %d rows after write(), expected 1",
+                                  n);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::readOnlyReaders() // static
+{
+        SessionGroup group(defaultURI(), 1);
+        auto         reader = group.read();
+
+        if (group.tryRead()) {
+                throw TestFailure("tryRead() lent out reader already in use");
+        }
+
+        try {
+                reader->exec("INSERT INTO events (name) VALUES ('illegal')");
+        } catch (Error &) {
+                return;
+        }
+
+        throw TestFailure("write through reader Session did not throw wr::sql::Error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::groupCommit() // static
+{
+        static const int N = 10;
+
+        SessionGroup group(defaultURI(), 1);
+
+        clearEvents(group);
+
+        std::promise<void>             gate;
+        std::shared_future<void>       open_gate = gate.get_future().share();
+        std::vector<std::future<void>> done;
+
+        // hold up the writer while further writes queue behind it
+        done.push_back(group.write([open_gate](Session &) {
+                open_gate.wait();
+        }));
+
+        auto commits_before = group.numCommits();
+
+        for (int i = 0; i < N; ++i) {
+                done.push_back(group.write([i](Session &writer) {
+                        writer.exec("INSERT INTO events (name) VALUES (?)",
+                                    "event " + std::to_string(i));
+                }));
+        }
+
+        gate.set_value();
+
+        for (auto &write: done) {
+                write.get();
+        }
+
+        auto commits = group.numCommits() - commits_before;
+
+        if (commits > 2) {
+                throw TestFailure("%d queued writes took %u commits, expected at most 2",
+                                  N + 1, commits);
+        }
+
+        int n = countEvents(group);
+
+        if (n != N) {
+                throw TestFailure("reader found %d rows, expected %d", n, N);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::failedWriteIsolated() // static
+{
+        SessionGroup group(defaultURI(), 1);
+
+        clearEvents(group);
+
+        std::promise<void>       gate;
+        std::shared_future<void> open_gate = gate.get_future().share();
+        bool                     committed = false;
+
+        auto blocker = group.write([open_gate](Session &) {
+                open_gate.wait();
+        });
+        auto first = group.write([&committed](Session &writer) {
+                writer.exec("INSERT INTO events (name) VALUES ('first')");
+                writer.onFinalCommit([&committed] { committed = true; });
+        });
+        auto failing = group.write([](Session &writer) {
+                writer.exec("INSERT INTO events (name) VALUES ('failing')");
+                throw std::runtime_error("write failed");
+        });
+        auto last = group.write([](Session &writer) {
+                writer.exec("INSERT INTO events (name) VALUES ('last')");
+        });
+
+        gate.set_value();
+        blocker.get();
+        first.get();
+        last.get();
+
+        try {
+                failing.get();
+                throw TestFailure("failed write's future did not receive its exception");
+        } catch (std::runtime_error &) {
+        }
+
+        if (!committed) {
+                throw TestFailure("onFinalCommit() action not invoked after shared commit");
+        }
+        if (countEvents(group, "name = 'failing'") != 0) {
+                throw TestFailure("changes by failed write were committed");
+        }
+        if (countEvents(group, "name IN ('first', 'last')") != 2) {
+                throw TestFailure("changes by other writes in batch were not committed");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionGroupTests::batchRolledBack() // static
+{
+        SessionGroup group(defaultURI(), 1);
+
+        clearEvents(group);
+        group.write([](Session &writer) {
+                writer.exec("INSERT INTO events VALUES (2, 'existing')");
+        }).get();
+
+        std::promise<void>       started, gate;
+        std::shared_future<void> open_gate = gate.get_future().share();
+
+        // hold up the writer so that the following writes form one batch
+        auto blocker = group.write([&started, open_gate](Session &) {
+                started.set_value();
+                open_gate.wait();
+        });
+        started.get_future().wait();
+
+        auto before = group.write([](Session &writer) {
+                writer.exec("INSERT INTO events VALUES (1, 'before')");
+        });
+        // constraint violation rolls back the entire shared transaction
+        auto rolling_back = group.write([](Session &writer) {
+                writer.exec("INSERT OR ROLLBACK INTO events VALUES (2, 'dup')");
+        });
+        auto after = group.write([](Session &writer) {
+                writer.exec("INSERT INTO events VALUES (3, 'after')");
+        });
+
+        gate.set_value();
+        blocker.get();
+        after.get();
+
+        try {
+                before.get();
+                throw TestFailure("write undone by later write's rollback reported as committed");
+        } catch (Error &) {
+        }
+
+        try {
+                rolling_back.get();
+                throw TestFailure("rolled back write reported as committed");
+        } catch (Error &) {
+        }
+
+        if (countEvents(group, "id = 1") != 0) {
+                throw TestFailure("changes by write reported as failed were committed");
+        } else if (countEvents(group, "id IN (2, 3)") != 2) {
+                throw TestFailure("changes by writes after the rollback were not committed");
+        }
+}
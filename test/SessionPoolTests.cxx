@@ -0,0 +1,598 @@
+/**
+ * \file SessionPoolTests.cxx
+ *
+ * \brief Unit test module for class \c wr::sql::SessionPool
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <iostream>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/SessionPool.h>
+#include <wrsql/Statement.h>
+#include <wrsql/Transaction.h>
+
+#include "SampleDB.h"
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class SessionPoolTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        SessionPoolTests(int argc, const char **argv) :
+                base_t("SessionPool", argc, argv) {}
+
+        int runAll();
+
+        static void createSampleDB(),
+                    defaultConstruct(),
+                    constructWithOpen(),
+                    openZeroSize(),
+                    acquireRelease(),
+                    tryAcquireExhausted(),
+                    moveLease(),
+                    threadAffinity(),
+                    prepareRegisteredStatements(),
+                    lateRegisteredStatement(),
+                    resetOnReturn(),
+                    rollbackOnReturn(),
+                    reopenOnAcquire(),
+                    trimOverBudget(),
+                    concurrentAcquire(),
+                    acquireClosed();
+};
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::SessionPoolTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::SessionPoolTests::runAll()
+{
+        run("init", 1, &createSampleDB);
+        run("construct", 1, &defaultConstruct);
+        run("construct", 2, &constructWithOpen);
+        run("open", 1, &openZeroSize);
+        run("acquire", 1, &acquireRelease);
+        run("acquire", 2, &tryAcquireExhausted);
+        run("acquire", 3, &moveLease);
+        run("acquire", 4, &threadAffinity);
+        run("acquire", 5, &concurrentAcquire);
+        run("acquire", 6, &acquireClosed);
+        run("prepareRegisteredStatements", 1, &prepareRegisteredStatements);
+        run("prepareRegisteredStatements", 2, &lateRegisteredStatement);
+        run("release", 1, &resetOnReturn);
+        run("release", 2, &trimOverBudget);
+        run("release", 3, &rollbackOnReturn);
+        run("release", 4, &reopenOnAcquire);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::createSampleDB() // static
+{
+        SampleDB db;
+        db.init(defaultURI());
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::defaultConstruct() // static
+{
+        SessionPool pool;
+
+        if (pool.isOpen()) {
+                throw TestFailure("pool.isOpen() returned true, expected false");
+        } else if (pool.size() != 0) {
+                throw TestFailure("pool.size() returned %u, expected 0",
+                                  pool.size());
+        } else if (!pool.uri().empty()) {
+                throw TestFailure("pool.uri() returned \"%s\", expected blank",
+                                  pool.uri());
+        }
+
+        try {
+                pool.acquire();  // should throw
+                throw TestFailure("pool.acquire() did not throw exception with pool closed");
+        } catch (const std::logic_error &) {
+                ;  // OK, as expected
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::constructWithOpen() // static
+{
+        SessionPool pool(defaultURI(), 3);
+
+        if (!pool.isOpen()) {
+                throw TestFailure("pool.isOpen() returned false, expected true");
+        } else if (pool.size() != 3) {
+                throw TestFailure("pool.size() returned %u, expected 3",
+                                  pool.size());
+        } else if (pool.available() != 3) {
+                throw TestFailure("pool.available() returned %u, expected 3",
+                                  pool.available());
+        } else if (pool.uri() != defaultURI()) {
+                throw TestFailure("pool.uri() returned \"%s\", expected \"%s\"",
+                                  pool.uri(), defaultURI());
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::openZeroSize() // static
+try {
+        SessionPool pool(defaultURI(), 0);
+        throw TestFailure("SessionPool constructor did not throw exception for zero size");
+} catch (const std::invalid_argument &) {
+        ;  // OK
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::acquireRelease() // static
+{
+        SessionPool pool(defaultURI(), 2);
+
+        {
+                auto lease = pool.acquire();
+
+                if (!lease) {
+                        throw TestFailure("pool.acquire() returned empty lease");
+                } else if (!lease->isOpen()) {
+                        throw TestFailure("leased Session not open");
+                } else if (pool.available() != 1) {
+                        throw TestFailure("pool.available() returned %u with one lease outstanding, expected 1",
+                                          pool.available());
+                }
+
+                size_t n = 0;
+
+                for (Row row: lease->exec("SELECT * FROM offices")) {
+                        (void) row;
+                        ++n;
+                }
+
+                if (n != 7) {
+                        throw TestFailure("query on leased Session returned %u rows, expected 7",
+                                          n);
+                }
+
+                lease.release();
+
+                if (lease) {
+                        throw TestFailure("lease not empty after lease.release()");
+                } else if (pool.available() != 2) {
+                        throw TestFailure("pool.available() returned %u after lease.release(), expected 2",
+                                          pool.available());
+                }
+        }
+
+        {
+                auto lease = pool.acquire();
+        }
+
+        if (pool.available() != 2) {
+                throw TestFailure("pool.available() returned %u after lease destroyed, expected 2",
+                                  pool.available());
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::tryAcquireExhausted() // static
+{
+        SessionPool pool(defaultURI(), 1);
+
+        auto lease1 = pool.tryAcquire();
+
+        if (!lease1) {
+                throw TestFailure("pool.tryAcquire() returned empty lease from idle pool");
+        }
+
+        auto lease2 = pool.tryAcquire();
+
+        if (lease2) {
+                throw TestFailure("pool.tryAcquire() returned a Session from exhausted pool");
+        }
+
+        lease1.release();
+        lease2 = pool.tryAcquire();
+
+        if (!lease2) {
+                throw TestFailure("pool.tryAcquire() returned empty lease after Session returned");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::moveLease() // static
+{
+        SessionPool         pool(defaultURI(), 1);
+        SessionPool::Lease  lease1 = pool.acquire();
+        Session            *session = lease1.get();
+        SessionPool::Lease  lease2(std::move(lease1));
+
+        if (lease1) {
+                throw TestFailure("moved-from lease not empty");
+        } else if (lease2.get() != session) {
+                throw TestFailure("moved-to lease does not hold original Session");
+        } else if (pool.available() != 0) {
+                throw TestFailure("pool.available() returned %u after move, expected 0",
+                                  pool.available());
+        }
+
+        lease1 = std::move(lease2);
+
+        if (lease1.get() != session) {
+                throw TestFailure("move-assigned lease does not hold original Session");
+        }
+}
+
+//--------------------------------------
+/**
+ * Ensure that a thread is given back the `Session` it used last, provided
+ * that `Session` is idle.
+ */
+void
+wr::sql::SessionPoolTests::threadAffinity() // static
+{
+        SessionPool  pool(defaultURI(), 4);
+        Session     *mine = pool.acquire().get();
+
+        auto theirs = std::async(std::launch::async, [&pool] {
+                Session *s = pool.acquire().get();
+                return s;
+        }).get();
+
+        if (theirs == mine) {
+                throw TestFailure("other thread was given this thread's idle Session");
+        }
+
+        for (int i = 0; i < 10; ++i) {
+                auto lease = pool.acquire();
+                if (lease.get() != mine) {
+                        throw TestFailure("pool.acquire() did not return the Session last used by this thread");
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::concurrentAcquire() // static
+{
+        static const int NUM_THREADS = 8, NUM_ITERATIONS = 50;
+
+        static size_t COUNT_CUSTOMERS = registerStatement(
+                        "SELECT COUNT(*) FROM customers");
+
+        SessionPool                    pool(defaultURI(), 2);
+        std::atomic<int>               in_use(0), max_in_use(0);
+        std::vector<std::future<int>>  tasks;
+
+        for (int i = 0; i < NUM_THREADS; ++i) {
+                tasks.push_back(std::async(std::launch::async, [&] {
+                        int total = 0;
+                        for (int j = 0; j < NUM_ITERATIONS; ++j) {
+                                auto lease = pool.acquire();
+                                int  n = ++in_use;
+                                int  m = max_in_use;
+                                while ((n > m)
+                                       && !max_in_use.compare_exchange_weak(m, n)) {}
+                                total += lease->exec(COUNT_CUSTOMERS)
+                                              .begin().get<int>(0);
+                                --in_use;
+                        }
+                        return total;
+                }));
+        }
+
+        int expected = -1;
+
+        for (auto &task: tasks) {
+                int total = task.get();
+                if (expected < 0) {
+                        expected = total;
+                } else if (total != expected) {
+                        throw TestFailure("thread counted %d customers, expected %d",
+                                          total, expected);
+                }
+        }
+
+        if (max_in_use > 2) {
+                throw TestFailure("%d Sessions leased simultaneously from pool of size 2",
+                                  max_in_use.load());
+        } else if (pool.available() != 2) {
+                throw TestFailure("pool.available() returned %u after all threads finished, expected 2",
+                                  pool.available());
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::acquireClosed() // static
+{
+        SessionPool pool(defaultURI(), 1);
+
+        pool.close();
+
+        if (pool.isOpen()) {
+                throw TestFailure("pool.isOpen() returned true after pool.close()");
+        }
+
+        try {
+                pool.tryAcquire();  // should throw
+                throw TestFailure("pool.tryAcquire() did not throw exception with pool closed");
+        } catch (const std::logic_error &) {
+                ;  // OK, as expected
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::prepareRegisteredStatements() // static
+{
+        static size_t GET_OFFICES = registerStatement("SELECT * FROM offices"),
+                      GET_MISSING = registerStatement(
+                                        "SELECT * FROM no_such_table");
+
+        SessionPool pool(defaultURI(), 1);
+        auto        lease = pool.acquire();
+        Session    &db = *lease;
+
+        if (!db.statement(GET_OFFICES)->isPrepared()) {
+                throw TestFailure("statement not prepared by pool");
+        }
+
+        try {
+                db.statement(GET_MISSING);
+                throw TestFailure("db.statement() did not throw exception for invalid SQL");
+        } catch (const Error &) {
+                ;  // OK, skipped by prepareRegisteredStatements()
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::lateRegisteredStatement() // static
+{
+        SessionPool pool(defaultURI(), 1);
+        Session    *db = pool.acquire().get();
+
+        static size_t GET_PAYMENTS = registerStatement(
+                        "SELECT * FROM payments");
+
+        auto lease = pool.acquire();
+
+        if (lease.get() != db) {
+                throw TestFailure("pool.acquire() returned a different Session");
+        }
+
+        if (!lease->statement(GET_PAYMENTS)->isPrepared()) {
+                throw TestFailure("late-registered statement not prepared");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::resetOnReturn() // static
+{
+        static size_t GET_CUSTOMERS = registerStatement(
+                        "SELECT * FROM customers");
+
+        SessionPool    pool(defaultURI(), 1);
+        Statement::Ptr stmt;
+
+        {
+                auto lease = pool.acquire();
+                stmt = lease->statement(GET_CUSTOMERS);
+                stmt->begin();
+                if (!stmt->isActive()) {
+                        throw TestFailure("statement not active after stmt->begin()");
+                }
+        }
+
+        if (stmt->isActive()) {
+                throw TestFailure("registered statement still active after Session returned to pool");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::trimOverBudget() // static
+{
+        static size_t GET_ORDERS = registerStatement("SELECT * FROM orders");
+
+        SessionPool pool(defaultURI(), 2, false);
+
+        {
+                auto lease = pool.acquire();
+                lease->exec(GET_ORDERS);
+        }
+
+        if (pool.numTrims() != 0) {
+                throw TestFailure("session trimmed with no memory budget set");
+        } else if (!pool.memoryUsed()) {
+                throw TestFailure("memory usage not sampled on return");
+        }
+
+        pool.setMemoryBudget(1);
+
+        Session *db;
+
+        {
+                auto lease = pool.acquire();
+                db = lease.get();
+                lease->exec(GET_ORDERS);
+        }
+
+        if (pool.numTrims() == 0) {
+                throw TestFailure("no session trimmed when over budget");
+        }
+
+        auto lease = pool.acquire(), other = pool.acquire();
+
+        if (other.get() != db) {
+                throw TestFailure("trimmed session not lent out last");
+        } else if (other->memoryStats().cached_stmts != 0) {
+                throw TestFailure("trimmed session still caches statements");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::rollbackOnReturn() // static
+{
+        SessionPool pool(defaultURI(), 1);
+        bool        rolled_back = false;
+        Transaction txn;
+
+        {
+                auto lease = pool.acquire();
+                lease->exec("CREATE TABLE IF NOT EXISTS pool_rows (id INTEGER)");
+                lease->exec("DELETE FROM pool_rows");
+                lease->exec("BEGIN");
+                lease->exec("INSERT INTO pool_rows VALUES (1)");
+                lease->setDeadline(Session::Clock::now());
+        }
+
+        {
+                auto lease = pool.acquire();
+
+                lease->exec("BEGIN");  // must not already be in a transaction
+                int n = lease->exec("SELECT COUNT(*) FROM pool_rows")
+                                .currentRow().get<int>(0);
+                lease->exec("COMMIT");
+
+                if (n != 0) {
+                        throw TestFailure("uncommitted row left by previous borrower visible");
+                } else if (lease->deadline() != Session::Clock::time_point::max()) {
+                        throw TestFailure("deadline set by previous borrower still in effect");
+                }
+        }
+
+        {
+                // returned from within a Transaction: nothing is committed
+                auto lease = pool.acquire();
+
+                txn = lease->beginTransaction([&](Transaction &) {
+                        lease->exec("INSERT INTO pool_rows VALUES (2)");
+                        lease->onRollback([&rolled_back] {
+                                rolled_back = true;
+                        });
+                        lease.release();
+                });
+        }
+
+        if (!rolled_back) {
+                throw TestFailure("onRollback() action not invoked on return to pool");
+        } else if (txn.active() || txn.committed()) {
+                throw TestFailure("Transaction not rolled back on return to pool");
+        }
+
+        auto lease = pool.acquire();
+        int  n = lease->exec("SELECT COUNT(*) FROM pool_rows")
+                        .currentRow().get<int>(0);
+
+        if (n != 0) {
+                throw TestFailure("%d rows committed, expected none", n);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionPoolTests::reopenOnAcquire() // static
+{
+        path           db_path(defaultPath().native() + "-reopen");
+        std::string    uri = defaultURI().to_string() + "-reopen";
+        SessionOptions options;
+        fs_error_code  err;
+
+        Session(uri).exec("CREATE TABLE IF NOT EXISTS pool_rows (id INTEGER)");
+        options.read_only = true;  // fails to open once the file is removed
+
+        SessionPool pool(uri, options, 1);
+
+        pool.acquire()->close();
+        remove(db_path, err);
+
+        try {
+                pool.acquire();
+                throw TestFailure("acquire() reopened a removed database");
+        } catch (Error &) {
+                // expected
+        }
+
+        Session(uri).exec("CREATE TABLE pool_rows (id INTEGER)");
+
+        auto lease = pool.tryAcquire();
+
+        if (!lease) {
+                throw TestFailure("session lost from pool after failing to reopen");
+        } else if (!lease->isOpen() || !lease->hasObject("table", "pool_rows")) {
+                throw TestFailure("closed session not reopened");
+        }
+
+        lease.release();
+        pool.close();
+        remove(db_path, err);
+}
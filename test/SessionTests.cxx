@@ -23,10 +23,15 @@
  * \endparblock
  */
 #include <iostream>
+#include <chrono>
 #include <condition_variable>
 #include <future>
 #include <mutex>
 #include <thread>
+#include <tuple>
+#include <vector>
+
+#include <wrutil/Format.h>
 
 #include <wrsql/Error.h>
 #include <wrsql/Session.h>
@@ -56,14 +61,28 @@ public:
                     openNonExistentFile(),
                     openUnrecognisedDatabaseType(),
                     reOpen(),
+                    openWithOptions(),
+                    openReadOnly(),
+                    openWithBadOptions(),
+                    busyHandler(),
+                    busyHandlerOnOpen(),
+                    busyHandlerThrows(),
                     getURI(),
                     execSimple(),
                     createSampleDBSchema(),
                     statement1(),
                     statement2(),
                     statement3(),
+                    statement4(),
                     finalizeRegisteredStatements(),
                     resetRegisteredStatements(),
+                    execBatch1(),
+                    execBatch2(),
+                    execBatchFailure(),
+                    execBatchNested(),
+                    execScript1(),
+                    execScript2(),
+                    execScript3(),
                     hasObject1(),
                     hasObject2(),
                     copyConstruct(),
@@ -82,8 +101,42 @@ public:
                     moveAssignThis(),
                     setProgressHandler(),
                     clearProgressHandler(),
+                    deadline1(),
+                    deadline2(),
+                    deadline3(),
                     onFinalCommit(),
-                    onRollback();
+                    onRollback(),
+                    statisticsDisabled(),
+                    statistics(),
+                    memoryStats(),
+                    alphaNumCollation(),
+                    alphaNumKey();
+
+private:
+        struct ScratchDB;
+};
+
+
+/*
+ * database file separate from the default test database, for tests which
+ * change the settings persisted in the file; deleted on destruction
+ */
+struct SessionTests::ScratchDB
+{
+        ScratchDB() : path_(temp_directory_path() / unique_path()) {}
+
+        ~ScratchDB()
+        {
+                fs_error_code err;
+                for (auto suffix: { "", "-wal", "-shm", "-journal" }) {
+                        remove(path(path_.string() + suffix), err);
+                }
+        }
+
+        std::string uri() const
+                { return u8"sqlite3:" + to_generic_u8string(path_); }
+
+        path path_;
 };
 
 
@@ -114,14 +167,28 @@ wr::sql::SessionTests::runAll()
         run("open", 1, &openNonExistentFile);
         run("open", 2, &openUnrecognisedDatabaseType);
         run("open", 3, &reOpen);
+        run("open", 4, &openWithOptions);
+        run("open", 5, &openReadOnly);
+        run("open", 6, &openWithBadOptions);
+        run("busyHandler", 1, &busyHandler);
+        run("busyHandler", 2, &busyHandlerOnOpen);
+        run("busyHandler", 3, &busyHandlerThrows);
         run("getURI", 1, &getURI);
         run("exec", 1, &execSimple);
         run("exec", 2, &createSampleDBSchema);
         run("statement", 1, &statement1);
         run("statement", 2, &statement2);
         run("statement", 3, &statement3);
+        run("statement", 4, &statement4);
         run("finalizeRegisteredStatements", 1, &finalizeRegisteredStatements);
         run("resetRegisteredStatements", 1, &resetRegisteredStatements);
+        run("execBatch", 1, &execBatch1);
+        run("execBatch", 2, &execBatch2);
+        run("execBatch", 3, &execBatchFailure);
+        run("execBatch", 4, &execBatchNested);
+        run("execScript", 1, &execScript1);
+        run("execScript", 2, &execScript2);
+        run("execScript", 3, &execScript3);
         run("hasObject", 1, &hasObject1);
         run("hasObject", 2, &hasObject2);
         run("interrupt", 1, &serialisedInterrupt);
@@ -138,8 +205,16 @@ wr::sql::SessionTests::runAll()
         run("moveAssignThis", 1, &moveAssignThis);
         run("setProgressHandler", 1, &setProgressHandler);
         run("clearProgressHandler", 1, &clearProgressHandler);
+        run("deadline", 1, &deadline1);
+        run("deadline", 2, &deadline2);
+        run("deadline", 3, &deadline3);
         run("onFinalCommit", 1, &onFinalCommit);
         run("onRollback", 1, &onRollback);
+        run("statistics", 1, &statisticsDisabled);
+        run("statistics", 2, &statistics);
+        run("memoryStats", 1, &memoryStats);
+        run("ALPHANUM", 1, &alphaNumCollation);
+        run("ALPHANUM", 2, &alphaNumKey);
 
         return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -251,6 +326,193 @@ wr::sql::SessionTests::reOpen() // static
 
 //--------------------------------------
 
+void
+wr::sql::SessionTests::openWithOptions() // static
+{
+        ScratchDB      scratch;
+        SessionOptions options;
+
+        options.journal_mode = SessionOptions::WAL_JOURNAL;
+        options.synchronous = SessionOptions::NORMAL_SYNC;
+        options.mmap_size = 1 << 20;
+        options.cache_size = -2000;
+        options.temp_store = SessionOptions::MEMORY_TEMP_STORE;
+        options.busy_timeout = std::chrono::milliseconds(1000);
+
+        Session db(scratch.uri(), options);
+
+        auto check = [](Session &db, const char *pragma, const char *expected) {
+                auto value = db.exec(printStr("PRAGMA %s", pragma))
+                                .currentRow().get<std::string>(0);
+                if (value != expected) {
+                        throw TestFailure("PRAGMA %s returned \"%s\", expected \"%s\"",
+                                          pragma, value, expected);
+                }
+        };
+
+        check(db, "journal_mode", "wal");
+        check(db, "synchronous", "1");
+        check(db, "mmap_size", "1048576");
+        check(db, "cache_size", "-2000");
+        check(db, "temp_store", "2");
+
+        Session copy(db);
+
+        check(copy, "cache_size", "-2000");
+        check(copy, "temp_store", "2");
+
+        if (copy.options().synchronous != SessionOptions::NORMAL_SYNC) {
+                throw TestFailure("copy.options().synchronous differs from original");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::openReadOnly() // static
+{
+        ScratchDB scratch;
+
+        Session(scratch.uri()).exec("CREATE TABLE foo (id INTEGER PRIMARY KEY)");
+
+        SessionOptions options;
+        options.read_only = true;
+
+        Session db(scratch.uri(), options);
+
+        db.exec("SELECT * FROM foo");  // reading permitted
+
+        try {
+                db.exec("INSERT INTO foo (id) VALUES (1)");
+        } catch (Error &) {
+                return;
+        }
+
+        throw TestFailure("INSERT on read-only connection did not throw wr::sql::Error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::openWithBadOptions() // static
+{
+        ScratchDB scratch;
+
+        Session(scratch.uri()).exec("CREATE TABLE foo (id INTEGER PRIMARY KEY)");
+
+        SessionOptions options;
+        options.read_only = true;
+        options.journal_mode = SessionOptions::WAL_JOURNAL;  // needs write
+
+        Session db(":memory:");
+
+        try {
+                db.open(scratch.uri(), options);
+        } catch (Error &) {
+                if (db.isOpen()) {
+                        throw TestFailure("db.isOpen() returned true after failed open(), expected false");
+                }
+                return;
+        }
+
+        throw TestFailure("db.open() did not throw wr::sql::Error for inapplicable options");
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::busyHandler() // static
+{
+        ScratchDB      scratch;
+        Session        db1(scratch.uri());
+        SessionOptions options;
+        int            calls = 0;
+
+        options.busy_handler = [&calls](int attempts) {
+                ++calls;
+                return attempts < 3;
+        };
+
+        Session db2(scratch.uri(), options);
+
+        db1.exec("BEGIN IMMEDIATE");
+
+        try {
+                db2.exec("BEGIN IMMEDIATE");
+                throw TestFailure("second BEGIN IMMEDIATE did not throw wr::sql::Busy");
+        } catch (Busy &) {
+                // expected
+        }
+
+        db1.exec("ROLLBACK");
+
+        if (calls != 4) {
+                throw TestFailure("busy handler called %d time(s), expected 4",
+                                  calls);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::busyHandlerOnOpen() // static
+{
+        ScratchDB      scratch;
+        Session        db1(scratch.uri());
+        SessionOptions options;
+        int            calls = 0;
+
+        db1.exec("CREATE TABLE foo (id INTEGER PRIMARY KEY)");
+        db1.exec("BEGIN EXCLUSIVE");
+
+        // changing the journal mode waits for db1 to release its lock
+        options.journal_mode = SessionOptions::WAL_JOURNAL;
+        options.busy_handler = [&](int) {
+                if (!calls++) {
+                        db1.exec("ROLLBACK");
+                }
+                return true;
+        };
+
+        Session db2(scratch.uri(), options);
+
+        if (!calls) {
+                throw TestFailure("busy handler not called while opening");
+        } else if (db2.exec("PRAGMA journal_mode").begin().get<std::string>(0)
+                        != "wal") {
+                throw TestFailure("journal mode not applied");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::busyHandlerThrows() // static
+{
+        ScratchDB      scratch;
+        Session        db1(scratch.uri());
+        SessionOptions options;
+
+        options.busy_handler = [](int) -> bool {
+                throw std::runtime_error("busy handler failed");
+        };
+
+        Session db2(scratch.uri(), options);
+
+        db1.exec("BEGIN IMMEDIATE");
+
+        try {
+                db2.exec("BEGIN IMMEDIATE");
+                throw TestFailure("second BEGIN IMMEDIATE did not throw wr::sql::Busy");
+        } catch (Busy &) {
+                // expected: the exception is not propagated through SQLite
+        }
+
+        db1.exec("ROLLBACK");
+}
+
+//--------------------------------------
+
 void
 wr::sql::SessionTests::getURI() // static
 {
@@ -304,6 +566,271 @@ wr::sql::SessionTests::createSampleDBSchema() // static
 
 //--------------------------------------
 
+static const size_t INSERT_BATCH_ROW = wr::sql::registerStatement(
+                        "INSERT INTO batch (id, value) VALUES (?, ?)");
+
+//--------------------------------------
+
+static std::vector<std::tuple<int, double>>
+batchRows(
+        int n
+)
+{
+        std::vector<std::tuple<int, double>> rows;
+
+        for (int i = 1; i <= n; ++i) {
+                rows.emplace_back(i, i * 0.5);
+        }
+
+        return rows;
+}
+
+//--------------------------------------
+
+static int
+countBatchRows(
+        wr::sql::Session &db
+)
+{
+        return db.exec("SELECT COUNT(*) FROM batch").begin().get<int>(0);
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::execBatch1() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE batch (id INTEGER PRIMARY KEY, value REAL)");
+
+        auto   rows = batchRows(1000);
+        size_t n = db.execBatch(INSERT_BATCH_ROW, rows);
+
+        if (n != rows.size()) {
+                throw TestFailure("db.execBatch() returned %u, expected %u",
+                                  n, rows.size());
+        } else if (countBatchRows(db) != 1000) {
+                throw TestFailure("table has %d rows, expected 1000",
+                                  countBatchRows(db));
+        }
+
+        auto sum = db.exec("SELECT SUM(value) FROM batch").begin()
+                     .get<double>(0);
+
+        if (sum != 250250.0) {
+                throw TestFailure("sum of values is %g, expected 250250",
+                                  sum);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::execBatch2() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE batch (id INTEGER PRIMARY KEY, value REAL)");
+
+        auto   rows = batchRows(250);
+        size_t n = db.execBatch(INSERT_BATCH_ROW, rows.begin(), rows.end(),
+                                100);
+
+        if (n != 250) {
+                throw TestFailure("db.execBatch() returned %u, expected 250",
+                                  n);
+        } else if (countBatchRows(db) != 250) {
+                throw TestFailure("table has %d rows, expected 250",
+                                  countBatchRows(db));
+        }
+}
+
+//--------------------------------------
+/**
+ * Ensure that a failing element rolls back only the chunk containing it.
+ */
+void
+wr::sql::SessionTests::execBatchFailure() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE batch (id INTEGER PRIMARY KEY, value REAL)");
+
+        auto rows = batchRows(30);
+        std::get<0>(rows[25]) = 1;  // duplicate primary key
+
+        try {
+                db.execBatch(INSERT_BATCH_ROW, rows, 10);
+                throw TestFailure("db.execBatch() did not throw exception for constraint violation");
+        } catch (const Error &) {
+                ;  // OK
+        }
+
+        if (countBatchRows(db) != 20) {
+                throw TestFailure("table has %d rows after failed batch, expected 20",
+                                  countBatchRows(db));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::execBatchNested() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE batch (id INTEGER PRIMARY KEY, value REAL)");
+
+        db.beginTransaction([&](Transaction &txn) {
+                db.execBatch(INSERT_BATCH_ROW, batchRows(50), 10);
+                txn.rollback();
+        });
+
+        if (countBatchRows(db) != 0) {
+                throw TestFailure("table has %d rows after outer transaction rolled back, expected 0",
+                                  countBatchRows(db));
+        }
+}
+
+//--------------------------------------
+
+static const char SCRIPT_SQL[] = u8R"(
+        -- schema; trigger body and string literal both contain ';'
+        CREATE TABLE IF NOT EXISTS script (id INTEGER PRIMARY KEY, note TEXT);
+        CREATE TABLE IF NOT EXISTS script_log (id INTEGER, note TEXT);
+        CREATE TRIGGER IF NOT EXISTS script_ins AFTER INSERT ON script BEGIN
+                INSERT INTO script_log VALUES (new.id, new.note);
+        END;;
+        INSERT INTO script (note) VALUES ('a;b');
+        /* trailing comment */;
+        SELECT COUNT(*), MAX(note) FROM script_log
+)";
+
+static const char SCRIPT_BOUND_SQL[] =
+        "INSERT INTO batch (id, value) VALUES (:id, :value);"
+        "UPDATE batch SET value = value * :scale WHERE id = :id;"
+        "SELECT value FROM batch WHERE id = :id";
+
+static const size_t SCRIPT_BOUND = wr::sql::registerScript(SCRIPT_BOUND_SQL);
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::execScript1() // static
+{
+        Session db(":memory:");
+
+        const auto &stmts = registeredScript(registerScript(SCRIPT_SQL));
+
+        if (stmts.size() != 5) {
+                throw TestFailure("script split into %u statements, expected 5",
+                                  stmts.size());
+        } else if (registeredStatement(stmts[3])
+                        != "INSERT INTO script (note) VALUES ('a;b');") {
+                throw TestFailure("statement 4 is \"%s\"",
+                                  registeredStatement(stmts[3]));
+        }
+
+        for (int i = 1; i <= 2; ++i) {
+                Statement result = db.execScript(SCRIPT_SQL);
+
+                if (!result.isActive()) {
+                        throw TestFailure("run %d: final SELECT returned no rows",
+                                          i);
+                } else if (result.currentRow().get<int>(0) != i) {
+                        throw TestFailure("run %d: script_log has %d rows, expected %d",
+                                          i, result.currentRow().get<int>(0),
+                                          i);
+                } else if (result.currentRow().get<std::string>(1) != "a;b") {
+                        throw TestFailure("run %d: logged note is \"%s\", expected \"a;b\"",
+                                          i, result.currentRow()
+                                                   .get<std::string>(1));
+                }
+        }
+
+        if (db.execScript(" -- nothing here ;\n").isPrepared()) {
+                throw TestFailure("execScript() of empty script returned a prepared statement");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::execScript2() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE batch (id INTEGER PRIMARY KEY, value REAL)");
+
+        if (registerScript(SCRIPT_BOUND_SQL) != SCRIPT_BOUND) {
+                throw TestFailure("repeated registerScript() returned a different ID");
+        } else if (registeredScript(SCRIPT_BOUND).size() != 3) {
+                throw TestFailure("registered script has %u statements, expected 3",
+                                  registeredScript(SCRIPT_BOUND).size());
+        }
+
+        size_t select_id = registeredScript(SCRIPT_BOUND).back();
+
+        for (int id = 1; id <= 3; ++id) {
+                auto result = db.execScript(SCRIPT_BOUND, ":id", id,
+                                            ":value", id * 0.5,
+                                            ":scale", 4, ":unused", 0);
+                Statement::Ptr stmt = db.statement(select_id);
+
+                if (!result) {
+                        throw TestFailure("id %d: final SELECT returned no rows",
+                                          id);
+                } else if (result->currentRow().get<double>(0) != id * 2.0) {
+                        throw TestFailure("id %d: value is %g, expected %g",
+                                          id,
+                                          result->currentRow().get<double>(0),
+                                          id * 2.0);
+                } else if (stmt.get() == &*result) {
+                        throw TestFailure("id %d: cached statement handed out while in use",
+                                          id);
+                }
+        }
+
+        if (countBatchRows(db) != 3) {
+                throw TestFailure("table has %d rows, expected 3",
+                                  countBatchRows(db));
+        }
+
+        try {
+                db.execScript(numRegisteredScripts());
+                throw TestFailure("execScript() accepted an unregistered script ID");
+        } catch (std::invalid_argument &) {
+                // expected
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::execScript3() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE batch (id INTEGER PRIMARY KEY, value REAL)");
+
+        try {
+                db.execScript("INSERT INTO batch VALUES (1, 0.5);"
+                              "INSERT INTO batch VALUES (1, 1.0);"
+                              "INSERT INTO batch VALUES (2, 1.5)");
+                throw TestFailure("constraint violation not reported");
+        } catch (Error &) {
+                // expected
+        }
+
+        if (countBatchRows(db) != 1) {
+                throw TestFailure("table has %d rows after failed script, expected 1",
+                                  countBatchRows(db));
+        }
+}
+
+//--------------------------------------
+
 void
 wr::sql::SessionTests::hasObject1() // static
 {
@@ -444,6 +971,34 @@ wr::sql::SessionTests::statement3() // static
         }
 }
 
+//--------------------------------------
+/**
+ * Ensure that the additional `Statement` objects compiled for reentrant use
+ * are also cached and reused.
+ */
+void
+wr::sql::SessionTests::statement4() // static
+{
+        static size_t GET_PARIS_CODE = registerStatement(
+                        "SELECT code FROM offices WHERE city = 'Paris'");
+
+        SampleDB       db(defaultURI());
+        Statement::Ptr stmt[2];
+
+        for (int pass = 0; pass < 2; ++pass) {
+                Session::ExecResult result[2] = { db.exec(GET_PARIS_CODE),
+                                                  db.exec(GET_PARIS_CODE) };
+
+                if (pass == 0) {
+                        stmt[0] = static_cast<Statement::Ptr>(result[0]);
+                        stmt[1] = static_cast<Statement::Ptr>(result[1]);
+                } else if ((static_cast<Statement::Ptr>(result[0]) != stmt[0])
+                           || (static_cast<Statement::Ptr>(result[1]) != stmt[1])) {
+                        throw TestFailure("nested calls to db.exec() did not reuse cached Statement objects");
+                }
+        }
+}
+
 //--------------------------------------
 
 void
@@ -760,6 +1315,136 @@ wr::sql::SessionTests::clearProgressHandler() // static
 
 //--------------------------------------
 
+// takes several seconds to run to completion unless interrupted
+static const char SLOW_COUNT[] =
+        "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c "
+                                "LIMIT 100000000) "
+        "SELECT COUNT(*) FROM c";
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::deadline1() // static
+{
+        using namespace std::chrono;
+
+        Session db(":memory:");
+        auto    start = Session::Clock::now();
+
+        try {
+                db.execWithDeadline(milliseconds(50), SLOW_COUNT);
+                throw TestFailure("statement not interrupted by deadline");
+        } catch (Interrupt &) {
+                // expected
+        }
+
+        auto elapsed = Session::Clock::now() - start;
+
+        if (elapsed > seconds(2)) {
+                throw TestFailure("statement interrupted after %d ms, expected about 50",
+                                  duration_cast<milliseconds>(elapsed).count());
+        } else if (db.deadline() != Session::Clock::time_point::max()) {
+                throw TestFailure("deadline not removed on exit from execWithDeadline()");
+        }
+
+        int n = db.execWithDeadline(seconds(60), "SELECT COUNT(*) FROM "
+                                        "(SELECT 1 UNION ALL SELECT 2)")
+                  .begin().get<int>(0);
+
+        if (n != 2) {
+                throw TestFailure("statement within deadline returned %d, expected 2",
+                                  n);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::deadline2() // static
+{
+        using namespace std::chrono;
+
+        Session db(":memory:");
+        bool    called = false;
+
+        if (db.progressInterval() != 10000) {
+                throw TestFailure("default progress interval is %u, expected 10000",
+                                  db.progressInterval());
+        }
+
+        db.setProgressInterval(100);
+        db.setProgressHandler([&called] { called = true; return false; });
+
+        auto outer_end = Session::Clock::now() + milliseconds(50);
+
+        {
+                Session::ScopedDeadline outer(db, outer_end);
+                Session::ScopedDeadline inner(db, minutes(10));
+
+                if (db.deadline() != outer_end) {
+                        throw TestFailure("inner deadline extended the outer deadline");
+                }
+
+                try {
+                        db.exec(SLOW_COUNT);
+                        throw TestFailure("statement not interrupted by deadline");
+                } catch (Interrupt &) {
+                        // expected
+                }
+        }
+
+        if (!called) {
+                throw TestFailure("progress handler not called alongside deadline");
+        } else if (db.deadline() != Session::Clock::time_point::max()) {
+                throw TestFailure("deadline not restored by ScopedDeadline");
+        }
+
+        // no deadline, so the handler alone decides
+        db.setProgressHandler([] { return true; });
+
+        try {
+                db.exec(SLOW_COUNT);
+                throw TestFailure("statement not interrupted by progress handler");
+        } catch (Interrupt &) {
+                // expected
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::deadline3() // static
+{
+        using namespace std::chrono;
+
+        static const char URI[]
+                = "file:deadline3?mode=memory&cache=shared";
+
+        Session writer(URI), reader(URI);
+
+        writer.exec("CREATE TABLE locked (id INTEGER PRIMARY KEY)");
+
+        writer.beginTransaction([&](Transaction &) {
+                writer.exec("INSERT INTO locked VALUES (1)");
+
+                // table stays locked until writer commits, so wait times out
+                Session::ScopedDeadline deadline(reader, milliseconds(50));
+
+                try {
+                        reader.exec("SELECT * FROM locked");
+                        throw TestFailure("read from locked table did not time out");
+                } catch (Interrupt &) {
+                        // expected
+                }
+        });
+
+        if (reader.exec("SELECT COUNT(*) FROM locked").begin().get<int>(0) != 1) {
+                throw TestFailure("reader unable to read table after unlock");
+        }
+}
+
+//--------------------------------------
+
 void
 wr::sql::SessionTests::onFinalCommit() // static
 {
@@ -798,3 +1483,232 @@ wr::sql::SessionTests::onRollback() // static
                 throw TestFailure("rollback hook function not called");
         }
 }
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::statisticsDisabled() // static
+{
+        SampleDB db(defaultURI());
+
+        db.exec("SELECT COUNT(*) FROM offices");
+
+        if (db.statisticsEnabled()) {
+                throw TestFailure("db.statisticsEnabled() returned true by default");
+        }
+        if (!db.statistics().empty()) {
+                throw TestFailure("statistics collected while disabled");
+        }
+
+        Session closed;
+
+        try {
+                closed.enableStatistics();
+        } catch (std::logic_error &) {
+                return;
+        }
+
+        throw TestFailure("enableStatistics() on closed Session did not throw std::logic_error");
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::statistics() // static
+{
+        static const size_t GET_OFFICE_CITIES = registerStatement(
+                        "SELECT city FROM offices WHERE country <> ?");
+
+        SampleDB db(defaultURI());
+
+        db.enableStatistics();
+
+        for (int i = 0; i < 3; ++i) {
+                for (Row row: db.exec(GET_OFFICE_CITIES, "Japan")) {
+                        (void) row;
+                }
+        }
+
+        db.exec("SELECT COUNT(*) FROM employees");
+
+        auto stats = db.statistics();
+        const StatementStats *registered = nullptr, *ad_hoc = nullptr;
+
+        for (auto &entry: stats) {
+                if (entry.stmt_id == GET_OFFICE_CITIES) {
+                        registered = &entry;
+                } else if (entry.sql == "SELECT COUNT(*) FROM employees") {
+                        ad_hoc = &entry;
+                }
+        }
+
+        if (!registered) {
+                throw TestFailure("no statistics for registered statement");
+        } else if (registered->executions != 3) {
+                throw TestFailure("registered statement executed %u times, expected 3",
+                                  registered->executions);
+        } else if (registered->rows != 18) {
+                throw TestFailure("registered statement returned %u rows, expected 18",
+                                  registered->rows);
+        } else if (!registered->fullscan_steps || !registered->vm_steps) {
+                throw TestFailure("full scan and VM step counters not collected");
+        } else if ((registered->p99_time > registered->max_time)
+                   || (registered->max_time > registered->total_time)) {
+                throw TestFailure("inconsistent execution times recorded");
+        }
+
+        if (!ad_hoc) {
+                throw TestFailure("no statistics for ad hoc statement");
+        } else if (ad_hoc->stmt_id != StatementStats::UNREGISTERED) {
+                throw TestFailure("ad hoc statement reported as registered with ID %u",
+                                  ad_hoc->stmt_id);
+        } else if ((ad_hoc->executions != 1) || (ad_hoc->rows != 1)) {
+                throw TestFailure("ad hoc statement recorded %u executions and %u rows, expected 1 and 1",
+                                  ad_hoc->executions, ad_hoc->rows);
+        }
+
+        db.resetStatistics();
+
+        if (!db.statistics().empty()) {
+                throw TestFailure("statistics remain after resetStatistics()");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::memoryStats() // static
+{
+        static const size_t GET_EMPLOYEES = registerStatement(
+                        "SELECT * FROM employees");
+
+        SessionOptions options;
+        options.lookaside = SessionOptions::Lookaside{ 256, 64 };
+
+        SampleDB db(defaultURI(), options);
+
+        for (Row row: db.exec(GET_EMPLOYEES)) {
+                (void) row;
+        }
+
+        auto stats = db.memoryStats();
+
+        if (!stats.cache_used || !stats.schema_used || !stats.stmt_used) {
+                throw TestFailure("cache, schema or statement memory not reported");
+        } else if (stats.cached_stmts < 1) {
+                throw TestFailure("cached registered statement not counted");
+        } else if (stats.lookaside_highwater > 64) {
+                throw TestFailure("%u lookaside slots used, only 64 configured",
+                                  stats.lookaside_highwater);
+        } else if (stats.memoryUsed() < stats.schema_used + stats.stmt_used) {
+                throw TestFailure("memoryUsed() less than its components");
+        }
+
+        db.releaseMemory();
+
+        if (db.memoryStats().cached_stmts != 0) {
+                throw TestFailure("cached statements remain after releaseMemory()");
+        }
+
+        db.close();
+
+        if (db.memoryStats().memoryUsed() != 0) {
+                throw TestFailure("closed Session reported memory in use");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::alphaNumCollation() // static
+{
+        static const struct { const char *a, *b; int cmp; } CASES[] = {
+                { "abc", "ABC", 0 },
+                { "a-b-c", "ABC", 0 },
+                { "  item 10", "ITEM10", 0 },
+                { "abcdefghijklmnop", "ABCDEFGHIJKLMNOP", 0 },
+                { "abcdefghijklmnop", "abcdefghijklmnoq", -1 },
+                { "abcdefgh-ijklmnop", "abcdefghijklmnop", 0 },
+                { "abd", "abc", 1 },
+                { "ab", "abc", -1 },
+                { "abc!", "abc", 1 },
+                { "abc!", "abc?", 0 },
+                { "!abc", "abc!", -1 },
+                { "abcdefghij\xc3\xa9", "abcdefghij\xc3\xa9", 0 },
+                { "abcdefghij!\xc3\xa9", "abcdefghij?\xc3\xa9", 0 },
+                { "abcdefghij\xc3\xa9z", "abcdefghij\xc3\xa9y", 1 },
+                { "", "", 0 },
+                { "", "-", -1 }
+        };
+
+        Session db(":memory:");
+
+        for (auto &c: CASES) {
+                int cmp = db.exec("SELECT (?1 > ?2 COLLATE ALPHANUM) "
+                                  "- (?1 < ?2 COLLATE ALPHANUM)", c.a, c.b)
+                            .begin().get<int>(0);
+                if (cmp != c.cmp) {
+                        throw TestFailure("\"%s\" vs. \"%s\" compared %d, expected %d",
+                                          c.a, c.b, cmp, c.cmp);
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::SessionTests::alphaNumKey() // static
+{
+        static const char * const WORDS[] = {
+                "abc", "ABC", "a-b-c", "ab", "abd", "abc!", "abc?!", "!abc",
+                "item 2", "item 10", "Item10", "", "-", "--", "z",
+                "\xc3\xa9t\xc3\xa9", "\xc3\x89T\xc3\x89", "ete",
+                "abcdefghij\xc3\xa9", "abcdefghij!\xc3\xa9",
+                "\xe2\x82\xac" "100", "\xf0\x9f\x98\x80 x"
+        };
+
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE words (word TEXT, "
+                "key BLOB GENERATED ALWAYS AS (alphanum_key(word)))");
+        db.exec("CREATE INDEX words_key ON words (key)");
+
+        for (auto word: WORDS) {
+                db.exec("INSERT INTO words (word) VALUES (?)", word);
+        }
+
+        size_t n = 0;
+
+        for (Row row: db.exec(
+                        "SELECT a.word, b.word, "
+                        "       (a.word > b.word COLLATE ALPHANUM) "
+                        "         - (a.word < b.word COLLATE ALPHANUM), "
+                        "       (a.key > b.key) - (a.key < b.key) "
+                        "FROM words a, words b")) {
+                if (row.get<int>(2) != row.get<int>(3)) {
+                        throw TestFailure("alphanum_key() ordered \"%s\" vs. \"%s\" as %d, collation as %d",
+                                          row.get<std::string>(0),
+                                          row.get<std::string>(1),
+                                          row.get<int>(3), row.get<int>(2));
+                }
+                ++n;
+        }
+
+        if (n != 22 * 22) {
+                throw TestFailure("%u pairs compared, expected %u", n, 22 * 22);
+        } else if (!db.exec("SELECT alphanum_key(NULL) IS NULL").begin()
+                                .get<bool>(0)) {
+                throw TestFailure("alphanum_key(NULL) did not return NULL");
+        }
+
+        // SQLite does not validate UTF-8: truncated sequences at the end
+        for (auto word: { "ab\xe2\x82", "ab\xc3", "ab\xf0\x9f\x98",
+                          "\xc3\xa9\xf0" }) {
+                auto key = db.exec("SELECT hex(alphanum_key(?))", word)
+                                .begin().get<std::string>(0);
+                if (key.size() < 10) {
+                        throw TestFailure("alphanum_key() of invalid UTF-8 returned \"%s\"",
+                                          key);
+                }
+        }
+}
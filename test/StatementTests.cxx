@@ -25,9 +25,13 @@
 #include <cmath>
 #include <iostream>
 #include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include <wrutil/codecvt.h>
 #include <wrutil/optional.h>
+#include <wrsql/ColumnBatch.h>
 #include <wrsql/Error.h>
 #include <wrsql/Session.h>
 #include <wrsql/Statement.h>
@@ -36,10 +40,34 @@
 #include "SQLTestManager.h"
 
 
+namespace {
+
+
+struct Office
+{
+        std::string                code,
+                                   city;
+        wr::optional<std::string>  state;
+};
+
+
+} // anonymous namespace
+
+
 namespace wr {
 namespace sql {
 
 
+template <> struct RowFields<Office>
+{
+        static auto fields()
+        {
+                return std::make_tuple(&Office::code, &Office::city,
+                                       &Office::state);
+        }
+};
+
+
 class StatementTests : public SQLTestManager
 {
 public:
@@ -97,6 +125,9 @@ public:
         static void bindBlob(),
                     bindBlobWithFree(),
                     bindBlobDupFree(),
+                    bindBlobFreeOnRebind(),
+                    bindMovedString(),
+                    bindMovedBlob(),
                     bindOptional(),
                     bindAfterFetch(),
                     bindUserType(),
@@ -104,6 +135,22 @@ public:
                     variadicBind2(),
                     bindDuringActiveStatement1(),
                     bindDuringActiveStatement2(),
+                    executeBatchTuples(),
+                    executeBatchValues(),
+                    executeBatchDiscardsRows(),
+                    colNoByName(),
+                    colNoDuplicateName(),
+                    columnRef(),
+                    columnRefOtherStatement(),
+                    columnRefAfterSchemaChange(),
+                    rowAsTuple(),
+                    rowAsPair(),
+                    rowAsStruct(),
+                    fetchAll(),
+                    fetchInto(),
+                    fetchTooFewColumns(),
+                    fetchBatchTypes(),
+                    fetchBatchResume(),
                     resetUnpreppedStatement(),
                     resetPreppedStatement(),
                     resetPreservesBindings(),
@@ -210,6 +257,9 @@ wr::sql::StatementTests::runAll()
         run("bindBlob", 1, &bindBlob);
         run("bindBlob", 2, &bindBlobWithFree);
         run("bindBlob", 3, &bindBlobDupFree);
+        run("bindBlob", 4, &bindBlobFreeOnRebind);
+        run("bindMoved", 1, &bindMovedString);
+        run("bindMoved", 2, &bindMovedBlob);
         run("bindOptional", 1, &bindOptional);
         run("bindAfterFetch", 1, &bindAfterFetch);
         run("bindUserType", 1, &bindUserType);
@@ -217,6 +267,22 @@ wr::sql::StatementTests::runAll()
         run("variadicBind", 2, &variadicBind2);
         run("bindDuringActiveStatement", 1, &bindDuringActiveStatement1);
         run("bindDuringActiveStatement", 2, &bindDuringActiveStatement2);
+        run("executeBatch", 1, &executeBatchTuples);
+        run("executeBatch", 2, &executeBatchValues);
+        run("executeBatch", 3, &executeBatchDiscardsRows);
+        run("colNo", 1, &colNoByName);
+        run("colNo", 2, &colNoDuplicateName);
+        run("columnRef", 1, &columnRef);
+        run("columnRef", 2, &columnRefOtherStatement);
+        run("columnRef", 3, &columnRefAfterSchemaChange);
+        run("rowAs", 1, &rowAsTuple);
+        run("rowAs", 2, &rowAsPair);
+        run("rowAs", 3, &rowAsStruct);
+        run("fetchAll", 1, &fetchAll);
+        run("fetchInto", 1, &fetchInto);
+        run("fetchInto", 2, &fetchTooFewColumns);
+        run("fetchBatch", 1, &fetchBatchTypes);
+        run("fetchBatch", 2, &fetchBatchResume);
         run("reset", 1, &resetUnpreppedStatement);
         run("reset", 2, &resetPreppedStatement);
         run("reset", 3, &resetPreservesBindings);
@@ -1079,13 +1145,136 @@ wr::sql::StatementTests::bindBlobDupFree() // static
 
         static const auto STR = u8"The quick brown fox jumps over the lazy dog";
 
-        query.bind(1, STR, strlen(STR), [](void *) {});
+        int freed = 0;
 
-        try {
-                query.bind(2, STR, strlen(STR), [](void *) {});
-                throw TestFailure("exception not thrown on duplicate registration of blob data");
-        } catch (Error &) {
-                // OK, expected
+        // the same data may be bound more than once, each with a destructor
+        query.bind(1, STR, strlen(STR), [&freed](void *) { ++freed; });
+        query.bind(2, STR, strlen(STR), [&freed](void *) { ++freed; });
+
+        auto row = query.begin();
+
+        if ((row.get<u8string_view>(0) != STR)
+                        || (row.get<u8string_view>(1) != STR)) {
+                throw TestFailure("retrieved blob values differ from bound data");
+        }
+
+        query.clearBindings();
+
+        if (freed != 2) {
+                throw TestFailure("free functions called %d time(s), expected 2",
+                                  freed);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::bindBlobFreeOnRebind() // static
+{
+        Statement query(db_, "SELECT ?1");
+
+        static const auto STR = u8"The quick brown fox jumps over the lazy dog";
+
+        int freed = 0;
+
+        query.bind(1, STR, strlen(STR), [&freed](void *data) {
+                if (data == STR) {
+                        ++freed;
+                }
+        });
+
+        if (freed != 0) {
+                throw TestFailure("free function called before rebinding");
+        }
+
+        query.bind(1, 42);
+
+        if (freed != 1) {
+                throw TestFailure("free function called %d time(s) after rebinding, expected 1",
+                                  freed);
+        }
+
+        if (query.begin().get<int>(0) != 42) {
+                throw TestFailure("rebound parameter did not take new value");
+        }
+
+        query.bind(1, STR, strlen(STR), [&freed](void *) { ++freed; });
+        query.finalize();
+
+        if (freed != 2) {
+                throw TestFailure("free function not called by finalize()");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::bindMovedString() // static
+{
+        Statement   query(db_, "SELECT ?1, ?2");
+        std::string long_text(1000, 'x'), short_text("short");
+
+        query.bind(1, std::move(long_text)).bind(2, std::move(short_text));
+
+        auto row = query.begin();
+
+        if (row.get<std::string>(0) != std::string(1000, 'x')) {
+                throw TestFailure("long moved string not bound correctly");
+        }
+        if (row.get<std::string>(1) != "short") {
+                throw TestFailure("short moved string not bound correctly");
+        }
+
+        // rebinding must not disturb the other parameter
+        query.bind(2, std::string(100, 'y'));
+        row = query.begin();
+
+        if ((row.get<std::string>(0) != std::string(1000, 'x'))
+                        || (row.get<std::string>(1) != std::string(100, 'y'))) {
+                throw TestFailure("values incorrect after rebinding");
+        }
+
+        query.bindAll(std::string(200, 'z'), std::string(64, 'w'));
+        row = query.begin();
+
+        if ((row.get<std::string>(0) != std::string(200, 'z'))
+                        || (row.get<std::string>(1) != std::string(64, 'w'))) {
+                throw TestFailure("values incorrect after bindAll()");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::bindMovedBlob() // static
+{
+        Statement            query(db_, "SELECT ?1, typeof(?2), length(?2)");
+        std::vector<uint8_t> blob(4096);
+
+        for (size_t i = 0; i < blob.size(); ++i) {
+                blob[i] = static_cast<uint8_t>(i * 7);
+        }
+
+        auto expected = blob;
+        auto data     = blob.data();
+
+        query.bind(1, std::move(blob)).bind(2, std::vector<uint8_t>());
+
+        auto row   = query.begin();
+        auto bytes = static_cast<const uint8_t *>(row.get<const void *>(0));
+
+        if (bytes != data) {
+                throw TestFailure("moved blob was copied");
+        }
+
+        if ((static_cast<size_t>(row.colSize(0)) != expected.size())
+                        || !std::equal(expected.begin(), expected.end(),
+                                       bytes)) {
+                throw TestFailure("moved blob not bound correctly");
+        }
+        if ((row.get<std::string>(1) != "blob") || (row.get<int>(2) != 0)) {
+                throw TestFailure("empty vector bound as %s of length %d, expected blob of length 0",
+                                  row.get<std::string>(1), row.get<int>(2));
         }
 }
 
@@ -1376,6 +1565,498 @@ wr::sql::StatementTests::bindDuringActiveStatement2() // static
 
 //--------------------------------------
 
+void
+wr::sql::StatementTests::executeBatchTuples() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT)");
+
+        std::vector<std::tuple<int, std::string>> rows = {
+                std::make_tuple(1, "one"), std::make_tuple(2, "two"),
+                std::make_tuple(3, "three")
+        };
+
+        std::pair<int, const char *> last_row = { 4, "four" };
+
+        Statement insert(db, "INSERT INTO t (id, name) VALUES (?, ?)");
+
+        size_t n = insert.executeBatch(rows);
+
+        if (n != rows.size()) {
+                throw TestFailure("insert.executeBatch() returned %u, expected %u",
+                                  n, rows.size());
+        }
+
+        insert.executeBatch(&last_row, &last_row + 1);
+
+        static const char * const EXPECTED_NAMES[]
+                                        = { "one", "two", "three", "four" };
+        int i = 0;
+
+        for (Row row: db.exec("SELECT id, name FROM t ORDER BY id")) {
+                auto id   = row.get<int>(0);
+                auto name = row.get<u8string_view>(1);
+                if (id != i + 1) {
+                        throw TestFailure("row %d has id %d, expected %d",
+                                          i, id, i + 1);
+                } else if (name != EXPECTED_NAMES[i]) {
+                        throw TestFailure("row %d has name \"%s\", expected \"%s\"",
+                                          i, name, EXPECTED_NAMES[i]);
+                }
+                ++i;
+        }
+
+        if (i != 4) {
+                throw TestFailure("table t has %d rows, expected 4", i);
+        }
+}
+
+//--------------------------------------
+/**
+ * Ensure that single-valued elements bind parameter 1 only, leaving the
+ * remaining parameters' bindings intact between elements.
+ */
+void
+wr::sql::StatementTests::executeBatchValues() // static
+{
+        Session db(":memory:");
+
+        db.exec("CREATE TABLE t (id INTEGER PRIMARY KEY, tag TEXT)");
+
+        Statement insert(db, "INSERT INTO t (id, tag) VALUES (?, ?)");
+        int       ids[] = { 10, 20, 30 };
+
+        insert.bind(2, "batch");
+
+        if (insert.executeBatch(ids) != 3) {
+                throw TestFailure("insert.executeBatch() did not return 3");
+        }
+
+        auto count = db.exec("SELECT COUNT(*) FROM t WHERE tag='batch'")
+                       .begin().get<int>(0);
+
+        if (count != 3) {
+                throw TestFailure("%d rows inserted with bound tag, expected 3",
+                                  count);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::executeBatchDiscardsRows() // static
+{
+        Statement   select(db_, "SELECT * FROM offices WHERE city=?");
+        std::string cities[] = { "London", "Paris", "Nowhere" };
+
+        if (select.executeBatch(cities) != 3) {
+                throw TestFailure("select.executeBatch() did not return 3");
+        } else if (select.isActive()) {
+                throw TestFailure("statement still active after select.executeBatch()");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::colNoByName() // static
+{
+        Statement stmt(db_, "SELECT code, city, phone, country FROM offices");
+        Row       row = stmt.begin();
+
+        static const char * const NAMES[] = { "code", "city", "phone",
+                                              "country" };
+
+        for (int i = 0; i < 4; ++i) {
+                int n = row.colNo(NAMES[i]);
+                if (n != i) {
+                        throw TestFailure("row.colNo(\"%s\") returned %d, expected %d",
+                                          NAMES[i], n, i);
+                }
+        }
+
+        if (row.colNo("postcode") != -1) {
+                throw TestFailure("row.colNo(\"postcode\") did not return -1");
+        }
+
+        try {
+                row.colNo_throw("postcode");
+                throw TestFailure("row.colNo_throw() did not throw exception for unknown column");
+        } catch (const std::invalid_argument &) {
+                ;  // OK
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::colNoDuplicateName() // static
+{
+        Statement stmt(db_, "SELECT 1 AS a, 2 AS b, 3 AS a");
+        Row       row = stmt.begin();
+
+        if (row.colNo("a") != 0) {
+                throw TestFailure("row.colNo(\"a\") returned %d, expected 0",
+                                  row.colNo("a"));
+        } else if (row.get<int>("a") != 1) {
+                throw TestFailure("row.get<int>(\"a\") returned %d, expected 1",
+                                  row.get<int>("a"));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::columnRef() // static
+{
+        ColumnRef city("city"), state("state"), missing("missing");
+        size_t    n = 0, num_null = 0;
+
+        for (Row row: db_.exec("SELECT * FROM offices ORDER BY code")) {
+                if (row.get<std::string>(city) != row.get<std::string>("city")) {
+                        throw TestFailure("ColumnRef and name lookup disagree on row %u",
+                                          n);
+                }
+                optional<std::string> s;
+                row.get(state, s);
+                if (!s) {
+                        ++num_null;
+                }
+                if (row.colNo(missing) != -1) {
+                        throw TestFailure("row.colNo(missing) did not return -1");
+                }
+                ++n;
+        }
+
+        if (n != 7) {
+                throw TestFailure("fetched %u rows, expected 7", n);
+        } else if (!num_null) {
+                throw TestFailure("ColumnRef did not report any NULL states");
+        } else if (city.name() != "city") {
+                throw TestFailure("city.name() returned \"%s\", expected \"city\"",
+                                  city.name());
+        }
+}
+
+//--------------------------------------
+/**
+ * Ensure that a `ColumnRef` object resolves its column again when used with
+ * a different statement.
+ */
+void
+wr::sql::StatementTests::columnRefOtherStatement() // static
+{
+        ColumnRef code("code");
+        Statement stmt1(db_, "SELECT code, city FROM offices WHERE code=1"),
+                  stmt2(db_, "SELECT city, code FROM offices WHERE code=1");
+
+        Row row1 = stmt1.begin();
+
+        if (row1.colNo(code) != 0) {
+                throw TestFailure("row1.colNo(code) returned %d, expected 0",
+                                  row1.colNo(code));
+        }
+
+        Row row2 = stmt2.begin();
+
+        if (row2.colNo(code) != 1) {
+                throw TestFailure("row2.colNo(code) returned %d, expected 1",
+                                  row2.colNo(code));
+        } else if (row2.get<int>(code) != 1) {
+                throw TestFailure("row2.get<int>(code) returned %d, expected 1",
+                                  row2.get<int>(code));
+        }
+}
+
+//--------------------------------------
+/**
+ * Ensure that column lookups reflect a change in result columns when SQLite
+ * recompiles a statement following a schema change.
+ */
+void
+wr::sql::StatementTests::columnRefAfterSchemaChange() // static
+{
+        Session   db(":memory:");
+        ColumnRef b("b");
+
+        db.exec("CREATE TABLE t (a INTEGER)");
+        db.exec("INSERT INTO t VALUES (1)");
+
+        Statement stmt(db, "SELECT * FROM t");
+
+        if (stmt.begin().colNo(b) != -1) {
+                throw TestFailure("column b found before being added");
+        }
+
+        stmt.reset();
+        db.exec("ALTER TABLE t ADD COLUMN b INTEGER DEFAULT 2");
+
+        Row row = stmt.begin();
+
+        if (row.colNo("b") != 1) {
+                throw TestFailure("row.colNo(\"b\") returned %d after schema change, expected 1",
+                                  row.colNo("b"));
+        } else if (row.get<int>(b) != 2) {
+                throw TestFailure("row.get<int>(b) returned %d after schema change, expected 2",
+                                  row.get<int>(b));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::rowAsTuple() // static
+{
+        Statement stmt(db_, "SELECT number, surname, reports_to "
+                            "FROM employees WHERE number=1002");
+
+        auto row = stmt.begin().as<std::tuple<int, std::string,
+                                              optional<int>>>();
+
+        if (std::get<0>(row) != 1002) {
+                throw TestFailure("number is %d, expected 1002",
+                                  std::get<0>(row));
+        } else if (std::get<1>(row) != "Murphy") {
+                throw TestFailure("surname is \"%s\", expected \"Murphy\"",
+                                  std::get<1>(row));
+        } else if (std::get<2>(row)) {
+                throw TestFailure("reports_to is %d, expected NULL",
+                                  *std::get<2>(row));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::rowAsPair() // static
+{
+        Statement                    stmt(db_, "SELECT city, phone FROM offices "
+                                               "WHERE code=4");
+        std::pair<std::string, std::string> row;
+
+        stmt.begin().as(row);
+
+        if (row.first != "Paris") {
+                throw TestFailure("city is \"%s\", expected \"Paris\"",
+                                  row.first);
+        } else if (row.second != "+33 14 723 4404") {
+                throw TestFailure("phone is \"%s\", expected \"+33 14 723 4404\"",
+                                  row.second);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::rowAsStruct() // static
+{
+        Statement stmt(db_, "SELECT code, city, state FROM offices "
+                            "WHERE code=?");
+
+        auto sf = stmt.begin("1").as<Office>();
+
+        if ((sf.code != "1") || (sf.city != "San Francisco")) {
+                throw TestFailure("decoded office %s \"%s\", expected 1 \"San Francisco\"",
+                                  sf.code, sf.city);
+        } else if (!sf.state || (*sf.state != "CA")) {
+                throw TestFailure("decoded state incorrectly");
+        }
+
+        auto paris = stmt.begin("4").as<Office>();
+
+        if (paris.state) {
+                throw TestFailure("state is \"%s\", expected NULL",
+                                  *paris.state);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::fetchAll() // static
+{
+        Statement stmt(db_, "SELECT code, city, state FROM offices "
+                            "ORDER BY code");
+
+        auto offices = stmt.fetchAll<Office>();
+
+        if (offices.size() != 7) {
+                throw TestFailure("stmt.fetchAll() returned %u rows, expected 7",
+                                  offices.size());
+        } else if (stmt.isActive()) {
+                throw TestFailure("statement still active after stmt.fetchAll()");
+        }
+
+        size_t i = 0;
+
+        for (Row row: stmt) {
+                if (row.get<std::string>(1) != offices[i].city) {
+                        throw TestFailure("row %u city \"%s\", expected \"%s\"",
+                                          i, offices[i].city,
+                                          row.get<std::string>(1));
+                }
+                ++i;
+        }
+
+        Statement count(db_, "SELECT COUNT(*) FROM customers WHERE country=?");
+        auto      n = count.fetchAll<std::tuple<int>>("USA");
+
+        if ((n.size() != 1) || (std::get<0>(n[0]) != 36)) {
+                throw TestFailure("stmt.fetchAll() with argument returned wrong result");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::fetchInto() // static
+{
+        Statement stmt(db_, "SELECT code, city FROM offices WHERE country=?");
+        std::vector<std::pair<int, std::string>> offices;
+
+        offices.reserve(16);
+
+        size_t n1 = stmt.fetchInto(offices, "USA"),
+               n2 = stmt.fetchInto(offices, "Japan");
+
+        if (n1 != 3) {
+                throw TestFailure("first stmt.fetchInto() returned %u, expected 3",
+                                  n1);
+        } else if (n2 != 1) {
+                throw TestFailure("second stmt.fetchInto() returned %u, expected 1",
+                                  n2);
+        } else if (offices.size() != 4) {
+                throw TestFailure("vector holds %u rows, expected 4",
+                                  offices.size());
+        } else if (offices.back().second != "Tokyo") {
+                throw TestFailure("last row has city \"%s\", expected \"Tokyo\"",
+                                  offices.back().second);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::fetchTooFewColumns() // static
+{
+        Statement                      stmt(db_, "SELECT code FROM offices");
+        std::vector<std::tuple<int, int>> rows;
+
+        try {
+                stmt.fetchInto(rows);
+                throw TestFailure("stmt.fetchInto() did not throw exception for too few columns");
+        } catch (const std::invalid_argument &) {
+                ;  // OK
+        }
+
+        if (!rows.empty()) {
+                throw TestFailure("stmt.fetchInto() appended rows before failing");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::fetchBatchTypes() // static
+{
+        Statement stmt(db_, "SELECT CAST(code AS INTEGER) AS code, city, "
+                            "state, NULL, CASE code WHEN '1' THEN 1 "
+                            "ELSE 0.5 END FROM offices ORDER BY code");
+        stmt.begin();
+
+        ColumnBatch batch = stmt.fetchBatch(100);
+
+        if (batch.numRows() != 7) {
+                throw TestFailure("batch holds %u rows, expected 7",
+                                  batch.numRows());
+        } else if (batch.numColumns() != 5) {
+                throw TestFailure("batch holds %u columns, expected 5",
+                                  batch.numColumns());
+        } else if (stmt.isActive()) {
+                throw TestFailure("statement still active after fetching all rows");
+        }
+
+        auto &code = batch.column(0), &city = batch.column(1),
+             &state = batch.column(2), &none = batch.column(3),
+             &mixed = batch.column(4);
+
+        if (code.name != "code") {
+                throw TestFailure("column 0 named \"%s\", expected \"code\"",
+                                  code.name);
+        } else if ((code.type != INT_TYPE) || (code.ints.size() != 7)
+                   || (code.ints[6] != 7)) {
+                throw TestFailure("integer column not stored correctly");
+        } else if ((city.type != TEXT_TYPE) || (city.offsets.size() != 8)
+                   || (city.text(0) != u8"San Francisco")) {
+                throw TestFailure("text column not stored correctly");
+        } else if ((none.type != NULL_TYPE) || (none.null_count != 7)
+                   || !none.isNull(6)) {
+                throw TestFailure("NULL column not stored correctly");
+        } else if ((mixed.type != FLOAT_TYPE) || (mixed.floats[0] != 1.0)
+                   || (mixed.floats[1] != 0.5)) {
+                throw TestFailure("integer column not widened to floating-point");
+        }
+
+        size_t nulls = 0;
+
+        for (size_t i = 0; i < batch.numRows(); ++i) {
+                if (state.isNull(i)) {
+                        if (state.valueSize(i) != 0) {
+                                throw TestFailure("NULL value in row %u is not empty",
+                                                  i);
+                        }
+                        ++nulls;
+                }
+        }
+
+        if ((nulls != state.null_count) || !nulls || (nulls == 7)) {
+                throw TestFailure("validity bitmap counts %u NULLs, expected %u",
+                                  nulls, state.null_count);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::StatementTests::fetchBatchResume() // static
+{
+        Statement   stmt(db_, "SELECT city FROM offices ORDER BY code");
+        ColumnBatch batch;
+        std::vector<std::string> cities;
+        std::vector<size_t>      sizes;
+
+        if (stmt.fetchBatch(batch, 3) != 0) {
+                throw TestFailure("stmt.fetchBatch() fetched rows before begin()");
+        }
+
+        stmt.begin();
+
+        while (size_t n = stmt.fetchBatch(batch, 3)) {
+                sizes.push_back(n);
+                for (size_t i = 0; i < n; ++i) {
+                        cities.push_back(batch.column(0).text(i).to_string());
+                }
+        }
+
+        if ((sizes.size() != 3) || (sizes[0] != 3) || (sizes[1] != 3)
+                                || (sizes[2] != 1)) {
+                throw TestFailure("7 rows were not fetched in batches of 3, 3 and 1");
+        }
+
+        auto expected = stmt.fetchAll<std::tuple<std::string>>();
+
+        for (size_t i = 0; i < expected.size(); ++i) {
+                if (cities[i] != std::get<0>(expected[i])) {
+                        throw TestFailure("row %u city \"%s\", expected \"%s\"",
+                                          i, cities[i],
+                                          std::get<0>(expected[i]));
+                }
+        }
+}
+
+//--------------------------------------
+
 void
 wr::sql::StatementTests::resetUnpreppedStatement() // static
 {
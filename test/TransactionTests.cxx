@@ -22,9 +22,12 @@
  *
  * \endparblock
  */
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <stdexcept>
 #include <thread>
+#include <vector>
 
 #include <wrutil/uiostream.h>
 
@@ -56,8 +59,15 @@ public:
                     begin(),
                     beginNested(),
                     rollback(),
+                    rollbackNested(),
+                    rollbackNestedActions(),
                     busyHandling(),
-                    nestedBusyHandling();
+                    nestedBusyHandling(),
+                    immediateLocking(),
+                    retryLimit(),
+                    retryCustom(),
+                    timeout1(),
+                    timeout2();
 
 private:
         static SampleDB db_;
@@ -90,8 +100,15 @@ wr::sql::TransactionTests::runAll()
         run("begin", 1, &begin);
         run("begin", 2, &beginNested);
         run("rollback", 1, &rollback);
+        run("rollback", 2, &rollbackNested);
+        run("rollback", 3, &rollbackNestedActions);
         run("busyHandling", 1, &busyHandling);
         run("busyHandling", 2, &nestedBusyHandling);
+        run("lockingMode", 1, &immediateLocking);
+        run("retryPolicy", 1, &retryLimit);
+        run("retryPolicy", 2, &retryCustom);
+        run("timeout", 1, &timeout1);
+        run("timeout", 2, &timeout2);
 
         return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -204,6 +221,85 @@ wr::sql::TransactionTests::rollback() // static
 
 //--------------------------------------
 
+void
+wr::sql::TransactionTests::rollbackNested() // static
+{
+        db_.exec("CREATE TEMP TABLE bar (id INTEGER PRIMARY KEY)");
+
+        auto txn1 = db_.beginTransaction([&](Transaction &txn1) {
+                db_.exec("INSERT INTO bar (id) VALUES (1)");
+
+                auto txn2 = db_.beginTransaction([&](Transaction &txn2) {
+                        db_.exec("INSERT INTO bar (id) VALUES (2)");
+                        txn2.rollback();
+                });
+
+                if (!txn2.rolledBack()) {
+                        throw TestFailure("txn2.rolledBack() returned false after completion, expected true");
+                }
+                if (!txn1.active()) {
+                        throw TestFailure("txn1.active() returned false after nested rollback, expected true");
+                }
+
+                try {
+                        db_.beginTransaction([&](Transaction &) {
+                                db_.exec("INSERT INTO bar (id) VALUES (3)");
+                                throw std::runtime_error("abandon txn3");
+                        });
+                } catch (std::runtime_error &) {
+                        // expected
+                }
+
+                db_.exec("INSERT INTO bar (id) VALUES (4)");
+        });
+
+        if (!txn1.committed()) {
+                throw TestFailure("txn1.committed() returned false after completion, expected true");
+        }
+
+        std::vector<int64_t> ids;
+
+        for (Row row: db_.exec("SELECT id FROM bar ORDER BY id")) {
+                ids.push_back(row.get<int64_t>(0));
+        }
+
+        if ((ids.size() != 2) || (ids[0] != 1) || (ids[1] != 4)) {
+                throw TestFailure("table contains %u row(s) after nested rollbacks, expected IDs 1 and 4",
+                                  ids.size());
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TransactionTests::rollbackNestedActions() // static
+{
+        int committed = 0, rolled_back = 0;
+
+        db_.beginTransaction([&](Transaction &) {
+                db_.onFinalCommit([&] { committed |= 1; });
+                db_.onRollback([&] { rolled_back |= 1; });
+
+                db_.beginTransaction([&](Transaction &txn2) {
+                        db_.onFinalCommit([&] { committed |= 2; });
+                        db_.onRollback([&] { rolled_back |= 2; });
+                        txn2.rollback();
+                });
+
+                if (rolled_back != 2) {
+                        throw TestFailure("rollback actions %d invoked after nested rollback, expected 2",
+                                          rolled_back);
+                }
+        });
+
+        if (committed != 1) {
+                throw TestFailure("commit actions %d invoked after final commit, expected 1",
+                                  committed);
+        }
+}
+
+//--------------------------------------
+
 void
 wr::sql::TransactionTests::busyHandling() // static
 {
@@ -349,3 +445,175 @@ wr::sql::TransactionTests::nestedBusyHandling() // static
                 throw TestFailure("expected busy condition on first transaction attempt");
         }
 }
+
+//--------------------------------------
+
+void
+wr::sql::TransactionTests::immediateLocking() // static
+{
+        Session db2(db_);
+
+        auto txn = db_.beginTransaction(IMMEDIATE_LOCKING, [&](Transaction &) {
+                // no statement executed yet, but write lock should be held
+                try {
+                        db2.exec("BEGIN IMMEDIATE");
+                } catch (Busy &) {
+                        return;
+                }
+                db2.exec("ROLLBACK");
+                throw TestFailure("second connection acquired write lock during IMMEDIATE_LOCKING transaction");
+        });
+
+        if (!txn.committed()) {
+                throw TestFailure("txn.committed() returned false after completion, expected true");
+        }
+        if (db_.lockingMode() != DEFERRED_LOCKING) {
+                throw TestFailure("db_.lockingMode() returned %d, expected DEFERRED_LOCKING",
+                                  static_cast<int>(db_.lockingMode()));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TransactionTests::retryLimit() // static
+{
+        RetryPolicy policy;
+        policy.max_attempts = 3;
+        policy.initial_delay = RetryPolicy::Duration(10);
+
+        int attempts = 0;
+
+        db_.resetTransactionStats();
+
+        try {
+                Transaction::begin(db_, DEFERRED_LOCKING, policy,
+                                   [&](Transaction &) {
+                        ++attempts;
+                        throw Busy();
+                });
+        } catch (Busy &) {
+                auto stats = db_.transactionStats();
+
+                if (attempts != 3) {
+                        throw TestFailure("transaction attempted %d time(s), expected 3",
+                                          attempts);
+                }
+                if (stats.busy_retries != 2) {
+                        throw TestFailure("stats.busy_retries is %u, expected 2",
+                                          stats.busy_retries);
+                }
+                if (stats.busy_failures != 1) {
+                        throw TestFailure("stats.busy_failures is %u, expected 1",
+                                          stats.busy_failures);
+                }
+                if (stats.backoff_time < std::chrono::microseconds(10)) {
+                        throw TestFailure("stats.backoff_time shorter than first retry delay");
+                }
+                return;
+        }
+
+        throw TestFailure("Transaction::begin() did not throw sql::Busy after retry limit reached");
+}
+
+//--------------------------------------
+
+void
+wr::sql::TransactionTests::retryCustom() // static
+{
+        RetryPolicy policy;
+        unsigned    last_failures = 0;
+
+        policy.decide = [&](unsigned failures, RetryPolicy::Duration,
+                            RetryPolicy::Duration &delay) {
+                last_failures = failures;
+                delay = RetryPolicy::Duration(0);
+                return failures < 5;
+        };
+
+        db_.setRetryPolicy(policy);
+
+        int attempts = 0;
+
+        auto txn = db_.beginTransaction([&](Transaction &) {
+                if (++attempts < 5) {
+                        throw Busy();
+                }
+        });
+
+        db_.setRetryPolicy(RetryPolicy());
+
+        if (!txn.committed()) {
+                throw TestFailure("txn.committed() returned false after completion, expected true");
+        }
+        if ((attempts != 5) || (last_failures != 4)) {
+                throw TestFailure("transaction attempted %d time(s) with %u failure(s) reported, expected 5 and 4",
+                                  attempts, last_failures);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TransactionTests::timeout1() // static
+{
+        using namespace std::chrono;
+
+        db_.exec("CREATE TEMP TABLE timeout_rows (id INTEGER PRIMARY KEY)");
+
+        try {
+                Transaction::begin(db_, milliseconds(50), [&](Transaction &) {
+                        db_.exec("INSERT INTO timeout_rows VALUES (1)");
+                        db_.exec("WITH RECURSIVE c(x) AS "
+                                        "(SELECT 1 UNION ALL SELECT x + 1 "
+                                         "FROM c LIMIT 100000000) "
+                                 "SELECT COUNT(*) FROM c");
+                });
+                throw TestFailure("transaction not interrupted by timeout");
+        } catch (Interrupt &) {
+                // expected
+        }
+
+        int n = db_.exec("SELECT COUNT(*) FROM timeout_rows").begin()
+                   .get<int>(0);
+
+        db_.exec("DROP TABLE timeout_rows");
+
+        if (n != 0) {
+                throw TestFailure("%d row(s) remain after timed-out transaction, expected 0",
+                                  n);
+        } else if (db_.deadline() != Session::Clock::time_point::max()) {
+                throw TestFailure("deadline not removed after transaction");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TransactionTests::timeout2() // static
+{
+        using namespace std::chrono;
+
+        RetryPolicy policy;
+        int         attempts = 0;
+
+        policy.initial_delay = milliseconds(20);
+        policy.growth = 1.0;
+        policy.jitter = false;
+
+        try {
+                Transaction::begin(db_, DEFERRED_LOCKING, policy,
+                                   milliseconds(50), [&](Transaction &) {
+                        ++attempts;
+                        throw Busy();
+                });
+                throw TestFailure("retries not abandoned at timeout");
+        } catch (Interrupt &) {
+                // expected
+        }
+
+        if ((attempts < 1) || (attempts > 3)) {
+                throw TestFailure("transaction attempted %d time(s), expected 1 to 3",
+                                  attempts);
+        }
+}
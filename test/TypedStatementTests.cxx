@@ -0,0 +1,224 @@
+/**
+ * \file TypedStatementTests.cxx
+ *
+ * \brief Unit test module for class template \c wr::sql::TypedStatement
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include <wrutil/u8string_view.h>
+#include <wrsql/Session.h>
+#include <wrsql/TypedStatement.h>
+
+#include "SampleDB.h"
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class TypedStatementTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        TypedStatementTests(int argc, const char **argv) :
+                base_t("TypedStatement", argc, argv)
+                { db_.init(defaultURI()); }
+
+        virtual ~TypedStatementTests() { db_.close(); }
+
+        int runAll();
+
+        static void registered(),
+                    fetchAll(),
+                    fetchOne(),
+                    execVoid(),
+                    tooFewParams(),
+                    tooManyColumns();
+
+private:
+        static SampleDB db_;
+};
+
+
+SampleDB TypedStatementTests::db_;
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::TypedStatementTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::TypedStatementTests::runAll()
+{
+        run("registered", 1, &registered);
+        run("fetchAll", 1, &fetchAll);
+        run("fetchOne", 1, &fetchOne);
+        run("exec", 1, &execVoid);
+        run("validate", 1, &tooFewParams);
+        run("validate", 2, &tooManyColumns);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::TypedStatementTests::registered() // static
+{
+        static const char SQL[] = "SELECT city FROM offices WHERE code = ?";
+        static const TypedStatement<std::tuple<std::string> (int)>
+                CITY_OF_OFFICE(SQL);
+
+        if (CITY_OF_OFFICE.id() != registerStatement(SQL)) {
+                throw TestFailure("TypedStatement did not register its SQL");
+        }
+
+        auto result = db_.exec(CITY_OF_OFFICE.id(), 4);
+
+        if (result->currentRow().get<std::string>(0) != "Paris") {
+                throw TestFailure("Session::exec() with TypedStatement ID returned wrong row");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TypedStatementTests::fetchAll() // static
+{
+        static const TypedStatement<
+                        std::pair<int, std::string> (u8string_view)>
+                OFFICES_IN("SELECT code, city FROM offices WHERE country = ? "
+                           "ORDER BY code");
+
+        auto offices = OFFICES_IN.fetchAll(db_, "USA");
+
+        if (offices.size() != 3) {
+                throw TestFailure("fetchAll() returned %u rows, expected 3",
+                                  offices.size());
+        } else if ((offices[0].first != 1)
+                   || (offices[0].second != "San Francisco")) {
+                throw TestFailure("first row (%d, \"%s\"), expected (1, \"San Francisco\")",
+                                  offices[0].first, offices[0].second);
+        }
+
+        size_t n = OFFICES_IN.fetchInto(offices, db_, "Japan");
+
+        if ((n != 1) || (offices.back().second != "Tokyo")) {
+                throw TestFailure("fetchInto() did not append the expected row");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TypedStatementTests::fetchOne() // static
+{
+        static const TypedStatement<std::tuple<int> (u8string_view)>
+                COUNT_CUSTOMERS("SELECT COUNT(*) FROM customers "
+                                "WHERE country = ?");
+        static const TypedStatement<std::tuple<int> (int)>
+                OFFICE_CODE("SELECT code FROM offices WHERE code = ?");
+
+        auto count = COUNT_CUSTOMERS.fetchOne(db_, "USA");
+
+        if (!count || (std::get<0>(*count) != 36)) {
+                throw TestFailure("fetchOne() returned wrong result");
+        } else if (OFFICE_CODE.fetchOne(db_, 100)) {
+                throw TestFailure("fetchOne() returned a row for empty result");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TypedStatementTests::execVoid() // static
+{
+        static const TypedStatement<void (int, u8string_view)>
+                INSERT_NOTE("INSERT INTO typed_notes VALUES (?, ?)");
+        static const TypedStatement<std::tuple<std::string> (int)>
+                NOTE("SELECT body FROM typed_notes WHERE id = ?");
+
+        db_.exec("CREATE TEMP TABLE IF NOT EXISTS typed_notes "
+                 "(id INTEGER PRIMARY KEY, body TEXT)");
+        db_.exec("DELETE FROM typed_notes");
+
+        INSERT_NOTE.exec(db_, 1, "first");
+        INSERT_NOTE.exec(db_, 2, "second");
+
+        auto note = NOTE.fetchOne(db_, 2);
+
+        if (!note || (std::get<0>(*note) != "second")) {
+                throw TestFailure("row inserted by exec() not found");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::TypedStatementTests::tooFewParams() // static
+{
+        static const TypedStatement<std::tuple<int> (u8string_view)>
+                BY_CITY_AND_COUNTRY("SELECT code FROM offices "
+                                    "WHERE city = ? AND country = ?");
+
+        try {
+                BY_CITY_AND_COUNTRY.fetchAll(db_, "Paris");
+        } catch (std::invalid_argument &) {
+                return;
+        }
+
+        throw TestFailure("parameter count mismatch did not throw std::invalid_argument");
+}
+
+//--------------------------------------
+
+void
+wr::sql::TypedStatementTests::tooManyColumns() // static
+{
+        static const TypedStatement<std::tuple<int, std::string> ()>
+                CODES("SELECT code FROM offices");
+
+        try {
+                CODES.fetchAll(db_);
+        } catch (std::invalid_argument &) {
+                return;
+        }
+
+        throw TestFailure("column count mismatch did not throw std::invalid_argument");
+}
@@ -0,0 +1,481 @@
+/**
+ * \file VirtualTableTests.cxx
+ *
+ * \brief Unit test module for class template \c wr::sql::VirtualTable
+ *
+ * \copyright
+ * \parblock
+ *
+ *   Copyright 2017 James S. Waller
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ * \endparblock
+ */
+#include <stdint.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <wrutil/optional.h>
+#include <wrsql/Error.h>
+#include <wrsql/Session.h>
+#include <wrsql/VirtualTable.h>
+
+#include "SampleDB.h"
+#include "SQLTestManager.h"
+
+
+namespace wr {
+namespace sql {
+
+
+class VirtualTableTests : public SQLTestManager
+{
+public:
+        using base_t = SQLTestManager;
+
+        VirtualTableTests(int argc, const char **argv) :
+                base_t("VirtualTable", argc, argv) {}
+
+        int runAll();
+
+        static void scanVector(),
+                    keyConstraints(),
+                    textKey(),
+                    orderByKey(),
+                    joinWithTable(),
+                    updateWriteBack(),
+                    updateRefused(),
+                    readOnly(),
+                    badColumns();
+};
+
+
+/*
+ * sample rows, sorted by code
+ */
+struct Part
+{
+        int64_t           code;
+        std::string       name;
+        double            price;
+        optional<int64_t> stock;
+};
+
+static std::vector<Part>
+sampleParts()
+{
+        std::vector<Part> parts;
+
+        for (int64_t code = 1; code <= 100; ++code) {
+                parts.push_back({ code * 10, "part " + std::to_string(code),
+                                  code * 1.5, nullopt });
+                if (code % 2) {
+                        parts.back().stock = code;
+                }
+        }
+
+        return parts;
+}
+
+//--------------------------------------
+
+static void
+declareColumns(
+        VirtualTable<Part> &table
+)
+{
+        table.column("code", &Part::code, SORTED_KEY_COLUMN)
+             .column("name", &Part::name)
+             .column("price", &Part::price)
+             .column("stock", &Part::stock);
+}
+
+//--------------------------------------
+
+static int64_t
+queryInt(
+        Session             &db,
+        const u8string_view &sql
+)
+{
+        auto result = db.exec(sql);
+        return result.currentRow().get<int64_t>(0);
+}
+
+
+} // namespace sql
+} // namespace wr
+
+//--------------------------------------
+
+int
+main(
+        int          argc,
+        const char **argv
+)
+{
+        return wr::sql::VirtualTableTests(argc, argv).runAll();
+}
+
+//--------------------------------------
+
+int
+wr::sql::VirtualTableTests::runAll()
+{
+        run("scan", 1, &scanVector);
+        run("key", 1, &keyConstraints);
+        run("key", 2, &textKey);
+        run("key", 3, &orderByKey);
+        run("join", 1, &joinWithTable);
+        run("update", 1, &updateWriteBack);
+        run("update", 2, &updateRefused);
+        run("update", 3, &readOnly);
+        run("column", 1, &badColumns);
+
+        return failed() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::scanVector() // static
+{
+        Session            db(":memory:");
+        auto               parts = sampleParts();
+        VirtualTable<Part> table(parts);
+
+        declareColumns(table);
+        table.attach(db, "parts");
+
+        if (queryInt(db, "SELECT COUNT(*) FROM parts") != 100) {
+                throw TestFailure("wrong number of rows");
+        } else if (queryInt(db, "SELECT COUNT(stock) FROM parts") != 50) {
+                throw TestFailure("empty optional members not NULL");
+        }
+
+        {
+                auto result = db.exec("SELECT rowid, name, price FROM parts "
+                                      "WHERE name = 'part 3'");
+                Row  row = result.currentRow();
+
+                if ((row.get<int>(0) != 2) || (row.get<double>(2) != 4.5)) {
+                        throw TestFailure("row (%d, \"%s\", %g), expected (2, \"part 3\", 4.5)",
+                                          row.get<int>(0),
+                                          row.get<std::string>(1),
+                                          row.get<double>(2));
+                }
+        }
+
+        // each statement sees the vector's current contents
+        parts.push_back({ 2000, "extra", 1, 1 });
+
+        if (queryInt(db, "SELECT MAX(code) FROM parts") != 2000) {
+                throw TestFailure("row appended to vector not seen");
+        }
+
+        table.detach();
+
+        if (table.db()) {
+                throw TestFailure("table still attached after detach()");
+        }
+
+        try {
+                db.exec("SELECT COUNT(*) FROM parts");
+        } catch (Error &) {
+                return;
+        }
+
+        throw TestFailure("table still queryable after detach()");
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::keyConstraints() // static
+{
+        Session            db(":memory:");
+        auto               parts = sampleParts();
+        VirtualTable<Part> table(parts);
+
+        declareColumns(table);
+        table.attach(db, "parts");
+
+        static const struct { const char *where; int64_t count; } CASES[] = {
+                { "code = 150", 1 },
+                { "code = 155", 0 },
+                { "code = 150.0", 1 },
+                { "code = '150'", 1 },
+                { "code = 'x'", 0 },
+                { "code = NULL", 0 },
+                { "code > 990", 1 },
+                { "code >= 990", 2 },
+                { "code < 20", 1 },
+                { "code <= 20", 2 },
+                { "code > 19.5 AND code < 40.5", 3 },
+                { "code BETWEEN 100 AND 200", 11 },
+                { "code < 'x'", 100 },
+                { "code IN (10, 20, 25, 1000)", 3 },
+                { "rowid = 5", 1 },
+                { "rowid = 500", 0 },
+                { "rowid = 5 AND code = 60", 1 },
+                { "rowid = 5 AND code = 70", 0 }
+        };
+
+        for (auto &c: CASES) {
+                auto n = queryInt(db, printStr("SELECT COUNT(*) FROM parts "
+                                               "WHERE %s", c.where));
+                if (n != c.count) {
+                        throw TestFailure("WHERE %s matched %d rows, expected %d",
+                                          c.where, n, c.count);
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::textKey() // static
+{
+        struct Word { std::string word; int64_t length; };
+
+        std::vector<Word> words = {
+                { "Banana", 6 }, { "apple", 5 }, { "banana", 6 },
+                { "cherry", 6 }, { "date", 4 }
+        };
+
+        Session            db(":memory:");
+        VirtualTable<Word> table(words);
+
+        table.column("word", &Word::word, SORTED_KEY_COLUMN)
+             .column("length", &Word::length)
+             .attach(db, "words");
+
+        static const struct { const char *where; int64_t count; } CASES[] = {
+                { "word = 'banana'", 1 },
+                { "word > 'banana'", 2 },
+                { "word >= 'b'", 3 },
+                { "word < 'apple'", 1 },
+                { "word = 'banana' COLLATE NOCASE", 2 },
+                { "word > 5", 5 }
+        };
+
+        for (auto &c: CASES) {
+                auto n = queryInt(db, printStr("SELECT COUNT(*) FROM words "
+                                               "WHERE %s", c.where));
+                if (n != c.count) {
+                        throw TestFailure("WHERE %s matched %d rows, expected %d",
+                                          c.where, n, c.count);
+                }
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::orderByKey() // static
+{
+        Session            db(":memory:");
+        auto               parts = sampleParts();
+        VirtualTable<Part> table(parts);
+
+        declareColumns(table);
+        table.attach(db, "parts");
+
+        int64_t last = -1;
+        size_t  n = 0;
+
+        for (Row row: db.exec("SELECT code FROM parts WHERE code > 500 "
+                              "ORDER BY code")) {
+                if (row.get<int64_t>(0) <= last) {
+                        throw TestFailure("rows not in key order");
+                }
+                last = row.get<int64_t>(0);
+                ++n;
+        }
+
+        if (n != 50) {
+                throw TestFailure("%u rows returned, expected 50", n);
+        }
+
+        last = 2000;
+
+        for (Row row: db.exec("SELECT code FROM parts ORDER BY code DESC")) {
+                if (row.get<int64_t>(0) >= last) {
+                        throw TestFailure("rows not in descending key order");
+                }
+                last = row.get<int64_t>(0);
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::joinWithTable() // static
+{
+        Session            db(":memory:");
+        auto               parts = sampleParts();
+        VirtualTable<Part> table(parts);
+
+        declareColumns(table);
+        table.attach(db, "parts");
+
+        db.exec("CREATE TABLE orders (id INTEGER PRIMARY KEY, part INTEGER, "
+                "qty INTEGER)");
+        db.exec("INSERT INTO orders (part, qty) VALUES "
+                "(10, 1), (20, 2), (30, 3), (35, 4), (990, 5)");
+
+        auto result = db.exec("SELECT COUNT(*), SUM(o.qty * p.price) "
+                              "FROM orders o JOIN parts p "
+                              "ON p.code = o.part");
+        Row  row = result.currentRow();
+
+        if ((row.get<int>(0) != 4)
+                        || (row.get<double>(1) != 1.5 + 6 + 13.5 + 742.5)) {
+                throw TestFailure("join returned (%d, %g), expected (4, 763.5)",
+                                  row.get<int>(0), row.get<double>(1));
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::updateWriteBack() // static
+{
+        Session            db(":memory:");
+        auto               parts = sampleParts();
+        VirtualTable<Part> table(parts);
+
+        declareColumns(table);
+        table.attach(db, "parts");
+
+        db.exec("UPDATE parts SET price = price * 2, name = 'renamed', "
+                "stock = NULL WHERE code = 30");
+
+        if ((parts[2].price != 9) || (parts[2].name != "renamed")
+                        || parts[2].stock) {
+                throw TestFailure("UPDATE not written back to row");
+        } else if (parts[1].price != 3) {
+                throw TestFailure("UPDATE changed other row");
+        }
+
+        db.exec("UPDATE parts SET stock = 7 WHERE code = 20");
+
+        if (!parts[1].stock || (*parts[1].stock != 7)) {
+                throw TestFailure("NULL member not set by UPDATE");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::updateRefused() // static
+{
+        Session            db(":memory:");
+        auto               parts = sampleParts();
+        VirtualTable<Part> table(parts);
+
+        declareColumns(table);
+        table.attach(db, "parts");
+
+        for (auto sql: { "UPDATE parts SET code = 5 WHERE code = 10",
+                         "UPDATE parts SET code = code, price = 0",
+                         "DELETE FROM parts WHERE code = 10",
+                         "INSERT INTO parts (code) VALUES (5)" }) {
+                try {
+                        db.exec(sql);
+                } catch (Error &) {
+                        continue;
+                }
+                throw TestFailure("statement did not fail: %s", sql);
+        }
+
+        if ((parts[0].code != 10) || (parts.size() != 100)
+                        || (parts[0].price != 1.5)) {
+                throw TestFailure("rows changed by refused statement");
+        }
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::readOnly() // static
+{
+        static const Part PARTS[] = {
+                { 1, "one", 1.0, nullopt },
+                { 2, "two", 2.0, 2 },
+                { 3, "three", 3.0, nullopt }
+        };
+
+        Session            db(":memory:");
+        VirtualTable<Part> table(PARTS, 3);
+
+        declareColumns(table);
+        table.attach(db, "parts");
+
+        if (!table.readOnly()) {
+                throw TestFailure("table over const array not read-only");
+        } else if (queryInt(db, "SELECT SUM(code) FROM parts "
+                                "WHERE code >= 2") != 5) {
+                throw TestFailure("wrong result from const array");
+        }
+
+        try {
+                db.exec("UPDATE parts SET price = 0");
+        } catch (Error &) {
+                return;
+        }
+
+        throw TestFailure("UPDATE of read-only table did not fail");
+}
+
+//--------------------------------------
+
+void
+wr::sql::VirtualTableTests::badColumns() // static
+{
+        Session            db(":memory:");
+        auto               parts = sampleParts();
+        VirtualTable<Part> table(parts);
+
+        try {
+                table.attach(db, "parts");
+                throw TestFailure("attach() without columns did not throw std::logic_error");
+        } catch (std::logic_error &) {
+        }
+
+        table.column("code", &Part::code, SORTED_KEY_COLUMN);
+
+        try {
+                table.column("price", &Part::price, SORTED_KEY_COLUMN);
+                throw TestFailure("second SORTED_KEY_COLUMN accepted");
+        } catch (std::invalid_argument &) {
+        }
+
+        try {
+                table.column("stock", &Part::stock, SORTED_KEY_COLUMN);
+                throw TestFailure("optional SORTED_KEY_COLUMN accepted");
+        } catch (std::invalid_argument &) {
+        }
+
+        table.attach(db, "parts");
+
+        try {
+                table.column("name", &Part::name);
+        } catch (std::logic_error &) {
+                return;
+        }
+
+        throw TestFailure("column() on attached table did not throw std::logic_error");
+}